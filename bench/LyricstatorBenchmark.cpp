@@ -0,0 +1,331 @@
+// Throughput benchmarks for the parsers and the equalizer, on inputs
+// generated here from a fixed seed so a run means the same thing on any
+// machine:
+//
+//   lyricstator_bench [--filter=<substring>] [--max-size=<bytes>] [--min-time=<seconds>]
+//
+// Each benchmark runs for at least --min-time (and at least once) and
+// reports the mean time per iteration. Sized benchmarks go from 1 KB to
+// --max-size (100 MB by default) in steps of ten.
+#include "scripting/LystrParser.h"
+#include "audio/MidiParser.h"
+#include "audio/Equalizer.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace Lyricstator {
+
+namespace {
+
+struct Options {
+    std::string filter;
+    size_t maxSize = 100 * 1000 * 1000;
+    double minTimeSeconds = 0.5;
+};
+
+// What one iteration processes, for the throughput column
+enum class Unit {
+    BYTES,
+    FRAMES
+};
+
+// One benchmark's input, built only if the benchmark is selected
+struct Case {
+    uint64_t itemsPerIteration;
+    std::function<size_t()> run;    // Returns something derived from the work, so it isn't optimized away
+};
+
+struct Benchmark {
+    std::string name;
+    Unit unit;
+    std::function<Case()> prepare;
+};
+
+volatile size_t g_sink = 0;
+
+std::string FormatSize(size_t bytes) {
+    if (bytes >= 1000 * 1000) {
+        return std::to_string(bytes / (1000 * 1000)) + "MB";
+    }
+    return std::to_string(bytes / 1000) + "KB";
+}
+
+std::vector<size_t> GetSizes(const Options& options) {
+    std::vector<size_t> sizes;
+    for (size_t size = 1000; size <= options.maxSize; size *= 10) {
+        sizes.push_back(size);
+    }
+    return sizes;
+}
+
+// A script of about `bytes` bytes using every command, named arguments,
+// comments, variables, constant and runtime if()s
+std::string GenerateLystrScript(size_t bytes) {
+    static const char* const kAnimations[] = {"glow", "pulse", "slide_left", "slide_up", "zoom_in"};
+    std::mt19937 rng(1234);
+    std::string script;
+    script.reserve(bytes + 256);
+    script += "# Generated benchmark script\nbase = 400\n";
+    for (uint32_t line = 0; script.size() < bytes; ++line) {
+        switch (rng() % 12) {
+            case 0:
+            case 1:
+            case 2:
+                script += "display(\"Line " + std::to_string(line) + " of the song\", " +
+                          std::to_string(500 + rng() % 4000) + ")\nwait(" + std::to_string(200 + rng() % 800) + ")\n";
+                break;
+            case 3:
+                script += "wait(" + std::to_string(100 + rng() % 2000) + ")\n";
+                break;
+            case 4:
+                script += "fade_in(duration=" + std::to_string(rng() % 1000) + ")\n";
+                break;
+            case 5:
+                script += "fade_out(" + std::to_string(rng() % 1000) + ");\n";
+                break;
+            case 6:
+                script += std::string("animate(\"") + kAnimations[rng() % 5] + "\", " +
+                          std::to_string(rng() % 3000) + ")\n";
+                break;
+            case 7:
+                script += "color(" + std::to_string(rng() % 256) + ", " + std::to_string(rng() % 256) + ", " +
+                          std::to_string(rng() % 256) + ")\n";
+                break;
+            case 8:
+                script += "position(base + " + std::to_string(rng() % 400) + ", " + std::to_string(rng() % 700) + ")\n";
+                break;
+            case 9:
+                script += "highlight(\"Line " + std::to_string(line) + "\")  // sung part\n";
+                break;
+            case 10:
+                script += "if (score > " + std::to_string(rng() % 100) + ") { display(\"Nice!\", 500) } else { highlight(\"Keep going\") }\n";
+                break;
+            case 11:
+                script += "if (base > 100) { wait(10) }\n";
+                break;
+        }
+    }
+    return script;
+}
+
+void AppendVariableLength(std::vector<uint8_t>& out, uint32_t value) {
+    uint8_t bytes[4];
+    int count = 0;
+    do {
+        bytes[count++] = value & 0x7F;
+        value >>= 7;
+    } while (value != 0 && count < 4);
+    while (count > 1) {
+        out.push_back(bytes[--count] | 0x80);
+    }
+    out.push_back(bytes[0]);
+}
+
+void AppendUInt32BE(std::vector<uint8_t>& out, uint32_t value) {
+    for (int shift = 24; shift >= 0; shift -= 8) {
+        out.push_back(static_cast<uint8_t>(value >> shift));
+    }
+}
+
+// A format 1 file of about `bytes` bytes: a tempo track, and note tracks
+// with lyrics, controller changes and running status
+std::vector<uint8_t> GenerateMidiFile(size_t bytes) {
+    const int kTracks = 4;
+    std::mt19937 rng(5678);
+    
+    std::vector<std::vector<uint8_t>> tracks(kTracks);
+    std::vector<uint8_t>& tempo = tracks[0];
+    tempo.insert(tempo.end(), {0x00, 0xFF, 0x58, 0x04, 0x04, 0x02, 0x18, 0x08});
+    
+    std::vector<uint8_t> runningStatus(kTracks, 0);
+    size_t total = 0;
+    while (total < bytes) {
+        size_t index = rng() % kTracks;
+        std::vector<uint8_t>& track = tracks[index];
+        size_t before = track.size();
+        AppendVariableLength(track, rng() % 4 == 0 ? 0 : rng() % 960);
+        if (index == 0) {
+            uint32_t microseconds = 300000 + rng() % 600000;
+            track.insert(track.end(), {0xFF, 0x51, 0x03, static_cast<uint8_t>(microseconds >> 16),
+                                       static_cast<uint8_t>(microseconds >> 8), static_cast<uint8_t>(microseconds)});
+        } else if (rng() % 8 == 0) {
+            std::string lyric = "la" + std::to_string(rng() % 1000);
+            track.insert(track.end(), {0xFF, 0x05});
+            AppendVariableLength(track, static_cast<uint32_t>(lyric.size()));
+            track.insert(track.end(), lyric.begin(), lyric.end());
+        } else {
+            uint8_t channel = static_cast<uint8_t>(index);
+            uint8_t status = static_cast<uint8_t>((rng() % 6 == 0 ? 0xB0 : (rng() % 2 ? 0x90 : 0x80)) | channel);
+            if (status != runningStatus[index]) {
+                track.push_back(status);
+                runningStatus[index] = status;
+            }
+            track.push_back(static_cast<uint8_t>(40 + rng() % 50));
+            track.push_back(static_cast<uint8_t>(rng() % 128));
+        }
+        total += track.size() - before;
+    }
+    
+    std::vector<uint8_t> file = {'M', 'T', 'h', 'd', 0, 0, 0, 6, 0, 1, 0, kTracks, 0x01, 0xE0};
+    for (std::vector<uint8_t>& track : tracks) {
+        track.insert(track.end(), {0x00, 0xFF, 0x2F, 0x00});
+        file.insert(file.end(), {'M', 'T', 'r', 'k'});
+        AppendUInt32BE(file, static_cast<uint32_t>(track.size()));
+        file.insert(file.end(), track.begin(), track.end());
+    }
+    return file;
+}
+
+void AddParserBenchmarks(std::vector<Benchmark>& benchmarks, const Options& options) {
+    for (size_t size : GetSizes(options)) {
+        benchmarks.push_back({"LystrLexer/" + FormatSize(size), Unit::BYTES, [size]() {
+            std::string script = GenerateLystrScript(size);
+            uint64_t bytes = script.size();
+            return Case{bytes, [script]() {
+                return Lexer(script).Tokenize().size();
+            }};
+        }});
+        
+        benchmarks.push_back({"LystrParser/" + FormatSize(size), Unit::BYTES, [size]() {
+            std::string script = GenerateLystrScript(size);
+            uint64_t bytes = script.size();
+            return Case{bytes, [script]() {
+                LystrParser parser;
+                parser.ParseString(script);
+                return parser.GetTimeline().GetSize();
+            }};
+        }});
+        
+        benchmarks.push_back({"MidiParser/" + FormatSize(size), Unit::BYTES, [size]() {
+            std::vector<uint8_t> midi = GenerateMidiFile(size);
+            uint64_t bytes = midi.size();
+            return Case{bytes, [midi]() {
+                MidiParser parser;
+                parser.LoadMidiData(midi.data(), midi.size());
+                return parser.GetNotes().size();
+            }};
+        }});
+    }
+}
+
+// One playback callback's worth of stereo through an equalizer with
+// `bands` log-spaced bands from 31 Hz to 16 kHz at alternating +/-6 dB.
+// The block is refilled from the same noise each time so the level stays
+// put however many passes run.
+void AddEqualizerBenchmarks(std::vector<Benchmark>& benchmarks) {
+    const int kFrames = 1024;
+    for (int bands : {10, 12, 31}) {
+        benchmarks.push_back({"Equalizer/" + std::to_string(bands) + "bands", Unit::FRAMES, [bands]() {
+            std::shared_ptr<Equalizer> equalizer = std::make_shared<Equalizer>();
+            equalizer->Configure(48000, 2);
+            equalizer->SetBandCount(bands);
+            for (int i = 0; i < bands; ++i) {
+                float frequency = 31.25f * std::pow(512.0f, i / static_cast<float>(bands - 1));
+                equalizer->SetBand(i, frequency, i % 2 == 0 ? 6.0f : -6.0f);
+            }
+            equalizer->SetEnabled(true);
+            
+            std::mt19937 rng(91011);
+            std::uniform_real_distribution<float> noise(-0.5f, 0.5f);
+            std::vector<float> input(kFrames * 2);
+            for (float& sample : input) {
+                sample = noise(rng);
+            }
+            
+            std::shared_ptr<std::vector<float>> buffer = std::make_shared<std::vector<float>>(input.size());
+            return Case{kFrames, [equalizer, input, buffer]() {
+                std::copy(input.begin(), input.end(), buffer->begin());
+                equalizer->Process(buffer->data(), kFrames);
+                return static_cast<size_t>((*buffer)[0] != 0.0f);
+            }};
+        }});
+    }
+}
+
+void Run(const Benchmark& benchmark, const Options& options) {
+    using Clock = std::chrono::steady_clock;
+    
+    Case input = benchmark.prepare();
+    
+    // The parsers log every run; keep that out of the timings and the table
+    std::streambuf* out = std::cout.rdbuf(nullptr);
+    std::streambuf* err = std::cerr.rdbuf(nullptr);
+    
+    uint64_t iterations = 0;
+    Clock::time_point start = Clock::now();
+    double elapsed = 0.0;
+    do {
+        g_sink = g_sink + input.run();
+        ++iterations;
+        elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+    } while (elapsed < options.minTimeSeconds);
+    
+    std::cout.rdbuf(out);
+    std::cerr.rdbuf(err);
+    
+    double perIteration = elapsed / iterations;
+    if (benchmark.unit == Unit::BYTES) {
+        double megabytesPerSecond = input.itemsPerIteration / perIteration / 1e6;
+        std::printf("%-28s %12.3f ms %10llu %12.2f MB/s\n", benchmark.name.c_str(), perIteration * 1e3,
+                    static_cast<unsigned long long>(iterations), megabytesPerSecond);
+    } else {
+        double nanosecondsPerFrame = perIteration * 1e9 / input.itemsPerIteration;
+        std::printf("%-28s %12.3f ms %10llu %12.2f ns/frame\n", benchmark.name.c_str(), perIteration * 1e3,
+                    static_cast<unsigned long long>(iterations), nanosecondsPerFrame);
+    }
+    std::fflush(stdout);
+}
+
+bool ParseOptions(int argc, char** argv, Options& options) {
+    for (int i = 1; i < argc; ++i) {
+        const char* argument = argv[i];
+        if (std::strncmp(argument, "--filter=", 9) == 0) {
+            options.filter = argument + 9;
+        } else if (std::strncmp(argument, "--max-size=", 11) == 0) {
+            options.maxSize = std::strtoull(argument + 11, nullptr, 10);
+        } else if (std::strncmp(argument, "--min-time=", 11) == 0) {
+            options.minTimeSeconds = std::strtod(argument + 11, nullptr);
+        } else {
+            std::fprintf(stderr, "Usage: %s [--filter=<substring>] [--max-size=<bytes>] [--min-time=<seconds>]\n",
+                         argv[0]);
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+} // namespace Lyricstator
+
+int main(int argc, char** argv) {
+    using namespace Lyricstator;
+    
+    Options options;
+    if (!ParseOptions(argc, argv, options)) {
+        return 1;
+    }
+    
+    std::vector<Benchmark> benchmarks;
+    AddParserBenchmarks(benchmarks, options);
+    AddEqualizerBenchmarks(benchmarks);
+    
+    std::printf("%-28s %15s %10s %15s\n", "Benchmark", "Time", "Iterations", "Throughput");
+    for (const Benchmark& benchmark : benchmarks) {
+        if (benchmark.name.find(options.filter) != std::string::npos) {
+            Run(benchmark, options);
+        }
+    }
+    return 0;
+}
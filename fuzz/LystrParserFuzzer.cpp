@@ -0,0 +1,54 @@
+// libFuzzer target for the Lystr front end: parses the input as a script,
+// then uses its last bytes to make one edit and re-parse incrementally, and
+// plays whatever compiled through the interpreter, seeking around it.
+#include "scripting/LystrParser.h"
+#include "scripting/LystrInterpreter.h"
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <string>
+
+using namespace Lyricstator;
+
+extern "C" int LLVMFuzzerInitialize(int*, char***) {
+    // The parser and interpreter report to stdout/stderr on every input
+    std::cout.setstate(std::ios::failbit);
+    std::cerr.setstate(std::ios::failbit);
+    return 0;
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+    // Four trailing bytes pick an edit: position, removed length and how
+    // much of the input to insert
+    const size_t kEditBytes = 4;
+    std::string source(reinterpret_cast<const char*>(data), size);
+    std::string edit;
+    size_t position = 0;
+    size_t removed = 0;
+    if (size > kEditBytes) {
+        const uint8_t* control = data + size - kEditBytes;
+        source.resize(size - kEditBytes);
+        position = (control[0] | (control[1] << 8)) % (source.size() + 1);
+        removed = control[2] % (source.size() - position + 1);
+        edit = source.substr(0, control[3] % (source.size() + 1));
+    }
+    
+    LystrParser parser;
+    parser.ParseString(source);
+    parser.GetCommands();
+    parser.GetValidationErrors(1);
+    parser.ApplyEdit(position, removed, edit);
+    
+    const LystrTimeline& timeline = parser.GetTimeline();
+    LystrInterpreter interpreter;
+    interpreter.LoadScript(timeline);
+    uint32_t endMs = timeline.IsEmpty() ? 0 : timeline.GetInstructions().back().time;
+    for (uint32_t step = 0; step <= 4; ++step) {
+        uint32_t timeMs = static_cast<uint32_t>(uint64_t(endMs) * step / 4);
+        interpreter.Update(timeMs);
+        interpreter.Animate(timeMs);
+    }
+    interpreter.Seek(endMs / 2);
+    interpreter.Animate(endMs / 2);
+    return 0;
+}
@@ -0,0 +1,29 @@
+// libFuzzer target for MidiParser: parses the input as a whole .mid file
+// from memory and queries everything derived from it.
+#include "audio/MidiParser.h"
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+
+using namespace Lyricstator;
+
+extern "C" int LLVMFuzzerInitialize(int*, char***) {
+    // The parser logs every track it reads
+    std::cout.setstate(std::ios::failbit);
+    std::cerr.setstate(std::ios::failbit);
+    return 0;
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+    MidiParser parser;
+    if (!parser.LoadMidiData(data, size)) {
+        return 0;
+    }
+    
+    uint32_t durationTicks = parser.GetDurationTicks();
+    parser.GetDurationMs();
+    parser.GetNoteRange();
+    parser.GetCurrentBPM(durationTicks / 2);
+    parser.MillisecondsToTicks(parser.TicksToMilliseconds(durationTicks));
+    return 0;
+}
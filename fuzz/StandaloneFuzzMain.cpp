@@ -0,0 +1,26 @@
+// Runs a fuzz target over the files named on the command line, for
+// compilers without libFuzzer and for replaying crashes and corpora.
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <vector>
+
+extern "C" int LLVMFuzzerInitialize(int* argc, char*** argv);
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size);
+
+int main(int argc, char** argv) {
+    LLVMFuzzerInitialize(&argc, &argv);
+    for (int i = 1; i < argc; ++i) {
+        std::ifstream file(argv[i], std::ios::binary);
+        if (!file.is_open()) {
+            std::fprintf(stderr, "Cannot open %s\n", argv[i]);
+            return 1;
+        }
+        std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        LLVMFuzzerTestOneInput(data.data(), data.size());
+        std::fprintf(stderr, "Ran %s (%zu bytes)\n", argv[i], data.size());
+    }
+    return 0;
+}
@@ -1,4 +1,5 @@
 #include "ai/NoteDetector.h"
+#include "ai/NoteTracker.h"
 #include <iostream>
 #include <algorithm>
 #include <cmath>
@@ -137,6 +138,8 @@ NoteDetector::NoteDetector()
     : currentAlgorithmPtr_(nullptr)
     , currentAlgorithm_(Algorithm::YIN)
     , sampleRate_(44100)
+    , analysisSampleRate_(44100)
+    , inputBufferSize_(1024)
     , bufferSize_(1024)
     , writeIndex_(0)
     , bufferFull_(false)
@@ -161,11 +164,10 @@ bool NoteDetector::Initialize(int sampleRate, int bufferSize) {
     std::cout << "Initializing NoteDetector..." << std::endl;
     
     sampleRate_ = sampleRate;
-    bufferSize_ = bufferSize;
+    inputBufferSize_ = bufferSize;
     
-    // Initialize audio buffers
-    audioBuffer_.resize(bufferSize_ * 2); // Double buffer for overlap
-    processBuffer_.resize(bufferSize_);
+    // Set up decimation and size the analysis buffers for the reduced rate
+    ConfigureAnalysisRate();
     
     // Create algorithm instances
     yinAlgorithm_ = std::make_unique<YinAlgorithm>();
@@ -177,12 +179,13 @@ bool NoteDetector::Initialize(int sampleRate, int bufferSize) {
     
     // Initialize detection state
     lastResult_ = {};
+    latestResult_.Store(lastResult_);
     detectionHistory_.clear();
     detectionHistory_.reserve(1000);
     
     initialized_ = true;
     std::cout << "NoteDetector initialized successfully" << std::endl;
-    std::cout << "Sample Rate: " << sampleRate_ << " Hz" << std::endl;
+    std::cout << "Sample Rate: " << sampleRate_ << " Hz (analysis at " << analysisSampleRate_ << " Hz)" << std::endl;
     std::cout << "Buffer Size: " << bufferSize_ << " samples" << std::endl;
     std::cout << "Algorithm: " << currentAlgorithmPtr_->GetAlgorithmName() << std::endl;
     
@@ -199,12 +202,45 @@ void NoteDetector::Shutdown() {
     
     audioBuffer_.clear();
     processBuffer_.clear();
+    resampleBuffer_.clear();
     detectionHistory_.clear();
     
     initialized_ = false;
     std::cout << "NoteDetector shutdown complete" << std::endl;
 }
 
+void NoteDetector::SetInputSampleRate(int sampleRate) {
+    if (sampleRate <= 0 || sampleRate == sampleRate_) {
+        return;
+    }
+    
+    sampleRate_ = sampleRate;
+    if (initialized_) {
+        ConfigureAnalysisRate();
+        if (currentAlgorithmPtr_) {
+            currentAlgorithmPtr_->Reset();
+        }
+        std::cout << "NoteDetector input rate changed to " << sampleRate_ 
+                  << " Hz (analysis at " << analysisSampleRate_ << " Hz)" << std::endl;
+    }
+}
+
+void NoteDetector::ConfigureAnalysisRate() {
+    resampler_.Configure(sampleRate_, kAnalysisSampleRate);
+    analysisSampleRate_ = resampler_.GetOutputRate();
+    
+    // Keep the analysis window the same length in time as the requested
+    // device-rate window, which now needs far fewer samples
+    bufferSize_ = std::max(256, static_cast<int>(
+        static_cast<long long>(inputBufferSize_) * analysisSampleRate_ / sampleRate_));
+    
+    audioBuffer_.assign(bufferSize_ * 2, 0.0f); // Double buffer for overlap
+    processBuffer_.assign(bufferSize_, 0.0f);
+    resampleBuffer_.resize(resampler_.GetMaxOutputSamples(inputBufferSize_));
+    writeIndex_ = 0;
+    bufferFull_ = false;
+}
+
 void NoteDetector::SetAlgorithm(Algorithm algorithm) {
     currentAlgorithm_ = algorithm;
     
@@ -253,11 +289,18 @@ void NoteDetector::SetConfidenceThreshold(float threshold) {
 }
 
 void NoteDetector::ProcessAudioBuffer(const float* samples, int numSamples) {
-    if (!initialized_ || !samples) return;
+    if (!initialized_ || !samples || numSamples <= 0) return;
+    
+    // Decimate to the analysis rate before buffering
+    int maxOutput = resampler_.GetMaxOutputSamples(numSamples);
+    if (maxOutput > static_cast<int>(resampleBuffer_.size())) {
+        resampleBuffer_.resize(maxOutput);
+    }
+    int numDecimated = resampler_.Process(samples, numSamples, resampleBuffer_.data());
     
     // Add samples to circular buffer
-    for (int i = 0; i < numSamples; ++i) {
-        audioBuffer_[writeIndex_] = samples[i];
+    for (int i = 0; i < numDecimated; ++i) {
+        audioBuffer_[writeIndex_] = resampleBuffer_[i];
         writeIndex_ = (writeIndex_ + 1) % audioBuffer_.size();
         
         if (writeIndex_ == 0) {
@@ -270,13 +313,13 @@ void NoteDetector::ProcessAudioBuffer(const std::vector<float>& samples) {
     ProcessAudioBuffer(samples.data(), static_cast<int>(samples.size()));
 }
 
-PitchDetectionResult NoteDetector::DetectPitch() {
+PitchDetectionResult NoteDetector::DetectPitch(uint32_t timestampMs) {
     if (!initialized_ || !currentAlgorithmPtr_ || !bufferFull_) {
         return lastResult_;
     }
     
-    // Copy audio data to process buffer
-    int readIndex = writeIndex_;
+    // Copy the most recent window to the process buffer
+    int readIndex = (writeIndex_ + static_cast<int>(audioBuffer_.size()) - bufferSize_) % audioBuffer_.size();
     for (int i = 0; i < bufferSize_; ++i) {
         processBuffer_[i] = audioBuffer_[readIndex];
         readIndex = (readIndex + 1) % audioBuffer_.size();
@@ -291,8 +334,8 @@ PitchDetectionResult NoteDetector::DetectPitch() {
     float voiceActivity = CalculateVoiceActivity(processBuffer_);
     
     // Detect pitch using current algorithm
-    PitchDetectionResult rawResult = currentAlgorithmPtr_->DetectPitch(processBuffer_, sampleRate_);
-    rawResult.timestamp = 0; // Will be set by caller if needed
+    PitchDetectionResult rawResult = currentAlgorithmPtr_->DetectPitch(processBuffer_, analysisSampleRate_);
+    rawResult.timestamp = timestampMs;
     
     // Apply voice activity detection
     if (voiceActivity < voiceActivityThreshold_) {
@@ -308,9 +351,10 @@ PitchDetectionResult NoteDetector::DetectPitch() {
     lastResult_ = filteredResult;
     UpdateDetectionHistory(filteredResult);
     
-    // Call callback if in real-time mode
-    if (realTimeMode_ && detectionCallback_) {
-        detectionCallback_(filteredResult);
+    // Publish without blocking; consumers read at their own rate
+    latestResult_.Store(filteredResult);
+    if (realTimeMode_) {
+        resultQueue_.Push(filteredResult);
     }
     
     // Store calibration data if calibrating
@@ -345,7 +389,8 @@ float NoteDetector::GetAverageConfidence(int windowSize) const {
 }
 
 bool NoteDetector::IsVoiceActive() const {
-    return lastResult_.voiceDetected && lastResult_.confidence > confidenceThreshold_;
+    PitchDetectionResult latest = latestResult_.Load();
+    return latest.voiceDetected && latest.confidence > confidenceThreshold_;
 }
 
 void NoteDetector::StartCalibration() {
@@ -415,10 +460,6 @@ void NoteDetector::SetRealTimeMode(bool enabled) {
     realTimeMode_ = enabled;
 }
 
-void NoteDetector::SetCallback(std::function<void(const PitchDetectionResult&)> callback) {
-    detectionCallback_ = callback;
-}
-
 // Private methods implementation
 void NoteDetector::UpdateDetectionHistory(const PitchDetectionResult& result) {
     detectionHistory_.push_back(result);
@@ -517,21 +558,16 @@ void NoteDetector::RemoveDCOffset(std::vector<float>& samples) {
 }
 
 float NoteDetector::HzToMidi(float frequency) {
-    return 69.0f + 12.0f * std::log2(frequency / 440.0f);
+    return NoteTracker::HzToMidi(frequency);
 }
 
 float NoteDetector::MidiToHz(int midiNote) {
-    return 440.0f * std::pow(2.0f, (midiNote - 69) / 12.0f);
+    return NoteTracker::MidiToHz(static_cast<float>(midiNote));
 }
 
 std::string NoteDetector::FrequencyToNoteName(float frequency) {
-    static const char* noteNames[] = {"C", "C#", "D", "D#", "E", "F", "F#", "G", "G#", "A", "A#", "B"};
-    
     int midiNote = static_cast<int>(std::round(HzToMidi(frequency)));
-    int octave = (midiNote / 12) - 1;
-    int noteIndex = midiNote % 12;
-    
-    return std::string(noteNames[noteIndex]) + std::to_string(octave);
+    return NoteTracker::GetNoteName(midiNote);
 }
 
 } // namespace Lyricstator
@@ -1,8 +1,9 @@
 #pragma once
 #include "common/Types.h"
+#include "common/LockFree.h"
+#include "ai/PolyphaseResampler.h"
 #include <vector>
 #include <memory>
-#include <functional>
 
 namespace Lyricstator {
 
@@ -66,12 +67,18 @@ public:
         HYBRID
     };
     
+    // Detection runs at this rate regardless of the device rate
+    static constexpr int kAnalysisSampleRate = 16000;
+    
     NoteDetector();
     ~NoteDetector();
     
-    // Initialization
+    // Initialization (sampleRate/bufferSize describe the incoming device audio)
     bool Initialize(int sampleRate = 44100, int bufferSize = 1024);
     void Shutdown();
+    void SetInputSampleRate(int sampleRate);
+    int GetInputSampleRate() const { return sampleRate_; }
+    int GetAnalysisSampleRate() const { return analysisSampleRate_; }
     
     // Algorithm selection
     void SetAlgorithm(Algorithm algorithm);
@@ -87,9 +94,16 @@ public:
     void ProcessAudioBuffer(const float* samples, int numSamples);
     void ProcessAudioBuffer(const std::vector<float>& samples);
     
-    // Detection results
-    PitchDetectionResult DetectPitch();
-    PitchDetectionResult GetLastDetection() const { return lastResult_; }
+    // Detection results (DetectPitch runs on the analysis thread)
+    PitchDetectionResult DetectPitch(uint32_t timestampMs = 0);
+    
+    // Publication - safe to call from any thread while DetectPitch runs.
+    // Each consumer (UI, scoring, recording) subscribes its own cursor.
+    using ResultCursor = BroadcastQueue<PitchDetectionResult, 256>::Cursor;
+    PitchDetectionResult GetLastDetection() const { return latestResult_.Load(); }
+    uint32_t GetDetectionCount() const { return latestResult_.GetVersion(); }
+    ResultCursor SubscribeResults() const { return resultQueue_.Subscribe(); }
+    bool PollResult(ResultCursor& cursor, PitchDetectionResult& result) const { return resultQueue_.Pop(cursor, result); }
     
     // Analysis features
     std::vector<PitchDetectionResult> GetDetectionHistory(int maxResults = 100) const;
@@ -103,9 +117,8 @@ public:
     bool SaveCalibrationData(const std::string& filepath);
     bool LoadCalibrationData(const std::string& filepath);
     
-    // Real-time processing
+    // Real-time processing (queue every result, not just the latest)
     void SetRealTimeMode(bool enabled);
-    void SetCallback(std::function<void(const PitchDetectionResult&)> callback);
     
 private:
     // Algorithm instances
@@ -116,10 +129,14 @@ private:
     Algorithm currentAlgorithm_;
     
     // Audio processing
+    PolyphaseResampler resampler_;
+    std::vector<float> resampleBuffer_;
     std::vector<float> audioBuffer_;
     std::vector<float> processBuffer_;
-    int sampleRate_;
-    int bufferSize_;
+    int sampleRate_;            // Device input rate
+    int analysisSampleRate_;    // Rate after decimation
+    int inputBufferSize_;       // Window length requested at the device rate
+    int bufferSize_;            // Window length at the analysis rate
     int writeIndex_;
     bool bufferFull_;
     
@@ -129,7 +146,7 @@ private:
     float maxFrequency_;
     float confidenceThreshold_;
     
-    // Detection state
+    // Detection state (analysis thread only)
     PitchDetectionResult lastResult_;
     std::vector<PitchDetectionResult> detectionHistory_;
     bool initialized_;
@@ -144,10 +161,12 @@ private:
     bool calibrating_;
     std::vector<PitchDetectionResult> calibrationData_;
     
-    // Callback for real-time processing
-    std::function<void(const PitchDetectionResult&)> detectionCallback_;
+    // Lock-free publication to consumers on other threads
+    SeqLock<PitchDetectionResult> latestResult_;
+    BroadcastQueue<PitchDetectionResult, 256> resultQueue_;
     
     // Internal methods
+    void ConfigureAnalysisRate();
     void UpdateDetectionHistory(const PitchDetectionResult& result);
     bool IsValidFrequency(float frequency) const;
     float CalculateVoiceActivity(const std::vector<float>& samples);
@@ -0,0 +1,224 @@
+#include "ai/NoteTracker.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+namespace Lyricstator {
+
+namespace {
+
+const int kLog2TableSize = 256;     // Mantissa resolution for HzToMidi
+const int kExp2TableSize = 64;      // Per-semitone resolution for MidiToHz
+
+struct PitchTables {
+    float log2Mantissa[kLog2TableSize + 1];   // log2(m) for m in [0.5, 1]
+    float semitoneRatio[12];                  // 2^(k/12)
+    float fractionRatio[kExp2TableSize + 1];  // 2^(f/12) for f in [0, 1]
+    char noteNames[128][5];
+    
+    PitchTables() {
+        for (int i = 0; i <= kLog2TableSize; ++i) {
+            log2Mantissa[i] = static_cast<float>(std::log2(0.5 + 0.5 * i / kLog2TableSize));
+        }
+        for (int k = 0; k < 12; ++k) {
+            semitoneRatio[k] = static_cast<float>(std::pow(2.0, k / 12.0));
+        }
+        for (int i = 0; i <= kExp2TableSize; ++i) {
+            fractionRatio[i] = static_cast<float>(std::pow(2.0, (static_cast<double>(i) / kExp2TableSize) / 12.0));
+        }
+        
+        static const char* names[] = {"C", "C#", "D", "D#", "E", "F", "F#", "G", "G#", "A", "A#", "B"};
+        for (int note = 0; note < 128; ++note) {
+            std::snprintf(noteNames[note], sizeof(noteNames[note]), "%s%d", names[note % 12], note / 12 - 1);
+        }
+    }
+};
+
+const PitchTables& Tables() {
+    static const PitchTables tables;
+    return tables;
+}
+
+} // namespace
+
+NoteTracker::NoteTracker()
+    : hysteresisCents_(30.0f)
+    , onsetFrames_(3)
+    , releaseFrames_(4)
+    , minConfidence_(0.5f)
+{
+    Reset();
+}
+
+void NoteTracker::SetHysteresisCents(float cents) {
+    hysteresisCents_ = std::max(0.0f, std::min(50.0f, cents));
+}
+
+void NoteTracker::SetOnsetFrames(int frames) {
+    onsetFrames_ = std::max(1, frames);
+}
+
+void NoteTracker::SetReleaseFrames(int frames) {
+    releaseFrames_ = std::max(1, frames);
+}
+
+void NoteTracker::SetMinConfidence(float confidence) {
+    minConfidence_ = std::max(0.0f, std::min(1.0f, confidence));
+}
+
+void NoteTracker::Reset() {
+    noteActive_ = false;
+    currentNote_ = 0;
+    currentOnset_ = 0;
+    centsAverage_ = 0.0f;
+    centsSamples_ = 0;
+    jitterAverage_ = 0.0f;
+    lastCents_ = 0.0f;
+    unvoicedFrames_ = 0;
+    ClearCandidate();
+}
+
+int NoteTracker::Process(const PitchDetectionResult& result, uint32_t timeMs, SungNoteEvent* events) {
+    int count = 0;
+    
+    bool voiced = result.voiceDetected && result.confidence >= minConfidence_ && result.frequency > 0.0f;
+    if (!voiced) {
+        ClearCandidate();
+        if (noteActive_ && ++unvoicedFrames_ >= releaseFrames_) {
+            EndNote(timeMs, events[count++]);
+        }
+        return count;
+    }
+    
+    unvoicedFrames_ = 0;
+    float midi = HzToMidi(result.frequency);
+    int nearest = static_cast<int>(std::floor(midi + 0.5f));
+    nearest = std::max(0, std::min(127, nearest));
+    
+    if (noteActive_) {
+        float deviation = (midi - currentNote_) * 100.0f;
+        if (std::fabs(deviation) <= 50.0f + hysteresisCents_) {
+            // Still the same note - fold into the running statistics
+            ClearCandidate();
+            ++centsSamples_;
+            centsAverage_ += (deviation - centsAverage_) / centsSamples_;
+            jitterAverage_ += (std::fabs(deviation - lastCents_) - jitterAverage_) * 0.2f;
+            lastCents_ = deviation;
+            return count;
+        }
+    }
+    
+    float cents = (midi - nearest) * 100.0f;
+    TrackCandidate(nearest, cents, timeMs);
+    
+    if (candidateFrames_ >= onsetFrames_) {
+        if (noteActive_) {
+            EndNote(candidateOnset_, events[count++]);
+        }
+        StartNote(static_cast<uint8_t>(candidateNote_), candidateOnset_,
+                  candidateCentsSum_ / candidateFrames_, timeMs, events[count++]);
+        ClearCandidate();
+    }
+    
+    return count;
+}
+
+float NoteTracker::GetCurrentStability() const {
+    if (!noteActive_) return 0.0f;
+    // 0 cents of frame-to-frame jitter is perfectly stable, 50 is hopeless
+    return std::max(0.0f, std::min(1.0f, 1.0f - jitterAverage_ / 50.0f));
+}
+
+void NoteTracker::StartNote(uint8_t note, uint32_t onsetTime, float cents, uint32_t timeMs, SungNoteEvent& event) {
+    noteActive_ = true;
+    currentNote_ = note;
+    currentOnset_ = onsetTime;
+    centsAverage_ = cents;
+    centsSamples_ = candidateFrames_;
+    jitterAverage_ = 0.0f;
+    lastCents_ = cents;
+    
+    event.type = SungNoteEventType::NOTE_ON;
+    event.midiNote = note;
+    event.cents = static_cast<int16_t>(std::lround(cents));
+    event.onsetTime = onsetTime;
+    event.timestamp = timeMs;
+    event.stability = 1.0f;
+}
+
+void NoteTracker::EndNote(uint32_t timeMs, SungNoteEvent& event) {
+    event.type = SungNoteEventType::NOTE_OFF;
+    event.midiNote = currentNote_;
+    event.cents = static_cast<int16_t>(std::lround(centsAverage_));
+    event.onsetTime = currentOnset_;
+    event.timestamp = timeMs;
+    event.stability = GetCurrentStability();
+    
+    noteActive_ = false;
+    unvoicedFrames_ = 0;
+}
+
+void NoteTracker::TrackCandidate(int note, float cents, uint32_t timeMs) {
+    if (note == candidateNote_) {
+        ++candidateFrames_;
+        candidateCentsSum_ += cents;
+    } else {
+        candidateNote_ = note;
+        candidateFrames_ = 1;
+        candidateOnset_ = timeMs;
+        candidateCentsSum_ = cents;
+    }
+}
+
+void NoteTracker::ClearCandidate() {
+    candidateNote_ = -1;
+    candidateFrames_ = 0;
+    candidateOnset_ = 0;
+    candidateCentsSum_ = 0.0f;
+}
+
+float NoteTracker::HzToMidi(float frequency) {
+    if (!(frequency > 0.0f) || !std::isfinite(frequency)) return 0.0f;
+    
+    // frequency = mantissa * 2^exponent with mantissa in [0.5, 1)
+    int exponent = 0;
+    float mantissa = std::frexp(frequency, &exponent);
+    
+    const PitchTables& tables = Tables();
+    float position = (mantissa - 0.5f) * 2.0f * kLog2TableSize;
+    int index = std::min(static_cast<int>(position), kLog2TableSize - 1);
+    float fraction = position - index;
+    float log2Mantissa = tables.log2Mantissa[index] +
+        (tables.log2Mantissa[index + 1] - tables.log2Mantissa[index]) * fraction;
+    
+    // 69 + 12 * log2(f / 440), with log2(440) folded into the constant
+    const float log2A4 = 8.78135971f;
+    return 69.0f + 12.0f * (exponent + log2Mantissa - log2A4);
+}
+
+float NoteTracker::MidiToHz(float midiNote) {
+    const PitchTables& tables = Tables();
+    
+    float semitones = midiNote - 69.0f;
+    int whole = static_cast<int>(std::floor(semitones));
+    float fraction = semitones - whole;
+    
+    // Split whole semitones into octaves plus 0-11
+    int octave = whole >= 0 ? whole / 12 : -((11 - whole) / 12);
+    int semitone = whole - octave * 12;
+    
+    float position = fraction * kExp2TableSize;
+    int index = std::min(static_cast<int>(position), kExp2TableSize - 1);
+    float blend = position - index;
+    float fractionRatio = tables.fractionRatio[index] +
+        (tables.fractionRatio[index + 1] - tables.fractionRatio[index]) * blend;
+    
+    return std::ldexp(440.0f * tables.semitoneRatio[semitone] * fractionRatio, octave);
+}
+
+const char* NoteTracker::GetNoteName(int midiNote) {
+    midiNote = std::max(0, std::min(127, midiNote));
+    return Tables().noteNames[midiNote];
+}
+
+} // namespace Lyricstator
@@ -0,0 +1,69 @@
+#pragma once
+#include "common/Types.h"
+
+namespace Lyricstator {
+
+// Turns the per-frame output of NoteDetector into sung note on/off events.
+// A note only starts after a few consistent voiced frames and only changes
+// once the pitch has left the current note by more than the hysteresis band,
+// so vibrato and detector jitter don't produce a stream of note changes.
+class NoteTracker {
+public:
+    // A single frame can end one note and start another
+    static constexpr int kMaxEventsPerFrame = 2;
+    
+    NoteTracker();
+    
+    // Tuning
+    void SetHysteresisCents(float cents);   // Extra margin beyond +/-50 cents
+    void SetOnsetFrames(int frames);        // Consistent frames before NOTE_ON
+    void SetReleaseFrames(int frames);      // Unvoiced frames before NOTE_OFF
+    void SetMinConfidence(float confidence);
+    void Reset();
+    
+    // Feed one detection result. Writes up to kMaxEventsPerFrame events to
+    // `events` and returns how many were written.
+    int Process(const PitchDetectionResult& result, uint32_t timeMs, SungNoteEvent* events);
+    
+    // Current state
+    bool IsNoteActive() const { return noteActive_; }
+    uint8_t GetCurrentNote() const { return currentNote_; }
+    float GetCurrentCents() const { return centsAverage_; }
+    float GetCurrentStability() const;
+    
+    // Table-driven pitch conversions (no log2/pow per call)
+    static float HzToMidi(float frequency);
+    static float MidiToHz(float midiNote);
+    static const char* GetNoteName(int midiNote); // e.g. "A4", static storage
+
+private:
+    // Tuning
+    float hysteresisCents_;
+    int onsetFrames_;
+    int releaseFrames_;
+    float minConfidence_;
+    
+    // Active note
+    bool noteActive_;
+    uint8_t currentNote_;
+    uint32_t currentOnset_;
+    float centsAverage_;
+    int centsSamples_;
+    float jitterAverage_;
+    float lastCents_;
+    
+    // Candidate for the next note (onset or note change)
+    int candidateNote_;
+    int candidateFrames_;
+    uint32_t candidateOnset_;
+    float candidateCentsSum_;
+    
+    int unvoicedFrames_;
+    
+    void StartNote(uint8_t note, uint32_t onsetTime, float cents, uint32_t timeMs, SungNoteEvent& event);
+    void EndNote(uint32_t timeMs, SungNoteEvent& event);
+    void TrackCandidate(int note, float cents, uint32_t timeMs);
+    void ClearCandidate();
+};
+
+} // namespace Lyricstator
@@ -0,0 +1,184 @@
+#include "ai/PolyphaseResampler.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define LYRICSTATOR_RESAMPLER_SSE 1
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define LYRICSTATOR_RESAMPLER_NEON 1
+#endif
+
+namespace Lyricstator {
+
+namespace {
+// Above this many phases the filter bank gets silly (e.g. 44056 -> 16000),
+// so fall back to plain integer decimation.
+const int kMaxPhases = 256;
+}
+
+PolyphaseResampler::PolyphaseResampler()
+    : inputRate_(44100)
+    , outputRate_(44100)
+    , interpolation_(1)
+    , decimation_(1)
+    , tapsPerPhase_(24)
+    , historySize_(0)
+    , readIndex_(0)
+    , phase_(0)
+{
+}
+
+bool PolyphaseResampler::Configure(int inputRate, int targetOutputRate, int tapsPerPhase) {
+    if (inputRate <= 0 || targetOutputRate <= 0 || tapsPerPhase <= 0) {
+        return false;
+    }
+    
+    inputRate_ = inputRate;
+    tapsPerPhase_ = tapsPerPhase;
+    
+    if (targetOutputRate >= inputRate) {
+        // Never upsample for analysis - just pass through
+        interpolation_ = 1;
+        decimation_ = 1;
+    } else {
+        int gcd = GreatestCommonDivisor(inputRate, targetOutputRate);
+        interpolation_ = targetOutputRate / gcd;
+        decimation_ = inputRate / gcd;
+        
+        if (interpolation_ > kMaxPhases) {
+            interpolation_ = 1;
+            decimation_ = std::max(1, static_cast<int>(std::lround(static_cast<double>(inputRate) / targetOutputRate)));
+        }
+    }
+    
+    outputRate_ = static_cast<int>(static_cast<long long>(inputRate_) * interpolation_ / decimation_);
+    
+    // Steeper decimation needs a longer filter to keep the passband flat
+    int stride = (decimation_ + interpolation_ - 1) / interpolation_;
+    tapsPerPhase_ = std::max(tapsPerPhase_, 8 * stride);
+    
+    DesignFilter();
+    Reset();
+    return true;
+}
+
+void PolyphaseResampler::Reset() {
+    // Prime with silence so the first output has a full history behind it
+    history_.assign(std::max<size_t>(history_.size(), tapsPerPhase_ * 4), 0.0f);
+    historySize_ = tapsPerPhase_ - 1;
+    readIndex_ = tapsPerPhase_ - 1;
+    phase_ = 0;
+}
+
+int PolyphaseResampler::GetMaxOutputSamples(int numInput) const {
+    return static_cast<int>((static_cast<long long>(numInput) * interpolation_) / decimation_) + 1;
+}
+
+int PolyphaseResampler::Process(const float* input, int numInput, float* output) {
+    if (!input || !output || numInput <= 0) {
+        return 0;
+    }
+    
+    if (IsPassthrough()) {
+        std::memcpy(output, input, numInput * sizeof(float));
+        return numInput;
+    }
+    
+    // Append new input after the retained history
+    if (historySize_ + numInput > static_cast<int>(history_.size())) {
+        history_.resize(historySize_ + numInput);
+    }
+    std::memcpy(history_.data() + historySize_, input, numInput * sizeof(float));
+    historySize_ += numInput;
+    
+    int written = 0;
+    const int taps = tapsPerPhase_;
+    while (readIndex_ < historySize_) {
+        const float* coeffs = phaseBank_.data() + phase_ * taps;
+        const float* samples = history_.data() + readIndex_ - taps + 1;
+        output[written++] = DotProduct(coeffs, samples, taps);
+        
+        phase_ += decimation_;
+        readIndex_ += phase_ / interpolation_;
+        phase_ %= interpolation_;
+    }
+    
+    // Drop input that no future output can reach
+    int keepStart = std::min(readIndex_ - (taps - 1), historySize_);
+    if (keepStart > 0) {
+        std::memmove(history_.data(), history_.data() + keepStart, (historySize_ - keepStart) * sizeof(float));
+        historySize_ -= keepStart;
+        readIndex_ -= keepStart;
+    }
+    
+    return written;
+}
+
+void PolyphaseResampler::DesignFilter() {
+    const int phases = interpolation_;
+    const int taps = tapsPerPhase_;
+    const int length = phases * taps;
+    
+    // Windowed-sinc lowpass at the upsampled rate, cutoff just under the
+    // output Nyquist (10% transition band is fine for pitch analysis)
+    const double cutoff = 0.45 / std::max(interpolation_, decimation_);
+    const double center = (length - 1) * 0.5;
+    
+    std::vector<double> prototype(length);
+    for (int k = 0; k < length; ++k) {
+        double t = k - center;
+        double sinc = (t == 0.0) ? 2.0 * cutoff : std::sin(2.0 * M_PI * cutoff * t) / (M_PI * t);
+        double window = 0.42 - 0.5 * std::cos(2.0 * M_PI * k / (length - 1))
+                             + 0.08 * std::cos(4.0 * M_PI * k / (length - 1));
+        prototype[k] = sinc * window * phases;
+    }
+    
+    // Split into phases, time-reversed within each phase
+    phaseBank_.assign(length, 0.0f);
+    for (int p = 0; p < phases; ++p) {
+        for (int i = 0; i < taps; ++i) {
+            phaseBank_[p * taps + i] = static_cast<float>(prototype[p + (taps - 1 - i) * phases]);
+        }
+    }
+}
+
+int PolyphaseResampler::GreatestCommonDivisor(int a, int b) {
+    while (b != 0) {
+        int t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+float PolyphaseResampler::DotProduct(const float* a, const float* b, int count) {
+    int i = 0;
+    float sum = 0.0f;
+
+#if defined(LYRICSTATOR_RESAMPLER_SSE)
+    __m128 acc = _mm_setzero_ps();
+    for (; i + 4 <= count; i += 4) {
+        acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+    }
+    float lanes[4];
+    _mm_storeu_ps(lanes, acc);
+    sum = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+#elif defined(LYRICSTATOR_RESAMPLER_NEON)
+    float32x4_t acc = vdupq_n_f32(0.0f);
+    for (; i + 4 <= count; i += 4) {
+        acc = vmlaq_f32(acc, vld1q_f32(a + i), vld1q_f32(b + i));
+    }
+    float32x2_t half = vadd_f32(vget_low_f32(acc), vget_high_f32(acc));
+    sum = vget_lane_f32(vpadd_f32(half, half), 0);
+#endif
+
+    for (; i < count; ++i) {
+        sum += a[i] * b[i];
+    }
+    return sum;
+}
+
+} // namespace Lyricstator
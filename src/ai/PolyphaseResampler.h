@@ -0,0 +1,53 @@
+#pragma once
+#include <vector>
+
+namespace Lyricstator {
+
+// Rational L/M polyphase FIR resampler used to bring device-rate audio down
+// to the pitch detector's analysis rate. Only the output phases that are
+// actually needed are computed, so decimating 48k -> 16k costs one short
+// dot product per output sample.
+class PolyphaseResampler {
+public:
+    PolyphaseResampler();
+    
+    // Configure for a given input rate and desired output rate. When the exact
+    // ratio would need too many phases (odd device rates), the output rate is
+    // snapped to the nearest integer decimation of the input rate instead.
+    bool Configure(int inputRate, int targetOutputRate, int tapsPerPhase = 24);
+    void Reset();
+    
+    // Streaming interface. Returns the number of samples written to output.
+    // Output must have room for at least GetMaxOutputSamples(numInput).
+    int Process(const float* input, int numInput, float* output);
+    int GetMaxOutputSamples(int numInput) const;
+    
+    int GetInputRate() const { return inputRate_; }
+    int GetOutputRate() const { return outputRate_; }
+    int GetInterpolation() const { return interpolation_; }
+    int GetDecimation() const { return decimation_; }
+    bool IsPassthrough() const { return interpolation_ == decimation_; }
+
+private:
+    int inputRate_;
+    int outputRate_;
+    int interpolation_;   // L
+    int decimation_;      // M
+    int tapsPerPhase_;
+    
+    // Filter bank: phase-major, each phase stored time-reversed so that one
+    // output is a contiguous dot product against the input history
+    std::vector<float> phaseBank_;
+    
+    // Input history (tapsPerPhase_ - 1 samples of lookback + pending input)
+    std::vector<float> history_;
+    int historySize_;
+    int readIndex_;       // Newest input sample used by the next output
+    int phase_;
+    
+    void DesignFilter();
+    static int GreatestCommonDivisor(int a, int b);
+    static float DotProduct(const float* a, const float* b, int count);
+};
+
+} // namespace Lyricstator
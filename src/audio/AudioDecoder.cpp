@@ -0,0 +1,524 @@
+#include "audio/AudioDecoder.h"
+#include <SDL2/SDL_mixer.h>
+#include <SDL2/SDL.h>
+#include <iostream>
+#include <algorithm>
+#include <cstring>
+
+// Single-file decoders for streaming MP3/FLAC/OGG: dr_mp3.h, dr_flac.h and
+// stb_vorbis.c. Whichever are on the include path are used; formats without
+// one go through the SDL_mixer fallback, which decodes whole songs into
+// memory. Define LYRICSTATOR_STREAMING_DECODERS=1 to require all three (the
+// build fails without them) or =0 to always use the fallback.
+#if defined(LYRICSTATOR_STREAMING_DECODERS)
+#if LYRICSTATOR_STREAMING_DECODERS
+#define DR_MP3_IMPLEMENTATION
+#include "dr_mp3.h"
+#define LYRICSTATOR_HAVE_DR_MP3 1
+#define DR_FLAC_IMPLEMENTATION
+#include "dr_flac.h"
+#define LYRICSTATOR_HAVE_DR_FLAC 1
+#include "stb_vorbis.c"
+#define LYRICSTATOR_HAVE_STB_VORBIS 1
+#endif
+#elif defined(__has_include)
+#if __has_include("dr_mp3.h")
+#define DR_MP3_IMPLEMENTATION
+#include "dr_mp3.h"
+#define LYRICSTATOR_HAVE_DR_MP3 1
+#endif
+#if __has_include("dr_flac.h")
+#define DR_FLAC_IMPLEMENTATION
+#include "dr_flac.h"
+#define LYRICSTATOR_HAVE_DR_FLAC 1
+#endif
+#if __has_include("stb_vorbis.c")
+#include "stb_vorbis.c"
+#define LYRICSTATOR_HAVE_STB_VORBIS 1
+#endif
+#endif
+
+namespace Lyricstator {
+
+namespace {
+
+const uint16_t kWaveFormatPcm = 0x0001;
+const uint16_t kWaveFormatFloat = 0x0003;
+const uint16_t kWaveFormatExtensible = 0xFFFE;
+const uint64_t kMaxMp3SeekPoints = 4096;
+const uint32_t kMaxFormatChunkSize = 64;
+
+uint16_t ReadLE16(const uint8_t* data) {
+    return static_cast<uint16_t>(data[0] | (data[1] << 8));
+}
+
+uint32_t ReadLE32(const uint8_t* data) {
+    return static_cast<uint32_t>(data[0]) | (static_cast<uint32_t>(data[1]) << 8) |
+           (static_cast<uint32_t>(data[2]) << 16) | (static_cast<uint32_t>(data[3]) << 24);
+}
+
+std::string GetExtension(const std::string& filepath) {
+    size_t dotPos = filepath.find_last_of('.');
+    if (dotPos == std::string::npos) {
+        return "";
+    }
+    std::string extension = filepath.substr(dotPos + 1);
+    std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+    return extension;
+}
+
+// Identify the container from its first bytes, falling back to the extension
+std::string SniffCodec(const std::string& filepath) {
+    uint8_t header[12] = {};
+    std::ifstream file(filepath, std::ios::binary);
+    if (file) {
+        file.read(reinterpret_cast<char*>(header), sizeof(header));
+        if (file.gcount() == static_cast<std::streamsize>(sizeof(header))) {
+            if (std::memcmp(header, "RIFF", 4) == 0 && std::memcmp(header + 8, "WAVE", 4) == 0) return "wav";
+            if (std::memcmp(header, "fLaC", 4) == 0) return "flac";
+            if (std::memcmp(header, "OggS", 4) == 0) return "ogg";
+            if (std::memcmp(header, "ID3", 3) == 0) return "mp3";
+            if (header[0] == 0xFF && (header[1] & 0xE0) == 0xE0) return "mp3";
+        }
+    }
+    return GetExtension(filepath);
+}
+
+#if defined(LYRICSTATOR_HAVE_DR_MP3)
+class Mp3Decoder : public AudioDecoder {
+public:
+    Mp3Decoder() : open_(false) {}
+    ~Mp3Decoder() override { Close(); }
+    
+    bool Open(const std::string& filepath) override {
+        Close();
+        if (!drmp3_init_file(&mp3_, filepath.c_str(), nullptr)) {
+            return false;
+        }
+        open_ = true;
+        format_.sampleRate = static_cast<int>(mp3_.sampleRate);
+        format_.channels = static_cast<int>(mp3_.channels);
+        format_.bitDepth = 16;
+        format_.codec = "mp3";
+        // Counting frames walks the file once and rewinds
+        format_.totalFrames = drmp3_get_pcm_frame_count(&mp3_);
+        BuildSeekTable();
+        return true;
+    }
+    
+    void Close() override {
+        if (open_) {
+            drmp3_uninit(&mp3_);
+            open_ = false;
+        }
+    }
+    
+    size_t Read(float* output, size_t frames) override {
+        return open_ ? static_cast<size_t>(drmp3_read_pcm_frames_f32(&mp3_, frames, output)) : 0;
+    }
+    
+    bool Seek(uint64_t frame) override {
+        return open_ && drmp3_seek_to_pcm_frame(&mp3_, frame);
+    }
+    
+    std::string GetName() const override { return "dr_mp3"; }
+
+private:
+    drmp3 mp3_;
+    bool open_;
+    std::vector<drmp3_seek_point> seekPoints_;
+    
+    // Without a table dr_mp3 seeks by decoding from the start of the file.
+    // A second header-only walk records (PCM frame -> byte offset, decoder
+    // priming) about once a second, so any seek decodes less than that.
+    void BuildSeekTable() {
+        drmp3_uint32 count = static_cast<drmp3_uint32>(
+            std::min<uint64_t>(kMaxMp3SeekPoints, format_.totalFrames / std::max(1, format_.sampleRate) + 1));
+        seekPoints_.resize(count);
+        if (drmp3_calculate_seek_points(&mp3_, &count, seekPoints_.data()) &&
+            drmp3_bind_seek_table(&mp3_, count, seekPoints_.data())) {
+            seekPoints_.resize(count);
+        } else {
+            seekPoints_.clear();
+        }
+    }
+};
+#endif
+
+#if defined(LYRICSTATOR_HAVE_DR_FLAC)
+class FlacDecoder : public AudioDecoder {
+public:
+    FlacDecoder() : flac_(nullptr) {}
+    ~FlacDecoder() override { Close(); }
+    
+    bool Open(const std::string& filepath) override {
+        Close();
+        flac_ = drflac_open_file(filepath.c_str(), nullptr);
+        if (!flac_) {
+            return false;
+        }
+        format_.sampleRate = static_cast<int>(flac_->sampleRate);
+        format_.channels = static_cast<int>(flac_->channels);
+        format_.bitDepth = static_cast<int>(flac_->bitsPerSample);
+        format_.totalFrames = flac_->totalPCMFrameCount;
+        format_.codec = "flac";
+        return true;
+    }
+    
+    void Close() override {
+        if (flac_) {
+            drflac_close(flac_);
+            flac_ = nullptr;
+        }
+    }
+    
+    size_t Read(float* output, size_t frames) override {
+        return flac_ ? static_cast<size_t>(drflac_read_pcm_frames_f32(flac_, frames, output)) : 0;
+    }
+    
+    bool Seek(uint64_t frame) override {
+        return flac_ && drflac_seek_to_pcm_frame(flac_, frame);
+    }
+    
+    std::string GetName() const override { return "dr_flac"; }
+
+private:
+    drflac* flac_;
+};
+#endif
+
+#if defined(LYRICSTATOR_HAVE_STB_VORBIS)
+class VorbisDecoder : public AudioDecoder {
+public:
+    VorbisDecoder() : vorbis_(nullptr) {}
+    ~VorbisDecoder() override { Close(); }
+    
+    bool Open(const std::string& filepath) override {
+        Close();
+        int error = 0;
+        vorbis_ = stb_vorbis_open_filename(filepath.c_str(), &error, nullptr);
+        if (!vorbis_) {
+            return false;
+        }
+        stb_vorbis_info info = stb_vorbis_get_info(vorbis_);
+        format_.sampleRate = static_cast<int>(info.sample_rate);
+        format_.channels = info.channels;
+        format_.bitDepth = 16;
+        format_.totalFrames = stb_vorbis_stream_length_in_samples(vorbis_);
+        format_.codec = "ogg";
+        return true;
+    }
+    
+    void Close() override {
+        if (vorbis_) {
+            stb_vorbis_close(vorbis_);
+            vorbis_ = nullptr;
+        }
+    }
+    
+    size_t Read(float* output, size_t frames) override {
+        if (!vorbis_) return 0;
+        int numFloats = static_cast<int>(frames * format_.channels);
+        return static_cast<size_t>(stb_vorbis_get_samples_float_interleaved(vorbis_, format_.channels, output, numFloats));
+    }
+    
+    bool Seek(uint64_t frame) override {
+        return vorbis_ && stb_vorbis_seek(vorbis_, static_cast<unsigned int>(frame));
+    }
+    
+    std::string GetName() const override { return "stb_vorbis"; }
+
+private:
+    stb_vorbis* vorbis_;
+};
+#endif
+
+std::unique_ptr<AudioDecoder> CreateStreamingDecoder(const std::string& codec) {
+    if (codec == "wav") {
+        return std::make_unique<WavDecoder>();
+    }
+#if defined(LYRICSTATOR_HAVE_DR_MP3)
+    if (codec == "mp3") {
+        return std::make_unique<Mp3Decoder>();
+    }
+#endif
+#if defined(LYRICSTATOR_HAVE_DR_FLAC)
+    if (codec == "flac") {
+        return std::make_unique<FlacDecoder>();
+    }
+#endif
+#if defined(LYRICSTATOR_HAVE_STB_VORBIS)
+    if (codec == "ogg") {
+        return std::make_unique<VorbisDecoder>();
+    }
+#endif
+    return nullptr;
+}
+
+} // namespace
+
+std::unique_ptr<AudioDecoder> AudioDecoder::Create(const std::string& filepath) {
+    std::string codec = SniffCodec(filepath);
+    
+    std::unique_ptr<AudioDecoder> decoder = CreateStreamingDecoder(codec);
+    if (decoder && decoder->Open(filepath)) {
+        return decoder;
+    }
+    
+    if (!decoder && codec != "wav") {
+        std::cout << "No streaming decoder for " << codec << ", decoding the whole file: " << filepath << std::endl;
+    }
+    decoder = std::make_unique<MixerChunkDecoder>();
+    if (decoder->Open(filepath)) {
+        return decoder;
+    }
+    
+    std::cerr << "No decoder could open: " << filepath << std::endl;
+    return nullptr;
+}
+
+// WavDecoder
+
+WavDecoder::WavDecoder()
+    : dataOffset_(0)
+    , position_(0)
+    , blockAlign_(0)
+    , isFloat_(false)
+{
+}
+
+bool WavDecoder::Open(const std::string& filepath) {
+    Close();
+    
+    file_.open(filepath, std::ios::binary);
+    if (!file_.is_open()) {
+        return false;
+    }
+    
+    if (!ParseHeader()) {
+        std::cerr << "Unsupported or corrupt WAV file: " << filepath << std::endl;
+        Close();
+        return false;
+    }
+    return true;
+}
+
+bool WavDecoder::ParseHeader() {
+    uint8_t riff[12];
+    if (!file_.read(reinterpret_cast<char*>(riff), sizeof(riff)) ||
+        std::memcmp(riff, "RIFF", 4) != 0 || std::memcmp(riff + 8, "WAVE", 4) != 0) {
+        return false;
+    }
+    
+    bool haveFormat = false;
+    uint16_t formatTag = 0;
+    
+    // Walk chunks until we have both "fmt " and "data"
+    for (;;) {
+        uint8_t chunkHeader[8];
+        if (!file_.read(reinterpret_cast<char*>(chunkHeader), sizeof(chunkHeader))) {
+            return false;
+        }
+        uint32_t chunkSize = ReadLE32(chunkHeader + 4);
+        
+        if (std::memcmp(chunkHeader, "fmt ", 4) == 0) {
+            // 16 bytes for PCM, up to 40 for WAVE_FORMAT_EXTENSIBLE; anything
+            // much bigger is a corrupt header, not a format
+            if (chunkSize < 16 || chunkSize > kMaxFormatChunkSize) return false;
+            uint8_t fmt[kMaxFormatChunkSize];
+            if (!file_.read(reinterpret_cast<char*>(fmt), chunkSize)) return false;
+            
+            formatTag = ReadLE16(&fmt[0]);
+            format_.channels = ReadLE16(&fmt[2]);
+            format_.sampleRate = static_cast<int>(ReadLE32(&fmt[4]));
+            blockAlign_ = ReadLE16(&fmt[12]);
+            format_.bitDepth = ReadLE16(&fmt[14]);
+            
+            if (formatTag == kWaveFormatExtensible && chunkSize >= 26) {
+                // First two bytes of the sub-format GUID carry the real tag
+                formatTag = ReadLE16(&fmt[24]);
+            }
+            if (chunkSize & 1) {
+                file_.seekg(1, std::ios::cur);
+            }
+            haveFormat = true;
+        } else if (std::memcmp(chunkHeader, "data", 4) == 0) {
+            if (!haveFormat) return false;
+            dataOffset_ = static_cast<uint64_t>(file_.tellg());
+            
+            if (blockAlign_ <= 0 || format_.channels <= 0) return false;
+            format_.totalFrames = chunkSize / blockAlign_;
+            break;
+        } else {
+            // Skip unknown chunk (chunks are word aligned)
+            file_.seekg(chunkSize + (chunkSize & 1), std::ios::cur);
+        }
+    }
+    
+    int bytesPerSample = blockAlign_ / format_.channels;
+    if (formatTag == kWaveFormatFloat) {
+        isFloat_ = true;
+        if (bytesPerSample != 4 && bytesPerSample != 8) return false;
+    } else if (formatTag == kWaveFormatPcm) {
+        isFloat_ = false;
+        if (bytesPerSample < 1 || bytesPerSample > 4) return false;
+    } else {
+        return false;
+    }
+    
+    format_.codec = "wav";
+    position_ = 0;
+    return true;
+}
+
+void WavDecoder::Close() {
+    if (file_.is_open()) {
+        file_.close();
+    }
+    file_.clear();
+    position_ = 0;
+    format_ = DecodedFormat();
+}
+
+size_t WavDecoder::Read(float* output, size_t frames) {
+    if (!file_.is_open() || position_ >= format_.totalFrames) {
+        return 0;
+    }
+    
+    frames = static_cast<size_t>(std::min<uint64_t>(frames, format_.totalFrames - position_));
+    readBuffer_.resize(frames * blockAlign_);
+    file_.read(reinterpret_cast<char*>(readBuffer_.data()), readBuffer_.size());
+    frames = static_cast<size_t>(file_.gcount()) / blockAlign_;
+    
+    const int bytesPerSample = blockAlign_ / format_.channels;
+    const size_t samples = frames * format_.channels;
+    const uint8_t* in = readBuffer_.data();
+    
+    for (size_t i = 0; i < samples; ++i, in += bytesPerSample) {
+        float value = 0.0f;
+        if (isFloat_) {
+            if (bytesPerSample == 4) {
+                uint32_t bits = ReadLE32(in);
+                std::memcpy(&value, &bits, sizeof(value));
+            } else {
+                uint64_t bits = ReadLE32(in) | (static_cast<uint64_t>(ReadLE32(in + 4)) << 32);
+                double wide;
+                std::memcpy(&wide, &bits, sizeof(wide));
+                value = static_cast<float>(wide);
+            }
+        } else {
+            switch (bytesPerSample) {
+                case 1:
+                    value = (static_cast<int>(in[0]) - 128) / 128.0f;
+                    break;
+                case 2:
+                    value = static_cast<int16_t>(ReadLE16(in)) / 32768.0f;
+                    break;
+                case 3: {
+                    int32_t sample = static_cast<int32_t>((in[0] << 8) | (in[1] << 16) | (static_cast<uint32_t>(in[2]) << 24)) >> 8;
+                    value = sample / 8388608.0f;
+                    break;
+                }
+                case 4:
+                    value = static_cast<int32_t>(ReadLE32(in)) / 2147483648.0f;
+                    break;
+            }
+        }
+        output[i] = value;
+    }
+    
+    position_ += frames;
+    return frames;
+}
+
+bool WavDecoder::Seek(uint64_t frame) {
+    if (!file_.is_open()) {
+        return false;
+    }
+    
+    position_ = std::min(frame, format_.totalFrames);
+    file_.clear();
+    file_.seekg(static_cast<std::streamoff>(dataOffset_ + position_ * blockAlign_), std::ios::beg);
+    return static_cast<bool>(file_);
+}
+
+// MixerChunkDecoder
+
+MixerChunkDecoder::MixerChunkDecoder()
+    : position_(0)
+{
+}
+
+bool MixerChunkDecoder::Open(const std::string& filepath) {
+    Close();
+    
+    int frequency = 0;
+    Uint16 deviceFormat = 0;
+    int channels = 0;
+    if (!Mix_QuerySpec(&frequency, &deviceFormat, &channels)) {
+        return false;
+    }
+    
+    // SDL_mixer decodes straight to the device format
+    Mix_Chunk* chunk = Mix_LoadWAV(filepath.c_str());
+    if (!chunk) {
+        std::cerr << "SDL_mixer Error: " << Mix_GetError() << std::endl;
+        return false;
+    }
+    
+    SDL_AudioCVT cvt;
+    if (SDL_BuildAudioCVT(&cvt, deviceFormat, static_cast<Uint8>(channels), frequency,
+                          AUDIO_F32SYS, static_cast<Uint8>(channels), frequency) < 0) {
+        Mix_FreeChunk(chunk);
+        return false;
+    }
+    
+    // Convert in place in the final buffer, and let the chunk go before
+    // converting: a long song is then only ever held twice, not three times
+    size_t bytes = static_cast<size_t>(chunk->alen) * std::max(1, cvt.len_mult);
+    samples_.resize((bytes + sizeof(float) - 1) / sizeof(float));
+    std::memcpy(samples_.data(), chunk->abuf, chunk->alen);
+    cvt.buf = reinterpret_cast<Uint8*>(samples_.data());
+    cvt.len = static_cast<int>(chunk->alen);
+    Mix_FreeChunk(chunk);
+    
+    if (cvt.needed && SDL_ConvertAudio(&cvt) < 0) {
+        Close();
+        return false;
+    }
+    int convertedBytes = cvt.needed ? cvt.len_cvt : cvt.len;
+    samples_.resize(convertedBytes / sizeof(float));
+    
+    format_.sampleRate = frequency;
+    format_.channels = channels;
+    format_.bitDepth = SDL_AUDIO_BITSIZE(deviceFormat);
+    format_.totalFrames = samples_.size() / channels;
+    format_.codec = GetExtension(filepath);
+    position_ = 0;
+    return true;
+}
+
+void MixerChunkDecoder::Close() {
+    samples_.clear();
+    samples_.shrink_to_fit();
+    position_ = 0;
+    format_ = DecodedFormat();
+}
+
+size_t MixerChunkDecoder::Read(float* output, size_t frames) {
+    if (position_ >= format_.totalFrames) {
+        return 0;
+    }
+    
+    frames = static_cast<size_t>(std::min<uint64_t>(frames, format_.totalFrames - position_));
+    std::memcpy(output, samples_.data() + position_ * format_.channels, frames * format_.channels * sizeof(float));
+    position_ += frames;
+    return frames;
+}
+
+bool MixerChunkDecoder::Seek(uint64_t frame) {
+    position_ = std::min(frame, format_.totalFrames);
+    return true;
+}
+
+} // namespace Lyricstator
@@ -0,0 +1,91 @@
+#pragma once
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace Lyricstator {
+
+// Format of the PCM a decoder produces. Samples are always delivered as
+// interleaved float in [-1, 1]; bitDepth describes the source encoding.
+struct DecodedFormat {
+    int sampleRate = 0;
+    int channels = 0;
+    int bitDepth = 0;
+    uint64_t totalFrames = 0;   // 0 if unknown
+    std::string codec;          // "wav", "mp3", "flac", "ogg", ...
+};
+
+// Pull-based decoder interface. Decoders are used from one thread at a
+// time (the decode side of PcmStream), never from the audio callback.
+class AudioDecoder {
+public:
+    virtual ~AudioDecoder() = default;
+    
+    virtual bool Open(const std::string& filepath) = 0;
+    virtual void Close() = 0;
+    
+    // Decode up to `frames` interleaved frames into `output`. Returns the
+    // number of frames written; 0 means end of stream.
+    virtual size_t Read(float* output, size_t frames) = 0;
+    virtual bool Seek(uint64_t frame) = 0;
+    
+    const DecodedFormat& GetFormat() const { return format_; }
+    virtual std::string GetName() const = 0;
+    
+    // Bytes of decoded audio or read buffers the decoder holds on to
+    virtual size_t GetMemoryUsage() const { return 0; }
+    
+    // Picks a decoder from the file header (falling back to the extension)
+    // and opens it. Returns nullptr if nothing can decode the file.
+    static std::unique_ptr<AudioDecoder> Create(const std::string& filepath);
+
+protected:
+    DecodedFormat format_;
+};
+
+// Native RIFF/WAVE reader: 8/16/24/32-bit PCM, 32/64-bit float and
+// WAVE_FORMAT_EXTENSIBLE. Streams straight from disk.
+class WavDecoder : public AudioDecoder {
+public:
+    WavDecoder();
+    
+    bool Open(const std::string& filepath) override;
+    void Close() override;
+    size_t Read(float* output, size_t frames) override;
+    bool Seek(uint64_t frame) override;
+    std::string GetName() const override { return "wav"; }
+    size_t GetMemoryUsage() const override { return readBuffer_.capacity(); }
+
+private:
+    std::ifstream file_;
+    uint64_t dataOffset_;
+    uint64_t position_;
+    int blockAlign_;
+    bool isFloat_;
+    std::vector<uint8_t> readBuffer_;
+    
+    bool ParseHeader();
+};
+
+// Last resort for formats we have no streaming decoder for: decodes the
+// whole file up front through SDL_mixer and serves it from memory, so its
+// footprint grows with the length of the song.
+class MixerChunkDecoder : public AudioDecoder {
+public:
+    MixerChunkDecoder();
+    
+    bool Open(const std::string& filepath) override;
+    void Close() override;
+    size_t Read(float* output, size_t frames) override;
+    bool Seek(uint64_t frame) override;
+    std::string GetName() const override { return "sdl_mixer"; }
+    size_t GetMemoryUsage() const override { return samples_.capacity() * sizeof(float); }
+
+private:
+    std::vector<float> samples_;
+    uint64_t position_;
+};
+
+} // namespace Lyricstator
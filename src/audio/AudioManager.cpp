@@ -1,31 +1,106 @@
 #include "audio/AudioManager.h"
+#include "audio/PcmStream.h"
+#include "audio/MicInput.h"
+#include "utils/FileUtils.h"
 #include <SDL2/SDL_mixer.h>
 #include <SDL2/SDL.h>
 #include <iostream>
 #include <algorithm>
+#include <chrono>
 #include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <sstream>
+#include <thread>
 
 namespace Lyricstator {
 
+namespace {
+const int kRenderBlockFrames = 4096;
+const int kAnalysisIntervalMs = 10;
+const int kAnalysisIdleWakes = 10;         // ~100 ms without audio before the meters fall
+const float kReadAheadSeconds = 0.5f;      // Of source audio decoded ahead, at 1x
+const float kMaxTempo = 4.0f;              // Stream rings are sized for this
+
+// FNV-1a; stable across runs and platforms, unlike std::hash
+uint64_t HashString(const std::string& text) {
+    uint64_t hash = 1469598103934665603ull;
+    for (unsigned char c : text) {
+        hash = (hash ^ c) * 1099511628211ull;
+    }
+    return hash;
+}
+
+// Float -> whatever sample format the device was opened with
+void WriteDeviceSamples(const float* input, int count, uint16_t format, uint8_t* output) {
+    switch (format) {
+        case AUDIO_F32SYS:
+            std::memcpy(output, input, count * sizeof(float));
+            break;
+        case AUDIO_S16SYS: {
+            int16_t* out = reinterpret_cast<int16_t*>(output);
+            for (int i = 0; i < count; ++i) {
+                float sample = std::max(-1.0f, std::min(1.0f, input[i]));
+                out[i] = static_cast<int16_t>(sample * 32767.0f);
+            }
+            break;
+        }
+        case AUDIO_S32SYS: {
+            int32_t* out = reinterpret_cast<int32_t*>(output);
+            for (int i = 0; i < count; ++i) {
+                double sample = std::max(-1.0f, std::min(1.0f, input[i]));
+                out[i] = static_cast<int32_t>(sample * 2147483647.0);
+            }
+            break;
+        }
+        default:
+            std::memset(output, 0, count * (SDL_AUDIO_BITSIZE(format) / 8));
+            break;
+    }
+}
+} // namespace
+
 AudioManager::AudioManager()
-    : music_(nullptr)
-    , chunk_(nullptr)
+    : deviceRate_(44100)
+    , deviceChannels_(2)
+    , deviceFormat_(AUDIO_S16SYS)
+    , activeStream_(nullptr)
+    , callbackBusy_(false)
+    , renderEnabled_(false)
+    , callbackVolume_(1.0f)
+    , streamSerial_(0)
+    , queuedStream_(nullptr)
+    , fadingStream_(nullptr)
+    , crossfadeFrames_(0)
+    , trackChanges_(0)
+    , seenTrackChanges_(0)
+    , trackChanged_(false)
+    , fadePosition_(0)
+    , fadeLength_(0)
+    , activeGuide_(nullptr)
+    , guideOwner_(nullptr)
+    , activeMic_(nullptr)
+    , instrumentalStream_(nullptr)
+    , instrumentalNext_(nullptr)
+    , cancelRender_(false)
+    , renderedSerial_(0)
+    , promotedSerial_(0)
+    , renderedSeekGeneration_(0)
+    , wasStretching_(false)
+    , wasRemovingVocals_(false)
+    , renderSource_(nullptr)
     , volume_(1.0f)
     , tempoMultiplier_(1.0f)
     , initialized_(false)
     , isPlaying_(false)
     , isPaused_(false)
-    , startTime_(0)
-    , pauseTime_(0)
-    , seekOffset_(0)
+    , analysisRunning_(false)
     , rmsLevel_(0.0f)
 {
     audioFormat_.sampleRate = 44100;
     audioFormat_.channels = 2;
     audioFormat_.bitDepth = 16;
     audioFormat_.format = "unknown";
-    
-    spectrumBuffer_.resize(64, 0.0f);
 }
 
 AudioManager::~AudioManager() {
@@ -39,11 +114,45 @@ bool AudioManager::Initialize() {
     
     std::cout << "Initializing AudioManager..." << std::endl;
     
-    // SDL_mixer should already be initialized by Application
-    // Set up audio format detection and analysis
+    // SDL_mixer is opened by Application; we take over its music slot
+    int frequency = 0;
+    Uint16 format = 0;
+    int channels = 0;
+    if (!Mix_QuerySpec(&frequency, &format, &channels)) {
+        std::cerr << "SDL_mixer is not open: " << Mix_GetError() << std::endl;
+        return false;
+    }
+    
+    if (format != AUDIO_S16SYS && format != AUDIO_S32SYS && format != AUDIO_F32SYS) {
+        std::cerr << "Unsupported device sample format: 0x" << std::hex << format << std::dec << std::endl;
+        return false;
+    }
+    
+    deviceRate_ = frequency;
+    deviceChannels_ = channels;
+    deviceFormat_ = format;
+    
+    renderBuffer_.assign(kRenderBlockFrames * deviceChannels_, 0.0f);
+    fadeBuffer_.assign(kRenderBlockFrames * deviceChannels_, 0.0f);
+    guideBuffer_.assign(kRenderBlockFrames * deviceChannels_, 0.0f);
+    playbackTap_.Resize(deviceRate_);
+    tapScratch_.assign(kRenderBlockFrames, 0.0f);
+    tapBuffer_.resize(kRenderBlockFrames);
+    clock_.Configure(deviceRate_);
+    stretcher_.Configure(deviceRate_, deviceChannels_, TimeStretcher::Quality::REALTIME);
+    vocalRemover_.Configure(deviceRate_, deviceChannels_, VocalRemover::Quality::REALTIME);
+    equalizer_.Configure(deviceRate_, deviceChannels_);
+    mixer_.Configure(deviceRate_, deviceChannels_, kRenderBlockFrames);
+    spectrum_.Configure(deviceRate_);
+    latencyProbe_.Configure(deviceRate_, deviceRate_);
+    
+    Mix_HookMusic(&AudioManager::MusicHookCallback, this);
+    StartAnalysis();
+    decodePool_.Start();
     
     initialized_ = true;
-    std::cout << "AudioManager initialized successfully" << std::endl;
+    std::cout << "AudioManager initialized successfully (" << deviceRate_ << " Hz, "
+              << deviceChannels_ << " channels)" << std::endl;
     return true;
 }
 
@@ -54,6 +163,11 @@ void AudioManager::Shutdown() {
     
     Stop();
     UnloadAudio();
+    CloseMicrophone();
+    CancelInstrumentalRender();
+    Mix_HookMusic(nullptr, nullptr);
+    StopAnalysis();
+    decodePool_.Stop();
     
     initialized_ = false;
     std::cout << "AudioManager shutdown complete" << std::endl;
@@ -64,88 +178,311 @@ bool AudioManager::LoadAudio(const std::string& filepath) {
     
     UnloadAudio();
     
-    // Detect audio format
-    audioFormat_ = DetectAudioFormat(filepath);
+    if (!initialized_) {
+        std::cerr << "AudioManager not initialized" << std::endl;
+        return false;
+    }
     
-    // Try loading as music first (for longer files like MP3, OGG)
-    if (LoadMusic(filepath)) {
-        currentFile_ = filepath;
-        std::cout << "Loaded as music: " << filepath << std::endl;
-        return true;
+    // A cached instrumental stands in for the original when there is one
+    std::string instrumental = FindInstrumental(filepath);
+    const float bufferSeconds = kReadAheadSeconds * kMaxTempo;
+    auto stream = std::make_unique<PcmStream>();
+    if (!instrumental.empty() && !stream->Open(instrumental, deviceRate_, deviceChannels_, bufferSeconds)) {
+        instrumental.clear();
+    }
+    if (instrumental.empty() && !stream->Open(filepath, deviceRate_, deviceChannels_, bufferSeconds)) {
+        std::cerr << "Failed to load audio file: " << filepath << std::endl;
+        return false;
     }
+    AttachDecoder(*stream);
     
-    // Fallback to loading as chunk (for WAV files)
-    if (LoadChunk(filepath)) {
-        currentFile_ = filepath;
-        std::cout << "Loaded as sound chunk: " << filepath << std::endl;
-        return true;
+    const DecodedFormat& source = stream->GetSourceFormat();
+    SetSourceInfo(*stream);
+    stream->SetGain(GetTrackGain(filepath), true);
+    
+    stream_ = std::move(stream);
+    currentFile_ = filepath;
+    instrumentalPath_ = instrumental;
+    instrumentalStream_.store(instrumental.empty() ? nullptr : stream_.get());
+    streamSerial_.fetch_add(1);
+    activeStream_.store(stream_.get());
+    
+    std::cout << "Loaded " << filepath << " via " << stream_->GetDecoderName() << " ("
+              << source.sampleRate << " Hz, " << source.channels << " channels, "
+              << GetDurationMs() << " ms)" << std::endl;
+    
+    if (instrumental.empty() && GetVocalReduction() == VocalRemover::Mode::SPECTRAL) {
+        StartInstrumentalRender(filepath);
+    } else if (!instrumental.empty()) {
+        std::cout << "Playing cached instrumental: " << instrumental << std::endl;
     }
+    return true;
+}
+
+void AudioManager::UnloadAudio() {
+    Stop();
+    UnloadGuideVocal();
+    ClearQueue();
+    fadingStream_.store(nullptr);
+    DetachStream();
     
-    std::cerr << "Failed to load audio file: " << filepath << std::endl;
-    std::cerr << "SDL_mixer Error: " << Mix_GetError() << std::endl;
-    return false;
+    stream_.reset();
+    retiredStreams_.clear();
+    currentFile_.clear();
+    instrumentalPath_.clear();
+    instrumentalStream_.store(nullptr);
 }
 
-bool AudioManager::LoadMusic(const std::string& filepath) {
-    music_ = Mix_LoadMUS(filepath.c_str());
-    return music_ != nullptr;
+bool AudioManager::LoadGuideVocal(const std::string& filepath) {
+    UnloadGuideVocal();
+    
+    if (!stream_) {
+        std::cerr << "Load a backing track before its guide vocal" << std::endl;
+        return false;
+    }
+    
+    auto guide = std::make_unique<PcmStream>();
+    if (!guide->Open(filepath, deviceRate_, deviceChannels_, kReadAheadSeconds * kMaxTempo)) {
+        std::cerr << "Failed to load guide vocal: " << filepath << std::endl;
+        return false;
+    }
+    guide->Seek(stream_->GetPositionFrames());
+    AttachDecoder(*guide);
+    
+    guide_ = std::move(guide);
+    guideOwner_.store(stream_.get());
+    activeGuide_.store(guide_.get(), std::memory_order_release);
+    
+    std::cout << "Loaded guide vocal: " << filepath << std::endl;
+    return true;
 }
 
-bool AudioManager::LoadChunk(const std::string& filepath) {
-    chunk_ = Mix_LoadWAV(filepath.c_str());
-    return chunk_ != nullptr;
+void AudioManager::UnloadGuideVocal() {
+    if (!guide_) {
+        return;
+    }
+    
+    activeGuide_.store(nullptr);
+    while (callbackBusy_.load()) {
+        SDL_Delay(0);
+    }
+    guideOwner_.store(nullptr);
+    guide_.reset();
 }
 
-void AudioManager::UnloadAudio() {
-    Stop();
+bool AudioManager::OpenMicrophone(const std::string& deviceName, int bufferFrames) {
+    CloseMicrophone();
     
-    if (music_) {
-        Mix_FreeMusic(music_);
-        music_ = nullptr;
+    if (!initialized_) {
+        std::cerr << "AudioManager not initialized" << std::endl;
+        return false;
     }
     
-    if (chunk_) {
-        Mix_FreeChunk(chunk_);
-        chunk_ = nullptr;
+    // Small capture periods keep the monitor path short
+    auto mic = std::make_unique<MicInput>();
+    mic->SetLatencyProbe(&latencyProbe_);
+    if (!mic->Open(deviceName, deviceRate_, bufferFrames)) {
+        return false;
     }
     
-    currentFile_.clear();
+    mic_ = std::move(mic);
+    activeMic_.store(mic_.get(), std::memory_order_release);
+    return true;
 }
 
-void AudioManager::Play() {
-    if (!initialized_ || (!music_ && !chunk_)) {
+void AudioManager::CloseMicrophone() {
+    if (!mic_) {
         return;
     }
     
-    if (isPaused_) {
-        // Resume from pause
-        if (music_) {
-            Mix_ResumeMusic();
+    latencyProbe_.Cancel();
+    activeMic_.store(nullptr);
+    while (callbackBusy_.load()) {
+        SDL_Delay(0);
+    }
+    mic_.reset();
+}
+
+size_t AudioManager::ReadMicSamples(float* output, size_t frames) {
+    return mic_ ? mic_->ReadAnalysis(output, frames) : 0;
+}
+
+int AudioManager::GetMicBufferFrames() const {
+    return mic_ ? mic_->GetBufferFrames() : 0;
+}
+
+double AudioManager::GetMicInputAgeMs() const {
+    return mic_ ? mic_->GetAnalysisAgeMs() : 0.0;
+}
+
+bool AudioManager::StartLatencyProbe(int impulses) {
+    if (!mic_) {
+        std::cerr << "Latency measurement needs an open microphone" << std::endl;
+        return false;
+    }
+    return latencyProbe_.Start(impulses);
+}
+
+int AudioManager::GetMicSampleRate() const {
+    return mic_ ? mic_->GetSampleRate() : deviceRate_;
+}
+
+AudioMixer::Stats AudioManager::GetCallbackStats() const {
+    return mixer_.GetStats(mic_.get());
+}
+
+void AudioManager::SetSourceInfo(const PcmStream& stream) {
+    const DecodedFormat& source = stream.GetSourceFormat();
+    audioFormat_.sampleRate = source.sampleRate;
+    audioFormat_.channels = source.channels;
+    audioFormat_.bitDepth = source.bitDepth;
+    audioFormat_.format = source.codec;
+}
+
+void AudioManager::AttachDecoder(PcmStream& stream) {
+    stream.SetReadAhead(GetReadAheadFrames());
+    stream.SetDecodePool(&decodePool_);
+}
+
+size_t AudioManager::GetReadAheadFrames() const {
+    return static_cast<size_t>(kReadAheadSeconds * deviceRate_ * std::max(1.0f, tempoMultiplier_));
+}
+
+bool AudioManager::QueueNext(const std::string& filepath, uint32_t crossfadeMs) {
+    if (!initialized_) {
+        std::cerr << "AudioManager not initialized" << std::endl;
+        return false;
+    }
+    
+    ClearQueue();
+    
+    crossfadeFrames_.store(static_cast<uint32_t>(static_cast<uint64_t>(crossfadeMs) * deviceRate_ / 1000));
+    nextFile_ = filepath;
+    nextInstrumentalPath_ = FindInstrumental(filepath);
+    
+    // Opening scans and pre-decodes the file, so keep it off this thread
+    int rate = deviceRate_;
+    int channels = deviceChannels_;
+    std::string openPath = nextInstrumentalPath_.empty() ? filepath : nextInstrumentalPath_;
+    pendingNext_ = std::async(std::launch::async, [openPath, rate, channels]() -> std::unique_ptr<PcmStream> {
+        auto stream = std::make_unique<PcmStream>();
+        if (!stream->Open(openPath, rate, channels, kReadAheadSeconds * kMaxTempo)) {
+            return nullptr;
+        }
+        return stream;
+    });
+    
+    std::cout << "Queued next track: " << filepath << std::endl;
+    return true;
+}
+
+void AudioManager::ClearQueue() {
+    if (pendingNext_.valid()) {
+        pendingNext_.wait();
+        pendingNext_ = std::future<std::unique_ptr<PcmStream>>();
+    }
+    
+    queuedStream_.store(nullptr);
+    while (callbackBusy_.load()) {
+        SDL_Delay(0);
+    }
+    
+    // The callback may have taken it just before we pulled it back
+    CollectTrackChange();
+    instrumentalNext_.store(nullptr);
+    nextStream_.reset();
+    nextFile_.clear();
+    nextInstrumentalPath_.clear();
+}
+
+bool AudioManager::ConsumeTrackChange(std::string& filepath) {
+    if (!trackChanged_) {
+        return false;
+    }
+    trackChanged_ = false;
+    filepath = currentFile_;
+    return true;
+}
+
+bool AudioManager::CollectTrackChange() {
+    uint32_t changes = trackChanges_.load(std::memory_order_acquire);
+    if (changes == seenTrackChanges_ || !nextStream_) {
+        return false;
+    }
+    seenTrackChanges_ = changes;
+    
+    // The callback already stopped mixing the guide (it follows its owner)
+    UnloadGuideVocal();
+    retiredStreams_.push_back(std::move(stream_));
+    stream_ = std::move(nextStream_);
+    currentFile_ = nextFile_;
+    instrumentalPath_ = nextInstrumentalPath_;
+    instrumentalStream_.store(instrumentalNext_.load());
+    instrumentalNext_.store(nullptr);
+    nextFile_.clear();
+    nextInstrumentalPath_.clear();
+    SetSourceInfo(*stream_);
+    trackChanged_ = true;
+    
+    std::cout << "Switched to queued track: " << currentFile_ << std::endl;
+    if (instrumentalPath_.empty() && GetVocalReduction() == VocalRemover::Mode::SPECTRAL) {
+        StartInstrumentalRender(currentFile_);
+    }
+    return true;
+}
+
+void AudioManager::UpdateQueue() {
+    if (pendingNext_.valid() && pendingNext_.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+        nextStream_ = pendingNext_.get();
+        if (nextStream_) {
+            AttachDecoder(*nextStream_);
+            nextStream_->SetGain(GetTrackGain(nextFile_), true);
+            instrumentalNext_.store(nextInstrumentalPath_.empty() ? nullptr : nextStream_.get());
+            queuedStream_.store(nextStream_.get(), std::memory_order_release);
         } else {
-            // For chunks, we need to restart from the pause position
-            // This is a limitation of SDL_mixer
+            std::cerr << "Failed to prepare queued track: " << nextFile_ << std::endl;
+            nextFile_.clear();
+        }
+    }
+    
+    CollectTrackChange();
+    
+    // Outgoing tracks can go once no crossfade reads them
+    if (!retiredStreams_.empty() && !fadingStream_.load(std::memory_order_acquire)) {
+        while (callbackBusy_.load()) {
+            SDL_Delay(0);
         }
+        retiredStreams_.clear();
+    }
+}
+
+void AudioManager::DetachStream() {
+    // Once the callback is seen idle after the swap, it can't still be
+    // holding the old pointer
+    activeStream_.store(nullptr);
+    while (callbackBusy_.load()) {
+        SDL_Delay(0);
+    }
+}
+
+void AudioManager::Play() {
+    if (!initialized_ || !stream_) {
+        return;
+    }
+    
+    if (isPaused_) {
         isPaused_ = false;
-        isPlaying_ = true;
-        
-        // Adjust start time to account for pause duration
-        uint32_t pauseDuration = SDL_GetTicks() - pauseTime_;
-        startTime_ += pauseDuration;
-    } else {
-        // Start from beginning or seek position
-        if (music_) {
-            if (Mix_PlayMusic(music_, 0) == 0) {
-                isPlaying_ = true;
-                startTime_ = SDL_GetTicks() - seekOffset_;
-            }
-        } else if (chunk_) {
-            if (Mix_PlayChannel(-1, chunk_, 0) >= 0) {
-                isPlaying_ = true;
-                startTime_ = SDL_GetTicks() - seekOffset_;
-            }
+    } else if (stream_->IsEndOfStream()) {
+        stream_->Seek(0);
+        if (guide_) {
+            guide_->Seek(0);
         }
     }
     
+    stream_->Fill();
+    isPlaying_ = true;
+    renderEnabled_.store(true);
+    
     std::cout << "Audio playback started" << std::endl;
 }
 
@@ -154,14 +491,8 @@ void AudioManager::Pause() {
         return;
     }
     
-    if (music_) {
-        Mix_PauseMusic();
-    } else {
-        Mix_Pause(-1); // Pause all channels
-    }
-    
+    renderEnabled_.store(false);
     isPaused_ = true;
-    pauseTime_ = SDL_GetTicks();
     std::cout << "Audio playback paused" << std::endl;
 }
 
@@ -170,165 +501,590 @@ void AudioManager::Stop() {
         return;
     }
     
-    if (music_) {
-        Mix_HaltMusic();
-    } else {
-        Mix_HaltChannel(-1); // Stop all channels
-    }
-    
+    renderEnabled_.store(false);
     isPlaying_ = false;
     isPaused_ = false;
-    seekOffset_ = 0;
+    
+    if (stream_) {
+        stream_->Seek(0);
+    }
+    if (guide_) {
+        guide_->Seek(0);
+    }
     std::cout << "Audio playback stopped" << std::endl;
 }
 
 void AudioManager::Seek(uint32_t timeMs) {
-    bool wasPlaying = isPlaying_;
-    
-    Stop();
-    seekOffset_ = timeMs;
-    
-    if (wasPlaying) {
-        Play();
+    if (!stream_) {
+        return;
     }
     
+    uint64_t frame = static_cast<uint64_t>(timeMs) * deviceRate_ / 1000;
+    stream_->Seek(frame);
+    if (guide_) {
+        guide_->Seek(frame);
+    }
     std::cout << "Seeked to: " << timeMs << "ms" << std::endl;
 }
 
 void AudioManager::SetVolume(float volume) {
     volume_ = std::max(0.0f, std::min(1.0f, volume));
+    callbackVolume_.store(volume_);
+}
+
+void AudioManager::SetEqualizerBandCount(int count) {
+    equalizer_.SetBandCount(count);
+}
+
+void AudioManager::SetEqualizerBand(int index, float frequency, float gainDb, bool enabled) {
+    equalizer_.SetBand(index, frequency, gainDb, enabled);
+}
+
+void AudioManager::EnableEqualizer(bool enabled) {
+    equalizer_.SetEnabled(enabled);
+}
+
+void AudioManager::SetTempo(float multiplier) {
+    stretcher_.SetTempo(multiplier);
+    tempoMultiplier_ = stretcher_.GetTempo();
     
-    int mixVolume = static_cast<int>(volume_ * MIX_MAX_VOLUME);
+    // Faster playback drains the rings faster; keep the same time in hand
+    size_t readAhead = GetReadAheadFrames();
+    for (PcmStream* stream : {stream_.get(), nextStream_.get(), guide_.get()}) {
+        if (stream) {
+            stream->SetReadAhead(readAhead);
+        }
+    }
+    std::cout << "Tempo set to: " << tempoMultiplier_ << "x" << std::endl;
+}
+
+void AudioManager::SetPitchShift(float semitones) {
+    stretcher_.SetPitchSemitones(semitones);
+    std::cout << "Pitch shift set to: " << stretcher_.GetPitchSemitones() << " semitones" << std::endl;
+}
+
+void AudioManager::SetTrackGain(const std::string& filepath, float gainDb) {
+    float gain = std::pow(10.0f, gainDb / 20.0f);
+    trackGains_[filepath] = gain;
+    
+    // Streams already playing glide to it
+    if (stream_ && filepath == currentFile_) {
+        stream_->SetGain(gain);
+    }
+    if (nextStream_ && filepath == nextFile_) {
+        nextStream_->SetGain(gain);
+    }
+}
+
+float AudioManager::GetTrackGain(const std::string& filepath) const {
+    auto gain = trackGains_.find(filepath);
+    return gain != trackGains_.end() ? gain->second : 1.0f;
+}
+
+void AudioManager::SetVocalReduction(VocalRemover::Mode mode, float strength) {
+    vocalRemover_.SetMode(mode);
+    vocalRemover_.SetStrength(strength);
+    std::cout << "Vocal reduction set to mode " << static_cast<int>(mode) << ", strength "
+              << vocalRemover_.GetStrength() << std::endl;
     
-    if (music_) {
-        Mix_VolumeMusic(mixVolume);
+    if (!stream_) {
+        return;
     }
     
-    if (chunk_) {
-        Mix_VolumeChunk(chunk_, mixVolume);
+    // Move between the original and its instrumental at the current position
+    std::string instrumental = FindInstrumental(currentFile_);
+    if (instrumental != instrumentalPath_) {
+        SwapSource(instrumental.empty() ? currentFile_ : instrumental, instrumental);
+    }
+    if (instrumental.empty() && mode == VocalRemover::Mode::SPECTRAL) {
+        StartInstrumentalRender(currentFile_);
     }
 }
 
-void AudioManager::SetTempo(float multiplier) {
-    tempoMultiplier_ = std::max(0.1f, std::min(4.0f, multiplier));
-    // Note: SDL_mixer doesn't support tempo changes directly
-    // This would require additional audio processing libraries like SoundTouch
-    std::cout << "Tempo set to: " << tempoMultiplier_ << "x (not implemented in SDL_mixer)" << std::endl;
+void AudioManager::SetInstrumentalCacheDirectory(const std::string& directory) {
+    instrumentalCacheDir_.clear();
+    if (directory.empty()) {
+        return;
+    }
+    
+    std::error_code error;
+    std::filesystem::create_directories(directory, error);
+    if (error) {
+        std::cerr << "Failed to create instrumental cache " << directory << ": " << error.message() << std::endl;
+        return;
+    }
+    instrumentalCacheDir_ = directory;
 }
 
-bool AudioManager::IsPlaying() const {
-    if (music_) {
-        return Mix_PlayingMusic() && !isPaused_;
-    } else if (chunk_) {
-        return Mix_Playing(-1) > 0 && !isPaused_;
+std::string AudioManager::GetInstrumentalPath(const std::string& filepath) const {
+    if (instrumentalCacheDir_.empty() || filepath.empty()) {
+        return "";
+    }
+    
+    // Keyed on the file as it is now and on everything the render depends
+    // on, so an edited file or a different device gets a fresh render
+    std::error_code error;
+    uintmax_t size = std::filesystem::file_size(filepath, error);
+    if (error) {
+        return "";
     }
-    return false;
+    auto modified = std::filesystem::last_write_time(filepath, error);
+    if (error) {
+        return "";
+    }
+    std::filesystem::path absolute = std::filesystem::absolute(filepath, error);
+    
+    std::ostringstream key;
+    key << absolute.string() << '|' << size << '|' << modified.time_since_epoch().count() << '|'
+        << deviceRate_ << '|' << deviceChannels_ << '|' << std::lround(vocalRemover_.GetStrength() * 100.0f);
+    
+    std::ostringstream name;
+    name << std::filesystem::path(filepath).stem().string() << '-' << std::hex << HashString(key.str()) << ".wav";
+    return (std::filesystem::path(instrumentalCacheDir_) / name.str()).string();
 }
 
-bool AudioManager::IsPaused() const {
-    if (music_) {
-        return Mix_PausedMusic() || isPaused_;
+std::string AudioManager::FindInstrumental(const std::string& filepath) const {
+    if (GetVocalReduction() != VocalRemover::Mode::SPECTRAL) {
+        return "";
+    }
+    std::string path = GetInstrumentalPath(filepath);
+    return !path.empty() && FileUtils::FileExists(path) ? path : "";
+}
+
+void AudioManager::StartInstrumentalRender(const std::string& filepath) {
+    if (deviceChannels_ != 2) {
+        return;
+    }
+    
+    std::string output = GetInstrumentalPath(filepath);
+    if (output.empty() || FileUtils::FileExists(output)) {
+        return;
+    }
+    if (instrumentalRender_.valid() && renderingFile_ == output) {
+        return;
+    }
+    
+    // One render at a time; the newest song wins
+    CancelInstrumentalRender();
+    renderingFile_ = output;
+    cancelRender_.store(false);
+    
+    int rate = deviceRate_;
+    int channels = deviceChannels_;
+    float strength = vocalRemover_.GetStrength();
+    instrumentalRender_ = std::async(std::launch::async, [this, filepath, output, rate, channels, strength]() {
+        return VocalRemover::RenderFile(filepath, output, rate, channels, strength, &cancelRender_);
+    });
+    
+    std::cout << "Rendering instrumental for " << filepath << std::endl;
+}
+
+void AudioManager::CancelInstrumentalRender() {
+    if (!instrumentalRender_.valid()) {
+        return;
+    }
+    
+    cancelRender_.store(true);
+    instrumentalRender_.get();
+    renderingFile_.clear();
+}
+
+void AudioManager::UpdateInstrumentalRender() {
+    if (!instrumentalRender_.valid() || instrumentalRender_.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+        return;
+    }
+    
+    // Used from the next time the song is loaded
+    if (instrumentalRender_.get()) {
+        std::cout << "Instrumental ready: " << renderingFile_ << std::endl;
     } else {
-        return Mix_Paused(-1) > 0 || isPaused_;
+        std::cerr << "Failed to render instrumental: " << renderingFile_ << std::endl;
     }
+    renderingFile_.clear();
 }
 
-uint32_t AudioManager::GetCurrentTimeMs() const {
-    if (!isPlaying_ && !isPaused_) {
-        return seekOffset_;
+bool AudioManager::SwapSource(const std::string& filepath, const std::string& instrumental) {
+    auto stream = std::make_unique<PcmStream>();
+    if (!stream->Open(filepath, deviceRate_, deviceChannels_, kReadAheadSeconds * kMaxTempo)) {
+        std::cerr << "Failed to open " << filepath << std::endl;
+        return false;
     }
+    stream->Seek(stream_->GetPositionFrames());
+    stream->Fill();
+    stream->SetGain(stream_->GetGain(), true);
+    AttachDecoder(*stream);
     
-    if (isPaused_) {
-        return (pauseTime_ - startTime_);
+    PcmStream* previous = stream_.get();
+    instrumentalStream_.store(instrumental.empty() ? nullptr : stream.get());
+    streamSerial_.fetch_add(1);
+    if (!activeStream_.compare_exchange_strong(previous, stream.get())) {
+        // The callback has moved on to the queued track meanwhile
+        instrumentalStream_.store(instrumentalPath_.empty() ? nullptr : stream_.get());
+        return false;
+    }
+    
+    PcmStream* owner = stream_.get();
+    guideOwner_.compare_exchange_strong(owner, stream.get());
+    while (callbackBusy_.load()) {
+        SDL_Delay(0);
+    }
+    
+    stream_ = std::move(stream);
+    instrumentalPath_ = instrumental;
+    return true;
+}
+
+bool AudioManager::IsPlaying() const {
+    return isPlaying_ && !isPaused_;
+}
+
+bool AudioManager::IsPaused() const {
+    return isPaused_;
+}
+
+uint32_t AudioManager::GetCurrentTimeMs() const {
+    return static_cast<uint32_t>(GetPlaybackTimeMs());
+}
+
+double AudioManager::GetPlaybackTimeMs() const {
+    if (!stream_) {
+        return 0.0;
     }
     
-    return (SDL_GetTicks() - startTime_);
+    // Until the callback has picked up a seek, report the target
+    if (stream_->IsSeekPending()) {
+        return stream_->GetPositionFrames() * 1000.0 / deviceRate_;
+    }
+    return clock_.GetTimeMs();
+}
+
+void AudioManager::SetOutputLatencyMs(float latencyMs) {
+    clock_.SetExtraLatencyMs(latencyMs);
 }
 
 uint32_t AudioManager::GetDurationMs() const {
-    // Note: SDL_mixer doesn't provide duration information
-    // This would require additional libraries like libsndfile for WAV
-    // or taglib for MP3/OGG to read metadata
-    return 0; // Placeholder
+    if (!stream_) {
+        return 0;
+    }
+    return static_cast<uint32_t>(stream_->GetLengthFrames() * 1000 / deviceRate_);
 }
 
 void AudioManager::Update(float deltaTime) {
     UpdatePlaybackTime();
-    UpdateAudioAnalysis();
 }
 
 void AudioManager::UpdatePlaybackTime() {
-    // Check if playback has finished
-    if (isPlaying_ && !IsPlaying()) {
+    UpdateQueue();
+    UpdateInstrumentalRender();
+    
+    if (!stream_) {
+        return;
+    }
+    
+    // Check if playback has finished - with a track queued the callback
+    // carries straight on into it
+    if (isPlaying_ && !isPaused_ && stream_->IsEndOfStream() && !HasQueuedTrack()) {
+        renderEnabled_.store(false);
         isPlaying_ = false;
-        isPaused_ = false;
         std::cout << "Audio playback finished" << std::endl;
     }
 }
 
-void AudioManager::UpdateAudioAnalysis() {
-    // Placeholder for audio analysis
-    // Real implementation would require access to audio stream data
-    // This could be implemented with SDL audio callbacks or additional libraries
+void AudioManager::MusicHookCallback(void* userData, uint8_t* stream, int length) {
+    static_cast<AudioManager*>(userData)->RenderAudio(stream, length);
+}
+
+size_t AudioManager::PullStream(void* context, float* output, size_t frames) {
+    AudioManager* self = static_cast<AudioManager*>(context);
+    return self->ReadSources(self->renderSource_, output, frames);
+}
+
+void AudioManager::RenderAudio(uint8_t* stream, int length) {
+    callbackBusy_.store(true);
+    auto callbackStart = std::chrono::steady_clock::now();
+    PcmStream* source = activeStream_.load();
+    bool rendering = renderEnabled_.load(std::memory_order_acquire);
+    float volume = callbackVolume_.load(std::memory_order_relaxed);
     
-    // Generate some fake spectrum data for demonstration
-    if (isPlaying_) {
-        for (size_t i = 0; i < spectrumBuffer_.size(); ++i) {
-            spectrumBuffer_[i] = std::sin(SDL_GetTicks() * 0.001f + i * 0.1f) * 0.5f + 0.5f;
-            spectrumBuffer_[i] *= (1.0f - static_cast<float>(i) / spectrumBuffer_.size()); // Decay with frequency
+    const int bytesPerSample = SDL_AUDIO_BITSIZE(deviceFormat_) / 8;
+    const int frameBytes = bytesPerSample * deviceChannels_;
+    const int totalFrames = length / frameBytes;
+    
+    // Crossfade into the queued track once the current one is that close
+    // to its end
+    PcmStream* queued = queuedStream_.load(std::memory_order_acquire);
+    uint32_t crossfade = crossfadeFrames_.load(std::memory_order_relaxed);
+    if (queued && source && rendering && crossfade > 0 && !fadingStream_.load(std::memory_order_relaxed)) {
+        uint64_t length = source->GetLengthFrames();
+        if (source->IsEndOfStream() || (length > 0 && source->GetPositionFrames() + crossfade >= length)) {
+            PromoteQueued(source, queued, crossfade);
         }
+    }
+    
+    // Anchor the clock at the first frame of this buffer
+    uint32_t serial = streamSerial_.load();
+    bool discontinuity = serial != renderedSerial_;
+    bool seeked = false;
+    uint64_t startFrame = 0;
+    if (source) {
+        source->ApplyPendingSeek();
+        startFrame = source->GetReadPosition();
+        seeked = source->GetSeekGeneration() != renderedSeekGeneration_;
+        discontinuity = discontinuity || seeked;
+        renderedSeekGeneration_ = source->GetSeekGeneration();
+    }
+    // Running into the queued track is the one switch that is seamless
+    bool seamless = serial != renderedSerial_ ? serial == promotedSerial_ : !seeked;
+    renderedSerial_ = serial;
+    
+    // The stretcher reads ahead of what it has played, so while it is in the
+    // path the media position comes from it rather than from the stream
+    bool stretching = source && stretcher_.IsActive();
+    float rate = 1.0f;
+    if (stretching) {
+        if (discontinuity || !wasStretching_) {
+            stretcher_.Reset(startFrame);
+        }
+        startFrame = stretcher_.GetMediaPosition();
+        rate = stretcher_.GetTempo();
+    }
+    wasStretching_ = stretching;
+    
+    // Live vocal reduction, unless the track already is an instrumental.
+    // What is heard now went into the remover a whole frame ago.
+    bool removingVocals = source && vocalRemover_.IsActive() &&
+                          source != instrumentalStream_.load(std::memory_order_acquire) &&
+                          source != instrumentalNext_.load(std::memory_order_acquire);
+    if (removingVocals) {
+        if (!seamless || !wasRemovingVocals_) {
+            vocalRemover_.Reset();
+        }
+        uint64_t latency = static_cast<uint64_t>(vocalRemover_.GetLatencyFrames() * rate);
+        startFrame -= std::min(startFrame, latency);
+    }
+    wasRemovingVocals_ = removingVocals;
+    
+    clock_.OnRender(startFrame, static_cast<uint32_t>(totalFrames), rendering && source, discontinuity, rate);
+    
+    MicInput* mic = activeMic_.load(std::memory_order_acquire);
+    bool xrun = false;
+    
+    for (int done = 0; done < totalFrames; ) {
+        int frames = std::min(totalFrames - done, kRenderBlockFrames);
+        int samples = frames * deviceChannels_;
+        float* buffer = renderBuffer_.data();
         
-        // Calculate RMS level
-        float sum = 0.0f;
-        for (float val : spectrumBuffer_) {
-            sum += val * val;
+        size_t produced = 0;
+        if (source && rendering) {
+            renderSource_ = source;
+            produced = stretching ? stretcher_.Process(buffer, frames, &AudioManager::PullStream, this)
+                                  : ReadSources(source, buffer, frames);
         }
-        rmsLevel_ = std::sqrt(sum / spectrumBuffer_.size());
-    } else {
-        // Clear spectrum when not playing
-        std::fill(spectrumBuffer_.begin(), spectrumBuffer_.end(), 0.0f);
-        rmsLevel_ = 0.0f;
+        
+        // Current track ran out: carry on into the queued one from the
+        // very next sample
+        if (source && rendering && produced < static_cast<size_t>(frames)) {
+            PcmStream* next = queuedStream_.load(std::memory_order_acquire);
+            if (next && PromoteQueued(source, next, 0)) {
+                produced += ReadSources(source, buffer + produced * deviceChannels_, frames - produced);
+            }
+            // Short of the end of the track, this is the decoder falling behind
+            xrun = xrun || (produced < static_cast<size_t>(frames) && !source->IsEndOfStream());
+        }
+        
+        // Underrun or idle: pad with silence
+        std::fill(buffer + produced * deviceChannels_, buffer + samples, 0.0f);
+        
+        if (rendering) {
+            MixCrossfade(buffer, frames);
+        }
+        
+        if (rendering && removingVocals) {
+            vocalRemover_.Process(buffer, frames);
+        }
+        
+        equalizer_.Process(buffer, frames);
+        
+        if (volume != 1.0f) {
+            for (int i = 0; i < samples; ++i) {
+                buffer[i] *= volume;
+            }
+        }
+        
+        if (rendering) {
+            // Mono mix for the analysis tap; dropped if nobody is reading
+            float scale = 1.0f / deviceChannels_;
+            for (int frame = 0; frame < frames; ++frame) {
+                float sum = 0.0f;
+                for (int ch = 0; ch < deviceChannels_; ++ch) {
+                    sum += buffer[frame * deviceChannels_ + ch];
+                }
+                tapScratch_[frame] = sum * scale;
+            }
+            playbackTap_.Write(tapScratch_.data(), frames);
+        }
+        
+        // The monitor runs whether or not a track is playing
+        if (!mixer_.AddMicMonitor(buffer, frames, mic)) {
+            xrun = true;
+        }
+        
+        int64_t blockStartNs = std::chrono::duration_cast<std::chrono::nanoseconds>(callbackStart.time_since_epoch()).count() +
+                               static_cast<int64_t>(done) * 1000000000 / deviceRate_;
+        latencyProbe_.Render(buffer, frames, deviceChannels_, blockStartNs);
+        
+        WriteDeviceSamples(buffer, samples, deviceFormat_, stream + done * frameBytes);
+        done += frames;
     }
+    
+    auto callbackTime = std::chrono::steady_clock::now() - callbackStart;
+    mixer_.RecordCallback(std::chrono::duration_cast<std::chrono::nanoseconds>(callbackTime).count(), totalFrames, xrun);
+    
+    callbackBusy_.store(false);
 }
 
-std::vector<float> AudioManager::GetSpectrumData(int numBands) {
-    if (numBands <= 0 || numBands > static_cast<int>(spectrumBuffer_.size())) {
-        return spectrumBuffer_;
+size_t AudioManager::ReadSources(PcmStream* source, float* output, size_t frames) {
+    PcmStream* guide = activeGuide_.load(std::memory_order_acquire);
+    if (guide && guideOwner_.load(std::memory_order_relaxed) != source) {
+        guide = nullptr;
     }
     
-    std::vector<float> result(numBands);
-    float scale = static_cast<float>(spectrumBuffer_.size()) / numBands;
+    size_t produced = 0;
+    while (produced < frames) {
+        size_t chunk = std::min(frames - produced, static_cast<size_t>(kRenderBlockFrames));
+        float* out = output + produced * deviceChannels_;
+        size_t read = source->Read(out, chunk);
+        if (read == 0) {
+            break;
+        }
+        
+        const float* stem = nullptr;
+        if (guide) {
+            // Keep the guide on the backing track's frame; if it fell
+            // behind (e.g. decoded late), drop what it missed
+            guide->ApplyPendingSeek();
+            uint64_t backingStart = source->GetReadPosition() - read;
+            uint64_t guideStart = guide->GetReadPosition();
+            while (guideStart < backingStart) {
+                size_t skip = std::min(static_cast<size_t>(backingStart - guideStart), static_cast<size_t>(kRenderBlockFrames));
+                size_t skipped = guide->Read(guideBuffer_.data(), skip);
+                if (skipped == 0) {
+                    break;
+                }
+                guideStart += skipped;
+            }
+            
+            size_t got = guide->Read(guideBuffer_.data(), read);
+            std::fill(guideBuffer_.begin() + got * deviceChannels_, guideBuffer_.begin() + read * deviceChannels_, 0.0f);
+            stem = guideBuffer_.data();
+        }
+        
+        mixer_.MixSources(out, stem, static_cast<int>(read));
+        produced += read;
+        if (read < chunk) {
+            break;
+        }
+    }
+    return produced;
+}
+
+bool AudioManager::PromoteQueued(PcmStream*& source, PcmStream* next, uint32_t fadeFrames) {
+    // Fails if the main thread detached the current stream meanwhile
+    PcmStream* expected = source;
+    if (!activeStream_.compare_exchange_strong(expected, next)) {
+        return false;
+    }
+    queuedStream_.store(nullptr, std::memory_order_relaxed);
     
-    for (int i = 0; i < numBands; ++i) {
-        int index = static_cast<int>(i * scale);
-        result[i] = spectrumBuffer_[index];
+    if (fadeFrames > 0) {
+        fadePosition_ = 0;
+        fadeLength_ = fadeFrames;
+        fadingStream_.store(source, std::memory_order_release);
     }
     
-    return result;
+    source = next;
+    promotedSerial_ = streamSerial_.fetch_add(1) + 1;
+    trackChanges_.fetch_add(1, std::memory_order_release);
+    return true;
 }
 
-float AudioManager::GetRMSLevel() {
-    return rmsLevel_;
+void AudioManager::MixCrossfade(float* buffer, int frames) {
+    PcmStream* fading = fadingStream_.load(std::memory_order_acquire);
+    if (!fading) {
+        return;
+    }
+    
+    const int samples = frames * deviceChannels_;
+    size_t read = fading->Read(fadeBuffer_.data(), frames);
+    std::fill(fadeBuffer_.begin() + read * deviceChannels_, fadeBuffer_.begin() + samples, 0.0f);
+    
+    // Equal-power: the sum stays level on uncorrelated material
+    const float scale = static_cast<float>(M_PI / 2.0) / fadeLength_;
+    for (int frame = 0; frame < frames; ++frame) {
+        float angle = std::min(fadePosition_ + frame, fadeLength_) * scale;
+        float fadeIn = std::sin(angle);
+        float fadeOut = std::cos(angle);
+        for (int ch = 0; ch < deviceChannels_; ++ch) {
+            int i = frame * deviceChannels_ + ch;
+            buffer[i] = buffer[i] * fadeIn + fadeBuffer_[i] * fadeOut;
+        }
+    }
+    
+    fadePosition_ += frames;
+    if (fadePosition_ >= fadeLength_) {
+        fadingStream_.store(nullptr, std::memory_order_release);
+    }
 }
 
-AudioFormat AudioManager::DetectAudioFormat(const std::string& filepath) {
-    AudioFormat format;
-    format.sampleRate = 44100; // Default
-    format.channels = 2;       // Default stereo
-    format.bitDepth = 16;      // Default
-    
-    // Extract file extension
-    size_t dotPos = filepath.find_last_of('.');
-    if (dotPos != std::string::npos) {
-        std::string extension = filepath.substr(dotPos + 1);
-        std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
-        format.format = extension;
+void AudioManager::StartAnalysis() {
+    if (analysisRunning_.load()) {
+        return;
     }
     
-    // Note: For real format detection, we would need to parse file headers
-    // or use libraries like libsndfile, libav, etc.
+    playbackTap_.Reset();
+    spectrum_.Reset();
+    analysisRunning_.store(true);
+    analysisThread_ = std::thread(&AudioManager::AnalysisLoop, this);
+}
+
+void AudioManager::StopAnalysis() {
+    analysisRunning_.store(false);
+    if (analysisThread_.joinable()) {
+        analysisThread_.join();
+    }
+    rmsLevel_.store(0.0f);
+}
+
+void AudioManager::AnalysisLoop() {
+    std::vector<float> silence(deviceRate_ * kAnalysisIntervalMs / 1000, 0.0f);
+    int idleWakes = 0;
     
-    return format;
+    while (analysisRunning_.load(std::memory_order_acquire)) {
+        // Everything played since the last wake
+        double sum = 0.0;
+        size_t count = 0;
+        size_t read;
+        while ((read = playbackTap_.Read(tapBuffer_.data(), tapBuffer_.size())) > 0) {
+            for (size_t i = 0; i < read; ++i) {
+                sum += tapBuffer_[i] * tapBuffer_[i];
+            }
+            spectrum_.Process(tapBuffer_.data(), read);
+            count += read;
+        }
+        
+        if (count > 0) {
+            rmsLevel_.store(static_cast<float>(std::sqrt(sum / count)), std::memory_order_relaxed);
+            idleWakes = 0;
+        } else if (++idleWakes >= kAnalysisIdleWakes) {
+            // Paused or stopped: let the meters fall instead of freezing
+            rmsLevel_.store(0.0f, std::memory_order_relaxed);
+            if (!spectrum_.IsSilent()) {
+                spectrum_.Process(silence.data(), silence.size());
+            }
+        }
+        
+        std::this_thread::sleep_for(std::chrono::milliseconds(kAnalysisIntervalMs));
+    }
 }
 
 } // namespace Lyricstator
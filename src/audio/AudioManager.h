@@ -1,14 +1,27 @@
 #pragma once
 #include "common/Types.h"
+#include "common/LockFree.h"
+#include "audio/PlaybackClock.h"
+#include "audio/Equalizer.h"
+#include "audio/TimeStretcher.h"
+#include "audio/AudioMixer.h"
+#include "audio/VocalRemover.h"
+#include "audio/SpectrumAnalyzer.h"
+#include "audio/LatencyProbe.h"
+#include "audio/DecodeWorkerPool.h"
+#include <atomic>
+#include <future>
 #include <memory>
 #include <string>
-
-// Forward declarations
-struct Mix_Chunk;
-struct Mix_Music;
+#include <thread>
+#include <unordered_map>
+#include <vector>
 
 namespace Lyricstator {
 
+class PcmStream;
+class MicInput;
+
 class AudioManager {
 public:
     AudioManager();
@@ -22,6 +35,66 @@ public:
     bool LoadAudio(const std::string& filepath);
     void UnloadAudio();
     
+    // Next-track queue. The file is opened and pre-decoded on a background
+    // thread; the callback switches to it on the sample where the current
+    // track runs out, or crossfades over the last `crossfadeMs` of it.
+    bool QueueNext(const std::string& filepath, uint32_t crossfadeMs = 0);
+    void ClearQueue();
+    bool HasQueuedTrack() const { return pendingNext_.valid() || nextStream_ != nullptr; }
+    bool IsQueuedTrackReady() const { return nextStream_ != nullptr; }
+    
+    // True once per switch to the queued track, with the new file
+    bool ConsumeTrackChange(std::string& filepath);
+    
+    // Guide-vocal stem, played in lockstep with the current track
+    bool LoadGuideVocal(const std::string& filepath);
+    void UnloadGuideVocal();
+    
+    // Microphone: monitored through the playback callback and teed into a
+    // ring for pitch analysis (drain it with ReadMicSamples). bufferFrames
+    // is the capture period, 64 - 4096.
+    bool OpenMicrophone(const std::string& deviceName = "", int bufferFrames = 256);
+    void CloseMicrophone();
+    size_t ReadMicSamples(float* output, size_t frames);
+    int GetMicSampleRate() const;
+    int GetMicBufferFrames() const;
+    double GetMicInputAgeMs() const;           // Of the newest sample ReadMicSamples returned
+    
+    // Loopback latency measurement: clicks out of the speakers, back in
+    // through the microphone. Run it with nothing else playing.
+    bool StartLatencyProbe(int impulses = 8);
+    void CancelLatencyProbe() { latencyProbe_.Cancel(); }
+    bool IsLatencyProbeRunning() const { return latencyProbe_.IsRunning(); }
+    bool IsLatencyProbeFinished() const { return latencyProbe_.IsFinished(); }
+    LatencyProbe::Result GetLatencyProbeResult() const { return latencyProbe_.GetResult(); }
+    
+    // Mix levels
+    void SetBackingGain(float gain) { mixer_.SetBackingGain(gain); }
+    void SetGuideVocalGain(float gain) { mixer_.SetGuideGain(gain); }
+    void SetMicMonitorGain(float gain) { mixer_.SetMicGain(gain); }
+    void SetMicReverbSend(float send) { mixer_.SetReverbSend(send); }
+    void EnableMicMonitor(bool enabled) { mixer_.SetMicMonitorEnabled(enabled); }
+    
+    // Callback health: xruns and duration histogram
+    AudioMixer::Stats GetCallbackStats() const;
+    void ResetCallbackStats() { mixer_.ResetStats(); }
+    
+    // Decoding: worker refills and decoded-audio memory, with its peak
+    DecodeWorkerPool::Stats GetDecodeStats() const { return decodePool_.GetStats(); }
+    void ResetDecodeStats() { decodePool_.ResetStats(); }
+    
+    // Vocal reduction. In SPECTRAL mode a track with a cached instrumental
+    // plays that instead; one without is processed live while an
+    // instrumental is rendered in the background for next time. MID_SIDE is
+    // the cheap live-only fallback for slow devices.
+    void SetVocalReduction(VocalRemover::Mode mode, float strength = 1.0f);
+    VocalRemover::Mode GetVocalReduction() const { return vocalRemover_.GetMode(); }
+    void SetInstrumentalCacheDirectory(const std::string& directory);
+    
+    // Per-track gain in dB (loudness normalisation). Remembered per file and
+    // applied whenever that file plays, queued tracks included.
+    void SetTrackGain(const std::string& filepath, float gainDb);
+    
     // Playback control
     void Play();
     void Pause();
@@ -30,28 +103,124 @@ public:
     
     // Audio properties
     void SetVolume(float volume);
-    void SetTempo(float multiplier);
+    void SetTempo(float multiplier);            // 0.25 - 4.0, pitch preserved
+    void SetPitchShift(float semitones);        // -12 - +12, tempo preserved
     float GetVolume() const { return volume_; }
+    float GetPitchShift() const { return stretcher_.GetPitchSemitones(); }
+    
+    // Equalizer (gains in dB), applied in the playback callback
+    void SetEqualizerBandCount(int count);
+    void SetEqualizerBand(int index, float frequency, float gainDb, bool enabled = true);
+    void EnableEqualizer(bool enabled);
     float getTempo() const { return tempoMultiplier_; }
     
     // Status and timing
     bool IsPlaying() const;
     bool IsPaused() const;
     uint32_t GetCurrentTimeMs() const;
+    double GetPlaybackTimeMs() const;          // Sub-millisecond, lock-free
     uint32_t GetDurationMs() const;
     AudioFormat GetAudioFormat() const { return audioFormat_; }
     
+    // Extra output latency (beyond the device buffer) for the clock to hide
+    void SetOutputLatencyMs(float latencyMs);
+    float GetOutputLatencyMs() const { return clock_.GetLatencyMs(); }
+    
+    // Output device as opened by SDL_mixer
+    int GetDeviceSampleRate() const { return deviceRate_; }
+    int GetDeviceChannels() const { return deviceChannels_; }
+    
     // Update (called per frame)
     void Update(float deltaTime);
     
-    // Audio analysis (for visualization)
-    std::vector<float> GetSpectrumData(int numBands = 64);
-    float GetRMSLevel();
+    // Audio analysis (for visualization), computed on a background thread
+    // from what the callback played. GetSpectrum returns the newest frame,
+    // or null before the first; the frame stays valid until the next call.
+    // Call it from one thread only.
+    const SpectrumFrame* GetSpectrum() { return spectrum_.GetLatest(); }
+    float GetRMSLevel() const { return rmsLevel_.load(std::memory_order_relaxed); }
     
 private:
-    // SDL_mixer resources
-    Mix_Music* music_;
-    Mix_Chunk* chunk_;
+    // Output device
+    int deviceRate_;
+    int deviceChannels_;
+    uint16_t deviceFormat_;
+    
+    // Refills every open stream; declared first so it outlives them
+    DecodeWorkerPool decodePool_;
+    
+    // Decoded source. The audio callback only reaches it through
+    // activeStream_, so it can be swapped out without locking.
+    std::unique_ptr<PcmStream> stream_;
+    std::atomic<PcmStream*> activeStream_;
+    std::atomic<bool> callbackBusy_;
+    std::atomic<bool> renderEnabled_;
+    std::atomic<float> callbackVolume_;
+    std::atomic<uint32_t> streamSerial_;    // Bumped per load so the clock sees the change
+    std::vector<float> renderBuffer_;       // Callback scratch, sized up front
+    
+    // Queued next track. The callback promotes queuedStream_ to
+    // activeStream_ itself and bumps trackChanges_; the main thread then
+    // catches ownership up. Outgoing streams stay alive in retiredStreams_
+    // until any crossfade reading them has finished.
+    std::future<std::unique_ptr<PcmStream>> pendingNext_;
+    std::unique_ptr<PcmStream> nextStream_;
+    std::vector<std::unique_ptr<PcmStream>> retiredStreams_;
+    std::string nextFile_;
+    std::atomic<PcmStream*> queuedStream_;
+    std::atomic<PcmStream*> fadingStream_;
+    std::atomic<uint32_t> crossfadeFrames_;
+    std::atomic<uint32_t> trackChanges_;
+    uint32_t seenTrackChanges_;
+    bool trackChanged_;
+    uint32_t fadePosition_;                 // Callback side
+    uint32_t fadeLength_;                   // Callback side
+    std::vector<float> fadeBuffer_;         // Callback scratch
+    
+    // Tap: mono mix of what the callback played, for analysis
+    SpscRingBuffer<float> playbackTap_;
+    std::vector<float> tapScratch_;         // Callback side
+    std::vector<float> tapBuffer_;          // Analysis thread
+    
+    // Guide stem; only mixed while guideOwner_ is the stream being played
+    std::unique_ptr<PcmStream> guide_;
+    std::atomic<PcmStream*> activeGuide_;
+    std::atomic<PcmStream*> guideOwner_;
+    std::vector<float> guideBuffer_;        // Callback scratch
+    
+    // Microphone capture
+    std::unique_ptr<MicInput> mic_;
+    std::atomic<MicInput*> activeMic_;
+    LatencyProbe latencyProbe_;
+    
+    // Pre-rendered instrumentals. The callback skips live vocal reduction
+    // for the streams these point at.
+    std::string instrumentalCacheDir_;
+    std::string instrumentalPath_;          // What stream_ plays instead of currentFile_, if anything
+    std::string nextInstrumentalPath_;
+    std::atomic<PcmStream*> instrumentalStream_;
+    std::atomic<PcmStream*> instrumentalNext_;
+    std::future<bool> instrumentalRender_;
+    std::string renderingFile_;
+    std::atomic<bool> cancelRender_;
+    
+    // DSP run in the callback
+    AudioMixer mixer_;
+    TimeStretcher stretcher_;
+    VocalRemover vocalRemover_;
+    Equalizer equalizer_;
+    
+    // Media clock, advanced by the callback
+    PlaybackClock clock_;
+    uint32_t renderedSerial_;               // Callback side
+    uint32_t promotedSerial_;               // Callback side, serial of its own last track switch
+    uint32_t renderedSeekGeneration_;       // Callback side
+    bool wasStretching_;                    // Callback side
+    bool wasRemovingVocals_;                // Callback side
+    PcmStream* renderSource_;               // Callback side, for PullStream
+    
+    // Loudness normalisation, linear, by file
+    std::unordered_map<std::string, float> trackGains_;
     
     // Audio properties
     AudioFormat audioFormat_;
@@ -62,21 +231,38 @@ private:
     bool initialized_;
     bool isPlaying_;
     bool isPaused_;
-    uint32_t startTime_;
-    uint32_t pauseTime_;
-    uint32_t seekOffset_;
     std::string currentFile_;
     
     // Internal methods
-    bool LoadMusic(const std::string& filepath);
-    bool LoadChunk(const std::string& filepath);
-    AudioFormat DetectAudioFormat(const std::string& filepath);
+    static void MusicHookCallback(void* userData, uint8_t* stream, int length);
+    static size_t PullStream(void* context, float* output, size_t frames);
+    void RenderAudio(uint8_t* stream, int length);
+    size_t ReadSources(PcmStream* source, float* output, size_t frames);
+    bool PromoteQueued(PcmStream*& source, PcmStream* next, uint32_t fadeFrames);
+    void MixCrossfade(float* buffer, int frames);
+    void DetachStream();
     void UpdatePlaybackTime();
+    void UpdateQueue();
+    bool CollectTrackChange();
+    void SetSourceInfo(const PcmStream& stream);
+    void AttachDecoder(PcmStream& stream);
+    size_t GetReadAheadFrames() const;
+    float GetTrackGain(const std::string& filepath) const;
+    std::string GetInstrumentalPath(const std::string& filepath) const;
+    std::string FindInstrumental(const std::string& filepath) const;
+    void StartInstrumentalRender(const std::string& filepath);
+    void CancelInstrumentalRender();
+    void UpdateInstrumentalRender();
+    bool SwapSource(const std::string& filepath, const std::string& instrumental);
     
-    // Audio analysis data
-    std::vector<float> spectrumBuffer_;
-    float rmsLevel_;
-    void UpdateAudioAnalysis();
+    // Audio analysis, fed from the tap
+    std::thread analysisThread_;
+    std::atomic<bool> analysisRunning_;
+    SpectrumAnalyzer spectrum_;
+    std::atomic<float> rmsLevel_;
+    void StartAnalysis();
+    void StopAnalysis();
+    void AnalysisLoop();
 };
 
 } // namespace Lyricstator
@@ -0,0 +1,125 @@
+#include "audio/AudioMixer.h"
+#include "audio/MicInput.h"
+#include <algorithm>
+
+namespace Lyricstator {
+
+namespace {
+const int64_t kFirstBucketNs = 32000;
+}
+
+AudioMixer::AudioMixer()
+    : sampleRate_(44100)
+    , channels_(2)
+    , backingGain_(1.0f)
+    , guideGain_(1.0f)
+    , micGain_(1.0f)
+    , reverbSend_(0.25f)
+    , micMonitor_(false)
+    , micPrimed_(false)
+    , callbacks_(0)
+    , xruns_(0)
+    , maxDurationNs_(0)
+    , lastFrames_(0)
+{
+    for (auto& bucket : histogram_) {
+        bucket.store(0);
+    }
+}
+
+void AudioMixer::Configure(int sampleRate, int channels, int maxFrames) {
+    sampleRate_ = std::max(1, sampleRate);
+    channels_ = std::max(1, channels);
+    reverb_.Configure(sampleRate_);
+    micBuffer_.assign(std::max(1, maxFrames), 0.0f);
+    micPrimed_ = false;
+}
+
+void AudioMixer::MixSources(float* backing, const float* guide, int frames) {
+    const int samples = frames * channels_;
+    const float backingGain = backingGain_.load(std::memory_order_relaxed);
+    
+    if (guide) {
+        const float guideGain = guideGain_.load(std::memory_order_relaxed);
+        for (int i = 0; i < samples; ++i) {
+            backing[i] = backing[i] * backingGain + guide[i] * guideGain;
+        }
+    } else if (backingGain != 1.0f) {
+        for (int i = 0; i < samples; ++i) {
+            backing[i] *= backingGain;
+        }
+    }
+}
+
+bool AudioMixer::AddMicMonitor(float* output, int frames, MicInput* mic) {
+    if (!mic || !micMonitor_.load(std::memory_order_relaxed)) {
+        micPrimed_ = false;
+        return true;
+    }
+    
+    frames = std::min(frames, static_cast<int>(micBuffer_.size()));
+    
+    // Keep about two capture periods queued: enough to ride out jitter
+    // between the two devices without the monitor drifting late
+    size_t maxLatency = static_cast<size_t>(mic->GetBufferFrames()) * 2;
+    size_t read = mic->ReadMonitor(micBuffer_.data(), frames, maxLatency);
+    std::fill(micBuffer_.begin() + read, micBuffer_.begin() + frames, 0.0f);
+    
+    // The capture device starts a little after us; don't count that
+    bool underrun = micPrimed_ && read < static_cast<size_t>(frames);
+    micPrimed_ = micPrimed_ || read > 0;
+    
+    const float gain = micGain_.load(std::memory_order_relaxed);
+    for (int frame = 0; frame < frames; ++frame) {
+        float sample = micBuffer_[frame] * gain;
+        for (int ch = 0; ch < channels_; ++ch) {
+            output[frame * channels_ + ch] += sample;
+        }
+    }
+    reverb_.ProcessAdd(micBuffer_.data(), output, frames, channels_, gain * reverbSend_.load(std::memory_order_relaxed));
+    
+    return !underrun;
+}
+
+void AudioMixer::RecordCallback(int64_t durationNs, int frames, bool xrun) {
+    int64_t budgetNs = static_cast<int64_t>(frames) * 1000000000LL / sampleRate_;
+    if (xrun || durationNs > budgetNs) {
+        xruns_.fetch_add(1, std::memory_order_relaxed);
+    }
+    
+    int bucket = 0;
+    for (int64_t limit = kFirstBucketNs; durationNs >= limit && bucket < kHistogramBuckets - 1; limit *= 2) {
+        ++bucket;
+    }
+    histogram_[bucket].fetch_add(1, std::memory_order_relaxed);
+    
+    if (durationNs > maxDurationNs_.load(std::memory_order_relaxed)) {
+        maxDurationNs_.store(durationNs, std::memory_order_relaxed);
+    }
+    lastFrames_.store(static_cast<uint32_t>(frames), std::memory_order_relaxed);
+    callbacks_.fetch_add(1, std::memory_order_relaxed);
+}
+
+AudioMixer::Stats AudioMixer::GetStats(const MicInput* mic) const {
+    Stats stats;
+    stats.callbacks = callbacks_.load(std::memory_order_relaxed);
+    stats.xruns = xruns_.load(std::memory_order_relaxed);
+    stats.micDroppedFrames = mic ? mic->GetDroppedFrames() : 0;
+    stats.maxCallbackMs = maxDurationNs_.load(std::memory_order_relaxed) / 1e6f;
+    stats.budgetMs = lastFrames_.load(std::memory_order_relaxed) * 1000.0f / sampleRate_;
+    for (int i = 0; i < kHistogramBuckets; ++i) {
+        stats.histogram[i] = histogram_[i].load(std::memory_order_relaxed);
+    }
+    return stats;
+}
+
+void AudioMixer::ResetStats() {
+    callbacks_.store(0, std::memory_order_relaxed);
+    xruns_.store(0, std::memory_order_relaxed);
+    maxDurationNs_.store(0, std::memory_order_relaxed);
+    for (auto& bucket : histogram_) {
+        bucket.store(0, std::memory_order_relaxed);
+    }
+}
+
+} // namespace Lyricstator
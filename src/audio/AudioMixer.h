@@ -0,0 +1,76 @@
+#pragma once
+#include "audio/Reverb.h"
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+namespace Lyricstator {
+
+class MicInput;
+
+// Mix stage of the playback callback: backing track and guide-vocal stem
+// gains, the mic monitor with its reverb send, and callback health stats.
+// Gains are atomics set from the control side; nothing here allocates or
+// locks once configured.
+class AudioMixer {
+public:
+    // Callback durations, log2 buckets starting below 32 us
+    static constexpr int kHistogramBuckets = 16;
+    
+    struct Stats {
+        uint64_t callbacks;
+        uint32_t xruns;             // Callbacks that under-ran a source or their budget
+        uint32_t micDroppedFrames;
+        float maxCallbackMs;
+        float budgetMs;             // Duration of the last callback's buffer
+        uint32_t histogram[kHistogramBuckets];
+    };
+    
+    AudioMixer();
+    
+    // Not thread-safe with the callback side
+    void Configure(int sampleRate, int channels, int maxFrames);
+    
+    // Control side
+    void SetBackingGain(float gain) { backingGain_.store(gain, std::memory_order_relaxed); }
+    void SetGuideGain(float gain) { guideGain_.store(gain, std::memory_order_relaxed); }
+    void SetMicGain(float gain) { micGain_.store(gain, std::memory_order_relaxed); }
+    void SetReverbSend(float send) { reverbSend_.store(send, std::memory_order_relaxed); }
+    void SetMicMonitorEnabled(bool enabled) { micMonitor_.store(enabled, std::memory_order_relaxed); }
+    void SetReverbRoomSize(float roomSize) { reverb_.SetRoomSize(roomSize); }
+    float GetGuideGain() const { return guideGain_.load(std::memory_order_relaxed); }
+    bool IsMicMonitorEnabled() const { return micMonitor_.load(std::memory_order_relaxed); }
+    
+    // Callback side. MixSources applies the stem gains in place (guide may
+    // be null); AddMicMonitor returns false if the mic under-ran.
+    void MixSources(float* backing, const float* guide, int frames);
+    bool AddMicMonitor(float* output, int frames, MicInput* mic);
+    void RecordCallback(int64_t durationNs, int frames, bool xrun);
+    
+    // Any thread
+    Stats GetStats(const MicInput* mic) const;
+    void ResetStats();
+
+private:
+    int sampleRate_;
+    int channels_;
+    
+    std::atomic<float> backingGain_;
+    std::atomic<float> guideGain_;
+    std::atomic<float> micGain_;
+    std::atomic<float> reverbSend_;
+    std::atomic<bool> micMonitor_;
+    
+    // Callback side
+    Reverb reverb_;
+    std::vector<float> micBuffer_;
+    bool micPrimed_;
+    
+    std::atomic<uint64_t> callbacks_;
+    std::atomic<uint32_t> xruns_;
+    std::atomic<int64_t> maxDurationNs_;
+    std::atomic<uint32_t> lastFrames_;
+    std::atomic<uint32_t> histogram_[kHistogramBuckets];
+};
+
+} // namespace Lyricstator
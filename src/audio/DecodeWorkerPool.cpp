@@ -0,0 +1,134 @@
+#include "audio/DecodeWorkerPool.h"
+#include "audio/PcmStream.h"
+#include <algorithm>
+#include <chrono>
+
+namespace Lyricstator {
+
+namespace {
+// Nothing can wake a worker from the audio callback, so they poll; this is
+// far below the shortest read-ahead
+const auto kPollInterval = std::chrono::milliseconds(5);
+}
+
+DecodeWorkerPool::DecodeWorkerPool()
+    : cursor_(0)
+    , stopping_(false)
+{
+}
+
+DecodeWorkerPool::~DecodeWorkerPool() {
+    Stop();
+}
+
+void DecodeWorkerPool::Start(int threadCount) {
+    if (!workers_.empty()) {
+        return;
+    }
+    
+    if (threadCount <= 0) {
+        threadCount = std::thread::hardware_concurrency() > 4 ? 2 : 1;
+    }
+    
+    stopping_ = false;
+    for (int i = 0; i < threadCount; ++i) {
+        workers_.emplace_back(&DecodeWorkerPool::WorkerLoop, this);
+    }
+}
+
+void DecodeWorkerPool::Stop() {
+    if (workers_.empty()) {
+        return;
+    }
+    
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    wake_.notify_all();
+    
+    for (std::thread& worker : workers_) {
+        worker.join();
+    }
+    workers_.clear();
+}
+
+void DecodeWorkerPool::Add(PcmStream* stream) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        entries_.push_back(Entry{stream, false});
+        UpdateResident();
+    }
+    wake_.notify_one();
+}
+
+void DecodeWorkerPool::Remove(PcmStream* stream) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    auto matches = [stream](const Entry& entry) { return entry.stream == stream; };
+    idle_.wait(lock, [&]() {
+        auto entry = std::find_if(entries_.begin(), entries_.end(), matches);
+        return entry == entries_.end() || !entry->busy;
+    });
+    entries_.erase(std::remove_if(entries_.begin(), entries_.end(), matches), entries_.end());
+    UpdateResident();
+}
+
+DecodeWorkerPool::Stats DecodeWorkerPool::GetStats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
+
+void DecodeWorkerPool::ResetStats() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stats_.peakResidentBytes = stats_.residentBytes;
+    stats_.refills = 0;
+    stats_.lowestBufferedMs = 0.0f;
+}
+
+void DecodeWorkerPool::WorkerLoop() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!stopping_) {
+        // Round robin, so one stream being seeked around can't starve the rest
+        PcmStream* stream = nullptr;
+        for (size_t i = 0; i < entries_.size(); ++i) {
+            Entry& entry = entries_[(cursor_ + i) % entries_.size()];
+            if (!entry.busy && entry.stream->NeedsFill()) {
+                entry.busy = true;
+                stream = entry.stream;
+                cursor_ = (cursor_ + i + 1) % entries_.size();
+                break;
+            }
+        }
+        if (!stream) {
+            wake_.wait_for(lock, kPollInterval);
+            continue;
+        }
+        
+        float bufferedMs = stream->GetBufferedFrames() * 1000.0f / stream->GetOutputRate();
+        lock.unlock();
+        stream->Fill();
+        lock.lock();
+        
+        for (Entry& entry : entries_) {
+            if (entry.stream == stream) {
+                entry.busy = false;
+            }
+        }
+        stats_.lowestBufferedMs = stats_.refills == 0 ? bufferedMs : std::min(stats_.lowestBufferedMs, bufferedMs);
+        ++stats_.refills;
+        UpdateResident();
+        idle_.notify_all();
+    }
+}
+
+void DecodeWorkerPool::UpdateResident() {
+    size_t resident = 0;
+    for (const Entry& entry : entries_) {
+        resident += entry.stream->GetMemoryUsage();
+    }
+    stats_.streams = entries_.size();
+    stats_.residentBytes = resident;
+    stats_.peakResidentBytes = std::max(stats_.peakResidentBytes, resident);
+}
+
+} // namespace Lyricstator
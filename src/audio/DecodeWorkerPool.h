@@ -0,0 +1,60 @@
+#pragma once
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Lyricstator {
+
+class PcmStream;
+
+// Keeps PcmStreams topped up from background threads, so decoding never
+// waits on the main loop (and carries on while it is busy or paused).
+// A stream is refilled once it drops below half its read-ahead, which
+// PcmStream sizes from the rate it is played at. Streams join with
+// PcmStream::SetDecodePool and leave on Close.
+class DecodeWorkerPool {
+public:
+    struct Stats {
+        size_t streams = 0;
+        size_t residentBytes = 0;       // Decode memory of every registered stream
+        size_t peakResidentBytes = 0;   // High-water mark since ResetStats
+        uint64_t refills = 0;
+        float lowestBufferedMs = 0.0f;  // Least audio left in a ring when a refill began
+    };
+    
+    DecodeWorkerPool();
+    ~DecodeWorkerPool();
+    
+    // 0 threads = one, or two on machines with cores to spare
+    void Start(int threadCount = 0);
+    void Stop();
+    
+    void Add(PcmStream* stream);
+    void Remove(PcmStream* stream);     // Waits for any refill of it to finish
+    
+    Stats GetStats() const;
+    void ResetStats();
+
+private:
+    struct Entry {
+        PcmStream* stream;
+        bool busy;
+    };
+    
+    std::vector<std::thread> workers_;
+    mutable std::mutex mutex_;
+    std::condition_variable wake_;
+    std::condition_variable idle_;
+    std::vector<Entry> entries_;
+    size_t cursor_;
+    bool stopping_;
+    Stats stats_;
+    
+    void WorkerLoop();
+    void UpdateResident();
+};
+
+} // namespace Lyricstator
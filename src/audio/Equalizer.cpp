@@ -0,0 +1,334 @@
+#include "audio/Equalizer.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define LYRICSTATOR_EQUALIZER_SSE 1
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define LYRICSTATOR_EQUALIZER_NEON 1
+#endif
+
+namespace Lyricstator {
+
+namespace {
+const int kSmoothFrames = 32;           // Coefficients glide once per sub-block
+const float kSmoothTimeSeconds = 0.02f;
+const float kIdentity[5] = {1.0f, 0.0f, 0.0f, 0.0f, 0.0f};
+}
+
+Equalizer::Equalizer()
+    : sampleRate_(44100)
+    , channels_(2)
+    , bandCount_(0)
+    , enabled_(true)
+    , appliedVersion_(0)
+    , activePairs_(0)
+    , settled_(true)
+    , smoothing_(1.0f)
+{
+    for (auto& band : bands_) {
+        band = Band{1000.0f, 0.0f, true};
+    }
+}
+
+void Equalizer::Configure(int sampleRate, int channels) {
+    sampleRate_ = std::max(1, sampleRate);
+    channels_ = (channels == 1 || channels == 2) ? channels : 0;
+    smoothing_ = 1.0f - std::exp(-kSmoothFrames / (kSmoothTimeSeconds * sampleRate_));
+    
+    for (auto& pair : pairs_) {
+        for (int c = 0; c < 5; ++c) {
+            for (int lane = 0; lane < 4; ++lane) {
+                pair.current[c][lane] = kIdentity[c];
+                pair.target[c][lane] = kIdentity[c];
+            }
+        }
+        std::memset(pair.s1, 0, sizeof(pair.s1));
+        std::memset(pair.s2, 0, sizeof(pair.s2));
+        pair.carry[0] = pair.carry[1] = 0.0f;
+    }
+    activePairs_ = 0;
+    settled_ = true;
+    appliedVersion_ = 0;
+    
+    Publish();
+}
+
+void Equalizer::SetBandCount(int count) {
+    count = std::max(0, std::min(kMaxBands, count));
+    
+    // Log-spaced 31.25 Hz - 16 kHz like the settings defaults; callers
+    // normally follow up with SetBand for each band
+    for (int i = 0; i < count; ++i) {
+        float position = count > 1 ? static_cast<float>(i) / (count - 1) : 0.5f;
+        bands_[i].frequency = 31.25f * std::pow(512.0f, position);
+        bands_[i].gainDb = 0.0f;
+        bands_[i].enabled = true;
+    }
+    
+    bandCount_ = count;
+    Publish();
+}
+
+void Equalizer::SetBand(int index, float frequency, float gainDb, bool enabled) {
+    if (index < 0 || index >= bandCount_) {
+        return;
+    }
+    
+    bands_[index].frequency = frequency;
+    bands_[index].gainDb = std::max(-24.0f, std::min(24.0f, gainDb));
+    bands_[index].enabled = enabled;
+    Publish();
+}
+
+void Equalizer::SetEnabled(bool enabled) {
+    enabled_ = enabled;
+    Publish();
+}
+
+void Equalizer::Publish() {
+    CoefficientSet set;
+    set.bandCount = static_cast<uint32_t>(bandCount_);
+    
+    for (int i = 0; i < bandCount_; ++i) {
+        // Disabled or flat bands become pass-through so the callback can
+        // glide to and from them like any other change
+        if (enabled_ && bands_[i].enabled && bands_[i].gainDb != 0.0f) {
+            ComputeCoefficients(bands_[i], i, set.coeffs[i]);
+        } else {
+            std::memcpy(set.coeffs[i], kIdentity, sizeof(kIdentity));
+        }
+    }
+    
+    published_.Store(set);
+}
+
+void Equalizer::ComputeCoefficients(const Band& band, int index, float* out) const {
+    // RBJ audio EQ cookbook. Bandwidth follows the band spacing so adjacent
+    // bands overlap the way a graphic EQ's should.
+    double octaves = 1.0;
+    if (bandCount_ > 1 && bands_[0].frequency > 0.0f) {
+        octaves = std::log2(bands_[bandCount_ - 1].frequency / bands_[0].frequency) / (bandCount_ - 1);
+        octaves = std::max(0.1, std::min(4.0, octaves));
+    }
+    double ratio = std::pow(2.0, octaves);
+    double q = std::sqrt(ratio) / (ratio - 1.0);
+    
+    double frequency = std::max(10.0, std::min(0.45 * sampleRate_, static_cast<double>(band.frequency)));
+    double a = std::pow(10.0, band.gainDb / 40.0);
+    double w0 = 2.0 * M_PI * frequency / sampleRate_;
+    double cosW = std::cos(w0);
+    double sinW = std::sin(w0);
+    
+    double b0, b1, b2, a0, a1, a2;
+    bool shelves = bandCount_ > 2;
+    
+    if (shelves && index == 0) {
+        double alpha = sinW / 2.0 * std::sqrt(2.0);
+        double sqrtA = 2.0 * std::sqrt(a) * alpha;
+        b0 = a * ((a + 1) - (a - 1) * cosW + sqrtA);
+        b1 = 2 * a * ((a - 1) - (a + 1) * cosW);
+        b2 = a * ((a + 1) - (a - 1) * cosW - sqrtA);
+        a0 = (a + 1) + (a - 1) * cosW + sqrtA;
+        a1 = -2 * ((a - 1) + (a + 1) * cosW);
+        a2 = (a + 1) + (a - 1) * cosW - sqrtA;
+    } else if (shelves && index == bandCount_ - 1) {
+        double alpha = sinW / 2.0 * std::sqrt(2.0);
+        double sqrtA = 2.0 * std::sqrt(a) * alpha;
+        b0 = a * ((a + 1) + (a - 1) * cosW + sqrtA);
+        b1 = -2 * a * ((a - 1) + (a + 1) * cosW);
+        b2 = a * ((a + 1) + (a - 1) * cosW - sqrtA);
+        a0 = (a + 1) - (a - 1) * cosW + sqrtA;
+        a1 = 2 * ((a - 1) - (a + 1) * cosW);
+        a2 = (a + 1) - (a - 1) * cosW - sqrtA;
+    } else {
+        double alpha = sinW / (2.0 * q);
+        b0 = 1 + alpha * a;
+        b1 = -2 * cosW;
+        b2 = 1 - alpha * a;
+        a0 = 1 + alpha / a;
+        a1 = -2 * cosW;
+        a2 = 1 - alpha / a;
+    }
+    
+    out[0] = static_cast<float>(b0 / a0);
+    out[1] = static_cast<float>(b1 / a0);
+    out[2] = static_cast<float>(b2 / a0);
+    out[3] = static_cast<float>(a1 / a0);
+    out[4] = static_cast<float>(a2 / a0);
+}
+
+void Equalizer::ApplyPublished() {
+    uint32_t version = published_.GetVersion();
+    if (version == appliedVersion_) {
+        return;
+    }
+    
+    CoefficientSet set;
+    if (!published_.TryLoad(set)) {
+        return; // Caught mid-update; next block will see it
+    }
+    appliedVersion_ = version;
+    
+    int pairs = (static_cast<int>(set.bandCount) + 1) / 2;
+    for (int p = 0; p < pairs; ++p) {
+        PairState& pair = pairs_[p];
+        if (p >= activePairs_) {
+            // Newly added pair starts flat and silent
+            for (int c = 0; c < 5; ++c) {
+                for (int lane = 0; lane < 4; ++lane) {
+                    pair.current[c][lane] = kIdentity[c];
+                }
+            }
+            std::memset(pair.s1, 0, sizeof(pair.s1));
+            std::memset(pair.s2, 0, sizeof(pair.s2));
+            pair.carry[0] = pair.carry[1] = 0.0f;
+        }
+        
+        for (int half = 0; half < 2; ++half) {
+            int band = p * 2 + half;
+            const float* coeffs = band < static_cast<int>(set.bandCount) ? set.coeffs[band] : kIdentity;
+            for (int c = 0; c < 5; ++c) {
+                pair.target[c][half * 2] = coeffs[c];
+                pair.target[c][half * 2 + 1] = coeffs[c];
+            }
+        }
+    }
+    
+    activePairs_ = pairs;
+    settled_ = false;
+}
+
+void Equalizer::SmoothCoefficients() {
+    if (settled_) {
+        return;
+    }
+    
+    float maxDelta = 0.0f;
+    for (int p = 0; p < activePairs_; ++p) {
+        PairState& pair = pairs_[p];
+        for (int c = 0; c < 5; ++c) {
+            for (int lane = 0; lane < 4; ++lane) {
+                float delta = pair.target[c][lane] - pair.current[c][lane];
+                pair.current[c][lane] += delta * smoothing_;
+                maxDelta = std::max(maxDelta, std::fabs(delta));
+            }
+        }
+    }
+    
+    if (maxDelta < 1e-6f) {
+        for (int p = 0; p < activePairs_; ++p) {
+            std::memcpy(pairs_[p].current, pairs_[p].target, sizeof(pairs_[p].current));
+        }
+        settled_ = true;
+    }
+}
+
+void Equalizer::Process(float* buffer, int frames) {
+    ApplyPublished();
+    
+    if (channels_ == 0 || activePairs_ == 0 || !buffer) {
+        return;
+    }
+    
+    for (int offset = 0; offset < frames; offset += kSmoothFrames) {
+        int count = std::min(kSmoothFrames, frames - offset);
+        SmoothCoefficients();
+        float* block = buffer + offset * channels_;
+        for (int p = 0; p < activePairs_; ++p) {
+            ProcessPair(pairs_[p], block, count);
+        }
+    }
+}
+
+void Equalizer::ProcessPair(PairState& pair, float* buffer, int frames) {
+    // Transposed direct form II on 4 lanes. Input lanes are the new L/R
+    // sample plus band k's previous output; output lanes are band k now
+    // (carried to the next sample) and band k+1 one sample late (written).
+#if defined(LYRICSTATOR_EQUALIZER_SSE)
+    if (channels_ == 2) {
+        const __m128 b0 = _mm_load_ps(pair.current[0]);
+        const __m128 b1 = _mm_load_ps(pair.current[1]);
+        const __m128 b2 = _mm_load_ps(pair.current[2]);
+        const __m128 a1 = _mm_load_ps(pair.current[3]);
+        const __m128 a2 = _mm_load_ps(pair.current[4]);
+        __m128 s1 = _mm_load_ps(pair.s1);
+        __m128 s2 = _mm_load_ps(pair.s2);
+        __m128 y = _mm_setr_ps(pair.carry[0], pair.carry[1], 0.0f, 0.0f);
+        
+        for (int n = 0; n < frames; ++n) {
+            float* frame = buffer + n * 2;
+            __m128 input = _mm_loadl_pi(_mm_setzero_ps(), reinterpret_cast<const __m64*>(frame));
+            __m128 x = _mm_movelh_ps(input, y);
+            y = _mm_add_ps(_mm_mul_ps(b0, x), s1);
+            s1 = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(b1, x), _mm_mul_ps(a1, y)), s2);
+            s2 = _mm_sub_ps(_mm_mul_ps(b2, x), _mm_mul_ps(a2, y));
+            _mm_storeh_pi(reinterpret_cast<__m64*>(frame), y);
+        }
+        
+        _mm_store_ps(pair.s1, s1);
+        _mm_store_ps(pair.s2, s2);
+        _mm_storel_pi(reinterpret_cast<__m64*>(pair.carry), y);
+        return;
+    }
+#elif defined(LYRICSTATOR_EQUALIZER_NEON)
+    if (channels_ == 2) {
+        const float32x4_t b0 = vld1q_f32(pair.current[0]);
+        const float32x4_t b1 = vld1q_f32(pair.current[1]);
+        const float32x4_t b2 = vld1q_f32(pair.current[2]);
+        const float32x4_t a1 = vld1q_f32(pair.current[3]);
+        const float32x4_t a2 = vld1q_f32(pair.current[4]);
+        float32x4_t s1 = vld1q_f32(pair.s1);
+        float32x4_t s2 = vld1q_f32(pair.s2);
+        float32x2_t carry = vld1_f32(pair.carry);
+        
+        for (int n = 0; n < frames; ++n) {
+            float* frame = buffer + n * 2;
+            float32x4_t x = vcombine_f32(vld1_f32(frame), carry);
+            float32x4_t y = vmlaq_f32(s1, b0, x);
+            s1 = vaddq_f32(vmlsq_f32(vmulq_f32(b1, x), a1, y), s2);
+            s2 = vmlsq_f32(vmulq_f32(b2, x), a2, y);
+            carry = vget_low_f32(y);
+            vst1_f32(frame, vget_high_f32(y));
+        }
+        
+        vst1q_f32(pair.s1, s1);
+        vst1q_f32(pair.s2, s2);
+        vst1_f32(pair.carry, carry);
+        return;
+    }
+#endif
+
+    // Scalar path (and mono): same lane layout, so results match the SIMD path
+    float s1[4], s2[4];
+    std::memcpy(s1, pair.s1, sizeof(s1));
+    std::memcpy(s2, pair.s2, sizeof(s2));
+    float carry[2] = {pair.carry[0], pair.carry[1]};
+    
+    for (int n = 0; n < frames; ++n) {
+        float* frame = buffer + n * channels_;
+        float x[4] = {frame[0], channels_ == 2 ? frame[1] : 0.0f, carry[0], carry[1]};
+        float y[4];
+        for (int lane = 0; lane < 4; ++lane) {
+            y[lane] = pair.current[0][lane] * x[lane] + s1[lane];
+            s1[lane] = pair.current[1][lane] * x[lane] - pair.current[3][lane] * y[lane] + s2[lane];
+            s2[lane] = pair.current[2][lane] * x[lane] - pair.current[4][lane] * y[lane];
+        }
+        carry[0] = y[0];
+        carry[1] = y[1];
+        frame[0] = y[2];
+        if (channels_ == 2) {
+            frame[1] = y[3];
+        }
+    }
+    
+    std::memcpy(pair.s1, s1, sizeof(s1));
+    std::memcpy(pair.s2, s2, sizeof(s2));
+    pair.carry[0] = carry[0];
+    pair.carry[1] = carry[1];
+}
+
+} // namespace Lyricstator
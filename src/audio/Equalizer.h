@@ -0,0 +1,80 @@
+#pragma once
+#include "common/LockFree.h"
+#include <cstdint>
+
+namespace Lyricstator {
+
+// Graphic equalizer: a cascade of RBJ biquads (low shelf, peaking bands,
+// high shelf) run on the playback callback. Band changes are published
+// lock-free and the callback glides towards the new coefficients, so
+// dragging a slider doesn't zipper.
+//
+// Bands are processed in pipelined pairs: one 4-lane vector holds L/R of
+// band k at sample n and L/R of band k+1 at sample n-1, which keeps every
+// SIMD lane busy on a recursive filter at the cost of one sample of delay
+// per pair.
+class Equalizer {
+public:
+    static constexpr int kMaxBands = 48;
+    
+    Equalizer();
+    
+    // Not thread-safe with Process; call before the callback starts
+    void Configure(int sampleRate, int channels);
+    
+    // Control side (one thread). Gains are in dB.
+    void SetBandCount(int count);
+    void SetBand(int index, float frequency, float gainDb, bool enabled = true);
+    void SetEnabled(bool enabled);
+    int GetBandCount() const { return bandCount_; }
+    bool IsEnabled() const { return enabled_; }
+    
+    // Audio callback. Interleaved samples, mono or stereo.
+    void Process(float* buffer, int frames);
+
+private:
+    struct Band {
+        float frequency;
+        float gainDb;
+        bool enabled;
+    };
+    
+    // b0 b1 b2 a1 a2 per band, a0 normalized out
+    struct CoefficientSet {
+        uint32_t bandCount;
+        float coeffs[kMaxBands][5];
+    };
+    
+    // Per pair of bands: five coefficient vectors and the filter state,
+    // laid out as 4 lanes [band k L, band k R, band k+1 L, band k+1 R]
+    struct alignas(16) PairState {
+        float current[5][4];
+        float target[5][4];
+        float s1[4];
+        float s2[4];
+        float carry[2];     // Band k output at the previous sample
+    };
+    
+    // Control side
+    int sampleRate_;
+    int channels_;
+    int bandCount_;
+    bool enabled_;
+    Band bands_[kMaxBands];
+    SeqLock<CoefficientSet> published_;
+    
+    // Callback side
+    uint32_t appliedVersion_;
+    int activePairs_;
+    bool settled_;
+    float smoothing_;
+    PairState pairs_[kMaxBands / 2];
+    
+    void Publish();
+    void ComputeCoefficients(const Band& band, int index, float* out) const;
+    void ApplyPublished();
+    void SmoothCoefficients();
+    void ProcessPair(PairState& pair, float* buffer, int frames);
+};
+
+} // namespace Lyricstator
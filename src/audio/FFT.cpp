@@ -0,0 +1,125 @@
+#include "audio/FFT.h"
+#include <cmath>
+
+namespace Lyricstator {
+
+FFT::FFT(int size)
+    : size_(0)
+{
+    if (size > 0) {
+        Resize(size);
+    }
+}
+
+bool FFT::Resize(int size) {
+    if (size < 4 || (size & (size - 1)) != 0) {
+        return false;
+    }
+    
+    size_ = size;
+    const int half = size_ / 2;
+    
+    twiddles_.resize(half / 2);
+    for (int k = 0; k < half / 2; ++k) {
+        double angle = -2.0 * M_PI * k / half;
+        twiddles_[k] = Complex(static_cast<float>(std::cos(angle)), static_cast<float>(std::sin(angle)));
+    }
+    
+    split_.resize(half);
+    for (int k = 0; k < half; ++k) {
+        double angle = -2.0 * M_PI * k / size_;
+        split_[k] = Complex(static_cast<float>(std::cos(angle)), static_cast<float>(std::sin(angle)));
+    }
+    
+    bitReverse_.resize(half);
+    int bits = 0;
+    while ((1 << bits) < half) {
+        ++bits;
+    }
+    for (int i = 0; i < half; ++i) {
+        int reversed = 0;
+        for (int b = 0; b < bits; ++b) {
+            reversed |= ((i >> b) & 1) << (bits - 1 - b);
+        }
+        bitReverse_[i] = reversed;
+    }
+    
+    work_.assign(half, Complex());
+    return true;
+}
+
+void FFT::Transform(Complex* data, bool inverse) const {
+    const int n = size_ / 2;
+    for (int i = 0; i < n; ++i) {
+        int j = bitReverse_[i];
+        if (i < j) {
+            std::swap(data[i], data[j]);
+        }
+    }
+    
+    for (int length = 2; length <= n; length <<= 1) {
+        const int halfLength = length / 2;
+        const int stride = n / length;
+        for (int start = 0; start < n; start += length) {
+            for (int k = 0; k < halfLength; ++k) {
+                Complex w = twiddles_[k * stride];
+                if (inverse) {
+                    w = std::conj(w);
+                }
+                Complex a = data[start + k];
+                Complex b = data[start + k + halfLength] * w;
+                data[start + k] = a + b;
+                data[start + k + halfLength] = a - b;
+            }
+        }
+    }
+}
+
+void FFT::Forward(const float* input, Complex* spectrum) {
+    if (size_ == 0) {
+        return;
+    }
+    
+    // Pack even/odd samples as one complex sequence
+    const int half = size_ / 2;
+    for (int i = 0; i < half; ++i) {
+        work_[i] = Complex(input[2 * i], input[2 * i + 1]);
+    }
+    Transform(work_.data(), false);
+    
+    // Separate the two half-size spectra and combine them
+    spectrum[0] = Complex(work_[0].real() + work_[0].imag(), 0.0f);
+    spectrum[half] = Complex(work_[0].real() - work_[0].imag(), 0.0f);
+    for (int k = 1; k < half; ++k) {
+        Complex a = work_[k];
+        Complex b = std::conj(work_[half - k]);
+        Complex even = 0.5f * (a + b);
+        Complex odd = Complex(0.0f, -0.5f) * (a - b);
+        spectrum[k] = even + split_[k] * odd;
+    }
+}
+
+void FFT::Inverse(const Complex* spectrum, float* output) {
+    if (size_ == 0) {
+        return;
+    }
+    
+    // Undo the split step, then one half-size inverse transform
+    const int half = size_ / 2;
+    for (int k = 0; k < half; ++k) {
+        Complex a = spectrum[k];
+        Complex b = std::conj(spectrum[half - k]);
+        Complex even = 0.5f * (a + b);
+        Complex odd = 0.5f * (a - b) * std::conj(split_[k]);
+        work_[k] = even + Complex(0.0f, 1.0f) * odd;
+    }
+    Transform(work_.data(), true);
+    
+    const float scale = 1.0f / half;
+    for (int i = 0; i < half; ++i) {
+        output[2 * i] = work_[i].real() * scale;
+        output[2 * i + 1] = work_[i].imag() * scale;
+    }
+}
+
+} // namespace Lyricstator
@@ -0,0 +1,38 @@
+#pragma once
+#include <complex>
+#include <cstddef>
+#include <vector>
+
+namespace Lyricstator {
+
+// Real-input radix-2 FFT. A size-N transform runs as an N/2-point complex
+// FFT plus a split step, with twiddles and bit-reversal precomputed so
+// Forward/Inverse never allocate and can run in the audio callback.
+//
+// Spectra are N/2 + 1 complex bins, DC through Nyquist.
+class FFT {
+public:
+    typedef std::complex<float> Complex;
+    
+    explicit FFT(int size = 0);
+    
+    // Size must be a power of two >= 4. Allocates.
+    bool Resize(int size);
+    int GetSize() const { return size_; }
+    int GetBinCount() const { return size_ / 2 + 1; }
+    
+    // Inverse(Forward(x)) == x
+    void Forward(const float* input, Complex* spectrum);
+    void Inverse(const Complex* spectrum, float* output);
+
+private:
+    int size_;
+    std::vector<Complex> twiddles_;     // e^(-2 pi i k / (N/2)), k < N/4
+    std::vector<Complex> split_;        // e^(-2 pi i k / N), k < N/2
+    std::vector<int> bitReverse_;
+    std::vector<Complex> work_;
+    
+    void Transform(Complex* data, bool inverse) const;
+};
+
+} // namespace Lyricstator
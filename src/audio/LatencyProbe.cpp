@@ -0,0 +1,162 @@
+#include "audio/LatencyProbe.h"
+#include <algorithm>
+#include <cmath>
+
+namespace Lyricstator {
+
+namespace {
+const float kPi = 3.14159265358979f;
+const float kClickFrequency = 3000.0f;
+const float kClickSeconds = 0.001f;
+const float kClickAmplitude = 0.9f;
+const float kLeadInSeconds = 0.3f;         // Listened to first, for the noise floor
+const float kIntervalSeconds = 0.5f;
+const int64_t kTimeoutNs = 450000000;      // A click not back by then is lost
+const float kMinThreshold = 0.02f;
+const float kThresholdOverNoise = 4.0f;
+}
+
+LatencyProbe::LatencyProbe()
+    : outputRate_(44100)
+    , inputRate_(44100)
+    , state_(IDLE)
+    , impulseCount_(0)
+    , framesUntilClick_(0)
+    , clickPosition_(0)
+    , emitted_(0)
+    , noisePeak_(0.0f)
+    , resolved_(0)
+{
+    for (auto& emit : emitNs_) {
+        emit.store(0, std::memory_order_relaxed);
+    }
+    std::fill(roundTripMs_, roundTripMs_ + kMaxImpulses, -1.0f);
+}
+
+void LatencyProbe::Configure(int outputRate, int inputRate) {
+    outputRate_ = outputRate;
+    inputRate_ = inputRate;
+    
+    // Hann-windowed tone burst: sharp onset, but nothing a small speaker
+    // can't reproduce
+    int length = std::max(8, static_cast<int>(outputRate_ * kClickSeconds));
+    click_.resize(length);
+    for (int i = 0; i < length; ++i) {
+        float window = 0.5f - 0.5f * std::cos(2.0f * kPi * i / (length - 1));
+        click_[i] = kClickAmplitude * window * std::sin(2.0f * kPi * kClickFrequency * i / outputRate_);
+    }
+    clickPosition_ = click_.size();
+}
+
+bool LatencyProbe::Start(int impulses) {
+    if (IsRunning() || click_.empty()) {
+        return false;
+    }
+    
+    impulseCount_ = std::max(1, std::min(impulses, kMaxImpulses));
+    framesUntilClick_ = static_cast<int64_t>(outputRate_ * kLeadInSeconds);
+    clickPosition_ = click_.size();
+    emitted_.store(0, std::memory_order_relaxed);
+    noisePeak_ = 0.0f;
+    resolved_ = 0;
+    std::fill(roundTripMs_, roundTripMs_ + kMaxImpulses, -1.0f);
+    
+    // Everything above is published to both callbacks by this store
+    state_.store(RUNNING, std::memory_order_release);
+    return true;
+}
+
+void LatencyProbe::Cancel() {
+    state_.store(IDLE, std::memory_order_release);
+}
+
+LatencyProbe::Result LatencyProbe::GetResult() const {
+    Result result;
+    if (!IsFinished()) {
+        return result;
+    }
+    
+    float detected[kMaxImpulses];
+    result.emitted = impulseCount_;
+    for (int i = 0; i < impulseCount_; ++i) {
+        if (roundTripMs_[i] >= 0.0f) {
+            detected[result.detected++] = roundTripMs_[i];
+        }
+    }
+    if (result.detected == 0) {
+        return result;
+    }
+    
+    std::sort(detected, detected + result.detected);
+    result.roundTripMs = detected[result.detected / 2];
+    result.minMs = detected[0];
+    result.maxMs = detected[result.detected - 1];
+    return result;
+}
+
+void LatencyProbe::Render(float* buffer, int frames, int channels, int64_t startNs) {
+    if (state_.load(std::memory_order_acquire) != RUNNING) {
+        return;
+    }
+    
+    const double nsPerFrame = 1e9 / outputRate_;
+    for (int frame = 0; frame < frames; ++frame) {
+        if (clickPosition_ >= click_.size()) {
+            int emitted = emitted_.load(std::memory_order_relaxed);
+            if (emitted >= impulseCount_) {
+                return;
+            }
+            if (framesUntilClick_ > 0) {
+                --framesUntilClick_;
+                continue;
+            }
+            
+            emitNs_[emitted].store(startNs + static_cast<int64_t>(frame * nsPerFrame), std::memory_order_relaxed);
+            emitted_.store(emitted + 1, std::memory_order_release);
+            framesUntilClick_ = static_cast<int64_t>(outputRate_ * kIntervalSeconds);
+            clickPosition_ = 0;
+        }
+        
+        float sample = click_[clickPosition_++];
+        for (int ch = 0; ch < channels; ++ch) {
+            buffer[frame * channels + ch] += sample;
+        }
+    }
+}
+
+void LatencyProbe::Capture(const float* samples, size_t frames, int64_t endNs) {
+    if (state_.load(std::memory_order_acquire) != RUNNING) {
+        return;
+    }
+    
+    const double nsPerFrame = 1e9 / inputRate_;
+    const int emitted = emitted_.load(std::memory_order_acquire);
+    const float threshold = std::max(kMinThreshold, noisePeak_ * kThresholdOverNoise);
+    
+    for (size_t i = 0; i < frames && resolved_ < emitted; ++i) {
+        int64_t captureNs = endNs - static_cast<int64_t>((frames - 1 - i) * nsPerFrame);
+        int64_t emitNs = emitNs_[resolved_].load(std::memory_order_relaxed);
+        if (captureNs < emitNs) {
+            continue;
+        }
+        
+        if (std::fabs(samples[i]) >= threshold) {
+            roundTripMs_[resolved_++] = static_cast<float>((captureNs - emitNs) / 1e6);
+        } else if (captureNs - emitNs > kTimeoutNs) {
+            roundTripMs_[resolved_++] = -1.0f;
+        }
+    }
+    
+    // Nothing sent yet: this is the room (and whatever else is playing)
+    if (emitted == 0) {
+        for (size_t i = 0; i < frames; ++i) {
+            noisePeak_ = std::max(noisePeak_, std::fabs(samples[i]));
+        }
+    }
+    
+    if (resolved_ == impulseCount_) {
+        state_.store(FINISHED, std::memory_order_release);
+    }
+}
+
+} // namespace Lyricstator
@@ -0,0 +1,74 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace Lyricstator {
+
+// Loopback latency measurement. The playback callback plays a train of
+// short clicks; the capture callback looks for each one in the microphone
+// signal. Round trip is the time from a click being handed to the output
+// device to it arriving back in a capture buffer, so it covers both device
+// buffers, the converters and the air gap - what a singer's voice needs to
+// be lined up against the song.
+//
+// Both callbacks stamp their buffers with the same steady clock, so the
+// input and output devices don't need to share a sample clock.
+class LatencyProbe {
+public:
+    static constexpr int kMaxImpulses = 16;
+    
+    struct Result {
+        int emitted = 0;
+        int detected = 0;
+        float roundTripMs = 0.0f;       // Median of the detected clicks
+        float minMs = 0.0f;
+        float maxMs = 0.0f;
+    };
+    
+    LatencyProbe();
+    
+    // Allocates; call before either callback can run
+    void Configure(int outputRate, int inputRate);
+    
+    // Control side. Start is ignored while a run is in progress.
+    bool Start(int impulses = 8);
+    void Cancel();
+    bool IsRunning() const { return state_.load(std::memory_order_acquire) == RUNNING; }
+    bool IsFinished() const { return state_.load(std::memory_order_acquire) == FINISHED; }
+    Result GetResult() const;           // Valid once IsFinished
+    
+    // Playback callback: adds the clicks to interleaved output. `startNs` is
+    // the steady-clock time of the buffer's first frame.
+    void Render(float* buffer, int frames, int channels, int64_t startNs);
+    
+    // Capture callback: mono input; `endNs` is when the buffer completed
+    void Capture(const float* samples, size_t frames, int64_t endNs);
+
+private:
+    enum State {
+        IDLE,
+        RUNNING,
+        FINISHED
+    };
+    
+    int outputRate_;
+    int inputRate_;
+    std::vector<float> click_;
+    std::atomic<int> state_;
+    int impulseCount_;
+    
+    // Playback side
+    int64_t framesUntilClick_;
+    size_t clickPosition_;
+    std::atomic<int64_t> emitNs_[kMaxImpulses];
+    std::atomic<int> emitted_;
+    
+    // Capture side
+    float noisePeak_;
+    int resolved_;
+    float roundTripMs_[kMaxImpulses];   // Negative if that click never arrived
+};
+
+} // namespace Lyricstator
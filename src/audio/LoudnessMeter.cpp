@@ -0,0 +1,189 @@
+#include "audio/LoudnessMeter.h"
+#include <algorithm>
+#include <cmath>
+
+namespace Lyricstator {
+
+namespace {
+const double kAbsoluteGateLufs = -70.0;
+const double kRelativeGateLu = -10.0;
+const int kInterpolatorTaps = 48;       // Across all phases at 4x, as in BS.1770-4
+
+double EnergyToLoudness(double energy) {
+    return -0.691 + 10.0 * std::log10(energy);
+}
+
+double LoudnessToEnergy(double loudness) {
+    return std::pow(10.0, (loudness + 0.691) / 10.0);
+}
+} // namespace
+
+constexpr double LoudnessMeter::kSilence;
+
+LoudnessMeter::LoudnessMeter()
+    : sampleRate_(48000)
+    , channels_(2)
+    , shelf_()
+    , highPass_()
+    , stepFrames_(0)
+    , stepPosition_(0)
+    , stepEnergy_(0.0)
+    , oversample_(4)
+    , tapsPerPhase_(0)
+    , historyPosition_(0)
+    , peak_(0.0f)
+{
+}
+
+void LoudnessMeter::Configure(int sampleRate, int channels) {
+    sampleRate_ = std::max(1, sampleRate);
+    channels_ = std::max(1, channels);
+    
+    // K-weighting, with the BS.1770 48 kHz filters re-derived for any rate
+    double K = std::tan(M_PI * 1681.974450955533 / sampleRate_);
+    double Q = 0.7071752369554196;
+    double Vh = std::pow(10.0, 3.999843853973347 / 20.0);
+    double Vb = std::pow(Vh, 0.4996667741545416);
+    double a0 = 1.0 + K / Q + K * K;
+    shelf_.b0 = (Vh + Vb * K / Q + K * K) / a0;
+    shelf_.b1 = 2.0 * (K * K - Vh) / a0;
+    shelf_.b2 = (Vh - Vb * K / Q + K * K) / a0;
+    shelf_.a1 = 2.0 * (K * K - 1.0) / a0;
+    shelf_.a2 = (1.0 - K / Q + K * K) / a0;
+    
+    K = std::tan(M_PI * 38.13547087602444 / sampleRate_);
+    Q = 0.5003270373238773;
+    a0 = 1.0 + K / Q + K * K;
+    highPass_.b0 = 1.0;
+    highPass_.b1 = -2.0;
+    highPass_.b2 = 1.0;
+    highPass_.a1 = 2.0 * (K * K - 1.0) / a0;
+    highPass_.a2 = (1.0 - K / Q + K * K) / a0;
+    
+    // Surrounds count +1.5 dB and the LFE not at all (5.1 order L R C LFE Ls Rs)
+    channelWeight_.assign(channels_, 1.0);
+    if (channels_ >= 5) {
+        channelWeight_[3] = channels_ == 6 ? 0.0 : 1.41;
+        for (int c = 4; c < channels_; ++c) {
+            channelWeight_[c] = 1.41;
+        }
+    }
+    filterState_.assign(static_cast<size_t>(channels_) * 4, 0.0);
+    
+    stepFrames_ = static_cast<size_t>(sampleRate_ / 10);
+    
+    // Windowed-sinc interpolator, cut off just under the original Nyquist
+    oversample_ = sampleRate_ >= 96000 ? 2 : 4;
+    tapsPerPhase_ = kInterpolatorTaps / 4;
+    const int length = tapsPerPhase_ * oversample_;
+    interpolator_.assign(length, 0.0f);
+    for (int i = 0; i < length; ++i) {
+        double t = (i - (length - 1) / 2.0) / oversample_;
+        double sinc = std::fabs(t) < 1e-9 ? 1.0 : std::sin(M_PI * t) / (M_PI * t);
+        double window = 0.5 - 0.5 * std::cos(2.0 * M_PI * (i + 0.5) / length);
+        int phase = i % oversample_;
+        interpolator_[phase * tapsPerPhase_ + i / oversample_] = static_cast<float>(sinc * window);
+    }
+    history_.assign(static_cast<size_t>(channels_) * tapsPerPhase_, 0.0f);
+    
+    Reset();
+}
+
+void LoudnessMeter::Reset() {
+    std::fill(filterState_.begin(), filterState_.end(), 0.0);
+    std::fill(history_.begin(), history_.end(), 0.0f);
+    stepPosition_ = 0;
+    stepEnergy_ = 0.0;
+    stepEnergies_.clear();
+    blockEnergies_.clear();
+    historyPosition_ = 0;
+    peak_ = 0.0f;
+}
+
+void LoudnessMeter::Process(const float* input, size_t frames) {
+    if (stepFrames_ == 0) {
+        return;
+    }
+    
+    for (size_t i = 0; i < frames; ++i) {
+        const float* frame = input + i * channels_;
+        double energy = 0.0;
+        
+        for (int c = 0; c < channels_; ++c) {
+            double* state = &filterState_[c * 4];
+            double x = frame[c];
+            
+            double y = shelf_.b0 * x + state[0];
+            state[0] = shelf_.b1 * x - shelf_.a1 * y + state[1];
+            state[1] = shelf_.b2 * x - shelf_.a2 * y;
+            
+            double z = highPass_.b0 * y + state[2];
+            state[2] = highPass_.b1 * y - highPass_.a1 * z + state[3];
+            state[3] = highPass_.b2 * y - highPass_.a2 * z;
+            
+            energy += channelWeight_[c] * z * z;
+            
+            // True peak: every interpolated phase of the newest sample
+            float* history = &history_[static_cast<size_t>(c) * tapsPerPhase_];
+            history[historyPosition_] = frame[c];
+            for (int phase = 0; phase < oversample_; ++phase) {
+                const float* taps = &interpolator_[phase * tapsPerPhase_];
+                float sum = 0.0f;
+                for (int t = 0; t < tapsPerPhase_; ++t) {
+                    sum += taps[t] * history[(historyPosition_ + tapsPerPhase_ - t) % tapsPerPhase_];
+                }
+                peak_ = std::max(peak_, std::fabs(sum));
+            }
+            peak_ = std::max(peak_, std::fabs(frame[c]));
+        }
+        historyPosition_ = (historyPosition_ + 1) % tapsPerPhase_;
+        
+        stepEnergy_ += energy;
+        if (++stepPosition_ == stepFrames_) {
+            stepEnergies_.push_back(stepEnergy_ / stepFrames_);
+            stepPosition_ = 0;
+            stepEnergy_ = 0.0;
+            
+            // A 400 ms block ends on every 100 ms step once four are in
+            size_t count = stepEnergies_.size();
+            if (count >= 4) {
+                double block = (stepEnergies_[count - 1] + stepEnergies_[count - 2] +
+                                stepEnergies_[count - 3] + stepEnergies_[count - 4]) / 4.0;
+                blockEnergies_.push_back(block);
+            }
+        }
+    }
+}
+
+double LoudnessMeter::GetIntegratedLoudness() const {
+    const double absoluteGate = LoudnessToEnergy(kAbsoluteGateLufs);
+    double sum = 0.0;
+    size_t count = 0;
+    for (double block : blockEnergies_) {
+        if (block > absoluteGate) {
+            sum += block;
+            ++count;
+        }
+    }
+    if (count == 0) {
+        return kSilence;
+    }
+    
+    const double relativeGate = LoudnessToEnergy(EnergyToLoudness(sum / count) + kRelativeGateLu);
+    const double gate = std::max(absoluteGate, relativeGate);
+    sum = 0.0;
+    count = 0;
+    for (double block : blockEnergies_) {
+        if (block > gate) {
+            sum += block;
+            ++count;
+        }
+    }
+    return count > 0 ? EnergyToLoudness(sum / count) : kSilence;
+}
+
+double LoudnessMeter::GetTruePeak() const {
+    return peak_ > 0.0f ? 20.0 * std::log10(peak_) : kSilence;
+}
+
+} // namespace Lyricstator
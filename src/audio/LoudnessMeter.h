@@ -0,0 +1,60 @@
+#pragma once
+#include <cstddef>
+#include <vector>
+
+namespace Lyricstator {
+
+// ITU-R BS.1770 / EBU R128 programme loudness and true peak.
+//
+// Audio is K-weighted (high shelf + high-pass), its mean square taken over
+// 400 ms blocks every 100 ms, and the integrated loudness is the mean of
+// the blocks left after the -70 LUFS absolute and -10 LU relative gates.
+// True peak is the sample peak of a 4x oversampled copy (2x at 96 kHz and
+// up), which catches inter-sample overs a sample peak misses.
+class LoudnessMeter {
+public:
+    LoudnessMeter();
+    
+    // Allocates and resets
+    void Configure(int sampleRate, int channels);
+    void Reset();
+    
+    // Interleaved float frames
+    void Process(const float* input, size_t frames);
+    
+    // LUFS; kSilence if nothing passed the absolute gate
+    double GetIntegratedLoudness() const;
+    // dBTP; kSilence for digital silence
+    double GetTruePeak() const;
+    
+    static constexpr double kSilence = -144.0;
+
+private:
+    struct Biquad {
+        double b0, b1, b2, a1, a2;
+    };
+    
+    int sampleRate_;
+    int channels_;
+    Biquad shelf_;
+    Biquad highPass_;
+    std::vector<double> filterState_;   // Per channel: 2 stages x 2 delays
+    std::vector<double> channelWeight_;
+    
+    // Gating: energy per 100 ms step, summed over four for each block
+    size_t stepFrames_;
+    size_t stepPosition_;
+    double stepEnergy_;
+    std::vector<double> stepEnergies_;
+    std::vector<double> blockEnergies_;
+    
+    // True peak: polyphase interpolator over a short per-channel history
+    int oversample_;
+    int tapsPerPhase_;
+    std::vector<float> interpolator_;   // [phase][tap]
+    std::vector<float> history_;        // Per channel, tapsPerPhase_ samples
+    size_t historyPosition_;
+    float peak_;
+};
+
+} // namespace Lyricstator
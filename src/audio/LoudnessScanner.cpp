@@ -0,0 +1,151 @@
+#include "audio/LoudnessScanner.h"
+#include "audio/AudioDecoder.h"
+#include "audio/LoudnessMeter.h"
+#include <algorithm>
+#include <iostream>
+
+namespace Lyricstator {
+
+namespace {
+const size_t kAnalysisChunkFrames = 8192;
+}
+
+LoudnessScanner::LoudnessScanner()
+    : stopping_(false)
+{
+}
+
+LoudnessScanner::~LoudnessScanner() {
+    Stop();
+}
+
+void LoudnessScanner::Start(int threadCount) {
+    if (!workers_.empty()) {
+        return;
+    }
+    
+    if (threadCount <= 0) {
+        threadCount = std::max(1, static_cast<int>(std::thread::hardware_concurrency()) / 2);
+    }
+    
+    stopping_.store(false);
+    for (int i = 0; i < threadCount; ++i) {
+        workers_.emplace_back(&LoudnessScanner::WorkerLoop, this);
+    }
+}
+
+void LoudnessScanner::Stop() {
+    if (workers_.empty()) {
+        return;
+    }
+    
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_.store(true);
+        queue_.clear();
+    }
+    wake_.notify_all();
+    
+    for (std::thread& worker : workers_) {
+        worker.join();
+    }
+    workers_.clear();
+    pending_.clear();
+}
+
+void LoudnessScanner::Enqueue(const std::string& filepath) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!pending_.insert(filepath).second) {
+            return;
+        }
+        queue_.push_back(filepath);
+    }
+    wake_.notify_one();
+}
+
+void LoudnessScanner::Prioritize(const std::string& filepath) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto queued = std::find(queue_.begin(), queue_.end(), filepath);
+        if (queued != queue_.end()) {
+            queue_.erase(queued);
+        } else if (!pending_.insert(filepath).second) {
+            return; // Already being analysed
+        }
+        queue_.push_front(filepath);
+    }
+    wake_.notify_one();
+}
+
+bool LoudnessScanner::PollResult(Result& result) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (results_.empty()) {
+        return false;
+    }
+    result = std::move(results_.front());
+    results_.pop_front();
+    return true;
+}
+
+size_t LoudnessScanner::GetPendingCount() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return pending_.size();
+}
+
+void LoudnessScanner::WorkerLoop() {
+    for (;;) {
+        std::string filepath;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            wake_.wait(lock, [this]() { return stopping_.load() || !queue_.empty(); });
+            if (stopping_.load()) {
+                return;
+            }
+            filepath = queue_.front();
+            queue_.pop_front();
+        }
+        
+        Result result;
+        result.filepath = filepath;
+        result.success = Analyze(filepath, result, &stopping_);
+        
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (stopping_.load()) {
+            return;
+        }
+        pending_.erase(filepath);
+        results_.push_back(std::move(result));
+    }
+}
+
+bool LoudnessScanner::Analyze(const std::string& filepath, Result& result, const std::atomic<bool>* cancel) {
+    auto decoder = AudioDecoder::Create(filepath);
+    if (!decoder) {
+        std::cerr << "Loudness analysis can't decode " << filepath << std::endl;
+        return false;
+    }
+    
+    // Measured at the file's own rate; K-weighting adapts to it
+    const DecodedFormat& format = decoder->GetFormat();
+    LoudnessMeter meter;
+    meter.Configure(format.sampleRate, format.channels);
+    
+    std::vector<float> buffer(kAnalysisChunkFrames * format.channels);
+    for (;;) {
+        if (cancel && cancel->load(std::memory_order_relaxed)) {
+            return false;
+        }
+        size_t frames = decoder->Read(buffer.data(), kAnalysisChunkFrames);
+        if (frames == 0) {
+            break;
+        }
+        meter.Process(buffer.data(), frames);
+    }
+    
+    result.integratedLufs = meter.GetIntegratedLoudness();
+    result.truePeakDb = meter.GetTruePeak();
+    return true;
+}
+
+} // namespace Lyricstator
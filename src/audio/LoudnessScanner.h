@@ -0,0 +1,55 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace Lyricstator {
+
+// Background EBU R128 analysis of the song library. A small pool of worker
+// threads decodes queued files and measures them; finished results are
+// collected on the main thread with PollResult.
+class LoudnessScanner {
+public:
+    struct Result {
+        std::string filepath;
+        bool success = false;
+        double integratedLufs = 0.0;
+        double truePeakDb = 0.0;
+    };
+    
+    LoudnessScanner();
+    ~LoudnessScanner();
+    
+    // 0 threads = half the cores, leaving room for playback and the UI
+    void Start(int threadCount = 0);
+    void Stop();
+    
+    // Files already queued or being analysed are ignored. Prioritize moves a
+    // file (queuing it if needed) to the front, for the song about to play.
+    void Enqueue(const std::string& filepath);
+    void Prioritize(const std::string& filepath);
+    
+    bool PollResult(Result& result);
+    size_t GetPendingCount() const;
+    
+    // Synchronous analysis of one file; used by the workers
+    static bool Analyze(const std::string& filepath, Result& result, const std::atomic<bool>* cancel = nullptr);
+
+private:
+    std::vector<std::thread> workers_;
+    mutable std::mutex mutex_;
+    std::condition_variable wake_;
+    std::deque<std::string> queue_;
+    std::set<std::string> pending_;     // Queued or in progress
+    std::deque<Result> results_;
+    std::atomic<bool> stopping_;
+    
+    void WorkerLoop();
+};
+
+} // namespace Lyricstator
@@ -0,0 +1,123 @@
+#include "audio/MicInput.h"
+#include "audio/LatencyProbe.h"
+#include <SDL2/SDL.h>
+#include <iostream>
+#include <algorithm>
+#include <chrono>
+
+namespace Lyricstator {
+
+MicInput::MicInput()
+    : device_(0)
+    , sampleRate_(44100)
+    , bufferFrames_(256)
+    , droppedFrames_(0)
+    , probe_(nullptr)
+    , analysisFramesRead_(0)
+{
+}
+
+MicInput::~MicInput() {
+    Close();
+}
+
+bool MicInput::Open(const std::string& deviceName, int sampleRate, int bufferFrames) {
+    Close();
+    
+    int period = kMinBufferFrames;
+    while (period < bufferFrames && period < kMaxBufferFrames) {
+        period <<= 1;
+    }
+    
+    // Mono float at the playback rate; SDL converts whatever the hardware does
+    SDL_AudioSpec desired;
+    SDL_zero(desired);
+    desired.freq = sampleRate;
+    desired.format = AUDIO_F32SYS;
+    desired.channels = 1;
+    desired.samples = static_cast<Uint16>(period);
+    desired.callback = &MicInput::CaptureCallback;
+    desired.userdata = this;
+    
+    SDL_AudioSpec obtained;
+    SDL_zero(obtained);
+    const char* name = deviceName.empty() ? nullptr : deviceName.c_str();
+    
+    // Rings are sized before the device can call back into them
+    sampleRate_ = sampleRate;
+    bufferFrames_ = period;
+    monitorRing_.Resize(sampleRate / 4);
+    analysisRing_.Resize(sampleRate);
+    droppedFrames_.store(0);
+    captureStamp_.Store(CaptureStamp{0, 0});
+    analysisFramesRead_ = 0;
+    
+    device_ = SDL_OpenAudioDevice(name, 1, &desired, &obtained, 0);
+    if (device_ == 0) {
+        std::cerr << "Failed to open microphone: " << SDL_GetError() << std::endl;
+        return false;
+    }
+    bufferFrames_ = obtained.samples;
+    
+    SDL_PauseAudioDevice(device_, 0);
+    std::cout << "Microphone opened (" << sampleRate_ << " Hz, " << bufferFrames_ << " frame buffer)" << std::endl;
+    return true;
+}
+
+void MicInput::Close() {
+    if (device_ != 0) {
+        SDL_CloseAudioDevice(device_);
+        device_ = 0;
+    }
+}
+
+void MicInput::CaptureCallback(void* userData, uint8_t* stream, int length) {
+    static_cast<MicInput*>(userData)->OnCapture(reinterpret_cast<const float*>(stream), length / sizeof(float));
+}
+
+void MicInput::OnCapture(const float* samples, size_t frames) {
+    int64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+    
+    size_t dropped = frames - monitorRing_.Write(samples, frames);
+    dropped += frames - analysisRing_.Write(samples, frames);
+    if (dropped > 0) {
+        droppedFrames_.fetch_add(static_cast<uint32_t>(dropped), std::memory_order_relaxed);
+    }
+    captureStamp_.Store(CaptureStamp{analysisRing_.GetWriteIndex(), now});
+    
+    if (LatencyProbe* probe = probe_.load(std::memory_order_acquire)) {
+        probe->Capture(samples, frames, now);
+    }
+}
+
+size_t MicInput::ReadMonitor(float* output, size_t frames, size_t maxLatencyFrames) {
+    size_t available = monitorRing_.GetReadAvailable();
+    if (available > frames + maxLatencyFrames) {
+        monitorRing_.Skip(available - frames - maxLatencyFrames);
+    }
+    return monitorRing_.Read(output, frames);
+}
+
+size_t MicInput::ReadAnalysis(float* output, size_t frames) {
+    size_t read = analysisRing_.Read(output, frames);
+    analysisFramesRead_ += read;
+    return read;
+}
+
+double MicInput::GetAnalysisAgeMs() const {
+    CaptureStamp stamp = captureStamp_.Load();
+    if (stamp.timeNs == 0 || analysisFramesRead_ == 0) {
+        return 0.0;
+    }
+    
+    // The stamp is the newest buffer; walk back to the last sample read
+    // (which may already be past the stamp if we read mid-callback)
+    int64_t behind = static_cast<int64_t>(stamp.frames) - static_cast<int64_t>(analysisFramesRead_);
+    double behindMs = std::max<int64_t>(behind, 0) * 1000.0 / sampleRate_;
+    int64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+    return (now - stamp.timeNs) / 1e6 + behindMs;
+}
+
+} // namespace Lyricstator
@@ -0,0 +1,71 @@
+#pragma once
+#include "common/LockFree.h"
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+namespace Lyricstator {
+
+class LatencyProbe;
+
+// Microphone capture through its own SDL capture device. The capture
+// callback tees mono float into two rings: one the playback callback pulls
+// from for monitoring, one the pitch analysis drains. Neither side blocks;
+// a ring nobody drains just drops.
+class MicInput {
+public:
+    // Capture periods the device is asked for; powers of two in between
+    static constexpr int kMinBufferFrames = 64;
+    static constexpr int kMaxBufferFrames = 4096;
+    
+    MicInput();
+    ~MicInput();
+    
+    // Empty deviceName picks the default input. bufferFrames is rounded up
+    // to a power of two within the limits above; GetBufferFrames reports
+    // what the device actually granted.
+    bool Open(const std::string& deviceName, int sampleRate, int bufferFrames);
+    void Close();
+    bool IsOpen() const { return device_ != 0; }
+    int GetSampleRate() const { return sampleRate_; }
+    int GetBufferFrames() const { return bufferFrames_; }
+    
+    // Playback callback side. Drops the oldest audio first so no more than
+    // `maxLatencyFrames` stay queued after this read.
+    size_t ReadMonitor(float* output, size_t frames, size_t maxLatencyFrames);
+    
+    // Analysis side
+    size_t ReadAnalysis(float* output, size_t frames);
+    
+    // How long ago the newest sample ReadAnalysis has handed out was
+    // captured, in ms. Call from the analysis side.
+    double GetAnalysisAgeMs() const;
+    
+    // Capture callback hands every buffer to the probe while one is set
+    void SetLatencyProbe(LatencyProbe* probe) { probe_.store(probe, std::memory_order_release); }
+    
+    // Frames dropped because a ring was full
+    uint32_t GetDroppedFrames() const { return droppedFrames_.load(std::memory_order_relaxed); }
+
+private:
+    uint32_t device_;
+    int sampleRate_;
+    int bufferFrames_;
+    SpscRingBuffer<float> monitorRing_;
+    SpscRingBuffer<float> analysisRing_;
+    std::atomic<uint32_t> droppedFrames_;
+    std::atomic<LatencyProbe*> probe_;
+    
+    // Capture time of the analysis ring, stamped per callback
+    struct CaptureStamp {
+        uint64_t frames;                // Analysis ring write index after the buffer
+        int64_t timeNs;                 // Steady clock when the buffer arrived
+    };
+    SeqLock<CaptureStamp> captureStamp_;
+    uint64_t analysisFramesRead_;       // Analysis side
+    
+    static void CaptureCallback(void* userData, uint8_t* stream, int length);
+    void OnCapture(const float* samples, size_t frames);
+};
+
+} // namespace Lyricstator
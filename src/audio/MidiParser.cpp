@@ -1,7 +1,8 @@
 #include "audio/MidiParser.h"
 #include <iostream>
 #include <algorithm>
-#include <cstring>
+#include <fstream>
+#include <iterator>
 
 namespace Lyricstator {
 
@@ -21,18 +22,27 @@ MidiParser::~MidiParser() {
 bool MidiParser::LoadMidiFile(const std::string& filepath) {
     std::cout << "Parsing MIDI file: " << filepath << std::endl;
     
-    Clear();
-    
     std::ifstream file(filepath, std::ios::binary);
     if (!file.is_open()) {
+        Clear();
         std::cerr << "Failed to open MIDI file: " << filepath << std::endl;
         return false;
     }
     
+    std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    file.close();
+    
+    return LoadMidiData(data.data(), data.size());
+}
+
+bool MidiParser::LoadMidiData(const uint8_t* data, size_t size) {
+    Clear();
+    
+    ByteReader reader = {data, size, 0, false};
+    
     // Parse MIDI header
-    if (!ParseHeader(file)) {
+    if (!ParseHeader(reader)) {
         std::cerr << "Failed to parse MIDI header" << std::endl;
-        file.close();
         return false;
     }
     
@@ -43,26 +53,32 @@ bool MidiParser::LoadMidiFile(const std::string& filepath) {
     // Parse all tracks
     for (uint16_t track = 0; track < trackCount_; ++track) {
         // Read track header
-        char trackHeader[4];
-        file.read(trackHeader, 4);
+        std::string trackHeader = ReadString(reader, 4);
+        uint32_t trackLength = ReadUInt32BE(reader);
         
-        if (std::strncmp(trackHeader, "MTrk", 4) != 0) {
+        if (reader.failed || trackHeader != "MTrk") {
             std::cerr << "Invalid track header at track " << track << std::endl;
-            file.close();
             return false;
         }
         
-        uint32_t trackLength = ReadUInt32BE(file);
         std::cout << "Parsing track " << track << " (length: " << trackLength << " bytes)" << std::endl;
         
-        if (!ParseTrack(file, trackLength)) {
+        if (!ParseTrack(reader, trackLength)) {
             std::cerr << "Failed to parse track " << track << std::endl;
-            file.close();
             return false;
         }
     }
     
-    file.close();
+    // Lyrics are timed once every track's tempo changes are in
+    std::stable_sort(tempoEvents_.begin(), tempoEvents_.end(),
+        [](const TempoEvent& a, const TempoEvent& b) {
+            return a.tick < b.tick;
+        });
+    for (size_t i = 0; i < lyricEvents_.size(); ++i) {
+        lyricEvents_[i].startTime = TicksToMilliseconds(lyricTicks_[i]);
+        lyricEvents_[i].endTime = lyricEvents_[i].startTime + 1000; // Default 1 second duration
+    }
+    lyricTicks_.clear();
     
     // Sort events by time
     std::sort(notes_.begin(), notes_.end(), 
@@ -91,6 +107,7 @@ void MidiParser::Clear() {
     tempoEvents_.clear();
     timeSignatures_.clear();
     lyricEvents_.clear();
+    lyricTicks_.clear();
     activeNotes_.clear();
     
     format_ = 0;
@@ -100,27 +117,31 @@ void MidiParser::Clear() {
     validFile_ = false;
 }
 
-bool MidiParser::ParseHeader(std::ifstream& file) {
+bool MidiParser::ParseHeader(ByteReader& reader) {
     // Read "MThd" chunk type
-    char chunkType[4];
-    file.read(chunkType, 4);
+    std::string chunkType = ReadString(reader, 4);
     
-    if (std::strncmp(chunkType, "MThd", 4) != 0) {
+    if (chunkType != "MThd") {
         std::cerr << "Invalid MIDI file header" << std::endl;
         return false;
     }
     
     // Read header length (should be 6)
-    uint32_t headerLength = ReadUInt32BE(file);
+    uint32_t headerLength = ReadUInt32BE(reader);
     if (headerLength != 6) {
         std::cerr << "Invalid MIDI header length: " << headerLength << std::endl;
         return false;
     }
     
     // Read format, track count, and division
-    format_ = ReadUInt16BE(file);
-    trackCount_ = ReadUInt16BE(file);
-    uint16_t division = ReadUInt16BE(file);
+    format_ = ReadUInt16BE(reader);
+    trackCount_ = ReadUInt16BE(reader);
+    uint16_t division = ReadUInt16BE(reader);
+    
+    if (reader.failed) {
+        std::cerr << "MIDI file ends inside its header" << std::endl;
+        return false;
+    }
     
     // Check if division is in ticks per quarter note format
     if (division & 0x8000) {
@@ -128,23 +149,39 @@ bool MidiParser::ParseHeader(std::ifstream& file) {
         return false;
     }
     
+    if (division == 0) {
+        std::cerr << "Invalid MIDI time division: 0 ticks per quarter note" << std::endl;
+        return false;
+    }
+    
     ticksPerQuarterNote_ = division;
     
     return true;
 }
 
-bool MidiParser::ParseTrack(std::ifstream& file, uint32_t trackLength) {
-    uint32_t bytesRead = 0;
+bool MidiParser::ParseTrack(ByteReader& reader, uint32_t trackLength) {
+    if (trackLength > reader.GetRemaining()) {
+        std::cerr << "Track length " << trackLength << " runs past the end of the file" << std::endl;
+        return false;
+    }
+    
+    // Events are read from the track's own bytes, so one that claims more
+    // than is left fails instead of running into the next chunk
+    ByteReader track = {reader.data + reader.position, trackLength, 0, false};
+    reader.position += trackLength;
+    
     uint32_t absoluteTime = 0;
     uint8_t runningStatus = 0;
     
     activeNotes_.clear();
+    openFirst_.assign(16 * 128, kNoNote);
+    openLast_.assign(16 * 128, kNoNote);
     
-    while (bytesRead < trackLength) {
+    while (track.position < track.size) {
         MidiEvent event;
         
-        if (!ParseEvent(file, event, runningStatus)) {
-            std::cerr << "Failed to parse MIDI event" << std::endl;
+        if (!ParseEvent(track, event, runningStatus)) {
+            std::cerr << "Failed to parse MIDI event at track byte " << track.position << std::endl;
             return false;
         }
         
@@ -159,15 +196,11 @@ bool MidiParser::ParseTrack(std::ifstream& file, uint32_t trackLength) {
             uint8_t channel = event.status & 0x0F;
             ProcessNoteEvent(event, absoluteTime, channel);
         }
-        
-        // Update bytes read counter
-        bytesRead += 1; // Delta time (variable length, counted in ReadVariableLength)
-        bytesRead += 1; // Status byte
-        bytesRead += event.data.size();
     }
     
     // Process any remaining active notes
     for (const auto& activeNote : activeNotes_) {
+        if (!activeNote.open) continue;
         MidiNote note;
         note.note = activeNote.note;
         note.velocity = activeNote.velocity;
@@ -180,20 +213,24 @@ bool MidiParser::ParseTrack(std::ifstream& file, uint32_t trackLength) {
     return true;
 }
 
-bool MidiParser::ParseEvent(std::ifstream& file, MidiEvent& event, uint8_t& runningStatus) {
+bool MidiParser::ParseEvent(ByteReader& track, MidiEvent& event, uint8_t& runningStatus) {
     // Read delta time
-    event.deltaTime = ReadVariableLength(file);
+    event.deltaTime = ReadVariableLength(track);
     
     // Read status byte
-    uint8_t statusByte;
-    file.read(reinterpret_cast<char*>(&statusByte), 1);
+    uint8_t statusByte = ReadUInt8(track);
     
     if (statusByte & 0x80) {
-        // New status byte
+        // New status byte; only channel messages carry over as running status
         event.status = statusByte;
-        runningStatus = statusByte;
+        if (statusByte < 0xF0) {
+            runningStatus = statusByte;
+        }
     } else {
         // Running status - use previous status and treat this byte as data
+        if (runningStatus == 0) {
+            return false; // Data byte with no status to continue
+        }
         event.status = runningStatus;
         event.data.push_back(statusByte);
     }
@@ -201,54 +238,44 @@ bool MidiParser::ParseEvent(std::ifstream& file, MidiEvent& event, uint8_t& runn
     // Read event data based on status
     if (event.status == 0xFF) {
         // Meta event
-        uint8_t metaType;
-        file.read(reinterpret_cast<char*>(&metaType), 1);
-        event.data.push_back(metaType);
+        event.data.push_back(ReadUInt8(track));
         
-        uint32_t length = ReadVariableLength(file);
-        for (uint32_t i = 0; i < length; ++i) {
-            uint8_t byte;
-            file.read(reinterpret_cast<char*>(&byte), 1);
-            event.data.push_back(byte);
+        uint32_t length = ReadVariableLength(track);
+        if (length > track.GetRemaining()) {
+            return false;
         }
+        event.data.insert(event.data.end(), track.data + track.position, track.data + track.position + length);
+        track.position += length;
+    } else if (event.status == 0xF0 || event.status == 0xF7) {
+        // SysEx - skipped
+        uint32_t length = ReadVariableLength(track);
+        if (length > track.GetRemaining()) {
+            return false;
+        }
+        track.position += length;
     } else if ((event.status & 0xF0) == 0x90 || (event.status & 0xF0) == 0x80) {
         // Note on/off - read note and velocity
         if (event.data.empty()) { // If not already read due to running status
-            uint8_t note, velocity;
-            file.read(reinterpret_cast<char*>(&note), 1);
-            file.read(reinterpret_cast<char*>(&velocity), 1);
-            event.data.push_back(note);
-            event.data.push_back(velocity);
-        } else {
-            // Running status case - need to read velocity
-            uint8_t velocity;
-            file.read(reinterpret_cast<char*>(&velocity), 1);
-            event.data.push_back(velocity);
+            event.data.push_back(ReadUInt8(track));
         }
+        event.data.push_back(ReadUInt8(track));
     } else if ((event.status & 0xF0) == 0xC0 || (event.status & 0xF0) == 0xD0) {
         // Program change or channel pressure - 1 data byte
         if (event.data.empty()) {
-            uint8_t data;
-            file.read(reinterpret_cast<char*>(&data), 1);
-            event.data.push_back(data);
+            event.data.push_back(ReadUInt8(track));
         }
     } else if ((event.status & 0xF0) >= 0x80 && (event.status & 0xF0) <= 0xE0) {
         // Other channel messages - 2 data bytes
-        if (event.data.empty()) {
-            uint8_t data1, data2;
-            file.read(reinterpret_cast<char*>(&data1), 1);
-            file.read(reinterpret_cast<char*>(&data2), 1);
-            event.data.push_back(data1);
-            event.data.push_back(data2);
-        } else {
-            // Running status case
-            uint8_t data2;
-            file.read(reinterpret_cast<char*>(&data2), 1);
-            event.data.push_back(data2);
+        if (event.data.empty()) { // Running status already supplied the first
+            event.data.push_back(ReadUInt8(track));
         }
+        event.data.push_back(ReadUInt8(track));
+    } else {
+        // System common/real-time messages don't belong in a file
+        return false;
     }
     
-    return true;
+    return !track.failed;
 }
 
 void MidiParser::ProcessNoteEvent(const MidiEvent& event, uint32_t absoluteTime, uint8_t channel) {
@@ -257,6 +284,8 @@ void MidiParser::ProcessNoteEvent(const MidiEvent& event, uint32_t absoluteTime,
     uint8_t note = event.data[0];
     uint8_t velocity = event.data[1];
     
+    size_t key = channel * 128 + (note & 0x7F);
+    
     if ((event.status & 0xF0) == 0x90 && velocity > 0) {
         // Note on
         ActiveNote activeNote;
@@ -264,25 +293,33 @@ void MidiParser::ProcessNoteEvent(const MidiEvent& event, uint32_t absoluteTime,
         activeNote.velocity = velocity;
         activeNote.startTime = absoluteTime;
         activeNote.channel = channel;
-        activeNotes_.push_back(activeNote);
-    } else {
-        // Note off (or note on with velocity 0)
-        auto it = std::find_if(activeNotes_.begin(), activeNotes_.end(),
-            [note, channel](const ActiveNote& activeNote) {
-                return activeNote.note == note && activeNote.channel == channel;
-            });
+        activeNote.open = true;
+        activeNote.next = kNoNote;
         
-        if (it != activeNotes_.end()) {
-            MidiNote midiNote;
-            midiNote.note = it->note;
-            midiNote.velocity = it->velocity;
-            midiNote.startTime = it->startTime;
-            midiNote.duration = absoluteTime - it->startTime;
-            midiNote.channel = it->channel;
-            notes_.push_back(midiNote);
-            
-            activeNotes_.erase(it);
+        uint32_t index = static_cast<uint32_t>(activeNotes_.size());
+        activeNotes_.push_back(activeNote);
+        if (openLast_[key] == kNoNote) {
+            openFirst_[key] = index;
+        } else {
+            activeNotes_[openLast_[key]].next = index;
         }
+        openLast_[key] = index;
+    } else if (openFirst_[key] != kNoNote) {
+        // Note off (or note on with velocity 0) ends the oldest open one
+        ActiveNote& activeNote = activeNotes_[openFirst_[key]];
+        activeNote.open = false;
+        openFirst_[key] = activeNote.next;
+        if (openFirst_[key] == kNoNote) {
+            openLast_[key] = kNoNote;
+        }
+        
+        MidiNote midiNote;
+        midiNote.note = activeNote.note;
+        midiNote.velocity = activeNote.velocity;
+        midiNote.startTime = activeNote.startTime;
+        midiNote.duration = absoluteTime - activeNote.startTime;
+        midiNote.channel = activeNote.channel;
+        notes_.push_back(midiNote);
     }
 }
 
@@ -323,18 +360,20 @@ void MidiParser::ProcessMetaEvent(const MidiEvent& event, uint32_t absoluteTime)
 void MidiParser::ProcessLyricEvent(const std::string& lyricText, uint32_t absoluteTime) {
     LyricEvent lyricEvent;
     lyricEvent.text = lyricText;
-    lyricEvent.startTime = TicksToMilliseconds(absoluteTime);
-    lyricEvent.endTime = lyricEvent.startTime + 1000; // Default 1 second duration
+    lyricEvent.startTime = 0; // Timed in LoadMidiData
+    lyricEvent.endTime = 0;
     lyricEvent.pitch = 0.0f; // Will be determined by synchronization
     lyricEvent.highlighted = false;
     
     lyricEvents_.push_back(lyricEvent);
+    lyricTicks_.push_back(absoluteTime);
 }
 
 void MidiParser::ProcessTempoEvent(const std::vector<uint8_t>& data, uint32_t absoluteTime) {
     if (data.size() < 3) return;
     
     uint32_t microsecondsPerQuarter = (data[0] << 16) | (data[1] << 8) | data[2];
+    if (microsecondsPerQuarter == 0) return; // Would divide by zero in every conversion
     currentTempo_ = microsecondsPerQuarter;
     
     TempoEvent tempoEvent;
@@ -346,7 +385,7 @@ void MidiParser::ProcessTempoEvent(const std::vector<uint8_t>& data, uint32_t ab
 }
 
 void MidiParser::ProcessTimeSignatureEvent(const std::vector<uint8_t>& data, uint32_t absoluteTime) {
-    if (data.size() < 4) return;
+    if (data.size() < 4 || data[1] > 7) return; // Denominators past 2^7 don't fit
     
     TimeSignature timeSig;
     timeSig.tick = absoluteTime;
@@ -357,15 +396,7 @@ void MidiParser::ProcessTimeSignatureEvent(const std::vector<uint8_t>& data, uin
 }
 
 uint32_t MidiParser::TicksToMilliseconds(uint32_t ticks) const {
-    // Find the current tempo at this tick position
-    uint32_t currentTempo = currentTempo_;
-    for (const auto& tempoEvent : tempoEvents_) {
-        if (tempoEvent.tick <= ticks) {
-            currentTempo = tempoEvent.microsecondsPerQuarter;
-        } else {
-            break;
-        }
-    }
+    uint32_t currentTempo = GetTempoAt(ticks);
     
     // Convert ticks to milliseconds
     // ms = (ticks / ticksPerQuarter) * (microsecondsPerQuarter / 1000)
@@ -384,16 +415,16 @@ uint32_t MidiParser::MillisecondsToTicks(uint32_t milliseconds) const {
 }
 
 double MidiParser::GetCurrentBPM(uint32_t ticks) const {
-    uint32_t currentTempo = currentTempo_;
-    for (const auto& tempoEvent : tempoEvents_) {
-        if (tempoEvent.tick <= ticks) {
-            currentTempo = tempoEvent.microsecondsPerQuarter;
-        } else {
-            break;
-        }
-    }
-    
-    return 60000000.0 / currentTempo;
+    return 60000000.0 / GetTempoAt(ticks);
+}
+
+uint32_t MidiParser::GetTempoAt(uint32_t ticks) const {
+    // Last tempo change at or before `ticks`; tempoEvents_ is sorted by tick
+    auto next = std::upper_bound(tempoEvents_.begin(), tempoEvents_.end(), ticks,
+        [](uint32_t tick, const TempoEvent& tempoEvent) {
+            return tick < tempoEvent.tick;
+        });
+    return next == tempoEvents_.begin() ? currentTempo_ : std::prev(next)->microsecondsPerQuarter;
 }
 
 std::pair<uint8_t, uint8_t> MidiParser::GetNoteRange() const {
@@ -426,34 +457,50 @@ uint32_t MidiParser::GetDurationMs() const {
 }
 
 // Utility functions for reading binary data
-uint16_t MidiParser::ReadUInt16BE(std::ifstream& file) {
-    uint16_t value;
-    file.read(reinterpret_cast<char*>(&value), 2);
-    return ((value & 0xFF) << 8) | ((value & 0xFF00) >> 8); // Convert to big-endian
+uint8_t MidiParser::ReadUInt8(ByteReader& reader) {
+    if (reader.position >= reader.size) {
+        reader.failed = true;
+        return 0;
+    }
+    return reader.data[reader.position++];
+}
+
+uint16_t MidiParser::ReadUInt16BE(ByteReader& reader) {
+    uint16_t high = ReadUInt8(reader);
+    uint16_t low = ReadUInt8(reader);
+    return static_cast<uint16_t>((high << 8) | low);
 }
 
-uint32_t MidiParser::ReadUInt32BE(std::ifstream& file) {
-    uint32_t value;
-    file.read(reinterpret_cast<char*>(&value), 4);
-    return ((value & 0xFF) << 24) | ((value & 0xFF00) << 8) | 
-           ((value & 0xFF0000) >> 8) | ((value & 0xFF000000) >> 24);
+uint32_t MidiParser::ReadUInt32BE(ByteReader& reader) {
+    uint32_t high = ReadUInt16BE(reader);
+    uint32_t low = ReadUInt16BE(reader);
+    return (high << 16) | low;
 }
 
-uint32_t MidiParser::ReadVariableLength(std::ifstream& file) {
+uint32_t MidiParser::ReadVariableLength(ByteReader& reader) {
     uint32_t value = 0;
-    uint8_t byte;
     
-    do {
-        file.read(reinterpret_cast<char*>(&byte), 1);
+    // At most four bytes (28 bits) in a valid file
+    for (int i = 0; i < 4; ++i) {
+        uint8_t byte = ReadUInt8(reader);
         value = (value << 7) | (byte & 0x7F);
-    } while (byte & 0x80);
+        if (!(byte & 0x80)) {
+            return value;
+        }
+    }
     
-    return value;
+    reader.failed = true;
+    return 0;
 }
 
-std::string MidiParser::ReadString(std::ifstream& file, size_t length) {
-    std::string result(length, '\0');
-    file.read(&result[0], length);
+std::string MidiParser::ReadString(ByteReader& reader, size_t length) {
+    if (length > reader.GetRemaining()) {
+        reader.failed = true;
+        reader.position = reader.size;
+        return std::string();
+    }
+    std::string result(reinterpret_cast<const char*>(reader.data + reader.position), length);
+    reader.position += length;
     return result;
 }
 
@@ -2,7 +2,6 @@
 #include "common/Types.h"
 #include <vector>
 #include <string>
-#include <fstream>
 
 namespace Lyricstator {
 
@@ -13,6 +12,7 @@ public:
     
     // File loading
     bool LoadMidiFile(const std::string& filepath);
+    bool LoadMidiData(const uint8_t* data, size_t size);   // A whole .mid file already in memory
     void Clear();
     
     // Data access
@@ -61,16 +61,30 @@ private:
         std::vector<uint8_t> data;
     };
     
+    // Bytes being parsed. Reading past the end sets `failed` and yields
+    // zeros, like a stream's failbit, so callers check once per event.
+    struct ByteReader {
+        const uint8_t* data;
+        size_t size;
+        size_t position;
+        bool failed;
+        
+        size_t GetRemaining() const { return size - position; }
+    };
+    
     // Parsing methods
-    bool ParseHeader(std::ifstream& file);
-    bool ParseTrack(std::ifstream& file, uint32_t trackLength);
-    bool ParseEvent(std::ifstream& file, MidiEvent& event, uint8_t& runningStatus);
+    bool ParseHeader(ByteReader& reader);
+    bool ParseTrack(ByteReader& reader, uint32_t trackLength);
+    bool ParseEvent(ByteReader& track, MidiEvent& event, uint8_t& runningStatus);
     
     // Data reading utilities
-    uint16_t ReadUInt16BE(std::ifstream& file);
-    uint32_t ReadUInt32BE(std::ifstream& file);
-    uint32_t ReadVariableLength(std::ifstream& file);
-    std::string ReadString(std::ifstream& file, size_t length);
+    uint8_t ReadUInt8(ByteReader& reader);
+    uint16_t ReadUInt16BE(ByteReader& reader);
+    uint32_t ReadUInt32BE(ByteReader& reader);
+    uint32_t ReadVariableLength(ByteReader& reader);
+    std::string ReadString(ByteReader& reader, size_t length);
+    
+    uint32_t GetTempoAt(uint32_t ticks) const;     // Microseconds per quarter note in effect
     
     // Event processing
     void ProcessNoteEvent(const MidiEvent& event, uint32_t absoluteTime, uint8_t channel);
@@ -79,14 +93,25 @@ private:
     void ProcessTempoEvent(const std::vector<uint8_t>& data, uint32_t absoluteTime);
     void ProcessTimeSignatureEvent(const std::vector<uint8_t>& data, uint32_t absoluteTime);
     
-    // Note tracking for note-off events
+    // Note tracking for note-off events: every note-on of the track being
+    // parsed, with the open ones of each channel and key chained oldest
+    // first, so a note-off finds its note without a scan
     struct ActiveNote {
         uint8_t note;
         uint8_t velocity;
         uint32_t startTime;
         uint8_t channel;
+        bool open;
+        uint32_t next;              // Next open note of the same channel and key
     };
     std::vector<ActiveNote> activeNotes_;
+    std::vector<uint32_t> openFirst_;   // By channel * 128 + key; kNoNote if none open
+    std::vector<uint32_t> openLast_;
+    static constexpr uint32_t kNoNote = UINT32_MAX;
+    
+    // Lyric positions in ticks, parallel to lyricEvents_ until the whole
+    // tempo map is known
+    std::vector<uint32_t> lyricTicks_;
     
     // Current parsing state
     uint32_t currentTempo_;  // Microseconds per quarter note
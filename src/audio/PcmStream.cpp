@@ -0,0 +1,441 @@
+#include "audio/PcmStream.h"
+#include "audio/DecodeWorkerPool.h"
+#include <SDL2/SDL.h>
+#include <iostream>
+#include <algorithm>
+#include <cmath>
+
+namespace Lyricstator {
+
+namespace {
+const size_t kDecodeChunkFrames = 4096;
+const size_t kCacheBlockFrames = 8192;      // ~170 ms at 48 kHz
+const size_t kCachedBlocks = 12;
+const float kGainSmoothing = 1.0f / 1024.0f;  // Per frame; ~20 ms time constant
+}
+
+PcmStream::PcmStream()
+    : converter_(nullptr)
+    , outputRate_(44100)
+    , outputChannels_(2)
+    , lengthFrames_(0)
+    , decodeFinished_(false)
+    , sourceExhausted_(false)
+    , readAheadFrames_(0)
+    , pool_(nullptr)
+    , requestedGeneration_(0)
+    , appliedGeneration_(0)
+    , positionFrames_(0)
+    , gain_(1.0f)
+    , appliedGain_(1.0f)
+    , cacheClock_(0)
+    , decoderFrame_(0)
+    , resumeFrame_(0)
+    , resumePending_(false)
+{
+}
+
+PcmStream::~PcmStream() {
+    Close();
+}
+
+bool PcmStream::Open(const std::string& filepath, int outputRate, int outputChannels, float bufferSeconds) {
+    Close();
+    
+    if (outputRate <= 0 || outputChannels <= 0) {
+        return false;
+    }
+    
+    decoder_ = AudioDecoder::Create(filepath);
+    if (!decoder_) {
+        return false;
+    }
+    
+    sourceFormat_ = decoder_->GetFormat();
+    outputRate_ = outputRate;
+    outputChannels_ = outputChannels;
+    
+    if (sourceFormat_.sampleRate != outputRate_ || sourceFormat_.channels != outputChannels_) {
+        converter_ = SDL_NewAudioStream(AUDIO_F32SYS, static_cast<Uint8>(sourceFormat_.channels), sourceFormat_.sampleRate,
+                                        AUDIO_F32SYS, static_cast<Uint8>(outputChannels_), outputRate_);
+        if (!converter_) {
+            std::cerr << "Failed to create audio converter: " << SDL_GetError() << std::endl;
+            Close();
+            return false;
+        }
+    }
+    
+    lengthFrames_ = sourceFormat_.totalFrames * outputRate_ / sourceFormat_.sampleRate;
+    
+    size_t ringFrames = std::max<size_t>(kDecodeChunkFrames, static_cast<size_t>(outputRate_ * bufferSeconds));
+    ring_.Resize(ringFrames * outputChannels_);
+    readAheadFrames_.store(ringFrames);
+    decodeBuffer_.resize(kDecodeChunkFrames * sourceFormat_.channels);
+    convertBuffer_.resize(kDecodeChunkFrames * outputChannels_);
+    
+    decodeFinished_.store(false);
+    sourceExhausted_ = false;
+    requestedGeneration_ = 0;
+    appliedGeneration_.store(0);
+    positionFrames_.store(0);
+    seekRequest_.Store(SeekRequest{0, 0, 0});
+    
+    blockCache_.resize(kCachedBlocks);
+    for (CachedBlock& cached : blockCache_) {
+        cached.valid = false;
+        cached.samples.resize(kCacheBlockFrames * outputChannels_);
+    }
+    cacheClock_ = 0;
+    decoderFrame_ = 0;
+    resumeFrame_ = 0;
+    resumePending_ = false;
+    
+    Fill();
+    return true;
+}
+
+void PcmStream::Close() {
+    // Out of the pool first, so no worker is inside Fill from here on
+    if (pool_) {
+        pool_->Remove(this);
+        pool_ = nullptr;
+    }
+    
+    decoder_.reset();
+    
+    if (converter_) {
+        SDL_FreeAudioStream(converter_);
+        converter_ = nullptr;
+    }
+    
+    ring_.Resize(0);
+    blockCache_.clear();
+    blockCache_.shrink_to_fit();
+    readAheadFrames_.store(0);
+    sourceFormat_ = DecodedFormat();
+    lengthFrames_ = 0;
+    decodeFinished_.store(false);
+    sourceExhausted_ = false;
+}
+
+void PcmStream::SetDecodePool(DecodeWorkerPool* pool) {
+    if (pool_ == pool || !decoder_) {
+        return;
+    }
+    if (pool_) {
+        pool_->Remove(this);
+    }
+    pool_ = pool;
+    if (pool_) {
+        pool_->Add(this);
+    }
+}
+
+void PcmStream::SetReadAhead(size_t frames) {
+    size_t capacity = ring_.GetCapacity() / std::max(outputChannels_, 1);
+    readAheadFrames_.store(std::max<size_t>(1, std::min(frames, capacity)), std::memory_order_relaxed);
+}
+
+bool PcmStream::NeedsFill() const {
+    if (!decoder_ || decodeFinished_.load(std::memory_order_acquire)) {
+        return false;
+    }
+    // Top up at half full, so each refill is a worthwhile amount of work
+    return GetBufferedFrames() < readAheadFrames_.load(std::memory_order_relaxed) / 2;
+}
+
+size_t PcmStream::GetFillSpace() const {
+    size_t buffered = GetBufferedFrames();
+    size_t readAhead = readAheadFrames_.load(std::memory_order_relaxed);
+    size_t space = ring_.GetWriteAvailable() / outputChannels_;
+    return buffered >= readAhead ? 0 : std::min(space, readAhead - buffered);
+}
+
+size_t PcmStream::Fill() {
+    std::lock_guard<std::mutex> lock(decodeMutex_);
+    if (!decoder_) {
+        return 0;
+    }
+    
+    size_t queued = 0;
+    for (;;) {
+        size_t space = GetFillSpace();
+        if (space == 0 || decodeFinished_.load(std::memory_order_relaxed)) {
+            break;
+        }
+        
+        if (resumePending_) {
+            size_t served = ServeFromCache();
+            if (served > 0) {
+                queued += served;
+                continue;
+            }
+            if (decodeFinished_.load(std::memory_order_relaxed)) {
+                break;
+            }
+            // Out of cached audio - pick the decoder up where the cache ended
+            if (decoderFrame_ != resumeFrame_ && !SeekDecoder(resumeFrame_)) {
+                decodeFinished_.store(true, std::memory_order_release);
+                break;
+            }
+            resumePending_ = false;
+        }
+        
+        size_t wanted = std::min(space, kDecodeChunkFrames);
+        size_t frames = DecodeFrames(convertBuffer_.data(), wanted);
+        ring_.Write(convertBuffer_.data(), frames * outputChannels_);
+        queued += frames;
+        if (frames < wanted) {
+            decodeFinished_.store(true, std::memory_order_release);
+            break;
+        }
+    }
+    
+    return queued;
+}
+
+size_t PcmStream::DecodeFrames(float* output, size_t frames) {
+    size_t decoded = 0;
+    if (converter_) {
+        for (;;) {
+            decoded += DrainConverter(output + decoded * outputChannels_, frames - decoded);
+            if (decoded == frames || sourceExhausted_) {
+                break;
+            }
+            DecodeChunk();
+        }
+    } else {
+        while (decoded < frames) {
+            size_t read = decoder_->Read(output + decoded * outputChannels_, frames - decoded);
+            if (read == 0) {
+                sourceExhausted_ = true;
+                break;
+            }
+            decoded += read;
+        }
+    }
+    
+    decoderFrame_ += decoded;
+    return decoded;
+}
+
+size_t PcmStream::DecodeChunk() {
+    size_t frames = decoder_->Read(decodeBuffer_.data(), kDecodeChunkFrames);
+    if (frames == 0) {
+        // Push out whatever the resampler is still holding back
+        SDL_AudioStreamFlush(converter_);
+        sourceExhausted_ = true;
+        return 0;
+    }
+    
+    SDL_AudioStreamPut(converter_, decodeBuffer_.data(), static_cast<int>(frames * sourceFormat_.channels * sizeof(float)));
+    return frames;
+}
+
+size_t PcmStream::DrainConverter(float* output, size_t maxFrames) {
+    const size_t frameBytes = outputChannels_ * sizeof(float);
+    size_t available = static_cast<size_t>(SDL_AudioStreamAvailable(converter_)) / frameBytes;
+    size_t frames = std::min(available, maxFrames);
+    if (frames == 0) {
+        return 0;
+    }
+    
+    int bytes = SDL_AudioStreamGet(converter_, output, static_cast<int>(frames * frameBytes));
+    if (bytes <= 0) {
+        return 0;
+    }
+    return static_cast<size_t>(bytes) / frameBytes;
+}
+
+bool PcmStream::SeekDecoder(uint64_t outputFrame) {
+    uint64_t sourceFrame = outputFrame * sourceFormat_.sampleRate / outputRate_;
+    if (!decoder_->Seek(sourceFrame)) {
+        std::cerr << "Seek failed in " << decoder_->GetName() << " decoder" << std::endl;
+        return false;
+    }
+    
+    if (converter_) {
+        SDL_AudioStreamClear(converter_);
+    }
+    sourceExhausted_ = false;
+    decoderFrame_ = outputFrame;
+    return true;
+}
+
+bool PcmStream::Seek(uint64_t outputFrame) {
+    std::lock_guard<std::mutex> lock(decodeMutex_);
+    if (!decoder_) {
+        return false;
+    }
+    
+    if (lengthFrames_ > 0) {
+        outputFrame = std::min(outputFrame, lengthFrames_);
+    }
+    
+    // Decode the whole block around the target so that seeking anywhere
+    // near it again is a memory copy
+    uint64_t block = outputFrame / kCacheBlockFrames;
+    CachedBlock* cached = FindBlock(block);
+    if (!cached) {
+        if (!SeekDecoder(block * kCacheBlockFrames)) {
+            return false;
+        }
+        cached = &AllocateBlock(block);
+        cached->frames = DecodeFrames(cached->samples.data(), kCacheBlockFrames);
+        cached->valid = true;
+    }
+    
+    resumeFrame_ = outputFrame;
+    resumePending_ = true;
+    decodeFinished_.store(false, std::memory_order_relaxed);
+    
+    // Everything written from here on belongs to the new position
+    seekRequest_.Store(SeekRequest{++requestedGeneration_, ring_.GetWriteIndex(), outputFrame});
+    
+    // Only queue what is already decoded; the next Fill does the rest
+    ServeFromCache();
+    return true;
+}
+
+size_t PcmStream::ServeFromCache() {
+    size_t served = 0;
+    while (resumePending_) {
+        size_t space = GetFillSpace();
+        CachedBlock* cached = FindBlock(resumeFrame_ / kCacheBlockFrames);
+        if (space == 0 || !cached) {
+            break;
+        }
+        
+        size_t offset = static_cast<size_t>(resumeFrame_ % kCacheBlockFrames);
+        if (offset >= cached->frames) {
+            // Past the end of a short (final) block
+            resumePending_ = false;
+            decodeFinished_.store(true, std::memory_order_release);
+            break;
+        }
+        
+        size_t frames = std::min(space, cached->frames - offset);
+        ring_.Write(cached->samples.data() + offset * outputChannels_, frames * outputChannels_);
+        resumeFrame_ += frames;
+        served += frames;
+    }
+    return served;
+}
+
+PcmStream::CachedBlock* PcmStream::FindBlock(uint64_t block) {
+    for (CachedBlock& cached : blockCache_) {
+        if (cached.valid && cached.block == block) {
+            cached.lastUse = ++cacheClock_;
+            return &cached;
+        }
+    }
+    return nullptr;
+}
+
+PcmStream::CachedBlock& PcmStream::AllocateBlock(uint64_t block) {
+    CachedBlock* victim = &blockCache_.front();
+    for (CachedBlock& cached : blockCache_) {
+        if (!cached.valid) {
+            victim = &cached;
+            break;
+        }
+        if (cached.lastUse < victim->lastUse) {
+            victim = &cached;
+        }
+    }
+    
+    victim->block = block;
+    victim->lastUse = ++cacheClock_;
+    victim->frames = 0;
+    victim->valid = false;
+    return *victim;
+}
+
+size_t PcmStream::Read(float* output, size_t frames) {
+    ApplyPendingSeek();
+    
+    size_t read = ring_.Read(output, frames * outputChannels_) / outputChannels_;
+    positionFrames_.store(positionFrames_.load(std::memory_order_relaxed) + read, std::memory_order_release);
+    
+    float gain = gain_.load(std::memory_order_relaxed);
+    if (gain != 1.0f || appliedGain_ != 1.0f) {
+        for (size_t frame = 0; frame < read; ++frame) {
+            if (appliedGain_ != gain) {
+                appliedGain_ += (gain - appliedGain_) * kGainSmoothing;
+                if (std::fabs(gain - appliedGain_) < 1e-4f) {
+                    appliedGain_ = gain;
+                }
+            }
+            for (int ch = 0; ch < outputChannels_; ++ch) {
+                output[frame * outputChannels_ + ch] *= appliedGain_;
+            }
+        }
+    }
+    return read;
+}
+
+void PcmStream::SetGain(float gain, bool immediate) {
+    gain_.store(gain, std::memory_order_relaxed);
+    if (immediate) {
+        appliedGain_ = gain;
+    }
+}
+
+void PcmStream::ApplyPendingSeek() {
+    SeekRequest request;
+    if (!seekRequest_.TryLoad(request)) {
+        return; // Mid-store; pick it up next callback
+    }
+    
+    if (request.generation != appliedGeneration_.load(std::memory_order_relaxed)) {
+        ring_.SkipTo(request.ringIndex);
+        positionFrames_.store(request.frame, std::memory_order_relaxed);
+        appliedGeneration_.store(request.generation, std::memory_order_release);
+    }
+}
+
+bool PcmStream::IsEndOfStream() const {
+    if (!decoder_) {
+        return true;
+    }
+    
+    SeekRequest request = seekRequest_.Load();
+    if (request.generation != appliedGeneration_.load(std::memory_order_acquire)) {
+        return false;
+    }
+    return decodeFinished_.load(std::memory_order_acquire) && ring_.GetReadAvailable() == 0;
+}
+
+bool PcmStream::IsSeekPending() const {
+    return seekRequest_.Load().generation != appliedGeneration_.load(std::memory_order_acquire);
+}
+
+uint64_t PcmStream::GetPositionFrames() const {
+    // A seek the callback hasn't seen yet already counts as the position
+    SeekRequest request = seekRequest_.Load();
+    if (request.generation != appliedGeneration_.load(std::memory_order_acquire)) {
+        return request.frame;
+    }
+    return positionFrames_.load(std::memory_order_acquire);
+}
+
+size_t PcmStream::GetBufferedFrames() const {
+    return ring_.GetReadAvailable() / outputChannels_;
+}
+
+std::string PcmStream::GetDecoderName() const {
+    return decoder_ ? decoder_->GetName() : "";
+}
+
+size_t PcmStream::GetMemoryUsage() const {
+    size_t bytes = (ring_.GetCapacity() + decodeBuffer_.capacity() + convertBuffer_.capacity()) * sizeof(float);
+    for (const CachedBlock& cached : blockCache_) {
+        bytes += cached.samples.capacity() * sizeof(float);
+    }
+    if (decoder_) {
+        bytes += decoder_->GetMemoryUsage();
+    }
+    return bytes;
+}
+
+} // namespace Lyricstator
@@ -0,0 +1,140 @@
+#pragma once
+#include "audio/AudioDecoder.h"
+#include "common/LockFree.h"
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Forward declarations
+struct _SDL_AudioStream;
+
+namespace Lyricstator {
+
+class DecodeWorkerPool;
+
+// One decoded source feeding the audio callback. The decode side (Open,
+// Fill, Seek) runs on a normal thread; the callback side (Read) never
+// blocks, allocates or touches the decoder. Both sides only share the
+// sample ring and a few atomics. Fill and Seek may be called from
+// different threads (a DecodeWorkerPool and the main loop).
+class PcmStream {
+public:
+    PcmStream();
+    ~PcmStream();
+    
+    // Decode side
+    bool Open(const std::string& filepath, int outputRate, int outputChannels, float bufferSeconds = 0.5f);
+    void Close();
+    bool IsOpen() const { return decoder_ != nullptr; }
+    
+    // Decode until the read-ahead is full or the source is exhausted.
+    // Returns the number of output frames queued.
+    size_t Fill();
+    
+    // Hand refilling over to a pool's worker threads until Close
+    void SetDecodePool(DecodeWorkerPool* pool);
+    
+    // Frames to keep decoded ahead of the callback, at most the ring size
+    // given to Open. Scale with playback rate: a stream played at 2x drains
+    // twice as fast.
+    void SetReadAhead(size_t frames);
+    size_t GetReadAhead() const { return readAheadFrames_.load(std::memory_order_relaxed); }
+    bool NeedsFill() const;
+    
+    // Jump to an output frame. Audio already queued is dropped by the
+    // callback side the next time it reads. Targets near a recent seek are
+    // served from the block cache without touching the decoder.
+    bool Seek(uint64_t outputFrame);
+    
+    // Callback side. Returns frames written; short reads mean the decoder
+    // has fallen behind or the stream has ended.
+    size_t Read(float* output, size_t frames);
+    
+    // Callback side: drop stale audio after a seek without reading (used
+    // while paused so the ring can refill before playback resumes)
+    void ApplyPendingSeek();
+    uint64_t GetReadPosition() const { return positionFrames_.load(std::memory_order_relaxed); }
+    uint32_t GetSeekGeneration() const { return appliedGeneration_.load(std::memory_order_relaxed); }
+    
+    // Linear gain applied by Read (loudness normalisation). Changes are
+    // smoothed over a few milliseconds so they never click; `immediate`
+    // skips that, only for a stream the callback can't see yet.
+    void SetGain(float gain, bool immediate = false);
+    float GetGain() const { return gain_.load(std::memory_order_relaxed); }
+    
+    // Safe from any thread
+    bool IsEndOfStream() const;
+    bool IsSeekPending() const;
+    uint64_t GetPositionFrames() const;
+    uint64_t GetLengthFrames() const { return lengthFrames_; }
+    size_t GetBufferedFrames() const;
+    
+    int GetOutputRate() const { return outputRate_; }
+    int GetOutputChannels() const { return outputChannels_; }
+    const DecodedFormat& GetSourceFormat() const { return sourceFormat_; }
+    std::string GetDecoderName() const;
+    
+    // Bytes of decoded audio held: ring, scratch buffers, seek cache and
+    // whatever the decoder itself keeps
+    size_t GetMemoryUsage() const;
+
+private:
+    std::unique_ptr<AudioDecoder> decoder_;
+    _SDL_AudioStream* converter_;      // Rate/channel conversion, null if not needed
+    DecodedFormat sourceFormat_;
+    int outputRate_;
+    int outputChannels_;
+    uint64_t lengthFrames_;
+    
+    SpscRingBuffer<float> ring_;
+    std::vector<float> decodeBuffer_;
+    std::vector<float> convertBuffer_;
+    std::atomic<bool> decodeFinished_;   // Source and converter fully drained into the ring
+    bool sourceExhausted_;               // Decoder hit the end (decode side only)
+    std::atomic<size_t> readAheadFrames_;
+    std::mutex decodeMutex_;             // Serialises Fill and Seek
+    DecodeWorkerPool* pool_;
+    
+    // Seek hand-off: the decode side publishes where fresh audio starts in
+    // the ring, the callback side skips to it and resets its position
+    struct SeekRequest {
+        uint32_t generation;
+        uint64_t ringIndex;
+        uint64_t frame;
+    };
+    SeqLock<SeekRequest> seekRequest_;
+    uint32_t requestedGeneration_;               // Decode side
+    std::atomic<uint32_t> appliedGeneration_;    // Written by the callback side
+    std::atomic<uint64_t> positionFrames_;       // Written by the callback side
+    std::atomic<float> gain_;
+    float appliedGain_;                          // Callback side
+    
+    // LRU of block-aligned decoded output around recent seek targets
+    // (decode side only). After a seek the ring is refilled from here until
+    // a block is missing, and only then is the decoder repositioned.
+    struct CachedBlock {
+        uint64_t block;
+        uint64_t lastUse;
+        size_t frames;          // Short only for the last block of the file
+        bool valid;
+        std::vector<float> samples;
+    };
+    std::vector<CachedBlock> blockCache_;
+    uint64_t cacheClock_;
+    uint64_t decoderFrame_;      // Output frame the decoder produces next
+    uint64_t resumeFrame_;       // Output frame the ring continues at
+    bool resumePending_;         // resumeFrame_ != where the decoder is
+    
+    size_t GetFillSpace() const;
+    size_t DecodeFrames(float* output, size_t frames);
+    size_t DecodeChunk();
+    size_t DrainConverter(float* output, size_t maxFrames);
+    bool SeekDecoder(uint64_t outputFrame);
+    size_t ServeFromCache();
+    CachedBlock* FindBlock(uint64_t block);
+    CachedBlock& AllocateBlock(uint64_t block);
+};
+
+} // namespace Lyricstator
@@ -0,0 +1,86 @@
+#include "audio/PlaybackClock.h"
+#include <algorithm>
+#include <chrono>
+
+namespace Lyricstator {
+
+namespace {
+const uint64_t kMicrosMask = (1ULL << 48) - 1;
+}
+
+PlaybackClock::PlaybackClock()
+    : sampleRate_(44100)
+    , extraLatencyFrames_(0)
+    , epoch_(0)
+    , floor_(0)
+{
+    anchor_.Store(Anchor{0, NowNs(), 0, 0, 0, 1.0f});
+}
+
+void PlaybackClock::Configure(int sampleRate) {
+    sampleRate_ = std::max(1, sampleRate);
+}
+
+void PlaybackClock::SetExtraLatencyMs(float latencyMs) {
+    float frames = std::max(0.0f, latencyMs) * sampleRate_ / 1000.0f;
+    extraLatencyFrames_.store(static_cast<uint32_t>(frames), std::memory_order_relaxed);
+}
+
+void PlaybackClock::OnRender(uint64_t frame, uint32_t frames, bool running, bool discontinuity, float rate) {
+    if (discontinuity) {
+        ++epoch_;
+    }
+    anchor_.Store(Anchor{frame, NowNs(), frames, running ? 1u : 0u, epoch_, rate});
+}
+
+double PlaybackClock::GetTimeMs() const {
+    Anchor anchor = anchor_.Load();
+    
+    // What the callback just rendered starts playing once the buffer ahead
+    // of it has drained, so the audible frame trails the anchor. Output
+    // frames are converted to media frames at the anchored rate.
+    double latency = static_cast<double>(anchor.bufferFrames) + extraLatencyFrames_.load(std::memory_order_relaxed);
+    double audible = static_cast<double>(anchor.frame) - latency * anchor.rate;
+    
+    if (anchor.running) {
+        // Interpolate, but never past the next callback's anchor - if the
+        // callback is late the device is starved too
+        double elapsed = (NowNs() - anchor.timestampNs) * 1e-9 * sampleRate_;
+        audible += std::min(elapsed, static_cast<double>(anchor.bufferFrames)) * anchor.rate;
+    }
+    
+    uint64_t micros = static_cast<uint64_t>(std::max(0.0, audible) * 1e6 / sampleRate_) & kMicrosMask;
+    uint64_t epoch = anchor.epoch & 0xFFFF;
+    uint64_t desired = (epoch << 48) | micros;
+    
+    uint64_t current = floor_.load(std::memory_order_relaxed);
+    for (;;) {
+        uint16_t floorEpoch = static_cast<uint16_t>(current >> 48);
+        int16_t age = static_cast<int16_t>(static_cast<uint16_t>(epoch) - floorEpoch);
+        if (age < 0) {
+            break; // Our anchor is already stale - don't disturb the floor
+        }
+        if (age == 0 && micros <= (current & kMicrosMask)) {
+            micros = current & kMicrosMask;
+            break;
+        }
+        if (floor_.compare_exchange_weak(current, desired, std::memory_order_relaxed)) {
+            break;
+        }
+    }
+    
+    return micros / 1000.0;
+}
+
+float PlaybackClock::GetLatencyMs() const {
+    Anchor anchor = anchor_.Load();
+    uint32_t frames = anchor.bufferFrames + extraLatencyFrames_.load(std::memory_order_relaxed);
+    return frames * 1000.0f / sampleRate_;
+}
+
+int64_t PlaybackClock::NowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+} // namespace Lyricstator
@@ -0,0 +1,52 @@
+#pragma once
+#include "common/LockFree.h"
+#include <atomic>
+#include <cstdint>
+
+namespace Lyricstator {
+
+// Media clock driven by the audio callback. Each callback publishes which
+// frame it just rendered and when; readers interpolate from that anchor
+// with a steady clock and subtract the output latency, so the time matches
+// what is coming out of the speakers rather than what was last decoded.
+// Reads are lock-free and never go backwards between discontinuities.
+class PlaybackClock {
+public:
+    PlaybackClock();
+    
+    void Configure(int sampleRate);
+    void SetExtraLatencyMs(float latencyMs);   // On top of the device buffer
+    
+    // Audio callback only. `frame` is the media frame at the start of the
+    // buffer being rendered; `discontinuity` marks a seek or source change.
+    // `rate` is media frames per output frame, so time keeps following the
+    // media while playback is time-stretched.
+    void OnRender(uint64_t frame, uint32_t frames, bool running, bool discontinuity, float rate = 1.0f);
+    
+    // Any thread
+    double GetTimeMs() const;
+    float GetLatencyMs() const;
+    int GetSampleRate() const { return sampleRate_; }
+
+private:
+    struct Anchor {
+        uint64_t frame;
+        int64_t timestampNs;
+        uint32_t bufferFrames;
+        uint32_t running;
+        uint32_t epoch;
+        float rate;
+    };
+    
+    int sampleRate_;
+    SeqLock<Anchor> anchor_;
+    std::atomic<uint32_t> extraLatencyFrames_;
+    uint32_t epoch_;    // Callback side
+    
+    // Last time handed out: epoch in the top 16 bits, microseconds below
+    mutable std::atomic<uint64_t> floor_;
+    
+    static int64_t NowNs();
+};
+
+} // namespace Lyricstator
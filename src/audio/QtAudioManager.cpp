@@ -30,7 +30,14 @@ QtAudioManager::QtAudioManager(QObject* parent)
     , equalizerEnabled_(true)
     , isRecording_(false)
     , lastError_()
+    , analysisThread_(nullptr)
+    , analysisContext_(nullptr)
     , spectrumTimer_(nullptr)
+    , analysisRate_(0)
+    , analysisIdleTicks_(0)
+#if QT_VERSION >= QT_VERSION_CHECK(6, 8, 0)
+    , bufferOutput_(nullptr)
+#endif
 {
     initializeAudio();
     setupAudioFormat();
@@ -39,14 +46,11 @@ QtAudioManager::QtAudioManager(QObject* parent)
     equalizerBands_.resize(12);
     for (int i = 0; i < 12; ++i) {
         equalizerBands_[i].frequency = 31.25f * (1 << i);
-        equalizerBands_[i].gain = 1.0f;
+        equalizerBands_[i].gain = 0.0f;
         equalizerBands_[i].enabled = true;
     }
     
-    // Initialize spectrum timer
-    spectrumTimer_ = new QTimer(this);
-    connect(spectrumTimer_, &QTimer::timeout, this, &QtAudioManager::updateSpectrum);
-    spectrumTimer_->start(50); // 20 FPS
+    startAnalysis();
 }
 
 QtAudioManager::~QtAudioManager() {
@@ -54,6 +58,8 @@ QtAudioManager::~QtAudioManager() {
         stopRecording();
     }
     
+    stopAnalysis();
+    
     if (mediaPlayer_) {
         mediaPlayer_->stop();
         delete mediaPlayer_;
@@ -332,8 +338,8 @@ QString QtAudioManager::getCurrentFile() const {
     return currentFile_;
 }
 
-QVector<float> QtAudioManager::getSpectrumData() {
-    return spectrumData_;
+const SpectrumFrame* QtAudioManager::getSpectrum() {
+    return spectrum_.GetLatest();
 }
 
 float QtAudioManager::getPitch() {
@@ -402,22 +408,97 @@ void QtAudioManager::processEqualizer() {
         return;
     }
     
-    // Placeholder implementation - would apply equalizer effects to audio
-    // This would require real-time audio processing
+    // Placeholder implementation - QMediaPlayer has no hook to modify the
+    // PCM it plays (QAudioBufferOutput only receives copies), so there is
+    // nothing to run the Equalizer engine on yet
+}
+
+void QtAudioManager::startAnalysis() {
+    // The context object lives on the analysis thread, so anything connected
+    // through it (decoded buffers, the decay timer) is handled there
+    analysisThread_ = new QThread(this);
+    analysisContext_ = new QObject();
+    spectrumTimer_ = new QTimer(analysisContext_);
+    spectrumTimer_->setInterval(100);
+    connect(spectrumTimer_, &QTimer::timeout, analysisContext_, [this]() { decaySpectrum(); });
+    analysisContext_->moveToThread(analysisThread_);
+    connect(analysisThread_, &QThread::started, spectrumTimer_, [this]() { spectrumTimer_->start(); });
+    // The timer started on the analysis thread has to be stopped and
+    // destroyed there too, so the context (and the timer it owns) is
+    // deleted by that thread as it finishes
+    connect(analysisThread_, &QThread::finished, analysisContext_, &QObject::deleteLater);
+    
+#if QT_VERSION >= QT_VERSION_CHECK(6, 8, 0)
+    bufferOutput_ = new QAudioBufferOutput(this);
+    mediaPlayer_->setAudioBufferOutput(bufferOutput_);
+    connect(bufferOutput_, &QAudioBufferOutput::audioBufferReceived, analysisContext_,
+            [this](const QAudioBuffer& buffer) { analyzeBuffer(buffer); });
+#else
+    qDebug() << "Spectrum analysis needs Qt 6.8 or newer";
+#endif
+    
+    analysisThread_->start(QThread::LowPriority);
+}
+
+void QtAudioManager::stopAnalysis() {
+    if (!analysisThread_) {
+        return;
+    }
+    
+#if QT_VERSION >= QT_VERSION_CHECK(6, 8, 0)
+    if (mediaPlayer_) {
+        mediaPlayer_->setAudioBufferOutput(nullptr);
+    }
+#endif
+    // Joining also runs the context's deleteLater on the analysis thread
+    analysisThread_->quit();
+    analysisThread_->wait();
+    analysisContext_ = nullptr;
+    spectrumTimer_ = nullptr;
+    delete analysisThread_;
+    analysisThread_ = nullptr;
+}
+
+#if QT_VERSION >= QT_VERSION_CHECK(6, 8, 0)
+void QtAudioManager::analyzeBuffer(const QAudioBuffer& buffer) {
+    const QAudioFormat format = buffer.format();
+    const int channels = format.channelCount();
+    const int frames = static_cast<int>(buffer.frameCount());
+    if (!format.isValid() || channels <= 0 || frames <= 0) {
+        return;
+    }
+    
+    if (format.sampleRate() != analysisRate_) {
+        analysisRate_ = format.sampleRate();
+        spectrum_.Configure(analysisRate_);
+    }
+    
+    // Mono mix; the scratch buffer only grows to the largest buffer seen
+    analysisBuffer_.resize(frames);
+    const char* data = buffer.constData<char>();
+    const int bytesPerSample = format.bytesPerSample();
+    for (int frame = 0; frame < frames; ++frame) {
+        float sum = 0.0f;
+        for (int ch = 0; ch < channels; ++ch) {
+            sum += format.normalizedSampleValue(data + (frame * channels + ch) * bytesPerSample);
+        }
+        analysisBuffer_[frame] = sum / channels;
+    }
+    
+    spectrum_.Process(analysisBuffer_.data(), analysisBuffer_.size());
+    analysisIdleTicks_ = 0;
 }
+#endif
 
-void QtAudioManager::updateSpectrum() {
-    if (!isPlaying()) {
-        spectrumData_.clear();
+void QtAudioManager::decaySpectrum() {
+    // No buffers for a while (paused or stopped): feed silence so the bars
+    // fall instead of freezing
+    if (analysisRate_ == 0 || ++analysisIdleTicks_ < 2 || spectrum_.IsSilent()) {
         return;
     }
     
-    // Placeholder implementation - would analyze audio data for spectrum
-    // This would require FFT analysis of audio samples
-    spectrumData_.resize(64);
-    for (int i = 0; i < 64; ++i) {
-        spectrumData_[i] = (float)rand() / RAND_MAX * 0.5f; // Random data for now
-    }
+    analysisBuffer_.assign(analysisRate_ / 10, 0.0f);
+    spectrum_.Process(analysisBuffer_.data(), analysisBuffer_.size());
 }
 
 void QtAudioManager::handleMediaPlayerError() {
@@ -10,6 +10,13 @@
 #include <QAudioFormat>
 #include <QBuffer>
 #include <QTimer>
+#include <QThread>
+#include <vector>
+#include "audio/SpectrumAnalyzer.h"
+
+#if QT_VERSION >= QT_VERSION_CHECK(6, 8, 0)
+#include <QAudioBufferOutput>
+#endif
 
 namespace Lyricstator {
 
@@ -31,7 +38,7 @@ struct QtAudioFormat {
 
 struct QtEqualizerBand {
     float frequency;
-    float gain;
+    float gain;         // dB
     bool enabled;
 };
 
@@ -76,8 +83,11 @@ public:
     uint32_t getDuration() const;
     QString getCurrentFile() const;
     
-    // Audio analysis
-    QVector<float> getSpectrumData();
+    // Audio analysis. The spectrum is computed on a worker thread from what
+    // the player decodes (needs Qt 6.8's QAudioBufferOutput; older Qt never
+    // publishes one). getSpectrum returns the newest frame, or null before
+    // the first, and must only be called from the GUI thread.
+    const SpectrumFrame* getSpectrum();
     float getPitch();
     float getTempo();
     
@@ -119,15 +129,26 @@ private:
     // Error handling
     QString lastError_;
     
-    // Audio processing
-    QTimer* spectrumTimer_;
-    QVector<float> spectrumData_;
+    // Audio analysis; everything below runs on analysisThread_
+    QThread* analysisThread_;
+    QObject* analysisContext_;
+    QTimer* spectrumTimer_;             // Lets the meters fall while nothing plays
+    SpectrumAnalyzer spectrum_;
+    std::vector<float> analysisBuffer_;
+    int analysisRate_;
+    int analysisIdleTicks_;
+#if QT_VERSION >= QT_VERSION_CHECK(6, 8, 0)
+    QAudioBufferOutput* bufferOutput_;
+    void analyzeBuffer(const QAudioBuffer& buffer);
+#endif
     
     // Private methods
     void initializeAudio();
     void setupAudioFormat();
     void processEqualizer();
-    void updateSpectrum();
+    void startAnalysis();
+    void stopAnalysis();
+    void decaySpectrum();
     void handleMediaPlayerError();
     void handleAudioOutputError();
     
@@ -0,0 +1,93 @@
+#include "audio/Reverb.h"
+#include <algorithm>
+
+namespace Lyricstator {
+
+namespace {
+// Freeverb tunings, in samples at 44.1 kHz
+const int kCombTuning[] = {1116, 1188, 1277, 1356, 1422, 1491, 1557, 1617};
+const int kAllpassTuning[] = {556, 441, 341, 225};
+const int kStereoSpread = 23;
+const float kAllpassFeedback = 0.5f;
+const float kInputGain = 0.015f;
+}
+
+Reverb::Reverb()
+    : feedback_(0.84f)
+    , damping_(0.2f)
+{
+    Configure(44100);
+}
+
+void Reverb::Configure(int sampleRate) {
+    float scale = std::max(1, sampleRate) / 44100.0f;
+    
+    for (int side = 0; side < 2; ++side) {
+        int spread = side * kStereoSpread;
+        for (int i = 0; i < kCombs; ++i) {
+            Comb& comb = combs_[side][i];
+            comb.buffer.assign(std::max(1, static_cast<int>((kCombTuning[i] + spread) * scale)), 0.0f);
+            comb.index = 0;
+            comb.store = 0.0f;
+        }
+        for (int i = 0; i < kAllpasses; ++i) {
+            Allpass& allpass = allpasses_[side][i];
+            allpass.buffer.assign(std::max(1, static_cast<int>((kAllpassTuning[i] + spread) * scale)), 0.0f);
+            allpass.index = 0;
+        }
+    }
+}
+
+void Reverb::SetRoomSize(float roomSize) {
+    roomSize = std::max(0.0f, std::min(1.0f, roomSize));
+    feedback_.store(0.7f + roomSize * 0.28f, std::memory_order_relaxed);
+}
+
+void Reverb::SetDamping(float damping) {
+    damping_.store(std::max(0.0f, std::min(1.0f, damping)) * 0.4f, std::memory_order_relaxed);
+}
+
+void Reverb::ProcessAdd(const float* input, float* output, int frames, int channels, float gain) {
+    if (gain == 0.0f || channels <= 0) {
+        return;
+    }
+    
+    const float feedback = feedback_.load(std::memory_order_relaxed);
+    const float damp = damping_.load(std::memory_order_relaxed);
+    const int sides = std::min(channels, 2);
+    
+    for (int frame = 0; frame < frames; ++frame) {
+        float in = input[frame] * kInputGain;
+        
+        for (int side = 0; side < sides; ++side) {
+            float out = 0.0f;
+            for (Comb& comb : combs_[side]) {
+                float delayed = comb.buffer[comb.index];
+                comb.store = delayed * (1.0f - damp) + comb.store * damp;
+                comb.buffer[comb.index] = in + comb.store * feedback;
+                if (++comb.index == static_cast<int>(comb.buffer.size())) {
+                    comb.index = 0;
+                }
+                out += delayed;
+            }
+            
+            for (Allpass& allpass : allpasses_[side]) {
+                float delayed = allpass.buffer[allpass.index];
+                allpass.buffer[allpass.index] = out + delayed * kAllpassFeedback;
+                out = delayed - out;
+                if (++allpass.index == static_cast<int>(allpass.buffer.size())) {
+                    allpass.index = 0;
+                }
+            }
+            
+            if (channels == 1) {
+                output[frame] += out * gain;
+            } else {
+                // Extra channels beyond stereo get nothing
+                output[frame * channels + side] += out * gain;
+            }
+        }
+    }
+}
+
+} // namespace Lyricstator
@@ -0,0 +1,46 @@
+#pragma once
+#include <atomic>
+#include <vector>
+
+namespace Lyricstator {
+
+// Small Schroeder/Moorer reverb (the Freeverb topology: eight damped combs
+// into four allpasses per side) for the mic monitor send. Mono in, stereo
+// out; all delay lines are allocated in Configure so Process is safe on the
+// audio callback.
+class Reverb {
+public:
+    Reverb();
+    
+    // Not thread-safe with Process
+    void Configure(int sampleRate);
+    
+    // Control side
+    void SetRoomSize(float roomSize);   // 0.0 - 1.0
+    void SetDamping(float damping);     // 0.0 - 1.0
+    
+    // Adds `gain` x reverb of the mono input to interleaved output
+    void ProcessAdd(const float* input, float* output, int frames, int channels, float gain);
+
+private:
+    static constexpr int kCombs = 8;
+    static constexpr int kAllpasses = 4;
+    
+    struct Comb {
+        std::vector<float> buffer;
+        int index;
+        float store;
+    };
+    
+    struct Allpass {
+        std::vector<float> buffer;
+        int index;
+    };
+    
+    Comb combs_[2][kCombs];
+    Allpass allpasses_[2][kAllpasses];
+    std::atomic<float> feedback_;
+    std::atomic<float> damping_;
+};
+
+} // namespace Lyricstator
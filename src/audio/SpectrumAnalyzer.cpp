@@ -0,0 +1,183 @@
+#include "audio/SpectrumAnalyzer.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace Lyricstator {
+
+namespace {
+const float kPi = 3.14159265358979f;
+const float kLowestFrequency = 40.0f;
+const float kHighestFrequency = 16000.0f;
+const float kReleaseSeconds = 0.25f;       // Time constant of the fall after a transient
+const float kPeakHoldSeconds = 0.6f;
+const float kPeakFallPerSecond = 0.6f;     // Of the display range
+}
+
+SpectrumAnalyzer::SpectrumAnalyzer()
+    : sampleRate_(0)
+    , bandCount_(0)
+    , fftSize_(0)
+    , hopSize_(0)
+    , fill_(0)
+    , release_(0.0f)
+    , peakFall_(0.0f)
+    , peakHoldHops_(0)
+    , silent_(true)
+    , sequence_(0)
+    , published_(false)
+{
+}
+
+void SpectrumAnalyzer::Configure(int sampleRate, int bandCount) {
+    sampleRate_ = std::max(sampleRate, 8000);
+    bandCount_ = std::max(1, std::min(bandCount, SpectrumFrame::kMaxBands));
+    
+    // ~20 Hz bins at the usual rates, so the bass bands aren't all one bin
+    fftSize_ = sampleRate_ > 48000 ? 4096 : 2048;
+    hopSize_ = fftSize_ / 4;
+    fft_.Resize(fftSize_);
+    
+    window_.resize(fftSize_);
+    for (int i = 0; i < fftSize_; ++i) {
+        window_[i] = 0.5f - 0.5f * std::cos(2.0f * kPi * i / fftSize_);
+    }
+    history_.assign(fftSize_, 0.0f);
+    frame_.assign(fftSize_, 0.0f);
+    spectrum_.assign(fft_.GetBinCount(), FFT::Complex());
+    
+    // Log-spaced band edges, stored in bins
+    float low = kLowestFrequency;
+    float high = std::min(kHighestFrequency, sampleRate_ * 0.45f);
+    float binHz = static_cast<float>(sampleRate_) / fftSize_;
+    bandLow_.resize(bandCount_);
+    bandHigh_.resize(bandCount_);
+    for (int band = 0; band < bandCount_; ++band) {
+        float from = low * std::pow(high / low, static_cast<float>(band) / bandCount_);
+        float to = low * std::pow(high / low, static_cast<float>(band + 1) / bandCount_);
+        bandLow_[band] = from / binHz;
+        bandHigh_[band] = to / binHz;
+    }
+    
+    float hopSeconds = static_cast<float>(hopSize_) / sampleRate_;
+    release_ = std::exp(-hopSeconds / kReleaseSeconds);
+    peakFall_ = kPeakFallPerSecond * hopSeconds;
+    peakHoldHops_ = static_cast<int>(kPeakHoldSeconds / hopSeconds);
+    
+    levels_.assign(bandCount_, 0.0f);
+    peaks_.assign(bandCount_, 0.0f);
+    peakHold_.assign(bandCount_, 0);
+    Reset();
+}
+
+void SpectrumAnalyzer::Reset() {
+    std::fill(history_.begin(), history_.end(), 0.0f);
+    std::fill(levels_.begin(), levels_.end(), 0.0f);
+    std::fill(peaks_.begin(), peaks_.end(), 0.0f);
+    std::fill(peakHold_.begin(), peakHold_.end(), 0);
+    fill_ = fftSize_ - hopSize_;
+    silent_ = true;
+}
+
+void SpectrumAnalyzer::Process(const float* samples, size_t count) {
+    if (fftSize_ == 0) {
+        return;
+    }
+    
+    while (count > 0) {
+        size_t take = std::min(count, static_cast<size_t>(fftSize_ - fill_));
+        std::memcpy(history_.data() + fill_, samples, take * sizeof(float));
+        fill_ += static_cast<int>(take);
+        samples += take;
+        count -= take;
+        
+        if (fill_ == fftSize_) {
+            AnalyzeFrame();
+            std::memmove(history_.data(), history_.data() + hopSize_, (fftSize_ - hopSize_) * sizeof(float));
+            fill_ = fftSize_ - hopSize_;
+        }
+    }
+}
+
+void SpectrumAnalyzer::AnalyzeFrame() {
+    for (int i = 0; i < fftSize_; ++i) {
+        frame_[i] = history_[i] * window_[i];
+    }
+    fft_.Forward(frame_.data(), spectrum_.data());
+    
+    SpectrumFrame& frame = frames_.GetWriteBuffer();
+    frame.bandCount = bandCount_;
+    frame.sequence = ++sequence_;
+    
+    // A Hann-windowed sine of amplitude A peaks at A * N / 4
+    const float amplitudeScale = 4.0f / fftSize_;
+    bool silent = true;
+    for (int band = 0; band < bandCount_; ++band) {
+        float amplitude = std::sqrt(GetBandPower(band)) * amplitudeScale;
+        float db = 20.0f * std::log10(std::max(amplitude, 1e-9f));
+        float level = std::max(0.0f, std::min(1.0f, 1.0f - db / kFloorDb));
+        
+        if (level >= levels_[band]) {
+            levels_[band] = level;
+        } else {
+            levels_[band] = level + (levels_[band] - level) * release_;
+        }
+        
+        if (levels_[band] >= peaks_[band]) {
+            peaks_[band] = levels_[band];
+            peakHold_[band] = peakHoldHops_;
+        } else if (peakHold_[band] > 0) {
+            --peakHold_[band];
+        } else {
+            peaks_[band] = std::max(levels_[band], peaks_[band] - peakFall_);
+        }
+        
+        if (levels_[band] < 1e-3f) {
+            levels_[band] = 0.0f;
+        }
+        if (peaks_[band] < 1e-3f) {
+            peaks_[band] = 0.0f;
+        }
+        silent = silent && peaks_[band] == 0.0f;
+        
+        frame.levels[band] = levels_[band];
+        frame.peaks[band] = peaks_[band];
+    }
+    silent_ = silent;
+    
+    frames_.Publish();
+}
+
+float SpectrumAnalyzer::GetBandPower(int band) const {
+    float low = bandLow_[band];
+    float high = bandHigh_[band];
+    int lastBin = static_cast<int>(spectrum_.size()) - 1;
+    
+    if (high - low < 1.0f) {
+        // Narrower than a bin (the bass end): interpolate at the centre
+        float centre = std::min(0.5f * (low + high), static_cast<float>(lastBin));
+        int bin = static_cast<int>(centre);
+        int next = std::min(bin + 1, lastBin);
+        float fraction = centre - bin;
+        return std::norm(spectrum_[bin]) * (1.0f - fraction) + std::norm(spectrum_[next]) * fraction;
+    }
+    
+    // Wider bands show their strongest bin, so a tone reads the same
+    // wherever it falls
+    int first = static_cast<int>(std::ceil(low));
+    int last = std::min(static_cast<int>(high), lastBin);
+    float power = 0.0f;
+    for (int bin = first; bin <= last; ++bin) {
+        power = std::max(power, std::norm(spectrum_[bin]));
+    }
+    return power;
+}
+
+const SpectrumFrame* SpectrumAnalyzer::GetLatest() {
+    if (frames_.Update()) {
+        published_ = true;
+    }
+    return published_ ? &frames_.GetReadBuffer() : nullptr;
+}
+
+} // namespace Lyricstator
@@ -0,0 +1,78 @@
+#pragma once
+#include "audio/FFT.h"
+#include "common/LockFree.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace Lyricstator {
+
+// One published spectrum. Fixed size so frames can be handed between
+// threads without allocating; levels and peaks are 0 - 1 over the
+// analyzer's display range (kFloorDb - 0 dBFS).
+struct SpectrumFrame {
+    static constexpr int kMaxBands = 128;
+    
+    int bandCount = 0;
+    uint32_t sequence = 0;              // Bumps per published frame
+    float levels[kMaxBands] = {};
+    float peaks[kMaxBands] = {};        // Peak-hold markers
+};
+
+// Log-frequency spectrum of a mono signal for the equalizer displays.
+//
+// A Hann-windowed FFT runs every quarter window (75% overlap); bins are
+// grouped into log-spaced bands, converted to dB so a full-scale sine
+// reads 0, and given an instant attack with a slower release. Each band
+// also keeps a peak that holds for a moment before falling.
+//
+// Process runs on one analysis thread and publishes through a triple
+// buffer; one reader (the GUI) picks the latest frame up with GetLatest.
+class SpectrumAnalyzer {
+public:
+    static constexpr float kFloorDb = -80.0f;
+    
+    SpectrumAnalyzer();
+    
+    // Allocates; not thread-safe with Process
+    void Configure(int sampleRate, int bandCount = 64);
+    
+    // Analysis side
+    void Reset();
+    void Process(const float* samples, size_t count);
+    bool IsSilent() const { return silent_; }     // Every band and peak has fallen to 0
+    
+    // Reader side: the newest frame, or null until one has been published
+    const SpectrumFrame* GetLatest();
+
+private:
+    int sampleRate_;
+    int bandCount_;
+    int fftSize_;
+    int hopSize_;
+    int fill_;
+    float release_;                     // Per hop
+    float peakFall_;                    // Per hop
+    int peakHoldHops_;
+    bool silent_;
+    uint32_t sequence_;
+    
+    FFT fft_;
+    std::vector<float> window_;
+    std::vector<float> history_;
+    std::vector<float> frame_;
+    std::vector<FFT::Complex> spectrum_;
+    std::vector<float> bandLow_;        // Band edges in (fractional) bins
+    std::vector<float> bandHigh_;
+    std::vector<float> levels_;
+    std::vector<float> peaks_;
+    std::vector<int> peakHold_;
+    
+    TripleBuffer<SpectrumFrame> frames_;
+    bool published_;                    // Reader side
+    
+    void AnalyzeFrame();
+    float GetBandPower(int band) const;
+};
+
+} // namespace Lyricstator
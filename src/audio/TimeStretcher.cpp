@@ -0,0 +1,299 @@
+#include "audio/TimeStretcher.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+namespace Lyricstator {
+
+namespace {
+const float kMinTempo = 0.25f;
+const float kMaxTempo = 4.0f;
+const float kMaxSemitones = 12.0f;
+const float kMaxStretchRate = kMaxTempo * 2.0f;   // Fastest tempo with an octave down
+
+struct OfflineSource {
+    const float* data;
+    size_t frames;
+    size_t position;
+    size_t padding;     // Silence served after the end so the last window completes
+    int channels;
+};
+
+size_t PullOffline(void* context, float* output, size_t frames) {
+    OfflineSource* source = static_cast<OfflineSource*>(context);
+    size_t available = source->frames + source->padding - source->position;
+    frames = std::min(frames, available);
+    
+    for (size_t i = 0; i < frames; ++i, ++source->position) {
+        float* frame = output + i * source->channels;
+        if (source->position < source->frames) {
+            std::memcpy(frame, source->data + source->position * source->channels, source->channels * sizeof(float));
+        } else {
+            std::memset(frame, 0, source->channels * sizeof(float));
+        }
+    }
+    return frames;
+}
+}
+
+TimeStretcher::TimeStretcher()
+    : sampleRate_(44100)
+    , channels_(2)
+    , quality_(Quality::REALTIME)
+    , tempo_(1.0f)
+    , semitones_(0.0f)
+    , windowFrames_(0)
+    , hopFrames_(0)
+    , searchFrames_(0)
+    , searchStep_(1)
+    , correlationStep_(1)
+    , inputFrames_(0)
+    , inputPosition_(0.0)
+    , previousStart_(0)
+    , havePrevious_(false)
+    , stretchedFrames_(0)
+    , stretchedRead_(0)
+    , resamplePhase_(0.0)
+    , mediaPosition_(0.0)
+{
+}
+
+void TimeStretcher::Configure(int sampleRate, int channels, Quality quality) {
+    sampleRate_ = std::max(1, sampleRate);
+    channels_ = std::max(1, channels);
+    quality_ = quality;
+    
+    bool highQuality = quality_ == Quality::HIGH_QUALITY;
+    double windowSeconds = highQuality ? 0.040 : 0.025;
+    windowFrames_ = std::max(64, static_cast<int>(sampleRate_ * windowSeconds) & ~1);
+    hopFrames_ = windowFrames_ / 2;
+    searchFrames_ = highQuality ? windowFrames_ / 2 : windowFrames_ / 4;
+    searchStep_ = highQuality ? 1 : 2;
+    correlationStep_ = highQuality ? 1 : 4;
+    
+    // Periodic Hann at 50% overlap sums to exactly one
+    window_.resize(windowFrames_);
+    for (int i = 0; i < windowFrames_; ++i) {
+        window_[i] = static_cast<float>(0.5 - 0.5 * std::cos(2.0 * M_PI * i / windowFrames_));
+    }
+    
+    int maxAnalysisHop = static_cast<int>(std::ceil(hopFrames_ * kMaxStretchRate));
+    int inputCapacity = 2 * windowFrames_ + 2 * searchFrames_ + maxAnalysisHop + hopFrames_;
+    input_.assign(static_cast<size_t>(inputCapacity) * channels_, 0.0f);
+    template_.assign(hopFrames_ / correlationStep_ + 1, 0.0f);
+    overlap_.assign(static_cast<size_t>(windowFrames_) * channels_, 0.0f);
+    stretched_.assign(static_cast<size_t>(hopFrames_) * channels_, 0.0f);
+    history_.assign(4 * channels_, 0.0f);
+    
+    Reset(0);
+}
+
+void TimeStretcher::SetTempo(float tempo) {
+    tempo_.store(std::max(kMinTempo, std::min(kMaxTempo, tempo)), std::memory_order_relaxed);
+}
+
+void TimeStretcher::SetPitchSemitones(float semitones) {
+    semitones_.store(std::max(-kMaxSemitones, std::min(kMaxSemitones, semitones)), std::memory_order_relaxed);
+}
+
+bool TimeStretcher::IsActive() const {
+    return std::fabs(GetTempo() - 1.0f) > 1e-3f || std::fabs(GetPitchSemitones()) > 1e-3f;
+}
+
+void TimeStretcher::Reset(uint64_t mediaFrame) {
+    inputFrames_ = 0;
+    inputPosition_ = 0.0;
+    previousStart_ = 0;
+    havePrevious_ = false;
+    std::fill(overlap_.begin(), overlap_.end(), 0.0f);
+    stretchedFrames_ = 0;
+    stretchedRead_ = 0;
+    std::fill(history_.begin(), history_.end(), 0.0f);
+    resamplePhase_ = 0.0;
+    mediaPosition_ = static_cast<double>(mediaFrame);
+}
+
+size_t TimeStretcher::Process(float* output, size_t frames, PullFunction pull, void* context) {
+    if (windowFrames_ == 0 || !pull) {
+        return 0;
+    }
+    
+    const float tempo = GetTempo();
+    const float pitch = std::pow(2.0f, GetPitchSemitones() / 12.0f);
+    const float stretchRate = std::min(kMaxStretchRate, tempo / pitch);
+    const bool resample = std::fabs(pitch - 1.0f) > 1e-4f;
+    const int channels = channels_;
+    
+    size_t produced = 0;
+    for (; produced < frames; ++produced) {
+        float* out = output + produced * channels;
+        
+        if (!resample) {
+            if (!NextStretchedFrame(stretchRate, pull, context, out)) {
+                break;
+            }
+        } else {
+            // Slide the cubic window until the phase sits between frames 1 and 2
+            bool starved = false;
+            while (resamplePhase_ >= 1.0) {
+                float next[8];
+                float* incoming = channels <= 8 ? next : out; // out is free scratch until written below
+                if (!NextStretchedFrame(stretchRate, pull, context, incoming)) {
+                    starved = true;
+                    break;
+                }
+                std::memmove(history_.data(), history_.data() + channels, 3 * channels * sizeof(float));
+                std::memcpy(history_.data() + 3 * channels, incoming, channels * sizeof(float));
+                resamplePhase_ -= 1.0;
+            }
+            if (starved) {
+                break;
+            }
+            
+            const float t = static_cast<float>(resamplePhase_);
+            for (int c = 0; c < channels; ++c) {
+                float h0 = history_[c];
+                float h1 = history_[channels + c];
+                float h2 = history_[2 * channels + c];
+                float h3 = history_[3 * channels + c];
+                out[c] = h1 + 0.5f * t * (h2 - h0 + t * (2.0f * h0 - 5.0f * h1 + 4.0f * h2 - h3 +
+                                                         t * (3.0f * (h1 - h2) + h3 - h0)));
+            }
+            resamplePhase_ += pitch;
+        }
+        
+        mediaPosition_ += tempo;
+    }
+    
+    return produced;
+}
+
+bool TimeStretcher::NextStretchedFrame(float stretchRate, PullFunction pull, void* context, float* frame) {
+    if (stretchedRead_ >= stretchedFrames_ && !RunSegment(stretchRate, pull, context)) {
+        return false;
+    }
+    
+    std::memcpy(frame, stretched_.data() + stretchedRead_ * channels_, channels_ * sizeof(float));
+    ++stretchedRead_;
+    return true;
+}
+
+bool TimeStretcher::RunSegment(float stretchRate, PullFunction pull, void* context) {
+    const int channels = channels_;
+    const int nominal = static_cast<int>(inputPosition_);
+    const int needed = nominal + searchFrames_ + windowFrames_;
+    
+    if (inputFrames_ < needed) {
+        size_t got = pull(context, input_.data() + static_cast<size_t>(inputFrames_) * channels, needed - inputFrames_);
+        inputFrames_ += static_cast<int>(got);
+        if (inputFrames_ < needed) {
+            return false;
+        }
+    }
+    
+    int start = havePrevious_ ? FindBestOffset(nominal) : nominal;
+    
+    // Overlap-add the windowed segment
+    const float* segment = input_.data() + static_cast<size_t>(start) * channels;
+    for (int i = 0; i < windowFrames_; ++i) {
+        float weight = window_[i];
+        for (int c = 0; c < channels; ++c) {
+            overlap_[i * channels + c] += weight * segment[i * channels + c];
+        }
+    }
+    
+    // The first hop is now complete
+    const size_t hopSamples = static_cast<size_t>(hopFrames_) * channels;
+    std::memcpy(stretched_.data(), overlap_.data(), hopSamples * sizeof(float));
+    std::memmove(overlap_.data(), overlap_.data() + hopSamples, (overlap_.size() - hopSamples) * sizeof(float));
+    std::fill(overlap_.end() - hopSamples, overlap_.end(), 0.0f);
+    stretchedFrames_ = hopFrames_;
+    stretchedRead_ = 0;
+    
+    previousStart_ = start;
+    havePrevious_ = true;
+    inputPosition_ += hopFrames_ * stretchRate;
+    
+    // Drop input nothing can reach any more
+    int keepFrom = std::min(previousStart_ + hopFrames_, static_cast<int>(inputPosition_) - searchFrames_);
+    if (keepFrom > windowFrames_) {
+        std::memmove(input_.data(), input_.data() + static_cast<size_t>(keepFrom) * channels,
+                     static_cast<size_t>(inputFrames_ - keepFrom) * channels * sizeof(float));
+        inputFrames_ -= keepFrom;
+        inputPosition_ -= keepFrom;
+        previousStart_ -= keepFrom;
+    }
+    
+    return true;
+}
+
+int TimeStretcher::FindBestOffset(int nominal) {
+    // Find the candidate that best continues where the previous segment
+    // would naturally have gone next
+    const int length = hopFrames_ / correlationStep_;
+    const int natural = previousStart_ + hopFrames_;
+    for (int k = 0; k < length; ++k) {
+        template_[k] = Mono(natural + k * correlationStep_);
+    }
+    
+    int lowest = std::max(0, nominal - searchFrames_);
+    int highest = nominal + searchFrames_;
+    int best = nominal;
+    float bestScore = -std::numeric_limits<float>::max();
+    
+    for (int candidate = lowest; candidate <= highest; candidate += searchStep_) {
+        float dot = 0.0f;
+        float energy = 0.0f;
+        for (int k = 0; k < length; ++k) {
+            float sample = Mono(candidate + k * correlationStep_);
+            dot += template_[k] * sample;
+            energy += sample * sample;
+        }
+        
+        float score = dot / std::sqrt(energy + 1e-9f);
+        if (score > bestScore) {
+            bestScore = score;
+            best = candidate;
+        }
+    }
+    
+    return best;
+}
+
+float TimeStretcher::Mono(int frame) const {
+    const float* samples = input_.data() + static_cast<size_t>(frame) * channels_;
+    float sum = 0.0f;
+    for (int c = 0; c < channels_; ++c) {
+        sum += samples[c];
+    }
+    return sum / channels_;
+}
+
+std::vector<float> TimeStretcher::RenderOffline(const float* input, size_t frames, int sampleRate, int channels,
+                                                float tempo, float semitones) {
+    TimeStretcher stretcher;
+    stretcher.Configure(sampleRate, channels, Quality::HIGH_QUALITY);
+    stretcher.SetTempo(tempo);
+    stretcher.SetPitchSemitones(semitones);
+    
+    OfflineSource source{input, frames, 0, static_cast<size_t>(stretcher.windowFrames_ * 4), std::max(1, channels)};
+    
+    size_t expected = static_cast<size_t>(frames / stretcher.GetTempo());
+    std::vector<float> output(expected * source.channels);
+    
+    size_t written = 0;
+    while (written < expected) {
+        size_t chunk = std::min<size_t>(4096, expected - written);
+        size_t produced = stretcher.Process(output.data() + written * source.channels, chunk, &PullOffline, &source);
+        written += produced;
+        if (produced < chunk) {
+            break;
+        }
+    }
+    
+    output.resize(written * source.channels);
+    return output;
+}
+
+} // namespace Lyricstator
@@ -0,0 +1,93 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace Lyricstator {
+
+// WSOLA time-stretch followed by a resampling pitch shift. Tempo and pitch
+// are independent: the stretch runs at tempo / pitch and the resampler then
+// speeds everything up by pitch, so the net rate is tempo and the net pitch
+// change is pitch.
+//
+// Realtime quality uses a short window and a decimated similarity search so
+// a callback stays well inside a few milliseconds; high quality uses a
+// longer window and an exhaustive search for offline rendering.
+class TimeStretcher {
+public:
+    enum class Quality {
+        REALTIME,
+        HIGH_QUALITY
+    };
+    
+    // Pulls up to `frames` interleaved input frames; returns how many it got
+    typedef size_t (*PullFunction)(void* context, float* output, size_t frames);
+    
+    TimeStretcher();
+    
+    // Allocates; not thread-safe with Process
+    void Configure(int sampleRate, int channels, Quality quality);
+    
+    // Control side, picked up at the next segment
+    void SetTempo(float tempo);              // 0.25 - 4.0, 1.0 = original
+    void SetPitchSemitones(float semitones); // -12 - +12
+    float GetTempo() const { return tempo_.load(std::memory_order_relaxed); }
+    float GetPitchSemitones() const { return semitones_.load(std::memory_order_relaxed); }
+    bool IsActive() const;
+    
+    // Processing side. Reset drops buffered audio and restarts at the given
+    // media frame; Process returns frames written, short only if the source
+    // ran dry.
+    void Reset(uint64_t mediaFrame);
+    size_t Process(float* output, size_t frames, PullFunction pull, void* context);
+    
+    // Media frame (in source frames) of the next output frame
+    uint64_t GetMediaPosition() const { return static_cast<uint64_t>(mediaPosition_); }
+    
+    // One-shot high-quality render of a whole buffer
+    static std::vector<float> RenderOffline(const float* input, size_t frames, int sampleRate, int channels,
+                                            float tempo, float semitones);
+
+private:
+    int sampleRate_;
+    int channels_;
+    Quality quality_;
+    std::atomic<float> tempo_;
+    std::atomic<float> semitones_;
+    
+    // WSOLA parameters
+    int windowFrames_;      // N
+    int hopFrames_;         // Synthesis hop, N / 2
+    int searchFrames_;      // +/- tolerance around the nominal position
+    int searchStep_;
+    int correlationStep_;   // Decimation of the similarity measure
+    std::vector<float> window_;
+    
+    // Input history (interleaved)
+    std::vector<float> input_;
+    int inputFrames_;
+    double inputPosition_;  // Nominal start of the next segment
+    int previousStart_;
+    bool havePrevious_;
+    std::vector<float> template_;
+    
+    // Overlap-add accumulator and finished stretched frames
+    std::vector<float> overlap_;
+    std::vector<float> stretched_;
+    int stretchedFrames_;
+    int stretchedRead_;
+    
+    // Pitch resampler: four-frame cubic history, phase in [0, 1)
+    std::vector<float> history_;
+    double resamplePhase_;
+    
+    double mediaPosition_;
+    
+    bool RunSegment(float stretchRate, PullFunction pull, void* context);
+    int FindBestOffset(int nominal);
+    bool NextStretchedFrame(float stretchRate, PullFunction pull, void* context, float* frame);
+    float Mono(int frame) const;
+};
+
+} // namespace Lyricstator
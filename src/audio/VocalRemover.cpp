@@ -0,0 +1,327 @@
+#include "audio/VocalRemover.h"
+#include "audio/PcmStream.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+namespace Lyricstator {
+
+namespace {
+const float kVocalLowHz = 100.0f;       // Fully kept below, fully processed an octave up
+const float kVocalHighHz = 8000.0f;     // Fully processed below, fully kept at 1.5x
+const float kMidSideCrossoverHz = 150.0f;
+const int kMaskExponent = 4;            // How alike left and right must be to count as centre
+const size_t kRenderChunkFrames = 4096;
+
+void WriteLE16(std::ofstream& file, uint16_t value) {
+    uint8_t bytes[2] = {static_cast<uint8_t>(value), static_cast<uint8_t>(value >> 8)};
+    file.write(reinterpret_cast<const char*>(bytes), 2);
+}
+
+void WriteLE32(std::ofstream& file, uint32_t value) {
+    uint8_t bytes[4] = {static_cast<uint8_t>(value), static_cast<uint8_t>(value >> 8),
+                        static_cast<uint8_t>(value >> 16), static_cast<uint8_t>(value >> 24)};
+    file.write(reinterpret_cast<const char*>(bytes), 4);
+}
+
+// 32-bit IEEE float WAV header; written once up front and again with the
+// real sizes when the render is done
+void WriteFloatWavHeader(std::ofstream& file, int sampleRate, int channels, uint32_t dataBytes) {
+    file.write("RIFF", 4);
+    WriteLE32(file, 36 + dataBytes);
+    file.write("WAVE", 4);
+    file.write("fmt ", 4);
+    WriteLE32(file, 16);
+    WriteLE16(file, 3);                                 // WAVE_FORMAT_IEEE_FLOAT
+    WriteLE16(file, static_cast<uint16_t>(channels));
+    WriteLE32(file, static_cast<uint32_t>(sampleRate));
+    WriteLE32(file, static_cast<uint32_t>(sampleRate * channels * 4));
+    WriteLE16(file, static_cast<uint16_t>(channels * 4));
+    WriteLE16(file, 32);
+    file.write("data", 4);
+    WriteLE32(file, dataBytes);
+}
+
+void WriteFloatSamples(std::ofstream& file, const float* samples, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        uint32_t bits;
+        std::memcpy(&bits, &samples[i], sizeof(bits));
+        WriteLE32(file, bits);
+    }
+}
+} // namespace
+
+VocalRemover::VocalRemover()
+    : sampleRate_(44100)
+    , channels_(2)
+    , mode_(static_cast<int>(Mode::OFF))
+    , strength_(1.0f)
+    , processedMode_(Mode::OFF)
+    , fftSize_(0)
+    , hopFrames_(0)
+    , fifoPosition_(0)
+    , overlapScale_(1.0f)
+    , lowpassCoefficient_(0.0f)
+    , lowpassState_(0.0f)
+{
+}
+
+void VocalRemover::Configure(int sampleRate, int channels, Quality quality) {
+    sampleRate_ = std::max(1, sampleRate);
+    channels_ = std::max(1, channels);
+    
+    // ~43 ms frames in realtime, twice that and denser overlap offline
+    bool highQuality = quality == Quality::HIGH_QUALITY;
+    fftSize_ = sampleRate_ > 32000 ? 2048 : 1024;
+    if (highQuality) {
+        fftSize_ *= 2;
+    }
+    hopFrames_ = highQuality ? fftSize_ / 8 : fftSize_ / 4;
+    fft_.Resize(fftSize_);
+    
+    // sqrt-Hann on both sides makes Hann overall, which overlaps to a
+    // constant fftSize / (2 * hop)
+    window_.resize(fftSize_);
+    for (int i = 0; i < fftSize_; ++i) {
+        window_[i] = static_cast<float>(std::sqrt(0.5 - 0.5 * std::cos(2.0 * M_PI * i / fftSize_)));
+    }
+    overlapScale_ = 2.0f * hopFrames_ / fftSize_;
+    
+    const int bins = fft_.GetBinCount();
+    bandWeight_.resize(bins);
+    for (int k = 0; k < bins; ++k) {
+        float frequency = static_cast<float>(k) * sampleRate_ / fftSize_;
+        float low = (frequency - kVocalLowHz) / kVocalLowHz;
+        float high = (1.5f * kVocalHighHz - frequency) / (0.5f * kVocalHighHz);
+        bandWeight_[k] = std::max(0.0f, std::min(1.0f, std::min(low, high)));
+    }
+    
+    inputLeft_.assign(fftSize_, 0.0f);
+    inputRight_.assign(fftSize_, 0.0f);
+    outputLeft_.assign(hopFrames_, 0.0f);
+    outputRight_.assign(hopFrames_, 0.0f);
+    accumLeft_.assign(fftSize_, 0.0f);
+    accumRight_.assign(fftSize_, 0.0f);
+    frame_.assign(fftSize_, 0.0f);
+    spectrumLeft_.assign(bins, FFT::Complex());
+    spectrumRight_.assign(bins, FFT::Complex());
+    
+    lowpassCoefficient_ = static_cast<float>(1.0 - std::exp(-2.0 * M_PI * kMidSideCrossoverHz / sampleRate_));
+    
+    Reset();
+}
+
+void VocalRemover::SetStrength(float strength) {
+    strength_.store(std::max(0.0f, std::min(1.0f, strength)), std::memory_order_relaxed);
+}
+
+int VocalRemover::GetLatencyFrames() const {
+    return channels_ == 2 && GetMode() == Mode::SPECTRAL ? fftSize_ : 0;
+}
+
+void VocalRemover::Reset() {
+    std::fill(inputLeft_.begin(), inputLeft_.end(), 0.0f);
+    std::fill(inputRight_.begin(), inputRight_.end(), 0.0f);
+    std::fill(outputLeft_.begin(), outputLeft_.end(), 0.0f);
+    std::fill(outputRight_.begin(), outputRight_.end(), 0.0f);
+    std::fill(accumLeft_.begin(), accumLeft_.end(), 0.0f);
+    std::fill(accumRight_.begin(), accumRight_.end(), 0.0f);
+    fifoPosition_ = fftSize_ - hopFrames_;
+    lowpassState_ = 0.0f;
+}
+
+void VocalRemover::Process(float* buffer, int frames) {
+    if (channels_ != 2 || fftSize_ == 0) {
+        return;
+    }
+    
+    Mode mode = GetMode();
+    if (mode != processedMode_) {
+        Reset();
+        processedMode_ = mode;
+    }
+    
+    float strength = GetStrength();
+    switch (mode) {
+        case Mode::SPECTRAL:
+            ProcessSpectral(buffer, frames, strength);
+            break;
+        case Mode::MID_SIDE:
+            ProcessMidSide(buffer, frames, strength);
+            break;
+        default:
+            break;
+    }
+}
+
+void VocalRemover::ProcessMidSide(float* buffer, int frames, float strength) {
+    // Take the centre out above the crossover only, so the bass stays
+    for (int i = 0; i < frames; ++i) {
+        float* frame = buffer + i * 2;
+        float mid = 0.5f * (frame[0] + frame[1]);
+        lowpassState_ += lowpassCoefficient_ * (mid - lowpassState_);
+        float centre = strength * (mid - lowpassState_);
+        frame[0] -= centre;
+        frame[1] -= centre;
+    }
+}
+
+void VocalRemover::ProcessSpectral(float* buffer, int frames, float strength) {
+    // Sample FIFO: a block is transformed every hop, and what is read back
+    // is the hop finished by the previous block, one full frame behind
+    const int fifoStart = fftSize_ - hopFrames_;
+    for (int i = 0; i < frames; ++i) {
+        float* frame = buffer + i * 2;
+        inputLeft_[fifoPosition_] = frame[0];
+        inputRight_[fifoPosition_] = frame[1];
+        frame[0] = outputLeft_[fifoPosition_ - fifoStart];
+        frame[1] = outputRight_[fifoPosition_ - fifoStart];
+        
+        if (++fifoPosition_ == fftSize_) {
+            ProcessBlock(strength);
+            fifoPosition_ = fifoStart;
+        }
+    }
+}
+
+void VocalRemover::ProcessBlock(float strength) {
+    for (int i = 0; i < fftSize_; ++i) {
+        frame_[i] = inputLeft_[i] * window_[i];
+    }
+    fft_.Forward(frame_.data(), spectrumLeft_.data());
+    for (int i = 0; i < fftSize_; ++i) {
+        frame_[i] = inputRight_[i] * window_[i];
+    }
+    fft_.Forward(frame_.data(), spectrumRight_.data());
+    
+    // A bin is centre-panned to the degree that left and right agree in
+    // both level and phase; remove that much of their common part
+    const int bins = fft_.GetBinCount();
+    for (int k = 0; k < bins; ++k) {
+        float weight = bandWeight_[k] * strength;
+        if (weight <= 0.0f) {
+            continue;
+        }
+        
+        FFT::Complex left = spectrumLeft_[k];
+        FFT::Complex right = spectrumRight_[k];
+        float power = std::norm(left) + std::norm(right);
+        if (power < 1e-12f) {
+            continue;
+        }
+        
+        float similarity = std::max(0.0f, 2.0f * (left * std::conj(right)).real() / power);
+        float mask = weight;
+        for (int p = 0; p < kMaskExponent; ++p) {
+            mask *= similarity;
+        }
+        
+        FFT::Complex centre = 0.5f * mask * (left + right);
+        spectrumLeft_[k] = left - centre;
+        spectrumRight_[k] = right - centre;
+    }
+    
+    fft_.Inverse(spectrumLeft_.data(), frame_.data());
+    for (int i = 0; i < fftSize_; ++i) {
+        accumLeft_[i] += frame_[i] * window_[i] * overlapScale_;
+    }
+    fft_.Inverse(spectrumRight_.data(), frame_.data());
+    for (int i = 0; i < fftSize_; ++i) {
+        accumRight_[i] += frame_[i] * window_[i] * overlapScale_;
+    }
+    
+    // The first hop is finished; shift everything along by one hop
+    const size_t hop = static_cast<size_t>(hopFrames_);
+    const size_t rest = static_cast<size_t>(fftSize_) - hop;
+    std::memcpy(outputLeft_.data(), accumLeft_.data(), hop * sizeof(float));
+    std::memcpy(outputRight_.data(), accumRight_.data(), hop * sizeof(float));
+    std::memmove(accumLeft_.data(), accumLeft_.data() + hop, rest * sizeof(float));
+    std::memmove(accumRight_.data(), accumRight_.data() + hop, rest * sizeof(float));
+    std::fill(accumLeft_.begin() + rest, accumLeft_.end(), 0.0f);
+    std::fill(accumRight_.begin() + rest, accumRight_.end(), 0.0f);
+    std::memmove(inputLeft_.data(), inputLeft_.data() + hop, rest * sizeof(float));
+    std::memmove(inputRight_.data(), inputRight_.data() + hop, rest * sizeof(float));
+}
+
+bool VocalRemover::RenderFile(const std::string& input, const std::string& output, int sampleRate, int channels,
+                              float strength, const std::atomic<bool>* cancel) {
+    if (channels != 2) {
+        std::cerr << "Vocal removal needs a stereo output: " << input << std::endl;
+        return false;
+    }
+    
+    PcmStream stream;
+    if (!stream.Open(input, sampleRate, channels, 2.0f)) {
+        std::cerr << "Failed to open for vocal removal: " << input << std::endl;
+        return false;
+    }
+    
+    VocalRemover remover;
+    remover.Configure(sampleRate, channels, Quality::HIGH_QUALITY);
+    remover.SetMode(Mode::SPECTRAL);
+    remover.SetStrength(strength);
+    
+    const std::string partial = output + ".part";
+    std::ofstream file(partial, std::ios::binary | std::ios::trunc);
+    if (!file) {
+        std::cerr << "Failed to create " << partial << std::endl;
+        return false;
+    }
+    WriteFloatWavHeader(file, sampleRate, channels, 0);
+    
+    // Drop the remover's latency from the front and flush it with silence at
+    // the end, so the render lines up sample for sample with the original
+    std::vector<float> buffer(kRenderChunkFrames * channels);
+    size_t skip = static_cast<size_t>(remover.GetLatencyFrames());
+    size_t flush = skip;
+    uint64_t written = 0;
+    bool finished = false;
+    
+    while (!finished) {
+        if (cancel && cancel->load(std::memory_order_relaxed)) {
+            break;
+        }
+        
+        stream.Fill();
+        size_t frames = stream.Read(buffer.data(), kRenderChunkFrames);
+        if (frames == 0) {
+            frames = std::min(flush, kRenderChunkFrames);
+            std::fill(buffer.begin(), buffer.begin() + frames * channels, 0.0f);
+            flush -= frames;
+            finished = flush == 0;
+        }
+        
+        remover.Process(buffer.data(), static_cast<int>(frames));
+        
+        size_t dropped = std::min(skip, frames);
+        skip -= dropped;
+        WriteFloatSamples(file, buffer.data() + dropped * channels, (frames - dropped) * channels);
+        written += frames - dropped;
+    }
+    
+    uint64_t dataBytes = written * channels * sizeof(float);
+    if (finished && dataBytes <= 0xFFFFFFFFull - 36) {
+        file.seekp(0);
+        WriteFloatWavHeader(file, sampleRate, channels, static_cast<uint32_t>(dataBytes));
+    }
+    file.close();
+    
+    std::error_code error;
+    if (!finished || !file || dataBytes > 0xFFFFFFFFull - 36) {
+        std::filesystem::remove(partial, error);
+        return false;
+    }
+    
+    std::filesystem::rename(partial, output, error);
+    if (error) {
+        std::cerr << "Failed to store " << output << ": " << error.message() << std::endl;
+        std::filesystem::remove(partial, error);
+        return false;
+    }
+    return true;
+}
+
+} // namespace Lyricstator
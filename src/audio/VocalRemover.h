@@ -0,0 +1,91 @@
+#pragma once
+#include "audio/FFT.h"
+#include <atomic>
+#include <string>
+#include <vector>
+
+namespace Lyricstator {
+
+// Karaoke-style vocal reduction for ordinary stereo mixes, which usually
+// have the lead vocal panned dead centre.
+//
+// SPECTRAL runs an STFT over both channels and, bin by bin, removes the part
+// of the signal that is identical in left and right, leaving bass and the
+// top octave alone so the kick, bass line and cymbals survive. MID_SIDE is
+// the cheap fallback: it subtracts the centre above ~150 Hz with no
+// transform and no latency, for devices that can't afford the FFTs.
+class VocalRemover {
+public:
+    enum class Mode {
+        OFF,
+        MID_SIDE,
+        SPECTRAL
+    };
+    
+    enum class Quality {
+        REALTIME,
+        HIGH_QUALITY
+    };
+    
+    VocalRemover();
+    
+    // Allocates; not thread-safe with Process. Only stereo is processed.
+    void Configure(int sampleRate, int channels, Quality quality);
+    
+    // Control side, picked up by the next Process call
+    void SetMode(Mode mode) { mode_.store(static_cast<int>(mode), std::memory_order_relaxed); }
+    void SetStrength(float strength);       // 0 - 1
+    Mode GetMode() const { return static_cast<Mode>(mode_.load(std::memory_order_relaxed)); }
+    float GetStrength() const { return strength_.load(std::memory_order_relaxed); }
+    bool IsActive() const { return channels_ == 2 && GetMode() != Mode::OFF; }
+    
+    // Processing side. In place on interleaved frames; Reset drops anything
+    // still in flight (after a seek or track change).
+    void Reset();
+    void Process(float* buffer, int frames);
+    
+    // Frames the output trails the input by in the current mode
+    int GetLatencyFrames() const;
+    
+    // Renders a whole file to a 32-bit float WAV with the high-quality
+    // spectral stage. Writes to a temporary name and renames on success, so
+    // a half-written file never looks like a finished one. Returns false on
+    // failure or if `cancel` was raised.
+    static bool RenderFile(const std::string& input, const std::string& output, int sampleRate, int channels,
+                           float strength, const std::atomic<bool>* cancel = nullptr);
+
+private:
+    int sampleRate_;
+    int channels_;
+    std::atomic<int> mode_;
+    std::atomic<float> strength_;
+    Mode processedMode_;                // Processing side
+    
+    // STFT state
+    FFT fft_;
+    int fftSize_;
+    int hopFrames_;
+    int fifoPosition_;
+    float overlapScale_;
+    std::vector<float> window_;         // sqrt-Hann, used for analysis and synthesis
+    std::vector<float> bandWeight_;     // Per bin: how much of it is vocal range
+    std::vector<float> inputLeft_;
+    std::vector<float> inputRight_;
+    std::vector<float> outputLeft_;
+    std::vector<float> outputRight_;
+    std::vector<float> accumLeft_;
+    std::vector<float> accumRight_;
+    std::vector<float> frame_;
+    std::vector<FFT::Complex> spectrumLeft_;
+    std::vector<FFT::Complex> spectrumRight_;
+    
+    // Mid/side state: one-pole lowpass on the mid channel
+    float lowpassCoefficient_;
+    float lowpassState_;
+    
+    void ProcessSpectral(float* buffer, int frames, float strength);
+    void ProcessMidSide(float* buffer, int frames, float strength);
+    void ProcessBlock(float strength);
+};
+
+} // namespace Lyricstator
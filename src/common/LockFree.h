@@ -0,0 +1,288 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <vector>
+#include <algorithm>
+
+namespace Lyricstator {
+
+// Payload storage for the lock-free types below. The value is kept as an
+// array of relaxed atomic words so that readers racing with the writer never
+// touch non-atomic memory; the surrounding sequence counter tells them
+// whether what they copied is consistent.
+template <typename T>
+class AtomicWords {
+public:
+    static_assert(std::is_trivially_copyable<T>::value, "AtomicWords requires a trivially copyable type");
+    
+    AtomicWords() {
+        for (auto& word : words_) {
+            word.store(0, std::memory_order_relaxed);
+        }
+    }
+    
+    void Write(const T& value) {
+        uint32_t buffer[kWordCount] = {};
+        std::memcpy(buffer, &value, sizeof(T));
+        for (size_t i = 0; i < kWordCount; ++i) {
+            words_[i].store(buffer[i], std::memory_order_relaxed);
+        }
+    }
+    
+    void Read(T& value) const {
+        uint32_t buffer[kWordCount];
+        for (size_t i = 0; i < kWordCount; ++i) {
+            buffer[i] = words_[i].load(std::memory_order_relaxed);
+        }
+        std::memcpy(&value, buffer, sizeof(T));
+    }
+
+private:
+    static constexpr size_t kWordCount = (sizeof(T) + sizeof(uint32_t) - 1) / sizeof(uint32_t);
+    std::atomic<uint32_t> words_[kWordCount];
+};
+
+// Single-writer "latest value" cell. The writer never blocks or retries;
+// readers retry only if they overlapped a write.
+template <typename T>
+class SeqLock {
+public:
+    SeqLock() : sequence_(0) {}
+    
+    void Store(const T& value) {
+        uint32_t seq = sequence_.load(std::memory_order_relaxed);
+        sequence_.store(seq + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        data_.Write(value);
+        sequence_.store(seq + 2, std::memory_order_release);
+    }
+    
+    T Load() const {
+        T value;
+        while (!TryLoad(value)) {
+        }
+        return value;
+    }
+    
+    bool TryLoad(T& value) const {
+        uint32_t before = sequence_.load(std::memory_order_acquire);
+        if (before & 1) {
+            return false;
+        }
+        data_.Read(value);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return sequence_.load(std::memory_order_relaxed) == before;
+    }
+    
+    // Bumps every time a new value is stored
+    uint32_t GetVersion() const { return sequence_.load(std::memory_order_acquire) >> 1; }
+
+private:
+    std::atomic<uint32_t> sequence_;
+    AtomicWords<T> data_;
+};
+
+// Bounded single-producer / multi-consumer broadcast queue. Every consumer
+// owns a Cursor and sees every item at its own pace; the producer never
+// waits, so a consumer that falls more than Capacity items behind skips
+// ahead and the skipped count is reported on its cursor.
+template <typename T, size_t Capacity>
+class BroadcastQueue {
+public:
+    static_assert((Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+    
+    struct Cursor {
+        uint64_t position = 0;
+        uint64_t dropped = 0;
+    };
+    
+    BroadcastQueue() : head_(0) {
+        for (auto& slot : slots_) {
+            slot.sequence.store(0, std::memory_order_relaxed);
+        }
+    }
+    
+    // Producer side
+    void Push(const T& value) {
+        uint64_t index = head_.load(std::memory_order_relaxed);
+        Slot& slot = slots_[index & (Capacity - 1)];
+        slot.sequence.store(index * 2 + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        slot.data.Write(value);
+        slot.sequence.store(index * 2 + 2, std::memory_order_release);
+        head_.store(index + 1, std::memory_order_release);
+    }
+    
+    // Consumer side. A fresh cursor from Subscribe() only sees new items.
+    Cursor Subscribe() const {
+        Cursor cursor;
+        cursor.position = head_.load(std::memory_order_acquire);
+        return cursor;
+    }
+    
+    bool Pop(Cursor& cursor, T& value) const {
+        for (;;) {
+            uint64_t head = head_.load(std::memory_order_acquire);
+            if (cursor.position >= head) {
+                return false;
+            }
+            if (head - cursor.position > Capacity) {
+                cursor.dropped += head - Capacity - cursor.position;
+                cursor.position = head - Capacity;
+            }
+            
+            const Slot& slot = slots_[cursor.position & (Capacity - 1)];
+            uint64_t expected = cursor.position * 2 + 2;
+            if (slot.sequence.load(std::memory_order_acquire) != expected) {
+                continue; // Overwritten while we looked - re-check head
+            }
+            slot.data.Read(value);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (slot.sequence.load(std::memory_order_relaxed) != expected) {
+                continue;
+            }
+            
+            ++cursor.position;
+            return true;
+        }
+    }
+    
+    uint64_t GetPushCount() const { return head_.load(std::memory_order_acquire); }
+
+private:
+    struct Slot {
+        std::atomic<uint64_t> sequence;
+        AtomicWords<T> data;
+    };
+    
+    Slot slots_[Capacity];
+    std::atomic<uint64_t> head_;
+};
+
+// Single-writer / single-reader "latest frame" exchange. Three slots: the
+// writer fills its back slot and swaps it with the middle one, the reader
+// swaps the middle one for its front slot when a new frame is there. Neither
+// side ever waits or copies, which suits large frames (a whole spectrum)
+// that SeqLock would have to copy word by word.
+template <typename T>
+class TripleBuffer {
+public:
+    TripleBuffer() : back_(0), middle_(1), front_(2) {}
+    
+    // Writer side: fill GetWriteBuffer(), then Publish() it
+    T& GetWriteBuffer() { return slots_[back_]; }
+    
+    void Publish() {
+        back_ = middle_.exchange(back_ | kFresh, std::memory_order_acq_rel) & kIndexMask;
+    }
+    
+    // Reader side: true if a newer frame was swapped in by this call
+    bool Update() {
+        if (!(middle_.load(std::memory_order_relaxed) & kFresh)) {
+            return false;
+        }
+        front_ = middle_.exchange(front_, std::memory_order_acq_rel) & kIndexMask;
+        return true;
+    }
+    
+    const T& GetReadBuffer() const { return slots_[front_]; }
+
+private:
+    static constexpr uint32_t kIndexMask = 3;
+    static constexpr uint32_t kFresh = 4;
+    
+    T slots_[3];
+    uint32_t back_;                     // Writer side
+    std::atomic<uint32_t> middle_;      // Shared, plus the kFresh flag
+    uint32_t front_;                    // Reader side
+};
+
+// Single-producer / single-consumer ring of samples. Indices are 64-bit and
+// only ever grow, which lets the consumer jump straight to a position the
+// producer published (used to flush stale audio after a seek).
+template <typename T>
+class SpscRingBuffer {
+public:
+    explicit SpscRingBuffer(size_t capacity = 0) : mask_(0), readIndex_(0), writeIndex_(0) {
+        Resize(capacity);
+    }
+    
+    // Not thread-safe: only call while neither side is running
+    void Resize(size_t capacity) {
+        size_t size = 1;
+        while (size < capacity) {
+            size <<= 1;
+        }
+        buffer_.assign(capacity ? size : 0, T());
+        mask_ = capacity ? size - 1 : 0;
+        Reset();
+    }
+    
+    void Reset() {
+        readIndex_.store(0, std::memory_order_relaxed);
+        writeIndex_.store(0, std::memory_order_relaxed);
+    }
+    
+    size_t GetCapacity() const { return buffer_.size(); }
+    
+    // Producer side
+    size_t GetWriteAvailable() const {
+        uint64_t write = writeIndex_.load(std::memory_order_relaxed);
+        uint64_t read = readIndex_.load(std::memory_order_acquire);
+        return buffer_.size() - static_cast<size_t>(write - read);
+    }
+    
+    size_t Write(const T* data, size_t count) {
+        uint64_t write = writeIndex_.load(std::memory_order_relaxed);
+        count = std::min(count, GetWriteAvailable());
+        for (size_t i = 0; i < count; ++i) {
+            buffer_[(write + i) & mask_] = data[i];
+        }
+        writeIndex_.store(write + count, std::memory_order_release);
+        return count;
+    }
+    
+    uint64_t GetWriteIndex() const { return writeIndex_.load(std::memory_order_relaxed); }
+    
+    // Consumer side
+    size_t GetReadAvailable() const {
+        uint64_t read = readIndex_.load(std::memory_order_relaxed);
+        return static_cast<size_t>(writeIndex_.load(std::memory_order_acquire) - read);
+    }
+    
+    size_t Read(T* data, size_t count) {
+        uint64_t read = readIndex_.load(std::memory_order_relaxed);
+        count = std::min(count, GetReadAvailable());
+        for (size_t i = 0; i < count; ++i) {
+            data[i] = buffer_[(read + i) & mask_];
+        }
+        readIndex_.store(read + count, std::memory_order_release);
+        return count;
+    }
+    
+    size_t Skip(size_t count) {
+        uint64_t read = readIndex_.load(std::memory_order_relaxed);
+        count = std::min(count, GetReadAvailable());
+        readIndex_.store(read + count, std::memory_order_release);
+        return count;
+    }
+    
+    // Drop everything before `index` (an index previously returned by
+    // GetWriteIndex on the producer side)
+    void SkipTo(uint64_t index) {
+        uint64_t read = readIndex_.load(std::memory_order_relaxed);
+        if (index > read) {
+            Skip(static_cast<size_t>(index - read));
+        }
+    }
+    
+private:
+    std::vector<T> buffer_;
+    size_t mask_;
+    std::atomic<uint64_t> readIndex_;
+    std::atomic<uint64_t> writeIndex_;
+};
+
+} // namespace Lyricstator
@@ -102,6 +102,21 @@ struct PitchDetectionResult {
     bool voiceDetected;     // Whether voice was detected
 };
 
+// Sung note segmentation events (emitted by NoteTracker)
+enum class SungNoteEventType {
+    NOTE_ON,
+    NOTE_OFF
+};
+
+struct SungNoteEvent {
+    SungNoteEventType type;
+    uint8_t midiNote;       // Nearest MIDI note (0-127)
+    int16_t cents;          // Average deviation from the note centre
+    uint32_t onsetTime;     // Note onset in milliseconds
+    uint32_t timestamp;     // Time the event was emitted in milliseconds
+    float stability;        // 0.0-1.0, higher means less pitch jitter
+};
+
 // Playback state
 enum class PlaybackState {
     STOPPED,
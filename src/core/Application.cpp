@@ -2,8 +2,10 @@
 #include "audio/AudioManager.h"
 #include "audio/MidiParser.h"
 #include "ai/NoteDetector.h"
+#include "ai/NoteTracker.h"
 #include "scripting/LystrParser.h"
 #include "scripting/LystrInterpreter.h"
+#include "scripting/LystrCompiledScript.h"
 #include "gui/Window.h"
 #include "gui/TGUIKaraokeDisplay.h"
 #include "gui/UserInterface.h"
@@ -16,24 +18,39 @@
 #include "utils/ErrorHandler.h"
 #include "core/AssetManager.h"
 #include "core/SettingsManager.h" // Added SettingsManager include
+#include "core/SongMetadataCache.h"
+#include "audio/LoudnessScanner.h"
+#include "utils/FileUtils.h"
 
 #include <TGUI/TGUI.hpp>
 #include <SDL2/SDL.h>
 #include <SDL2/SDL_mixer.h>
 #include <SDL2/SDL_ttf.h>
+#include <filesystem>
 #include <iostream>
 
 namespace Lyricstator {
 
+namespace {
+const float kMaxTruePeakDb = -1.0f;     // Headroom normalisation never eats into
+const float kMaxNormalizationBoostDb = 12.0f;
+}
+
 Application::Application()
     : running_(false)
     , initialized_(false)
     , playbackState_(PlaybackState::STOPPED)
+    , lyricScriptParsed_(false)
     , windowWidth_(1280)
     , windowHeight_(720)
     , volume_(1.0f)
     , tempoMultiplier_(1.0f)
     , pitchDetectionEnabled_(true)
+    , micBufferFrames_(0)
+    , measuringLatency_(false)
+    , pitchLatencySumMs_(0.0)
+    , pitchLatencyMaxMs_(0.0)
+    , pitchLatencyCount_(0)
     , lastFrameTime_(std::chrono::steady_clock::now())
     , settingsManager_(nullptr) // Initialize settingsManager pointer
 {
@@ -64,6 +81,7 @@ bool Application::Initialize() {
         audioManager_ = std::make_unique<AudioManager>();
         midiParser_ = std::make_unique<MidiParser>();
         noteDetector_ = std::make_unique<NoteDetector>();
+        noteTracker_ = std::make_unique<NoteTracker>();
         lystrParser_ = std::make_unique<LystrParser>();
         lystrInterpreter_ = std::make_unique<LystrInterpreter>();
         window_ = std::make_unique<Window>();
@@ -75,8 +93,11 @@ bool Application::Initialize() {
         keybindEditor_ = std::make_unique<TGUIKeybindEditor>(); // Create TGUIKeybindEditor instance
         syncManager_ = std::make_unique<SynchronizationManager>();
         formatExporter_ = std::make_unique<FormatExporter>();
+        songMetadata_ = std::make_unique<SongMetadataCache>();
+        loudnessScanner_ = std::make_unique<LoudnessScanner>();
         
         // Initialize subsystems
+        lystrParser_->SetScreenSize(windowWidth_, windowHeight_);
         if (!window_->Initialize(windowWidth_, windowHeight_, "Lyricstator")) {
             std::cerr << "Failed to initialize window" << std::endl;
             return false;
@@ -95,6 +116,22 @@ bool Application::Initialize() {
             return false;
         }
         
+        // Instrumentals rendered for vocal reduction are kept for next time
+        audioManager_->SetInstrumentalCacheDirectory("cache/instrumentals");
+        
+        // Pitch detection is fed at the device rate and decimates internally
+        const auto& audioSettings = settingsManager_->getAudioSettings();
+        if (!noteDetector_->Initialize(audioSettings.sampleRate, audioSettings.bufferSize)) {
+            std::cerr << "Failed to initialize note detector" << std::endl;
+            return false;
+        }
+        noteDetector_->SetRealTimeMode(true);
+        detectionCursor_ = noteDetector_->SubscribeResults();
+        
+        // Singing is picked up live; without a mic, detection just idles
+        OpenMicrophone();
+        micBuffer_.resize(4096);
+        
         if (!karaokeDisplay_->Initialize(*gui_, assetManager_.get())) {
             std::cerr << "Failed to initialize karaoke display" << std::endl;
             return false;
@@ -131,13 +168,19 @@ bool Application::Initialize() {
         
         equalizer_->SetBandChangedCallback([this](int bandIndex, float gain) {
             // Apply equalizer changes to audio system
-            std::cout << "Equalizer band " << bandIndex << " changed to " << gain << "dB" << std::endl;
+            const auto& bands = settingsManager_->getAudioSettings().equalizerBands;
+            if (bandIndex >= 0 && bandIndex < static_cast<int>(bands.size())) {
+                audioManager_->SetEqualizerBand(bandIndex, bands[bandIndex].frequency, gain, bands[bandIndex].enabled);
+            }
         });
         
         equalizer_->SetEqualizerToggleCallback([this](bool enabled) {
+            audioManager_->EnableEqualizer(enabled);
             std::cout << "Equalizer " << (enabled ? "enabled" : "disabled") << std::endl;
         });
         
+        ApplyEqualizerSettings();
+        
         songBrowser_->SetSongSelectedCallback([this](const SongInfo& song) {
             std::string extension = song.format;
             std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
@@ -145,12 +188,25 @@ bool Application::Initialize() {
             if (extension == "mid" || extension == "midi") {
                 LoadMidiFile(song.filepath);
             } else if (extension == "wav" || extension == "mp3" || extension == "ogg" || extension == "flac") {
-                LoadAudioFile(song.filepath);
+                if (playbackState_ == PlaybackState::PLAYING) {
+                    // Don't cut the current singer off - line it up next
+                    std::string basePath = song.filepath.substr(0, song.filepath.find_last_of('.'));
+                    std::string midiFile = FileUtils::FileExists(basePath + ".mid") ? basePath + ".mid" : "";
+                    std::string lyricScript = FileUtils::FileExists(basePath + ".lystr") ? basePath + ".lystr" : "";
+                    QueueSong(song.filepath, midiFile, lyricScript);
+                } else {
+                    LoadAudioFile(song.filepath);
+                }
             } else if (extension == "lystr") {
                 LoadLyricScript(song.filepath);
             }
         });
         
+        // Measure the library's loudness in the background, once per file
+        songMetadata_->Load("cache/song_metadata.json");
+        loudnessScanner_->Start();
+        ScanLibraryLoudness();
+        
         if (!syncManager_->Initialize()) {
             std::cerr << "Failed to initialize synchronization manager" << std::endl;
             return false;
@@ -235,6 +291,12 @@ void Application::Shutdown() {
         settingsManager_->saveSettings();
     }
     
+    loudnessScanner_.reset();
+    if (songMetadata_) {
+        songMetadata_->Save();
+    }
+    songMetadata_.reset();
+    
     formatExporter_.reset();
     syncManager_.reset();
     keybindEditor_.reset();
@@ -246,6 +308,7 @@ void Application::Shutdown() {
     window_.reset();
     lystrInterpreter_.reset();
     lystrParser_.reset();
+    noteTracker_.reset();
     noteDetector_.reset();
     midiParser_.reset();
     audioManager_.reset();
@@ -298,25 +361,72 @@ void Application::HandleSDLEvents() {
 }
 
 void Application::UpdateSystems(float deltaTime) {
+    UpdateLoudnessScan();
+    UpdateLatencyReport();
+    
+    // Drain the mic analysis ring every frame so it never backs up, but
+    // only score while a song is playing
+    bool scoring = playbackState_ == PlaybackState::PLAYING && pitchDetectionEnabled_ && noteDetector_;
+    size_t micFrames;
+    while ((micFrames = audioManager_->ReadMicSamples(micBuffer_.data(), micBuffer_.size())) > 0) {
+        if (scoring) {
+            noteDetector_->ProcessAudioBuffer(micBuffer_.data(), static_cast<int>(micFrames));
+        }
+    }
+    
     if (playbackState_ == PlaybackState::PLAYING) {
-        uint32_t currentTime = GetCurrentTimeMs();
-        
         audioManager_->Update(deltaTime);
         
+        std::string switchedTo;
+        if (audioManager_->ConsumeTrackChange(switchedTo)) {
+            OnQueuedSongStarted(switchedTo);
+        }
+        
+        uint32_t currentTime = GetCurrentTimeMs();
+        
         if (pitchDetectionEnabled_ && noteDetector_) {
-            auto detectionResult = noteDetector_->DetectPitch();
-            if (detectionResult.voiceDetected) {
-                PushEvent(AppEvent(EventType::NOTE_DETECTED, "", &detectionResult));
+            noteDetector_->DetectPitch(currentTime);
+            
+            // Drain everything published since last frame; only sung note
+            // changes reach the event queue, not every detection
+            PitchDetectionResult detectionResult;
+            bool detected = false;
+            while (noteDetector_->PollResult(detectionCursor_, detectionResult)) {
+                detected = true;
+                SungNoteEvent noteEvents[NoteTracker::kMaxEventsPerFrame];
+                int eventCount = noteTracker_->Process(detectionResult, detectionResult.timestamp, noteEvents);
+                for (int i = 0; i < eventCount; ++i) {
+                    if (noteEvents[i].type == SungNoteEventType::NOTE_ON) {
+                        PushEvent(AppEvent(EventType::NOTE_DETECTED, NoteTracker::GetNoteName(noteEvents[i].midiNote)));
+                    }
+                }
+            }
+            
+            // How stale the newest sung sample is by the time its result is in hand
+            if (detected) {
+                double ageMs = audioManager_->GetMicInputAgeMs();
+                pitchLatencySumMs_ += ageMs;
+                pitchLatencyMaxMs_ = std::max(pitchLatencyMaxMs_, ageMs);
+                ++pitchLatencyCount_;
             }
         }
         
         syncManager_->Update(currentTime);
         
+        // What the script's runtime if()s test against
+        if (pitchDetectionEnabled_ && noteTracker_) {
+            bool singing = noteTracker_->IsNoteActive();
+            lystrInterpreter_->SetRuntimeValue(LystrRuntimeValue::PITCH_SCORE, noteTracker_->GetCurrentStability() * 100.0f);
+            lystrInterpreter_->SetRuntimeValue(LystrRuntimeValue::SUNG_NOTE, singing ? noteTracker_->GetCurrentNote() : 0.0f);
+            lystrInterpreter_->SetRuntimeValue(LystrRuntimeValue::PITCH_CENTS, singing ? noteTracker_->GetCurrentCents() : 0.0f);
+        }
         lystrInterpreter_->Update(currentTime);
+        karaokeDisplay_->SetLyricElements(lystrInterpreter_->Animate(currentTime));
         
         if (equalizer_->IsVisible()) {
-            auto spectrumData = audioManager_->GetSpectrumData(64);
-            equalizer_->UpdateSpectrum(spectrumData);
+            if (const SpectrumFrame* spectrum = audioManager_->GetSpectrum()) {
+                equalizer_->UpdateSpectrum(*spectrum);
+            }
         }
     }
     
@@ -338,6 +448,7 @@ float Application::GetDeltaTime() {
 bool Application::LoadAudioFile(const std::string& filepath) {
     std::cout << "Loading audio file: " << filepath << std::endl;
     
+    ApplyTrackLoudness(filepath);
     if (!audioManager_->LoadAudio(filepath)) {
         ShowErrorDialog("Failed to load audio file: " + filepath, ErrorType::AUDIO_ERROR);
         return false;
@@ -364,19 +475,197 @@ bool Application::LoadMidiFile(const std::string& filepath) {
 bool Application::LoadLyricScript(const std::string& filepath) {
     std::cout << "Loading lyric script: " << filepath << std::endl;
     
-    if (!lystrParser_->ParseFile(filepath)) {
+    // From the .lystrc when it's current; the text is only parsed (and the
+    // .lystrc rewritten) when that's missing or stale
+    LystrTimeline timeline;
+    std::vector<LystrInterpreter::Keyframe> keyframes;
+    if (!LystrCompiledScript::Load(filepath, timeline, keyframes)) {
         ShowErrorDialog("Failed to parse lyric script: " + filepath, ErrorType::PARSING_ERROR);
         return false;
     }
     
-    auto commands = lystrParser_->GetCommands();
-    lystrInterpreter_->LoadScript(commands);
+    lystrInterpreter_->LoadScript(std::move(timeline), std::move(keyframes));
     
     currentLyricScript_ = filepath;
+    lyricScriptParsed_ = false;
     PushEvent(AppEvent(EventType::LYRIC_SCRIPT_LOADED, filepath));
     return true;
 }
 
+bool Application::EditLyricScript(size_t position, size_t removed, const std::string& text) {
+    // Playback runs from the compiled script; the editor's parse of the
+    // text is only needed once it's edited
+    if (!lyricScriptParsed_) {
+        if (!currentLyricScript_.empty()) {
+            lystrParser_->ParseFile(currentLyricScript_);
+        } else {
+            lystrParser_->Clear();
+        }
+        lyricScriptParsed_ = true;
+    }
+    
+    bool valid = lystrParser_->ApplyEdit(position, removed, text);
+    lystrInterpreter_->ReloadScript(lystrParser_->GetTimeline(), GetCurrentTimeMs());
+    return valid;
+}
+
+bool Application::QueueSong(const std::string& audioFile, const std::string& midiFile,
+                            const std::string& lyricScript, uint32_t crossfadeMs) {
+    ApplyTrackLoudness(audioFile);
+    if (!audioManager_->QueueNext(audioFile, crossfadeMs)) {
+        ShowErrorDialog("Failed to queue audio file: " + audioFile, ErrorType::AUDIO_ERROR);
+        return false;
+    }
+    queuedAudioFile_ = audioFile;
+    
+    // Own parser instances, so nothing the current song uses is touched
+    preparedSong_ = std::async(std::launch::async, [midiFile, lyricScript]() {
+        PreparedSong song;
+        song.midiFile = midiFile;
+        song.lyricScript = lyricScript;
+        
+        if (!midiFile.empty()) {
+            song.midiParser = std::make_unique<MidiParser>();
+            if (!song.midiParser->LoadMidiFile(midiFile)) {
+                std::cerr << "Failed to load queued MIDI file: " << midiFile << std::endl;
+                song.midiParser.reset();
+                song.midiFile.clear();
+            }
+        }
+        
+        if (!lyricScript.empty()) {
+            if (!LystrCompiledScript::Load(lyricScript, song.timeline, song.keyframes)) {
+                std::cerr << "Failed to parse queued lyric script: " << lyricScript << std::endl;
+                song.lyricScript.clear();
+            }
+        }
+        return song;
+    });
+    
+    std::cout << "Queued song: " << audioFile << std::endl;
+    return true;
+}
+
+void Application::OnQueuedSongStarted(const std::string& audioFile) {
+    currentAudioFile_ = audioFile;
+    queuedAudioFile_.clear();
+    PushEvent(AppEvent(EventType::AUDIO_LOADED, audioFile));
+    
+    // Parsing finishes well before the audio is ready, so this doesn't wait
+    PreparedSong song;
+    if (preparedSong_.valid()) {
+        song = preparedSong_.get();
+    }
+    
+    if (song.midiParser) {
+        midiParser_ = std::move(song.midiParser);
+        currentMidiFile_ = song.midiFile;
+        PushEvent(AppEvent(EventType::MIDI_LOADED, currentMidiFile_));
+    } else {
+        midiParser_ = std::make_unique<MidiParser>();
+        currentMidiFile_.clear();
+    }
+    
+    // An empty script clears the previous song's lyrics
+    lystrInterpreter_->LoadScript(std::move(song.timeline), std::move(song.keyframes));
+    currentLyricScript_ = song.lyricScript;
+    lyricScriptParsed_ = false;
+    if (!currentLyricScript_.empty()) {
+        PushEvent(AppEvent(EventType::LYRIC_SCRIPT_LOADED, currentLyricScript_));
+    }
+    
+    syncManager_->Seek(0);
+    lystrInterpreter_->Seek(0);
+}
+
+void Application::ScanLibraryLoudness() {
+    const auto& directories = settingsManager_->getDirectorySettings();
+    size_t queued = 0;
+    
+    auto enqueue = [&](const std::filesystem::directory_entry& entry) {
+        std::string filepath = entry.path().string();
+        if (entry.is_regular_file() && FileUtils::IsAudioFile(filepath) && !songMetadata_->Contains(filepath)) {
+            loudnessScanner_->Enqueue(filepath);
+            ++queued;
+        }
+    };
+    
+    for (const auto& directory : directories.songDirectories) {
+        try {
+            if (!std::filesystem::is_directory(directory)) {
+                continue;
+            }
+            if (directories.recursiveSearch) {
+                for (const auto& entry : std::filesystem::recursive_directory_iterator(directory)) {
+                    enqueue(entry);
+                }
+            } else {
+                for (const auto& entry : std::filesystem::directory_iterator(directory)) {
+                    enqueue(entry);
+                }
+            }
+        } catch (const std::filesystem::filesystem_error& e) {
+            std::cerr << "Failed to scan " << directory << " for loudness: " << e.what() << std::endl;
+        }
+    }
+    
+    if (queued > 0) {
+        std::cout << "Measuring loudness of " << queued << " songs in the background" << std::endl;
+    }
+}
+
+void Application::ApplyTrackLoudness(const std::string& audioFile) {
+    if (!settingsManager_->getAudioSettings().normalizeLoudness) {
+        audioManager_->SetTrackGain(audioFile, 0.0f);
+        return;
+    }
+    
+    SongMetadata metadata;
+    if (songMetadata_->Lookup(audioFile, metadata)) {
+        audioManager_->SetTrackGain(audioFile, ComputeNormalizationGain(metadata));
+    } else {
+        // Not measured yet: jump the queue; the gain follows when it's done
+        loudnessScanner_->Prioritize(audioFile);
+    }
+}
+
+void Application::UpdateLoudnessScan() {
+    LoudnessScanner::Result result;
+    bool stored = false;
+    while (loudnessScanner_->PollResult(result)) {
+        if (!result.success) {
+            continue;
+        }
+        
+        SongMetadata metadata;
+        metadata.integratedLufs = result.integratedLufs;
+        metadata.truePeakDb = result.truePeakDb;
+        stored = songMetadata_->Store(result.filepath, metadata) || stored;
+        
+        if (result.filepath == currentAudioFile_ || result.filepath == queuedAudioFile_) {
+            ApplyTrackLoudness(result.filepath);
+        }
+    }
+    
+    // Persist once the backlog is through, so a restart doesn't redo it
+    if (stored && loudnessScanner_->GetPendingCount() == 0) {
+        songMetadata_->Save();
+    }
+}
+
+float Application::ComputeNormalizationGain(const SongMetadata& metadata) const {
+    if (metadata.integratedLufs <= -70.0) {
+        return 0.0f; // Silence; nothing to match
+    }
+    
+    float target = settingsManager_->getAudioSettings().targetLoudness;
+    float gain = target - static_cast<float>(metadata.integratedLufs);
+    
+    // Quiet masters are only lifted as far as their peaks allow
+    gain = std::min(gain, kMaxTruePeakDb - static_cast<float>(metadata.truePeakDb));
+    return std::min(gain, kMaxNormalizationBoostDb);
+}
+
 void Application::Play() {
     if (playbackState_ == PlaybackState::PLAYING) {
         return;
@@ -412,6 +701,7 @@ void Application::Seek(uint32_t timeMs) {
     audioManager_->Seek(timeMs);
     syncManager_->Seek(timeMs);
     lystrInterpreter_->Seek(timeMs);
+    karaokeDisplay_->SetLyricElements(lystrInterpreter_->Animate(timeMs));
 }
 
 void Application::SetTempo(float multiplier) {
@@ -419,6 +709,14 @@ void Application::SetTempo(float multiplier) {
     audioManager_->SetTempo(multiplier);
 }
 
+void Application::SetPitchShift(float semitones) {
+    audioManager_->SetPitchShift(semitones);
+}
+
+void Application::SetVocalReduction(VocalRemover::Mode mode, float strength) {
+    audioManager_->SetVocalReduction(mode, strength);
+}
+
 uint32_t Application::GetCurrentTimeMs() const {
     return audioManager_->GetCurrentTimeMs();
 }
@@ -444,10 +742,7 @@ void Application::OnEvent(const AppEvent& event) {
             karaokeDisplay_->SetLyric(event.data);
             break;
         case EventType::NOTE_DETECTED:
-            if (event.userData) {
-                auto* result = static_cast<PitchDetectionResult*>(event.userData);
-                karaokeDisplay_->UpdatePitchAccuracy(result->confidence);
-            }
+            karaokeDisplay_->UpdatePitchAccuracy(noteTracker_->GetCurrentStability());
             break;
         case EventType::ERROR_OCCURRED:
             std::cerr << "Error: " << event.data << std::endl;
@@ -472,6 +767,9 @@ void Application::SetWindowSize(int width, int height) {
     if (window_) {
         window_->Resize(width, height);
     }
+    if (lystrParser_) {
+        lystrParser_->SetScreenSize(width, height);
+    }
 }
 
 void Application::SetVolume(float volume) {
@@ -485,6 +783,63 @@ void Application::SetPitchDetectionEnabled(bool enabled) {
     pitchDetectionEnabled_ = enabled;
 }
 
+void Application::OpenMicrophone() {
+    int bufferFrames = settingsManager_->getAudioSettings().inputBufferSize;
+    micBufferFrames_ = 0;
+    measuringLatency_ = false;
+    if (audioManager_->OpenMicrophone("", bufferFrames)) {
+        micBufferFrames_ = bufferFrames;
+        noteDetector_->SetInputSampleRate(audioManager_->GetMicSampleRate());
+    }
+}
+
+void Application::MeasureLatency() {
+    if (measuringLatency_) {
+        return;
+    }
+    if (playbackState_ == PlaybackState::PLAYING) {
+        std::cout << "Stop playback before measuring latency" << std::endl;
+        return;
+    }
+    
+    // Clicks through the speakers, so the mic has to be able to hear them
+    if (audioManager_->StartLatencyProbe()) {
+        measuringLatency_ = true;
+        std::cout << "Measuring mic latency..." << std::endl;
+    }
+}
+
+void Application::UpdateLatencyReport() {
+    if (!measuringLatency_ || !audioManager_->IsLatencyProbeFinished()) {
+        return;
+    }
+    measuringLatency_ = false;
+    
+    int bufferFrames = audioManager_->GetMicBufferFrames();
+    int sampleRate = audioManager_->GetMicSampleRate();
+    std::cout << "Mic latency report" << std::endl;
+    std::cout << "  Capture period: " << bufferFrames << " frames ("
+              << bufferFrames * 1000.0f / sampleRate << " ms)" << std::endl;
+    
+    LatencyProbe::Result result = audioManager_->GetLatencyProbeResult();
+    if (result.detected > 0) {
+        std::cout << "  Round trip: " << result.roundTripMs << " ms (" << result.minMs << " - " << result.maxMs
+                  << " ms, " << result.detected << "/" << result.emitted << " clicks heard)" << std::endl;
+    } else {
+        std::cout << "  Round trip: no clicks heard - check the mic can hear the speakers" << std::endl;
+    }
+    
+    if (pitchLatencyCount_ > 0) {
+        std::cout << "  Input to pitch result: " << pitchLatencySumMs_ / pitchLatencyCount_ << " ms average, "
+                  << pitchLatencyMaxMs_ << " ms worst over " << pitchLatencyCount_ << " results" << std::endl;
+    } else {
+        std::cout << "  Input to pitch result: nothing detected since the last report" << std::endl;
+    }
+    pitchLatencySumMs_ = 0.0;
+    pitchLatencyMaxMs_ = 0.0;
+    pitchLatencyCount_ = 0;
+}
+
 void Application::InitializeSettings() {
     settingsManager_ = &SettingsManager::getInstance();
     settingsManager_->loadSettings();
@@ -507,6 +862,13 @@ void Application::OnSettingsChanged(const std::string& setting) {
     if (setting == "audio" || setting == "all") {
         auto& audioSettings = settingsManager_->getAudioSettings();
         SetVolume(audioSettings.masterVolume);
+        // The detector keeps the device's actual mic rate, which OpenMicrophone sets
+        if (audioManager_ && micBufferFrames_ != 0 && audioSettings.inputBufferSize != micBufferFrames_) {
+            OpenMicrophone();
+        }
+        if (audioManager_ && !currentAudioFile_.empty()) {
+            ApplyTrackLoudness(currentAudioFile_);
+        }
     }
     
     if (setting == "ui" || setting == "all") {
@@ -521,6 +883,9 @@ void Application::OnSettingsChanged(const std::string& setting) {
         if (songBrowser_) {
             songBrowser_->RefreshSongList();
         }
+        if (loudnessScanner_) {
+            ScanLibraryLoudness();
+        }
     }
     
     if (setting == "equalizer" || setting == "all") {
@@ -529,7 +894,23 @@ void Application::OnSettingsChanged(const std::string& setting) {
             equalizer_->SetBandCount(audioSettings.equalizerBandCount);
             equalizer_->EnableEqualizer(audioSettings.enableEqualizer);
         }
+        ApplyEqualizerSettings();
+    }
+}
+
+void Application::ApplyEqualizerSettings() {
+    if (!audioManager_ || !settingsManager_) {
+        return;
+    }
+    
+    const auto& audioSettings = settingsManager_->getAudioSettings();
+    const auto& bands = audioSettings.equalizerBands;
+    
+    audioManager_->SetEqualizerBandCount(static_cast<int>(bands.size()));
+    for (size_t i = 0; i < bands.size(); ++i) {
+        audioManager_->SetEqualizerBand(static_cast<int>(i), bands[i].frequency, bands[i].gain, bands[i].enabled);
     }
+    audioManager_->EnableEqualizer(audioSettings.enableEqualizer);
 }
 
 void Application::ProcessKeyboardInput(const SDL_Event& event) {
@@ -577,6 +958,8 @@ void Application::HandleKeyBinding(const std::string& action) {
     } else if (action == "seek_backward") {
         uint32_t currentTime = GetCurrentTimeMs();
         Seek(currentTime > 5000 ? currentTime - 5000 : 0); // 5 seconds backward
+    } else if (action == "measure_latency") {
+        MeasureLatency();
     }
 }
 
@@ -1,9 +1,15 @@
 #pragma once
 #include <SDL.h>
 #include "common/Types.h"
+#include "ai/NoteDetector.h"
+#include "audio/VocalRemover.h"
+#include "scripting/LystrInterpreter.h"
 #include <memory>
 #include <functional>
+#include <future>
 #include <queue>
+#include <string>
+#include <vector>
 
 // Forward declarations
 struct SDL_Window;
@@ -17,7 +23,7 @@ namespace Lyricstator {
 
 class AudioManager;
 class MidiParser;
-class NoteDetector;
+class NoteTracker;
 class LystrParser;
 class LystrInterpreter;
 class Window;
@@ -32,6 +38,9 @@ class FormatExporter;
 class ErrorHandler;
 class AssetManager;
 class SettingsManager; // Added SettingsManager forward declaration
+class SongMetadataCache;
+class LoudnessScanner;
+struct SongMetadata;
 
 class Application {
 public:
@@ -47,6 +56,14 @@ public:
     bool LoadAudioFile(const std::string& filepath);
     bool LoadMidiFile(const std::string& filepath);
     bool LoadLyricScript(const std::string& filepath);
+    // An edit to the loaded script from the lyric editor (see
+    // LystrParser::ApplyEdit); playback carries on with the new version
+    bool EditLyricScript(size_t position, size_t removed, const std::string& text);
+    
+    // Prepare the next song (audio, MIDI, lyric script) in the background
+    // while the current one plays; it takes over when the current audio ends
+    bool QueueSong(const std::string& audioFile, const std::string& midiFile = "",
+                   const std::string& lyricScript = "", uint32_t crossfadeMs = 0);
     
     // Playback control
     void Play();
@@ -54,6 +71,8 @@ public:
     void Stop();
     void Seek(uint32_t timeMs);
     void SetTempo(float multiplier);
+    void SetPitchShift(float semitones);
+    void SetVocalReduction(VocalRemover::Mode mode, float strength = 1.0f);
     
     // Export functionality
     bool ExportProject(const std::string& filepath, ExportFormat format);
@@ -71,6 +90,10 @@ public:
     void SetVolume(float volume);
     void SetPitchDetectionEnabled(bool enabled);
     
+    // Loopback mic latency measurement; the report goes to the console
+    // together with the input-to-pitch-result latency seen since the last one
+    void MeasureLatency();
+    
     void HandleKeyBinding(const std::string& action);
     
 private:
@@ -79,6 +102,7 @@ private:
     std::unique_ptr<AudioManager> audioManager_;
     std::unique_ptr<MidiParser> midiParser_;
     std::unique_ptr<NoteDetector> noteDetector_;
+    std::unique_ptr<NoteTracker> noteTracker_;
     std::unique_ptr<LystrParser> lystrParser_;
     std::unique_ptr<LystrInterpreter> lystrInterpreter_;
     std::unique_ptr<Window> window_;
@@ -91,6 +115,8 @@ private:
     std::unique_ptr<SynchronizationManager> syncManager_;
     std::unique_ptr<FormatExporter> formatExporter_;
     std::unique_ptr<ErrorHandler> errorHandler_;
+    std::unique_ptr<SongMetadataCache> songMetadata_;
+    std::unique_ptr<LoudnessScanner> loudnessScanner_;
     
     std::unique_ptr<tgui::Gui> gui_;
     
@@ -103,6 +129,8 @@ private:
     std::string currentAudioFile_;
     std::string currentMidiFile_;
     std::string currentLyricScript_;
+    std::string queuedAudioFile_;
+    bool lyricScriptParsed_;            // lystrParser_ holds the current script (parsed on its first edit)
     
     // Event system
     std::queue<AppEvent> eventQueue_;
@@ -114,6 +142,26 @@ private:
     float volume_;
     float tempoMultiplier_;
     bool pitchDetectionEnabled_;
+    NoteDetector::ResultCursor detectionCursor_;
+    std::vector<float> micBuffer_;
+    int micBufferFrames_;
+    
+    // Input-to-pitch-result latency: age of the newest mic sample when a
+    // detection result is picked up
+    bool measuringLatency_;
+    double pitchLatencySumMs_;
+    double pitchLatencyMaxMs_;
+    uint32_t pitchLatencyCount_;
+    
+    // Parsed companions of the queued song
+    struct PreparedSong {
+        std::unique_ptr<MidiParser> midiParser;
+        LystrTimeline timeline;
+        std::vector<LystrInterpreter::Keyframe> keyframes;
+        std::string midiFile;
+        std::string lyricScript;
+    };
+    std::future<PreparedSong> preparedSong_;
     
     // Internal methods
     bool InitializeSDL();
@@ -124,6 +172,17 @@ private:
     
     void InitializeSettings();
     void OnSettingsChanged(const std::string& setting);
+    void ApplyEqualizerSettings();
+    void OnQueuedSongStarted(const std::string& audioFile);
+    
+    // Loudness normalisation
+    void ScanLibraryLoudness();
+    void ApplyTrackLoudness(const std::string& audioFile);
+    void UpdateLoudnessScan();
+    float ComputeNormalizationGain(const SongMetadata& metadata) const;
+    
+    void OpenMicrophone();
+    void UpdateLatencyReport();
     void ProcessKeyboardInput(const SDL_Event& event);
     
     // Timing
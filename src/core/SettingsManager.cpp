@@ -41,6 +41,9 @@ bool SettingsManager::loadSettings(const std::string& filepath) {
             audioSettings_.bufferSize = audio.get("bufferSize", 1024).asInt();
             audioSettings_.enableEqualizer = audio.get("enableEqualizer", true).asBool();
             audioSettings_.equalizerBandCount = audio.get("equalizerBandCount", 12).asInt();
+            audioSettings_.normalizeLoudness = audio.get("normalizeLoudness", true).asBool();
+            audioSettings_.targetLoudness = audio.get("targetLoudness", -18.0f).asFloat();
+            audioSettings_.inputBufferSize = audio.get("inputBufferSize", 256).asInt();
             
             // Load equalizer bands
             if (audio.isMember("equalizerBands")) {
@@ -140,6 +143,9 @@ bool SettingsManager::saveSettings(const std::string& filepath) const {
         audio["bufferSize"] = audioSettings_.bufferSize;
         audio["enableEqualizer"] = audioSettings_.enableEqualizer;
         audio["equalizerBandCount"] = audioSettings_.equalizerBandCount;
+        audio["normalizeLoudness"] = audioSettings_.normalizeLoudness;
+        audio["targetLoudness"] = audioSettings_.targetLoudness;
+        audio["inputBufferSize"] = audioSettings_.inputBufferSize;
         
         // Save equalizer bands
         Json::Value bands(Json::arrayValue);
@@ -234,6 +240,9 @@ void SettingsManager::initializeDefaults() {
     audioSettings_.bufferSize = 1024;
     audioSettings_.enableEqualizer = true;
     audioSettings_.equalizerBandCount = 12;
+    audioSettings_.normalizeLoudness = true;
+    audioSettings_.targetLoudness = -18.0f;
+    audioSettings_.inputBufferSize = 256;
     initializeDefaultEqualizer(12);
     
     // Initialize default directory settings
@@ -279,6 +288,7 @@ void SettingsManager::initializeDefaultKeyBindings() {
     keyBindings_.push_back({SDL_SCANCODE_UP, false, false, false, "volume_up", "Volume Up"});
     keyBindings_.push_back({SDL_SCANCODE_DOWN, false, false, false, "volume_down", "Volume Down"});
     keyBindings_.push_back({SDL_SCANCODE_F11, false, false, false, "toggle_fullscreen", "Toggle Fullscreen"});
+    keyBindings_.push_back({SDL_SCANCODE_L, true, false, false, "measure_latency", "Measure Mic Latency"});
 }
 
 void SettingsManager::initializeDefaultEqualizer(int bandCount) {
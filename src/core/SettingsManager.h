@@ -29,6 +29,9 @@ struct AudioSettings {
     int bufferSize = 1024;
     bool enableEqualizer = true;
     int equalizerBandCount = 12; // Default to 12-band
+    bool normalizeLoudness = true;
+    float targetLoudness = -18.0f; // LUFS
+    int inputBufferSize = 256; // Mic capture period in frames, 64 - 4096
 };
 
 struct DirectorySettings {
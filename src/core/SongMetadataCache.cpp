@@ -0,0 +1,151 @@
+#include "core/SongMetadataCache.h"
+#include <json/json.h>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+namespace Lyricstator {
+
+namespace {
+const int kCacheVersion = 1;
+}
+
+SongMetadataCache::SongMetadataCache()
+    : dirty_(false)
+{
+}
+
+bool SongMetadataCache::Load(const std::string& filepath) {
+    cacheFilePath_ = filepath;
+    entries_.clear();
+    dirty_ = false;
+    
+    if (!std::filesystem::exists(cacheFilePath_)) {
+        return true;
+    }
+    
+    try {
+        std::ifstream file(cacheFilePath_);
+        if (!file.is_open()) {
+            std::cerr << "Cannot open song metadata cache: " << cacheFilePath_ << std::endl;
+            return false;
+        }
+        
+        Json::Value root;
+        file >> root;
+        
+        // An older layout is simply rebuilt
+        if (root.get("version", 0).asInt() != kCacheVersion) {
+            return true;
+        }
+        
+        const Json::Value& songs = root["songs"];
+        for (const auto& path : songs.getMemberNames()) {
+            const Json::Value& song = songs[path];
+            SongMetadata metadata;
+            metadata.fileSize = song.get("fileSize", 0).asUInt64();
+            metadata.modifiedTime = song.get("modifiedTime", 0).asInt64();
+            metadata.integratedLufs = song.get("integratedLufs", 0.0).asDouble();
+            metadata.truePeakDb = song.get("truePeakDb", 0.0).asDouble();
+            entries_[path] = metadata;
+        }
+        
+        std::cout << "Loaded metadata for " << entries_.size() << " songs" << std::endl;
+        return true;
+        
+    } catch (const std::exception& e) {
+        std::cerr << "Failed to load song metadata cache: " << e.what() << std::endl;
+        entries_.clear();
+        return false;
+    }
+}
+
+bool SongMetadataCache::Save() {
+    if (!dirty_ || cacheFilePath_.empty()) {
+        return true;
+    }
+    
+    try {
+        Json::Value root;
+        root["version"] = kCacheVersion;
+        
+        Json::Value songs(Json::objectValue);
+        for (const auto& entry : entries_) {
+            Json::Value song;
+            song["fileSize"] = static_cast<Json::UInt64>(entry.second.fileSize);
+            song["modifiedTime"] = static_cast<Json::Int64>(entry.second.modifiedTime);
+            song["integratedLufs"] = entry.second.integratedLufs;
+            song["truePeakDb"] = entry.second.truePeakDb;
+            songs[entry.first] = song;
+        }
+        root["songs"] = songs;
+        
+        std::filesystem::path parent = std::filesystem::path(cacheFilePath_).parent_path();
+        if (!parent.empty()) {
+            std::filesystem::create_directories(parent);
+        }
+        
+        std::ofstream file(cacheFilePath_);
+        if (!file.is_open()) {
+            std::cerr << "Cannot create song metadata cache: " << cacheFilePath_ << std::endl;
+            return false;
+        }
+        
+        file << root;
+        dirty_ = false;
+        return true;
+        
+    } catch (const std::exception& e) {
+        std::cerr << "Failed to save song metadata cache: " << e.what() << std::endl;
+        return false;
+    }
+}
+
+bool SongMetadataCache::Lookup(const std::string& songPath, SongMetadata& metadata) const {
+    auto entry = entries_.find(songPath);
+    if (entry == entries_.end()) {
+        return false;
+    }
+    
+    uint64_t size = 0;
+    int64_t modifiedTime = 0;
+    if (!GetFileStamp(songPath, size, modifiedTime) ||
+        size != entry->second.fileSize || modifiedTime != entry->second.modifiedTime) {
+        return false;
+    }
+    
+    metadata = entry->second;
+    return true;
+}
+
+bool SongMetadataCache::Contains(const std::string& songPath) const {
+    SongMetadata metadata;
+    return Lookup(songPath, metadata);
+}
+
+bool SongMetadataCache::Store(const std::string& songPath, SongMetadata metadata) {
+    if (!GetFileStamp(songPath, metadata.fileSize, metadata.modifiedTime)) {
+        return false;
+    }
+    
+    entries_[songPath] = metadata;
+    dirty_ = true;
+    return true;
+}
+
+bool SongMetadataCache::GetFileStamp(const std::string& songPath, uint64_t& size, int64_t& modifiedTime) {
+    std::error_code error;
+    size = std::filesystem::file_size(songPath, error);
+    if (error) {
+        return false;
+    }
+    
+    auto time = std::filesystem::last_write_time(songPath, error);
+    if (error) {
+        return false;
+    }
+    modifiedTime = static_cast<int64_t>(time.time_since_epoch().count());
+    return true;
+}
+
+} // namespace Lyricstator
@@ -0,0 +1,43 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+
+namespace Lyricstator {
+
+// Per-song facts that are expensive to work out (decoding the whole file)
+// and don't change unless the file does.
+struct SongMetadata {
+    uint64_t fileSize = 0;
+    int64_t modifiedTime = 0;           // Filesystem clock ticks, only compared for equality
+    double integratedLufs = 0.0;
+    double truePeakDb = 0.0;
+};
+
+// JSON-backed cache of SongMetadata keyed by file path. An entry only counts
+// while the file's size and modification time still match, so an edited or
+// replaced file is analysed again. Main thread only.
+class SongMetadataCache {
+public:
+    SongMetadataCache();
+    
+    bool Load(const std::string& filepath);
+    bool Save();                        // No-op when nothing changed
+    
+    bool Lookup(const std::string& songPath, SongMetadata& metadata) const;
+    bool Contains(const std::string& songPath) const;
+    
+    // Stamps the entry with the file's current size and time
+    bool Store(const std::string& songPath, SongMetadata metadata);
+    
+    size_t GetEntryCount() const { return entries_.size(); }
+
+private:
+    std::string cacheFilePath_;
+    std::unordered_map<std::string, SongMetadata> entries_;
+    bool dirty_;
+    
+    static bool GetFileStamp(const std::string& songPath, uint64_t& size, int64_t& modifiedTime);
+};
+
+} // namespace Lyricstator
@@ -1,6 +1,7 @@
 #include "TGUIEqualizer.h"
 #include "core/SettingsManager.h"
 #include "utils/ErrorHandler.h"
+#include "audio/SpectrumAnalyzer.h"
 #include <cmath>
 #include <algorithm>
 #include <sstream>
@@ -19,6 +20,7 @@ TGUIEqualizer::TGUIEqualizer()
 {
     spectrumData_.resize(64, 0.0f);
     smoothedSpectrum_.resize(64, 0.0f);
+    spectrumPeaks_.resize(64, 0.0f);
 }
 
 TGUIEqualizer::~TGUIEqualizer() {
@@ -356,13 +358,16 @@ void TGUIEqualizer::EnableEqualizer(bool enable) {
     }
 }
 
-void TGUIEqualizer::UpdateSpectrum(const std::vector<float>& spectrumData) {
-    if (spectrumData.size() != spectrumData_.size()) {
-        spectrumData_.resize(spectrumData.size());
-        smoothedSpectrum_.resize(spectrumData.size());
+void TGUIEqualizer::UpdateSpectrum(const SpectrumFrame& frame) {
+    size_t bands = static_cast<size_t>(frame.bandCount);
+    if (bands != spectrumData_.size()) {
+        spectrumData_.resize(bands);
+        smoothedSpectrum_.resize(bands, 0.0f);
+        spectrumPeaks_.resize(bands);
     }
     
-    spectrumData_ = spectrumData;
+    std::copy(frame.levels, frame.levels + bands, spectrumData_.begin());
+    std::copy(frame.peaks, frame.peaks + bands, spectrumPeaks_.begin());
 }
 
 void TGUIEqualizer::Update(float deltaTime) {
@@ -500,6 +505,15 @@ void TGUIEqualizer::RenderSpectrum() {
         bar.setSize(sf::Vector2f(barWidth - 1, barHeight));
         bar.setFillColor(sf::Color(barColor.getRed(), barColor.getGreen(), barColor.getBlue(), barColor.getAlpha()));
         spectrumCanvas_->draw(bar);
+        
+        // Peak-hold marker
+        if (i < spectrumPeaks_.size() && spectrumPeaks_[i] > 0.0f) {
+            sf::RectangleShape peak;
+            peak.setPosition(x, height - spectrumPeaks_[i] * height * 0.8f);
+            peak.setSize(sf::Vector2f(barWidth - 1, 2.0f));
+            peak.setFillColor(sf::Color(230, 235, 245, 200));
+            spectrumCanvas_->draw(peak);
+        }
     }
     
     spectrumCanvas_->display();
@@ -509,8 +523,14 @@ void TGUIEqualizer::SmoothSpectrum(float deltaTime) {
     const float smoothingFactor = 8.0f * deltaTime;
     
     for (size_t i = 0; i < spectrumData_.size(); ++i) {
+        // The analyzer already shapes the fall; only ease the way down
+        // between its frames and let transients through at once
         float target = spectrumData_[i];
-        smoothedSpectrum_[i] += (target - smoothedSpectrum_[i]) * smoothingFactor;
+        if (target >= smoothedSpectrum_[i]) {
+            smoothedSpectrum_[i] = target;
+        } else {
+            smoothedSpectrum_[i] += (target - smoothedSpectrum_[i]) * smoothingFactor;
+        }
         
         // Ensure values stay in valid range
         smoothedSpectrum_[i] = std::max(0.0f, std::min(1.0f, smoothedSpectrum_[i]));
@@ -7,6 +7,7 @@
 namespace Lyricstator {
 
 struct EqualizerBand;
+struct SpectrumFrame;
 
 class TGUIEqualizer {
 public:
@@ -37,7 +38,7 @@ public:
     std::vector<std::string> GetAvailablePresets() const;
     
     // Spectrum visualization
-    void UpdateSpectrum(const std::vector<float>& spectrumData);
+    void UpdateSpectrum(const SpectrumFrame& frame);
     void SetSpectrumVisible(bool visible) { showSpectrum_ = visible; }
     
     // Callbacks
@@ -84,6 +85,7 @@ private:
     tgui::Canvas::Ptr spectrumCanvas_;
     std::vector<float> spectrumData_;
     std::vector<float> smoothedSpectrum_;
+    std::vector<float> spectrumPeaks_;
     
     // Animation and styling
     float slideAnimation_;
@@ -101,6 +101,39 @@ void TGUIKaraokeDisplay::UpdatePitch(float frequency, float confidence) {
     pitchBar_->setValue(static_cast<unsigned int>(targetValue));
 }
 
+void TGUIKaraokeDisplay::SetLyricElements(const std::vector<LystrElementState>& elements) {
+    while (elementLabels_.size() < elements.size()) {
+        tgui::Label::Ptr label = tgui::Label::create();
+        label->setTextSize(48);
+        label->setOrigin(0.5f, 0.5f);   // Script positions are the text's center
+        mainPanel_->add(label);
+        elementLabels_.push_back(label);
+    }
+    
+    for (size_t i = 0; i < elementLabels_.size(); ++i) {
+        tgui::Label::Ptr& label = elementLabels_[i];
+        if (i >= elements.size()) {
+            label->setVisible(false);
+            continue;
+        }
+        
+        const LystrElementState& element = elements[i];
+        tgui::String text(std::string(element.text));
+        if (label->getText() != text) {
+            label->setText(text);
+        }
+        label->setPosition(element.x, element.y);
+        label->setVisible(true);
+        
+        // Glow is drawn as a soft outline in the text's own color
+        const Color& color = element.color;
+        label->getRenderer()->setTextColor(tgui::Color(color.r, color.g, color.b, color.a));
+        label->getRenderer()->setTextOutlineColor(tgui::Color(color.r, color.g, color.b,
+                                                              static_cast<tgui::Uint8>(color.a * element.glow * 0.6f)));
+        label->getRenderer()->setTextOutlineThickness(element.glow * 4.0f);
+    }
+}
+
 void TGUIKaraokeDisplay::UpdateAnimations(float deltaTime) {
     float pulseIntensity = 0.8f + 0.2f * std::sin(animationTime_ * 2.0f);
     tgui::Color bgColor = tgui::Color(
@@ -146,6 +179,7 @@ void TGUIKaraokeDisplay::ApplyTheme(const std::string& themeName) {
 void TGUIKaraokeDisplay::Shutdown() {
     if (mainPanel_) {
         mainPanel_->removeAllWidgets();
+        elementLabels_.clear();
         mainPanel_ = nullptr;
     }
 }
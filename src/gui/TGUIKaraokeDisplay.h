@@ -1,9 +1,11 @@
 #pragma once
 
 #include "common/Types.h"
+#include "scripting/LystrAnimator.h"
 #include <TGUI/TGUI.hpp>
 #include <string>
 #include <memory>
+#include <vector>
 
 namespace Lyricstator {
 
@@ -29,6 +31,9 @@ public:
     void HighlightLyric(float progress); // 0.0 to 1.0
     void UpdatePitch(float frequency, float confidence);
     
+    // The script's lyrics this frame, one label each
+    void SetLyricElements(const std::vector<LystrElementState>& elements);
+    
     // Theme support - easy to customize
     void ApplyTheme(const std::string& themeName);
     void SetColors(const Color& primary, const Color& accent, const Color& highlight);
@@ -39,6 +44,7 @@ private:
     tgui::Label::Ptr lyricLabel_;
     tgui::ProgressBar::Ptr pitchBar_;
     tgui::Panel::Ptr visualizerPanel_;
+    std::vector<tgui::Label::Ptr> elementLabels_;   // Grows to the most lyrics shown at once
     
     // Simple state management
     std::string currentLyric_;
@@ -1,4 +1,5 @@
 #include "QtEqualizer.h"
+#include "audio/QtAudioManager.h"
 #include <QApplication>
 #include <QScreen>
 #include <QMessageBox>
@@ -60,6 +61,7 @@ QtEqualizer::QtEqualizer(QWidget *parent)
     // Initialize spectrum data
     spectrumData_.resize(64, 0.0f);
     smoothedSpectrum_.resize(64, 0.0f);
+    spectrumPeaks_.resize(64, 0.0f);
     
     // Initialize settings
     settings_ = new QSettings("Lyricstator", "Equalizer", this);
@@ -248,13 +250,23 @@ QStringList QtEqualizer::getAvailablePresets() const
     return presets_.keys();
 }
 
-void QtEqualizer::updateSpectrumData(const QVector<float>& spectrumData)
+void QtEqualizer::updateSpectrumData(const Lyricstator::SpectrumFrame& frame)
 {
-    if (spectrumData.size() == spectrumData_.size()) {
-        spectrumData_ = spectrumData;
-        
-        // Smooth the spectrum data
-        for (int i = 0; i < smoothedSpectrum_.size(); ++i) {
+    if (frame.bandCount != static_cast<int>(spectrumData_.size())) {
+        spectrumData_.resize(frame.bandCount);
+        smoothedSpectrum_.resize(frame.bandCount);
+        spectrumPeaks_.resize(frame.bandCount);
+    }
+    
+    std::copy(frame.levels, frame.levels + frame.bandCount, spectrumData_.begin());
+    std::copy(frame.peaks, frame.peaks + frame.bandCount, spectrumPeaks_.begin());
+    
+    // The analyzer already shapes the fall; only ease the way down between
+    // its frames and let transients through at once
+    for (int i = 0; i < smoothedSpectrum_.size(); ++i) {
+        if (spectrumData_[i] >= smoothedSpectrum_[i]) {
+            smoothedSpectrum_[i] = spectrumData_[i];
+        } else {
             smoothedSpectrum_[i] = smoothedSpectrum_[i] * 0.7f + spectrumData_[i] * 0.3f;
         }
     }
@@ -756,11 +768,11 @@ void QtEqualizer::updateBandColors()
 
 void QtEqualizer::updateSpectrumData()
 {
-    // This would typically get real-time spectrum data from the audio engine
-    if (application_ && equalizerEnabled_) {
-        // TODO: Get spectrum data from application
-        // QVector<float> newSpectrum = application_->getAudioSpectrum();
-        // updateSpectrumData(newSpectrum);
+    // Latest frame from the audio engine's analysis thread
+    if (equalizerEnabled_) {
+        if (const Lyricstator::SpectrumFrame* frame = Lyricstator::QtAudioManager::getInstance().getSpectrum()) {
+            updateSpectrumData(*frame);
+        }
     }
 }
 
@@ -816,6 +828,12 @@ void QtEqualizer::paintEvent(QPaintEvent* event)
             
             QRect barRect(i * barWidth, barHeight - height, barWidth, height);
             painter.fillRect(barRect, barColor);
+            
+            // Peak-hold marker
+            if (i < spectrumPeaks_.size() && spectrumPeaks_[i] > 0.0f) {
+                int peakY = barHeight - (int)(spectrumPeaks_[i] * barHeight);
+                painter.fillRect(QRect(i * barWidth, peakY, barWidth, 2), QColor(230, 235, 245, 200));
+            }
         }
     }
 }
@@ -898,6 +916,7 @@ void QtEqualizer::updateAnimation()
 void QtEqualizer::updateSpectrumVisualization()
 {
     if (spectrumCanvas_ && equalizerEnabled_) {
+        updateSpectrumData();
         spectrumCanvas_->update();
     }
 }
@@ -26,6 +26,7 @@
 #include <cmath>
 
 #include "core/Application.h"
+#include "audio/SpectrumAnalyzer.h"
 
 struct EqualizerBand {
     int index;
@@ -61,7 +62,7 @@ public:
     void savePreset(const QString& presetName, const QString& description = "");
     void deletePreset(const QString& presetName);
     QStringList getAvailablePresets() const;
-    void updateSpectrumData(const QVector<float>& spectrumData);
+    void updateSpectrumData(const Lyricstator::SpectrumFrame& frame);
 
 public slots:
     void show();
@@ -122,6 +123,7 @@ private:
     QFrame* spectrumCanvas_;
     QVector<float> spectrumData_;
     QVector<float> smoothedSpectrum_;
+    QVector<float> spectrumPeaks_;
     QTimer* spectrumUpdateTimer_;
     
     // Band controls
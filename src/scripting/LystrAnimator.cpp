@@ -0,0 +1,348 @@
+#include "scripting/LystrAnimator.h"
+#include <algorithm>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define LYRICSTATOR_ANIMATOR_SSE 1
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define LYRICSTATOR_ANIMATOR_NEON 1
+#endif
+
+namespace Lyricstator {
+
+namespace {
+const uint32_t kDefaultAnimationMs = 500;   // animate() without a duration
+const float kSlideDistance = 200.0f;        // Pixels a slide_* comes in from
+const uint32_t kPulsePeriodMs = 500;
+const uint32_t kMaxPulses = 32;             // Longer pulses just slow down
+const size_t kKeySlack = 256;
+
+const char* const kAnimationNames[] = {
+    "glow", "pulse", "slide_left", "slide_right", "slide_up", "slide_down", "zoom_in"
+};
+
+// Saturating, so a long duration can't wrap round to the start
+uint32_t After(uint32_t timeMs, uint32_t durationMs) {
+    return static_cast<uint32_t>(std::min<uint64_t>(static_cast<uint64_t>(timeMs) + durationMs, UINT32_MAX - 1));
+}
+
+uint8_t ToChannel(float value) {
+    return static_cast<uint8_t>(std::clamp(value, 0.0f, 255.0f) + 0.5f);
+}
+}
+
+LystrAnimator::LystrAnimator(bool curves) : curves_(curves), lastDisplay_(SIZE_MAX) {
+}
+
+void LystrAnimator::Reset(const Color& color, const Position& position) {
+    elements_.clear();
+    keyTimes_.clear();
+    keyValues_.clear();
+    lastDisplay_ = SIZE_MAX;
+    color_ = color;
+    position_ = position;
+}
+
+LystrAnimator::Element* LystrAnimator::GetCurrent(uint32_t timeMs) {
+    if (elements_.empty() || elements_.back().source != lastDisplay_ || elements_.back().endMs <= timeMs) {
+        return nullptr;
+    }
+    return &elements_.back();
+}
+
+void LystrAnimator::Apply(const LystrTimeline& timeline, size_t index) {
+    const LystrInstruction& instruction = timeline.GetInstructions()[index];
+    const uint32_t time = instruction.time;
+    Element* current = GetCurrent(time);
+    Vec4 value;
+    
+    switch (instruction.op) {
+        case LystrOpcode::DISPLAY_LYRIC: {
+            if (current && current->endMs == kOpenEnd) {
+                current->endMs = time;
+            }
+            Element element;
+            element.source = index;
+            element.text = instruction.a;
+            element.startMs = time;
+            element.endMs = instruction.b > 0 ? After(time, instruction.b) : kOpenEnd;
+            for (Track& track : element.tracks) {
+                track = Track{static_cast<uint32_t>(keyTimes_.size()), 0, 0};
+            }
+            elements_.push_back(element);
+            lastDisplay_ = index;
+            if (!curves_) {
+                break;
+            }
+            Track* tracks = elements_.back().tracks;
+            PushKey(tracks[static_cast<size_t>(LystrProperty::ALPHA)], time, Vec4{{1.0f, 0.0f, 0.0f, 0.0f}});
+            PushKey(tracks[static_cast<size_t>(LystrProperty::COLOR)], time,
+                    Vec4{{float(color_.r), float(color_.g), float(color_.b), float(color_.a)}});
+            PushKey(tracks[static_cast<size_t>(LystrProperty::POSITION)], time,
+                    Vec4{{float(position_.x), float(position_.y), 0.0f, 0.0f}});
+            PushKey(tracks[static_cast<size_t>(LystrProperty::GLOW)], time, Vec4{{0.0f, 0.0f, 0.0f, 0.0f}});
+            break;
+        }
+        case LystrOpcode::SET_COLOR:
+            // Only lyrics displayed from here on; the ones on screen keep theirs
+            color_ = LystrTimeline::UnpackColor(instruction.a);
+            break;
+        case LystrOpcode::SET_POSITION:
+            position_ = Position(instruction.GetSignedA(), instruction.GetSignedB());
+            break;
+        case LystrOpcode::FADE_IN:
+            if (current && curves_) {
+                Track& track = current->tracks[static_cast<size_t>(LystrProperty::ALPHA)];
+                HoldAt(track, time, value);
+                PushKey(track, time, Vec4{{0.0f, 0.0f, 0.0f, 0.0f}});
+                PushKey(track, After(time, instruction.a), Vec4{{1.0f, 0.0f, 0.0f, 0.0f}});
+            }
+            break;
+        case LystrOpcode::FADE_OUT:
+            if (current) {
+                // Timed to end with the lyric if it has a duration and there's
+                // room, otherwise from now, keeping the lyric up until it's done
+                uint32_t start = time;
+                if (current->endMs != kOpenEnd && current->endMs - time > instruction.a) {
+                    start = current->endMs - instruction.a;
+                }
+                current->endMs = After(start, instruction.a);
+                if (curves_) {
+                    Track& track = current->tracks[static_cast<size_t>(LystrProperty::ALPHA)];
+                    HoldAt(track, start, value);
+                    PushKey(track, current->endMs, Vec4{{0.0f, 0.0f, 0.0f, 0.0f}});
+                }
+            }
+            break;
+        case LystrOpcode::ANIMATE_TEXT:
+            if (current && curves_) {
+                Animate(*current, timeline.GetString(instruction.a), time,
+                        instruction.b > 0 ? instruction.b : kDefaultAnimationMs);
+            }
+            break;
+        case LystrOpcode::SET_TIMING:
+        case LystrOpcode::HIGHLIGHT:
+        case LystrOpcode::WAIT:
+        case LystrOpcode::BRANCH:
+            break;
+    }
+}
+
+void LystrAnimator::Animate(Element& element, std::string_view name, uint32_t timeMs, uint32_t durationMs) {
+    const uint32_t endMs = After(timeMs, durationMs);
+    Track& alpha = element.tracks[static_cast<size_t>(LystrProperty::ALPHA)];
+    Track& position = element.tracks[static_cast<size_t>(LystrProperty::POSITION)];
+    Track& glow = element.tracks[static_cast<size_t>(LystrProperty::GLOW)];
+    Vec4 value;
+    
+    if (name == "glow") {
+        HoldAt(glow, timeMs, value);
+        PushKey(glow, After(timeMs, durationMs / 2), Vec4{{1.0f, 0.0f, 0.0f, 0.0f}});
+        PushKey(glow, endMs, Vec4{{0.0f, 0.0f, 0.0f, 0.0f}});
+    } else if (name == "pulse") {
+        uint32_t period = std::max(kPulsePeriodMs, durationMs / kMaxPulses);
+        HoldAt(glow, timeMs, value);
+        for (uint64_t pulse = 0; pulse < durationMs; pulse += period) {
+            const uint32_t peak = static_cast<uint32_t>(std::min<uint64_t>(pulse + period / 2, durationMs));
+            const uint32_t trough = static_cast<uint32_t>(std::min<uint64_t>(pulse + period, durationMs));
+            PushKey(glow, After(timeMs, peak), Vec4{{1.0f, 0.0f, 0.0f, 0.0f}});
+            PushKey(glow, After(timeMs, trough), Vec4{{0.0f, 0.0f, 0.0f, 0.0f}});
+        }
+    } else if (name.compare(0, 6, "slide_") == 0) {
+        // Comes in from the opposite side, to where it is now
+        HoldAt(position, timeMs, value);
+        Vec4 from = value;
+        if (name == "slide_left") {
+            from.v[0] += kSlideDistance;
+        } else if (name == "slide_right") {
+            from.v[0] -= kSlideDistance;
+        } else if (name == "slide_up") {
+            from.v[1] += kSlideDistance;
+        } else if (name == "slide_down") {
+            from.v[1] -= kSlideDistance;
+        } else {
+            return;
+        }
+        PushKey(position, timeMs, from);
+        PushKey(position, endMs, value);
+    } else if (name == "zoom_in") {
+        // There's no scale to animate, so it comes up out of a glow instead
+        HoldAt(alpha, timeMs, value);
+        PushKey(alpha, timeMs, Vec4{{0.0f, 0.0f, 0.0f, 0.0f}});
+        PushKey(alpha, endMs, Vec4{{1.0f, 0.0f, 0.0f, 0.0f}});
+        HoldAt(glow, timeMs, value);
+        PushKey(glow, timeMs, Vec4{{1.0f, 0.0f, 0.0f, 0.0f}});
+        PushKey(glow, endMs, Vec4{{0.0f, 0.0f, 0.0f, 0.0f}});
+    }
+}
+
+bool LystrAnimator::IsKnownAnimation(std::string_view name) {
+    return std::find(std::begin(kAnimationNames), std::end(kAnimationNames), name) != std::end(kAnimationNames);
+}
+
+uint32_t LystrAnimator::GetAnimatedProperties(std::string_view name) {
+    if (!IsKnownAnimation(name)) {
+        return 0;
+    }
+    if (name == "glow" || name == "pulse") {
+        return 1u << static_cast<uint32_t>(LystrProperty::GLOW);
+    }
+    if (name == "zoom_in") {
+        return (1u << static_cast<uint32_t>(LystrProperty::ALPHA)) | (1u << static_cast<uint32_t>(LystrProperty::GLOW));
+    }
+    return 1u << static_cast<uint32_t>(LystrProperty::POSITION);
+}
+
+void LystrAnimator::PushKey(Track& track, uint32_t timeMs, const Vec4& value) {
+    // Tracks grow at the end of the pool; one that isn't there any more
+    // moves there first
+    if (track.firstKey + track.keyCount != keyTimes_.size()) {
+        const uint32_t first = static_cast<uint32_t>(keyTimes_.size());
+        for (uint32_t k = 0; k < track.keyCount; ++k) {
+            keyTimes_.push_back(keyTimes_[track.firstKey + k]);
+            keyValues_.push_back(keyValues_[track.firstKey + k]);
+        }
+        track.firstKey = first;
+    }
+    keyTimes_.push_back(timeMs);
+    keyValues_.push_back(value);
+    ++track.keyCount;
+}
+
+void LystrAnimator::HoldAt(Track& track, uint32_t timeMs, Vec4& value) {
+    // Drops the keys after `timeMs` and ends the curve on its value there,
+    // so a new movement starts from wherever the last one had got to
+    value = Sample(track, timeMs);
+    const uint32_t end = track.firstKey + track.keyCount;
+    while (track.keyCount > 0 && keyTimes_[track.firstKey + track.keyCount - 1] > timeMs) {
+        --track.keyCount;
+    }
+    if (end == keyTimes_.size()) {
+        keyTimes_.resize(track.firstKey + track.keyCount);
+        keyValues_.resize(track.firstKey + track.keyCount);
+    }
+    track.cursor = 0;
+    if (track.keyCount == 0 || keyTimes_[track.firstKey + track.keyCount - 1] < timeMs) {
+        PushKey(track, timeMs, value);
+    }
+}
+
+LystrAnimator::Blend LystrAnimator::Locate(Track& track, uint32_t timeMs) {
+    // Playback only moves forward, so this usually steps at most one key
+    const uint32_t* times = keyTimes_.data() + track.firstKey;
+    uint32_t k = track.cursor;
+    if (k >= track.keyCount || times[k] > timeMs) {
+        k = 0;
+    }
+    while (k + 1 < track.keyCount && times[k + 1] <= timeMs) {
+        ++k;
+    }
+    track.cursor = k;
+    
+    if (k + 1 >= track.keyCount || times[k] > timeMs) {
+        return Blend{track.firstKey + k, track.firstKey + k, 0.0f};
+    }
+    float fraction = static_cast<float>(timeMs - times[k]) / static_cast<float>(times[k + 1] - times[k]);
+    return Blend{track.firstKey + k, track.firstKey + k + 1, fraction};
+}
+
+LystrAnimator::Vec4 LystrAnimator::Sample(Track& track, uint32_t timeMs) {
+    Vec4 result = {};
+    if (track.keyCount == 0) {
+        return result;
+    }
+    Blend blend = Locate(track, timeMs);
+    for (int i = 0; i < 4; ++i) {
+        const float from = keyValues_[blend.from].v[i];
+        result.v[i] = from + (keyValues_[blend.to].v[i] - from) * blend.fraction;
+    }
+    return result;
+}
+
+void LystrAnimator::Prune(uint32_t timeMs) {
+    auto over = [timeMs](const Element& element) { return element.endMs <= timeMs; };
+    elements_.erase(std::remove_if(elements_.begin(), elements_.end(), over), elements_.end());
+    
+    size_t liveKeys = 0;
+    for (const Element& element : elements_) {
+        for (const Track& track : element.tracks) {
+            liveKeys += track.keyCount;
+        }
+    }
+    if (keyTimes_.size() > 2 * liveKeys + kKeySlack) {
+        CompactKeys();
+    }
+}
+
+void LystrAnimator::CompactKeys() {
+    std::vector<uint32_t> times;
+    std::vector<Vec4> values;
+    for (Element& element : elements_) {
+        for (Track& track : element.tracks) {
+            const uint32_t first = static_cast<uint32_t>(times.size());
+            times.insert(times.end(), keyTimes_.begin() + track.firstKey,
+                         keyTimes_.begin() + track.firstKey + track.keyCount);
+            values.insert(values.end(), keyValues_.begin() + track.firstKey,
+                          keyValues_.begin() + track.firstKey + track.keyCount);
+            track.firstKey = first;
+        }
+    }
+    keyTimes_.swap(times);
+    keyValues_.swap(values);
+}
+
+size_t LystrAnimator::GetOldestSource() const {
+    return elements_.empty() ? SIZE_MAX : elements_.front().source;
+}
+
+const std::vector<LystrElementState>& LystrAnimator::Evaluate(uint32_t timeMs, const LystrTimeline& timeline) {
+    Prune(timeMs);
+    
+    // Find where every curve is up to: scalar, but cheap, as the cursors
+    // only step forward during playback
+    blends_.clear();
+    for (Element& element : elements_) {
+        for (Track& track : element.tracks) {
+            blends_.push_back(Locate(track, timeMs));
+        }
+    }
+    
+    // Then blend them all in one pass, four channels at a time
+    blended_.resize(blends_.size());
+    const Vec4* values = keyValues_.data();
+    for (size_t i = 0; i < blends_.size(); ++i) {
+        const Blend& blend = blends_[i];
+#if defined(LYRICSTATOR_ANIMATOR_SSE)
+        const __m128 from = _mm_load_ps(values[blend.from].v);
+        const __m128 to = _mm_load_ps(values[blend.to].v);
+        _mm_store_ps(blended_[i].v, _mm_add_ps(from, _mm_mul_ps(_mm_sub_ps(to, from), _mm_set1_ps(blend.fraction))));
+#elif defined(LYRICSTATOR_ANIMATOR_NEON)
+        const float32x4_t from = vld1q_f32(values[blend.from].v);
+        const float32x4_t to = vld1q_f32(values[blend.to].v);
+        vst1q_f32(blended_[i].v, vmlaq_n_f32(from, vsubq_f32(to, from), blend.fraction));
+#else
+        for (int c = 0; c < 4; ++c) {
+            const float from = values[blend.from].v[c];
+            blended_[i].v[c] = from + (values[blend.to].v[c] - from) * blend.fraction;
+        }
+#endif
+    }
+    
+    states_.resize(elements_.size());
+    for (size_t e = 0; e < elements_.size(); ++e) {
+        const Vec4* properties = &blended_[e * kLystrPropertyCount];
+        const float* color = properties[static_cast<size_t>(LystrProperty::COLOR)].v;
+        const float alpha = std::clamp(properties[static_cast<size_t>(LystrProperty::ALPHA)].v[0], 0.0f, 1.0f);
+        
+        LystrElementState& state = states_[e];
+        state.text = timeline.GetString(elements_[e].text);
+        state.color = Color(ToChannel(color[0]), ToChannel(color[1]), ToChannel(color[2]), ToChannel(color[3] * alpha));
+        state.x = properties[static_cast<size_t>(LystrProperty::POSITION)].v[0];
+        state.y = properties[static_cast<size_t>(LystrProperty::POSITION)].v[1];
+        state.glow = std::clamp(properties[static_cast<size_t>(LystrProperty::GLOW)].v[0], 0.0f, 1.0f);
+    }
+    return states_;
+}
+
+} // namespace Lyricstator
@@ -0,0 +1,116 @@
+#pragma once
+#include "common/Types.h"
+#include "scripting/LystrTimeline.h"
+#include <string_view>
+#include <vector>
+
+namespace Lyricstator {
+
+// What a lyric animates. Each is a curve of keys holding up to four
+// floats, so they all evaluate the same way.
+enum class LystrProperty : uint8_t {
+    ALPHA,          // 0-1, on top of the color's own alpha
+    COLOR,          // r, g, b, a, 0-255
+    POSITION,       // x, y
+    GLOW            // 0-1
+};
+const size_t kLystrPropertyCount = 4;
+
+// One lyric on screen, resolved for drawing
+struct LystrElementState {
+    std::string_view text;      // Points into the timeline's string pool
+    Color color;                // Alpha includes any fade
+    float x;
+    float y;
+    float glow;
+};
+
+// Turns display(), fade_in/out(), animate(), color() and position() into
+// keyframe curves, one set per lyric, and samples every lyric on screen
+// together each frame. fade_in/out() and animate() act on the lyric
+// displayed last, and fade_out() finishes as that lyric's time runs out
+// (or runs past it). color() and position() set up the lyrics displayed
+// after them and leave the ones already on screen where they are, so
+// several lines can be laid out one display() at a time.
+class LystrAnimator {
+public:
+    // Without curves it only keeps track of when each lyric ends, which is
+    // all a seek needs to know ahead of time
+    explicit LystrAnimator(bool curves = true);
+    
+    // Drops every lyric; the next ones start out in this color and place
+    void Reset(const Color& color = Color(), const Position& position = Position());
+    
+    // Feeds instruction `index` of `timeline`, once it has run. Instructions
+    // must come in time order.
+    void Apply(const LystrTimeline& timeline, size_t index);
+    
+    // Forgets lyrics that are over by `timeMs`
+    void Prune(uint32_t timeMs);
+    
+    // Every lyric showing at `timeMs`, oldest first
+    const std::vector<LystrElementState>& Evaluate(uint32_t timeMs, const LystrTimeline& timeline);
+    
+    // Instruction that displayed the oldest lyric still kept (SIZE_MAX if none)
+    size_t GetOldestSource() const;
+    
+    // glow, pulse, slide_left/right/up/down, zoom_in
+    static bool IsKnownAnimation(std::string_view name);
+    
+    // Bit (1 << LystrProperty) for each curve animate(name) drives, 0 if
+    // it isn't an animation
+    static uint32_t GetAnimatedProperties(std::string_view name);
+    
+private:
+    struct alignas(16) Vec4 {
+        float v[4];
+    };
+    
+    // Keys [firstKey, firstKey + keyCount) of the shared pool, in time order.
+    // Two keys at the same time make a step.
+    struct Track {
+        uint32_t firstKey;
+        uint32_t keyCount;
+        uint32_t cursor;            // Key last sampled from
+    };
+    
+    struct Element {
+        size_t source;              // Index of its DISPLAY_LYRIC
+        uint32_t text;
+        uint32_t startMs;
+        uint32_t endMs;             // kOpenEnd = until the next lyric
+        Track tracks[kLystrPropertyCount];
+    };
+    
+    // A curve sampled this frame: from + (to - from) * fraction
+    struct Blend {
+        uint32_t from;
+        uint32_t to;
+        float fraction;
+    };
+    
+    static constexpr uint32_t kOpenEnd = UINT32_MAX;
+    
+    std::vector<Element> elements_;
+    std::vector<uint32_t> keyTimes_;
+    std::vector<Vec4> keyValues_;
+    bool curves_;
+    size_t lastDisplay_;            // Source of the lyric commands act on
+    Color color_;
+    Position position_;
+    
+    // Evaluate's scratch, kept between frames
+    std::vector<Blend> blends_;
+    std::vector<Vec4> blended_;
+    std::vector<LystrElementState> states_;
+    
+    Element* GetCurrent(uint32_t timeMs);
+    void Animate(Element& element, std::string_view name, uint32_t timeMs, uint32_t durationMs);
+    void PushKey(Track& track, uint32_t timeMs, const Vec4& value);
+    void HoldAt(Track& track, uint32_t timeMs, Vec4& value);
+    Blend Locate(Track& track, uint32_t timeMs);
+    Vec4 Sample(Track& track, uint32_t timeMs);
+    void CompactKeys();
+};
+
+} // namespace Lyricstator
@@ -0,0 +1,134 @@
+#include "scripting/LystrAst.h"
+#include <cstring>
+
+namespace Lyricstator {
+
+namespace {
+const size_t kBlockBytes = 64 * 1024;
+const size_t kInitialTableSize = 256;
+const StringId kNoString = UINT32_MAX;
+
+// FNV-1a
+uint32_t HashText(std::string_view text) {
+    uint32_t hash = 2166136261u;
+    for (unsigned char c : text) {
+        hash = (hash ^ c) * 16777619u;
+    }
+    return hash;
+}
+}
+
+// StringInterner
+
+StringInterner::StringInterner()
+    : blockIndex_(0)
+    , blockUsed_(0)
+{
+    Clear();
+}
+
+void StringInterner::Clear() {
+    strings_.clear();
+    largeBlocks_.clear();
+    table_.assign(kInitialTableSize, kNoString);
+    blockIndex_ = 0;
+    blockUsed_ = 0;
+    
+    // Id 0 is always the empty string
+    strings_.push_back(Entry{std::string_view(), HashText(std::string_view())});
+    table_[strings_.back().hash & (table_.size() - 1)] = kEmptyString;
+}
+
+StringId StringInterner::Intern(std::string_view text) {
+    uint32_t hash = HashText(text);
+    size_t mask = table_.size() - 1;
+    for (size_t slot = hash & mask;; slot = (slot + 1) & mask) {
+        StringId id = table_[slot];
+        if (id == kNoString) {
+            break;
+        }
+        if (strings_[id].hash == hash && strings_[id].text == text) {
+            return id;
+        }
+    }
+    
+    StringId id = static_cast<StringId>(strings_.size());
+    strings_.push_back(Entry{std::string_view(Store(text), text.size()), hash});
+    
+    // Keep the table at most half full
+    if (strings_.size() * 2 > table_.size()) {
+        Grow();
+    } else {
+        size_t slot = hash & mask;
+        while (table_[slot] != kNoString) {
+            slot = (slot + 1) & mask;
+        }
+        table_[slot] = id;
+    }
+    return id;
+}
+
+const char* StringInterner::Store(std::string_view text) {
+    if (text.empty()) {
+        return "";
+    }
+    
+    // Oversized strings get a block of their own
+    if (text.size() > kBlockBytes / 4) {
+        largeBlocks_.emplace_back(new char[text.size()]);
+        std::memcpy(largeBlocks_.back().get(), text.data(), text.size());
+        return largeBlocks_.back().get();
+    }
+    
+    if (blockIndex_ < blocks_.size() && blockUsed_ + text.size() > kBlockBytes) {
+        ++blockIndex_;
+        blockUsed_ = 0;
+    }
+    if (blockIndex_ == blocks_.size()) {
+        blocks_.emplace_back(new char[kBlockBytes]);
+        blockUsed_ = 0;
+    }
+    
+    char* stored = blocks_[blockIndex_].get() + blockUsed_;
+    std::memcpy(stored, text.data(), text.size());
+    blockUsed_ += text.size();
+    return stored;
+}
+
+void StringInterner::Grow() {
+    table_.assign(table_.size() * 2, kNoString);
+    size_t mask = table_.size() - 1;
+    for (StringId id = 0; id < strings_.size(); ++id) {
+        size_t slot = strings_[id].hash & mask;
+        while (table_[slot] != kNoString) {
+            slot = (slot + 1) & mask;
+        }
+        table_[slot] = id;
+    }
+}
+
+// LystrAst
+
+void LystrAst::Clear() {
+    nodes_.clear();
+    strings_.Clear();
+    root_ = kNoNode;
+}
+
+NodeId LystrAst::AddNode(ASTNodeType type, StringId value, int line) {
+    NodeId id = static_cast<NodeId>(nodes_.size());
+    nodes_.push_back(ASTNode{type, value, line, kNoNode, kNoNode, kNoNode});
+    return id;
+}
+
+void LystrAst::AddChild(NodeId parent, NodeId child) {
+    ASTNode& node = nodes_[parent];
+    if (node.lastChild == kNoNode) {
+        node.firstChild = child;
+    } else {
+        nodes_[node.lastChild].nextSibling = child;
+    }
+    node.lastChild = child;
+}
+
+} // namespace Lyricstator
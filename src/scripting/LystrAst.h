@@ -0,0 +1,118 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+namespace Lyricstator {
+
+// AST Node types
+enum class ASTNodeType {
+    PROGRAM,
+    COMMAND,
+    EXPRESSION,
+    LITERAL,
+    IDENTIFIER,
+    PARAMETER_LIST,
+    PARAMETER,
+    CONDITION,
+    LOOP,
+    BLOCK,
+    ASSIGNMENT
+};
+
+using StringId = uint32_t;
+using NodeId = uint32_t;
+
+constexpr StringId kEmptyString = 0;
+constexpr NodeId kNoNode = UINT32_MAX;
+
+// Deduplicating string store. Text lives in large shared blocks, so
+// interning a script's identifiers and literals costs a few allocations
+// in total, and equal strings compare by id. Views stay valid until Clear.
+class StringInterner {
+public:
+    StringInterner();
+    
+    StringId Intern(std::string_view text);
+    std::string_view Get(StringId id) const { return strings_[id].text; }
+    size_t GetCount() const { return strings_.size(); }
+    
+    // Keeps the text blocks for the next script
+    void Clear();
+
+private:
+    struct Entry {
+        std::string_view text;
+        uint32_t hash;
+    };
+    
+    std::vector<std::unique_ptr<char[]>> blocks_;
+    std::vector<std::unique_ptr<char[]>> largeBlocks_;
+    size_t blockIndex_;              // Block being filled
+    size_t blockUsed_;
+    std::vector<Entry> strings_;
+    std::vector<StringId> table_;    // Open addressing over ids
+    
+    const char* Store(std::string_view text);
+    void Grow();
+};
+
+// One node. Children form a singly linked list through node indices, so
+// nodes are plain data in one array and hold no pointers.
+struct ASTNode {
+    ASTNodeType type;
+    StringId value;         // Command, parameter or variable name, literal text, operator
+    int line;
+    NodeId firstChild;
+    NodeId lastChild;
+    NodeId nextSibling;
+};
+
+// A parsed script: nodes are bump-allocated from one array and strings
+// are interned, so building it takes a handful of allocations however
+// long the script is, and Clear releases it all in O(1) while keeping
+// the capacity for the next parse.
+class LystrAst {
+public:
+    LystrAst() : root_(kNoNode) {}
+    
+    // At least doubles when it grows, so edits adding a few nodes at a
+    // time don't reallocate on each one
+    void Reserve(size_t nodes) {
+        if (nodes > nodes_.capacity()) {
+            nodes_.reserve(std::max(nodes, nodes_.capacity() * 2));
+        }
+    }
+    void Clear();
+    
+    NodeId AddNode(ASTNodeType type, StringId value = kEmptyString, int line = 0);
+    NodeId AddNode(ASTNodeType type, std::string_view value, int line = 0) {
+        return AddNode(type, strings_.Intern(value), line);
+    }
+    void AddChild(NodeId parent, NodeId child);
+    void SetRoot(NodeId root) { root_ = root; }
+    
+    NodeId GetRoot() const { return root_; }
+    bool IsEmpty() const { return root_ == kNoNode; }
+    const ASTNode& GetNode(NodeId id) const { return nodes_[id]; }
+    ASTNode& GetNode(NodeId id) { return nodes_[id]; }
+    size_t GetNodeCount() const { return nodes_.size(); }
+    
+    std::string_view GetValue(NodeId id) const { return strings_.Get(nodes_[id].value); }
+    StringInterner& GetStrings() { return strings_; }
+    const StringInterner& GetStrings() const { return strings_; }
+    
+    // for (NodeId child = ast.FirstChild(node); child != kNoNode; child = ast.NextSibling(child))
+    NodeId FirstChild(NodeId id) const { return nodes_[id].firstChild; }
+    NodeId NextSibling(NodeId id) const { return nodes_[id].nextSibling; }
+
+private:
+    std::vector<ASTNode> nodes_;
+    StringInterner strings_;
+    NodeId root_;
+};
+
+} // namespace Lyricstator
@@ -0,0 +1,439 @@
+#include "scripting/LystrCompiledScript.h"
+#include "scripting/LystrParser.h"
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+
+#if defined(_WIN32)
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace Lyricstator {
+
+namespace {
+const char kMagic[4] = {'L', 'Y', 'S', 'C'};
+// Bump whenever the file's layout or anything stored raw in it changes:
+// FileHeader, LystrInstruction, the records below, the opcode or runtime
+// value numbering, or what keyframes mean. Files of another version are
+// ignored and rebuilt from their source.
+const uint16_t kVersion = 1;
+const uint16_t kByteOrder = 0x0102;     // Reads back as 0x0201 on a machine of the other endianness
+
+// Everything is stored as the machine lays it out; the byte order mark
+// turns away a file from a different kind of machine
+struct FileHeader {
+    char magic[4];
+    uint16_t version;
+    uint16_t byteOrder;
+    uint64_t checksum;                  // Of everything after this field
+    uint64_t sourceSize;
+    int64_t sourceModifiedTime;         // Filesystem clock ticks, only compared for equality
+    uint64_t sourceHash;
+    uint32_t instructionCount;
+    uint32_t offsetCount;
+    uint32_t conditionCount;
+    uint32_t keyframeCount;
+    uint32_t textSize;
+    uint32_t reserved;
+};
+static_assert(sizeof(FileHeader) == 64, "FileHeader has no padding");
+const size_t kChecksummedFrom = offsetof(FileHeader, sourceSize);
+
+// Fixed-width copies of the structs that have padding or platform-sized
+// fields
+struct ConditionRecord {
+    uint8_t value;
+    uint8_t compare;
+    uint16_t reserved;
+    float constant;
+};
+
+struct KeyframeRecord {
+    uint32_t index;
+    uint32_t liveFrom;
+    uint32_t color;
+    int32_t x;
+    int32_t y;
+    uint32_t lyricText;
+    uint32_t lyricStartMs;
+    uint32_t lyricDurationMs;
+    uint32_t highlightText;
+    uint32_t animation;
+    uint32_t animationStartMs;
+    uint32_t animationDurationMs;
+    uint32_t fadeStartMs;
+    uint32_t fadeDurationMs;
+    uint32_t fadingIn;
+};
+
+// FNV-1a; stable across runs and platforms, and continues from `hash` so
+// separate arrays can be hashed as one
+uint64_t Hash(const void* data, size_t size, uint64_t hash = 1469598103934665603ull) {
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    for (size_t i = 0; i < size; ++i) {
+        hash = (hash ^ bytes[i]) * 1099511628211ull;
+    }
+    return hash;
+}
+
+bool GetFileStamp(const std::string& path, uint64_t& size, int64_t& modifiedTime) {
+    std::error_code error;
+    size = std::filesystem::file_size(path, error);
+    if (error) {
+        return false;
+    }
+    auto time = std::filesystem::last_write_time(path, error);
+    if (error) {
+        return false;
+    }
+    modifiedTime = static_cast<int64_t>(time.time_since_epoch().count());
+    return true;
+}
+
+bool ReadSource(const std::string& path, std::string& source) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        return false;
+    }
+    source.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    return true;
+}
+
+// A whole file mapped read-only; empty if it can't be
+class MappedFile {
+public:
+    explicit MappedFile(const std::string& path) : data_(nullptr), size_(0) {
+#if defined(_WIN32)
+        file_ = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                            FILE_ATTRIBUTE_NORMAL, nullptr);
+        mapping_ = nullptr;
+        LARGE_INTEGER size;
+        if (file_ == INVALID_HANDLE_VALUE || !GetFileSizeEx(file_, &size) || size.QuadPart == 0) {
+            return;
+        }
+        mapping_ = CreateFileMappingA(file_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (mapping_) {
+            data_ = static_cast<const uint8_t*>(MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0));
+            size_ = data_ ? static_cast<size_t>(size.QuadPart) : 0;
+        }
+#else
+        int descriptor = open(path.c_str(), O_RDONLY);
+        if (descriptor < 0) {
+            return;
+        }
+        struct stat status;
+        if (fstat(descriptor, &status) == 0 && status.st_size > 0) {
+            void* data = mmap(nullptr, static_cast<size_t>(status.st_size), PROT_READ, MAP_PRIVATE, descriptor, 0);
+            if (data != MAP_FAILED) {
+                data_ = static_cast<const uint8_t*>(data);
+                size_ = static_cast<size_t>(status.st_size);
+            }
+        }
+        close(descriptor);
+#endif
+    }
+    
+    ~MappedFile() {
+#if defined(_WIN32)
+        if (data_) {
+            UnmapViewOfFile(data_);
+        }
+        if (mapping_) {
+            CloseHandle(mapping_);
+        }
+        if (file_ != INVALID_HANDLE_VALUE) {
+            CloseHandle(file_);
+        }
+#else
+        if (data_) {
+            munmap(const_cast<uint8_t*>(data_), size_);
+        }
+#endif
+    }
+    
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    
+    const uint8_t* GetData() const { return data_; }
+    size_t GetSize() const { return size_; }
+    
+private:
+    const uint8_t* data_;
+    size_t size_;
+#if defined(_WIN32)
+    HANDLE file_;
+    HANDLE mapping_;
+#endif
+};
+
+// Copies `count` items out of the mapping and moves past them
+template <typename T>
+std::vector<T> ReadArray(const uint8_t*& cursor, size_t count) {
+    std::vector<T> items(count);
+    if (count > 0) {
+        std::memcpy(items.data(), cursor, count * sizeof(T));
+    }
+    cursor += count * sizeof(T);
+    return items;
+}
+
+// Checksums say the file is as written, not that what was written makes
+// sense, so everything the interpreter indexes with is checked before use
+bool IsConsistent(const std::vector<LystrInstruction>& instructions, const std::vector<uint32_t>& offsets,
+                  size_t conditionCount, size_t textSize, const std::vector<LystrInterpreter::Keyframe>& keyframes) {
+    if (offsets.empty() || offsets.front() != 0 || offsets.back() != textSize
+        || !std::is_sorted(offsets.begin(), offsets.end())) {
+        return false;
+    }
+    const uint32_t stringCount = static_cast<uint32_t>(offsets.size() - 1);
+    auto isText = [stringCount](uint32_t id) { return id == LystrDisplayState::kNoText || id < stringCount; };
+    
+    uint32_t time = 0;
+    size_t branchCount = 0;
+    for (const LystrInstruction& instruction : instructions) {
+        if (instruction.time < time || instruction.op > LystrOpcode::BRANCH) {
+            return false;
+        }
+        time = instruction.time;
+        switch (instruction.op) {
+            case LystrOpcode::DISPLAY_LYRIC:
+            case LystrOpcode::ANIMATE_TEXT:
+            case LystrOpcode::HIGHLIGHT:
+                if (instruction.a >= stringCount) {
+                    return false;
+                }
+                break;
+            case LystrOpcode::BRANCH:
+                // A slot per branch at most, so the slots can't outnumber the instructions
+                if (instruction.a >= conditionCount || instruction.b >= instructions.size()) {
+                    return false;
+                }
+                branchCount = std::max<size_t>(branchCount, instruction.b + 1);
+                break;
+            default:
+                break;
+        }
+    }
+    for (const LystrInstruction& instruction : instructions) {
+        if (instruction.guard > branchCount) {
+            return false;
+        }
+    }
+    
+    if (keyframes.empty() || keyframes.front().index != 0) {
+        return false;
+    }
+    uint32_t index = 0;
+    for (const LystrInterpreter::Keyframe& keyframe : keyframes) {
+        const LystrDisplayState& state = keyframe.state;
+        if (keyframe.index < index || keyframe.index > instructions.size() || keyframe.liveFrom > keyframe.index
+            || !isText(state.lyricText) || !isText(state.highlightText) || !isText(state.animation)) {
+            return false;
+        }
+        index = keyframe.index;
+    }
+    return true;
+}
+
+// Loads `compiledPath` if it's intact and was compiled from the source as
+// it is now. `source` is filled in if the source had to be read to tell.
+bool LoadCompiled(const std::string& compiledPath, const std::string& sourcePath, std::string& source,
+                  LystrTimeline& timeline, std::vector<LystrInterpreter::Keyframe>& keyframes) {
+    MappedFile file(compiledPath);
+    if (file.GetSize() < sizeof(FileHeader)) {
+        return false;
+    }
+    
+    FileHeader header;
+    std::memcpy(&header, file.GetData(), sizeof(header));
+    if (std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 || header.version != kVersion
+        || header.byteOrder != kByteOrder) {
+        return false;
+    }
+    const uint64_t expectedSize = sizeof(FileHeader)
+                                  + uint64_t(header.instructionCount) * sizeof(LystrInstruction)
+                                  + uint64_t(header.offsetCount) * sizeof(uint32_t)
+                                  + uint64_t(header.conditionCount) * sizeof(ConditionRecord)
+                                  + uint64_t(header.keyframeCount) * sizeof(KeyframeRecord)
+                                  + header.textSize;
+    if (file.GetSize() != expectedSize
+        || Hash(file.GetData() + kChecksummedFrom, file.GetSize() - kChecksummedFrom) != header.checksum) {
+        std::cerr << "Ignoring damaged compiled script: " << compiledPath << std::endl;
+        return false;
+    }
+    
+    // Same size and time is taken as unchanged; a new time alone (copied,
+    // touched) costs reading the source to compare hashes
+    uint64_t sourceSize = 0;
+    int64_t sourceModifiedTime = 0;
+    if (!GetFileStamp(sourcePath, sourceSize, sourceModifiedTime) || sourceSize != header.sourceSize) {
+        return false;
+    }
+    if (sourceModifiedTime != header.sourceModifiedTime) {
+        if (!ReadSource(sourcePath, source) || Hash(source.data(), source.size()) != header.sourceHash) {
+            return false;
+        }
+    }
+    
+    const uint8_t* cursor = file.GetData() + sizeof(FileHeader);
+    std::vector<LystrInstruction> instructions = ReadArray<LystrInstruction>(cursor, header.instructionCount);
+    std::vector<uint32_t> offsets = ReadArray<uint32_t>(cursor, header.offsetCount);
+    std::vector<ConditionRecord> conditionRecords = ReadArray<ConditionRecord>(cursor, header.conditionCount);
+    std::vector<KeyframeRecord> keyframeRecords = ReadArray<KeyframeRecord>(cursor, header.keyframeCount);
+    std::vector<char> text = ReadArray<char>(cursor, header.textSize);
+    
+    std::vector<LystrCondition> conditions;
+    conditions.reserve(conditionRecords.size());
+    for (const ConditionRecord& record : conditionRecords) {
+        if (record.value >= kLystrRuntimeValueCount || record.compare > static_cast<uint8_t>(LystrCompare::GREATER)) {
+            return false;
+        }
+        conditions.push_back(LystrCondition{static_cast<LystrRuntimeValue>(record.value),
+                                            static_cast<LystrCompare>(record.compare), record.constant});
+    }
+    
+    std::vector<LystrInterpreter::Keyframe> loaded;
+    loaded.reserve(keyframeRecords.size());
+    for (const KeyframeRecord& record : keyframeRecords) {
+        LystrInterpreter::Keyframe keyframe;
+        keyframe.index = record.index;
+        keyframe.liveFrom = record.liveFrom;
+        LystrDisplayState& state = keyframe.state;
+        state.color = LystrTimeline::UnpackColor(record.color);
+        state.position = Position(record.x, record.y);
+        state.lyricText = record.lyricText;
+        state.lyricStartMs = record.lyricStartMs;
+        state.lyricDurationMs = record.lyricDurationMs;
+        state.highlightText = record.highlightText;
+        state.animation = record.animation;
+        state.animationStartMs = record.animationStartMs;
+        state.animationDurationMs = record.animationDurationMs;
+        state.fadeStartMs = record.fadeStartMs;
+        state.fadeDurationMs = record.fadeDurationMs;
+        state.fadingIn = record.fadingIn != 0;
+        loaded.push_back(keyframe);
+    }
+    
+    if (!IsConsistent(instructions, offsets, conditions.size(), text.size(), loaded)) {
+        std::cerr << "Ignoring inconsistent compiled script: " << compiledPath << std::endl;
+        return false;
+    }
+    timeline.Restore(std::move(instructions), std::move(text), std::move(offsets), std::move(conditions));
+    keyframes = std::move(loaded);
+    return true;
+}
+}
+
+bool LystrCompiledScript::Load(const std::string& sourcePath, LystrTimeline& timeline,
+                               std::vector<LystrInterpreter::Keyframe>& keyframes) {
+    std::string source;
+    if (LoadCompiled(GetCompiledPath(sourcePath), sourcePath, source, timeline, keyframes)) {
+        std::cout << "Loaded compiled lystr script with " << timeline.GetSize() << " commands" << std::endl;
+        return true;
+    }
+    
+    // Missing or stale: compile it again from the source
+    if (source.empty() && !ReadSource(sourcePath, source)) {
+        std::cerr << "Could not open lyric script: " << sourcePath << std::endl;
+        return false;
+    }
+    LystrParser parser;
+    if (!parser.ParseString(source)) {
+        return false;
+    }
+    timeline = parser.GetTimeline();
+    keyframes = LystrInterpreter::BuildKeyframes(timeline);
+    Save(sourcePath, source, timeline, keyframes);
+    return true;
+}
+
+bool LystrCompiledScript::Save(const std::string& sourcePath, const std::string& source, const LystrTimeline& timeline,
+                               const std::vector<LystrInterpreter::Keyframe>& keyframes) {
+    const std::vector<LystrInstruction>& instructions = timeline.GetInstructions();
+    const std::vector<char>& text = timeline.GetPoolText();
+    std::vector<uint32_t> offsets = timeline.GetPoolOffsets();
+    if (offsets.empty()) {
+        offsets.push_back(0);           // A timeline that never pooled anything
+    }
+    
+    std::vector<ConditionRecord> conditions;
+    for (const LystrCondition& condition : timeline.GetConditions()) {
+        conditions.push_back(ConditionRecord{static_cast<uint8_t>(condition.value),
+                                             static_cast<uint8_t>(condition.compare), 0, condition.constant});
+    }
+    std::vector<KeyframeRecord> keyframeRecords;
+    for (const LystrInterpreter::Keyframe& keyframe : keyframes) {
+        const LystrDisplayState& state = keyframe.state;
+        keyframeRecords.push_back(KeyframeRecord{
+            keyframe.index, keyframe.liveFrom, LystrTimeline::PackColor(state.color),
+            state.position.x, state.position.y, state.lyricText, state.lyricStartMs, state.lyricDurationMs,
+            state.highlightText, state.animation, state.animationStartMs, state.animationDurationMs,
+            state.fadeStartMs, state.fadeDurationMs, state.fadingIn ? 1u : 0u});
+    }
+    
+    FileHeader header = {};
+    std::memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.version = kVersion;
+    header.byteOrder = kByteOrder;
+    if (!GetFileStamp(sourcePath, header.sourceSize, header.sourceModifiedTime)) {
+        return false;
+    }
+    header.sourceHash = Hash(source.data(), source.size());
+    header.instructionCount = static_cast<uint32_t>(instructions.size());
+    header.offsetCount = static_cast<uint32_t>(offsets.size());
+    header.conditionCount = static_cast<uint32_t>(conditions.size());
+    header.keyframeCount = static_cast<uint32_t>(keyframeRecords.size());
+    header.textSize = static_cast<uint32_t>(text.size());
+    
+    uint64_t checksum = Hash(reinterpret_cast<const uint8_t*>(&header) + kChecksummedFrom,
+                             sizeof(header) - kChecksummedFrom);
+    checksum = Hash(instructions.data(), instructions.size() * sizeof(LystrInstruction), checksum);
+    checksum = Hash(offsets.data(), offsets.size() * sizeof(uint32_t), checksum);
+    checksum = Hash(conditions.data(), conditions.size() * sizeof(ConditionRecord), checksum);
+    checksum = Hash(keyframeRecords.data(), keyframeRecords.size() * sizeof(KeyframeRecord), checksum);
+    checksum = Hash(text.data(), text.size(), checksum);
+    header.checksum = checksum;
+    
+    // Written aside and renamed over, so a loader never maps half a file
+    const std::string compiledPath = GetCompiledPath(sourcePath);
+    const std::string partialPath = compiledPath + ".part";
+    {
+        std::ofstream file(partialPath, std::ios::binary | std::ios::trunc);
+        if (!file.is_open()) {
+            std::cerr << "Cannot write compiled script: " << compiledPath << std::endl;
+            return false;
+        }
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(reinterpret_cast<const char*>(instructions.data()), instructions.size() * sizeof(LystrInstruction));
+        file.write(reinterpret_cast<const char*>(offsets.data()), offsets.size() * sizeof(uint32_t));
+        file.write(reinterpret_cast<const char*>(conditions.data()), conditions.size() * sizeof(ConditionRecord));
+        file.write(reinterpret_cast<const char*>(keyframeRecords.data()), keyframeRecords.size() * sizeof(KeyframeRecord));
+        file.write(text.data(), text.size());
+        if (!file) {
+            std::cerr << "Failed to write compiled script: " << compiledPath << std::endl;
+            file.close();
+            std::filesystem::remove(partialPath);
+            return false;
+        }
+    }
+    
+    std::error_code error;
+    std::filesystem::rename(partialPath, compiledPath, error);
+    if (error) {
+        std::cerr << "Failed to replace compiled script " << compiledPath << ": " << error.message() << std::endl;
+        std::filesystem::remove(partialPath, error);
+        return false;
+    }
+    return true;
+}
+
+} // namespace Lyricstator
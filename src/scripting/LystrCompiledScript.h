@@ -0,0 +1,32 @@
+#pragma once
+#include "scripting/LystrInterpreter.h"
+#include "scripting/LystrTimeline.h"
+#include <string>
+#include <vector>
+
+namespace Lyricstator {
+
+// A script saved as it plays, next to its source (song.lystr ->
+// song.lystrc), so a show doesn't lex and parse every song again: the
+// timeline's instructions, string pool and runtime conditions, plus the
+// interpreter's keyframes. Loading maps the file and copies each array out
+// whole. The header holds a checksum of the file and the source's size,
+// modification time and hash; a file that fails either check is ignored
+// and rebuilt from the source.
+class LystrCompiledScript {
+public:
+    // The script's timeline and keyframes, from its .lystrc if that's
+    // current, otherwise parsed from the source, which also rewrites the
+    // .lystrc. False if the source doesn't parse either.
+    static bool Load(const std::string& sourcePath, LystrTimeline& timeline,
+                     std::vector<LystrInterpreter::Keyframe>& keyframes);
+    
+    // `source` is the text `timeline` was compiled from, as read from
+    // `sourcePath` (whose size and time are stamped into the file)
+    static bool Save(const std::string& sourcePath, const std::string& source, const LystrTimeline& timeline,
+                     const std::vector<LystrInterpreter::Keyframe>& keyframes);
+    
+    static std::string GetCompiledPath(const std::string& sourcePath) { return sourcePath + "c"; }
+};
+
+} // namespace Lyricstator
@@ -1,58 +1,210 @@
 #include "scripting/LystrInterpreter.h"
 #include <iostream>
+#include <algorithm>
 
 namespace Lyricstator {
 
-LystrInterpreter::LystrInterpreter() : currentCommandIndex_(0) {
+namespace {
+// A seek replays at most one interval's worth of commands
+const uint32_t kKeyframeIntervalMs = 5000;
+const size_t kKeyframeMaxCommands = 256;
+}
+
+LystrInterpreter::LystrInterpreter() : currentCommandIndex_(0), runtimeValues_() {
 }
 
 LystrInterpreter::~LystrInterpreter() {
 }
 
-void LystrInterpreter::LoadScript(const std::vector<LystrCommand>& commands) {
-    commands_ = commands;
-    currentCommandIndex_ = 0;
-    std::cout << "Loaded script with " << commands_.size() << " commands" << std::endl;
+void LystrInterpreter::LoadScript(const LystrTimeline& timeline) {
+    LoadScript(LystrTimeline(timeline));
+}
+
+void LystrInterpreter::LoadScript(LystrTimeline&& timeline) {
+    LoadScript(std::move(timeline), {});
+}
+
+void LystrInterpreter::LoadScript(LystrTimeline&& timeline, std::vector<Keyframe>&& keyframes) {
+    timeline_ = std::move(timeline);
+    keyframes_ = keyframes.empty() ? BuildKeyframes(timeline_) : std::move(keyframes);
+    SizeBranches();
+    Reset();
+    std::cout << "Loaded script with " << timeline_.GetSize() << " commands, "
+              << keyframes_.size() << " keyframes" << std::endl;
+}
+
+void LystrInterpreter::ReloadScript(const LystrTimeline& timeline, uint32_t timeMs) {
+    timeline_ = timeline;
+    keyframes_ = BuildKeyframes(timeline_);
+    SizeBranches();
+    Seek(timeMs);
+}
+
+std::vector<LystrInterpreter::Keyframe> LystrInterpreter::BuildKeyframes(const LystrTimeline& timeline) {
+    std::vector<Keyframe> keyframes;
+    LystrDisplayState state;
+    keyframes.push_back(Keyframe{0, 0, state});
+    
+    // Run through the animations too, only to see which lyrics are still
+    // up at each keyframe
+    LystrAnimator lifetimes(false);
+    
+    const std::vector<LystrInstruction>& instructions = timeline.GetInstructions();
+    uint32_t nextTime = kKeyframeIntervalMs;
+    for (size_t i = 0; i < instructions.size(); ++i) {
+        size_t sinceLast = i - keyframes.back().index;
+        if (sinceLast > 0 && (instructions[i].time >= nextTime || sinceLast >= kKeyframeMaxCommands)) {
+            lifetimes.Prune(instructions[i - 1].time);
+            size_t liveFrom = std::min(lifetimes.GetOldestSource(), i);
+            keyframes.push_back(Keyframe{static_cast<uint32_t>(i), static_cast<uint32_t>(liveFrom), state});
+            nextTime = (instructions[i].time / kKeyframeIntervalMs + 1) * kKeyframeIntervalMs;
+        }
+        if (instructions[i].guard == 0) {
+            ApplyState(state, instructions[i]);
+            lifetimes.Apply(timeline, i);
+        }
+    }
+    return keyframes;
+}
+
+void LystrInterpreter::SizeBranches() {
+    size_t branchCount = 0;
+    for (const LystrInstruction& instruction : timeline_.GetInstructions()) {
+        if (instruction.op == LystrOpcode::BRANCH) {
+            branchCount = std::max<size_t>(branchCount, instruction.b + 1);
+        }
+    }
+    branches_.assign(branchCount, BRANCH_UNKNOWN);
 }
 
 void LystrInterpreter::Update(uint32_t currentTimeMs) {
     // Execute commands at their scheduled time
-    while (currentCommandIndex_ < commands_.size()) {
-        const auto& command = commands_[currentCommandIndex_];
-        
-        if (command.timestamp <= currentTimeMs) {
-            // Execute command
-            if (command.type == LystrCommandType::DISPLAY_LYRIC && lyricCallback_) {
-                auto it = command.parameters.find("text");
-                if (it != command.parameters.end()) {
-                    lyricCallback_(it->second);
-                }
+    const std::vector<LystrInstruction>& instructions = timeline_.GetInstructions();
+    while (currentCommandIndex_ < instructions.size() && instructions[currentCommandIndex_].time <= currentTimeMs) {
+        Execute(currentCommandIndex_);
+        currentCommandIndex_++;
+    }
+}
+
+bool LystrInterpreter::IsGuardedOut(const LystrInstruction& instruction) const {
+    if (instruction.guard == 0) {
+        return false;
+    }
+    uint8_t branch = branches_[instruction.guard - 1];
+    return branch != ((instruction.flags & LystrInstruction::kElseBranch) ? BRANCH_NOT_TAKEN : BRANCH_TAKEN);
+}
+
+void LystrInterpreter::Execute(size_t index) {
+    const LystrInstruction& instruction = timeline_.GetInstructions()[index];
+    if (IsGuardedOut(instruction)) {
+        return;
+    }
+    if (instruction.op == LystrOpcode::BRANCH) {
+        const LystrCondition& condition = timeline_.GetCondition(instruction.a);
+        bool taken = condition.Test(runtimeValues_[static_cast<size_t>(condition.value)]);
+        branches_[instruction.b] = taken ? BRANCH_TAKEN : BRANCH_NOT_TAKEN;
+        return;
+    }
+    ApplyState(state_, instruction);
+    animator_.Apply(timeline_, index);
+    
+    switch (instruction.op) {
+        case LystrOpcode::DISPLAY_LYRIC:
+            if (lyricCallback_) {
+                lyricCallback_(timeline_.GetString(instruction.a));
             }
-            currentCommandIndex_++;
-        } else {
             break;
-        }
+        default:
+            break;
+    }
+}
+
+void LystrInterpreter::ApplyState(LystrDisplayState& state, const LystrInstruction& instruction) {
+    switch (instruction.op) {
+        case LystrOpcode::DISPLAY_LYRIC:
+            state.lyricText = instruction.a;
+            state.lyricStartMs = instruction.time;
+            state.lyricDurationMs = instruction.b;
+            state.highlightText = LystrDisplayState::kNoText;
+            break;
+        case LystrOpcode::SET_COLOR:
+            state.color = LystrTimeline::UnpackColor(instruction.a);
+            break;
+        case LystrOpcode::SET_POSITION:
+            state.position = Position(instruction.GetSignedA(), instruction.GetSignedB());
+            break;
+        case LystrOpcode::FADE_IN:
+        case LystrOpcode::FADE_OUT:
+            state.fadeStartMs = instruction.time;
+            state.fadeDurationMs = instruction.a;
+            state.fadingIn = instruction.op == LystrOpcode::FADE_IN;
+            break;
+        case LystrOpcode::ANIMATE_TEXT:
+            state.animation = instruction.a;
+            state.animationStartMs = instruction.time;
+            state.animationDurationMs = instruction.b;
+            break;
+        case LystrOpcode::HIGHLIGHT:
+            state.highlightText = instruction.a;
+            break;
+        case LystrOpcode::SET_TIMING:
+        case LystrOpcode::WAIT:
+        case LystrOpcode::BRANCH:
+            break;
     }
 }
 
 void LystrInterpreter::Seek(uint32_t timeMs) {
-    // Reset to beginning and fast-forward to the correct position
-    currentCommandIndex_ = 0;
+    // Everything at or before timeMs has happened
+    const std::vector<LystrInstruction>& instructions = timeline_.GetInstructions();
+    auto position = std::upper_bound(instructions.begin(), instructions.end(), timeMs,
+                                     [](uint32_t time, const LystrInstruction& instruction) { return time < instruction.time; });
+    currentCommandIndex_ = static_cast<size_t>(position - instructions.begin());
     
-    for (size_t i = 0; i < commands_.size(); ++i) {
-        if (commands_[i].timestamp <= timeMs) {
-            currentCommandIndex_ = i + 1;
-        } else {
-            break;
+    // Latest keyframe at or before that (the first is at 0), then replay
+    // the rest. Lyrics still showing may have been displayed before it, so
+    // the replay starts early enough to rebuild their animations.
+    auto before = [](size_t index, const Keyframe& frame) { return index < frame.index; };
+    auto keyframe = std::upper_bound(keyframes_.begin(), keyframes_.end(), currentCommandIndex_, before) - 1;
+    const size_t liveFrom = keyframe->liveFrom;
+    auto start = std::upper_bound(keyframes_.begin(), keyframe + 1, liveFrom, before) - 1;
+    state_ = start->state;
+    for (size_t i = start->index; i < currentCommandIndex_; ++i) {
+        if (i == liveFrom) {
+            animator_.Reset(state_.color, state_.position);
+        }
+        if (instructions[i].guard == 0) {
+            ApplyState(state_, instructions[i]);
+            if (i >= liveFrom) {
+                animator_.Apply(timeline_, i);
+            }
         }
     }
+    if (liveFrom == currentCommandIndex_) {
+        animator_.Reset(state_.color, state_.position);
+    }
+    std::fill(branches_.begin(), branches_.end(), BRANCH_UNKNOWN);
+    
+    if (lyricCallback_) {
+        uint64_t lyricEndMs = static_cast<uint64_t>(state_.lyricStartMs) + state_.lyricDurationMs;
+        bool showing = state_.lyricText != LystrDisplayState::kNoText
+                       && (state_.lyricDurationMs == 0 || timeMs < lyricEndMs);
+        lyricCallback_(showing ? timeline_.GetString(state_.lyricText) : std::string_view());
+    }
 }
 
 void LystrInterpreter::Reset() {
     currentCommandIndex_ = 0;
+    state_ = LystrDisplayState();
+    animator_.Reset();
+    std::fill(branches_.begin(), branches_.end(), BRANCH_UNKNOWN);
+}
+
+void LystrInterpreter::SetRuntimeValue(LystrRuntimeValue value, float current) {
+    runtimeValues_[static_cast<size_t>(value)] = current;
 }
 
-void LystrInterpreter::SetLyricCallback(std::function<void(const std::string&)> callback) {
+void LystrInterpreter::SetLyricCallback(std::function<void(std::string_view)> callback) {
     lyricCallback_ = callback;
 }
 
@@ -1,26 +1,106 @@
 #pragma once
 #include "common/Types.h"
+#include "scripting/LystrAnimator.h"
+#include "scripting/LystrTimeline.h"
 #include <vector>
 #include <functional>
+#include <string_view>
 
 namespace Lyricstator {
 
+// What the stateful commands have set up at a point in the script. Text
+// fields are string pool ids (kNoText if none).
+struct LystrDisplayState {
+    static constexpr uint32_t kNoText = UINT32_MAX;
+    
+    Color color;
+    Position position;
+    uint32_t lyricText = kNoText;
+    uint32_t lyricStartMs = 0;
+    uint32_t lyricDurationMs = 0;       // 0 = until the next lyric
+    uint32_t highlightText = kNoText;
+    uint32_t animation = kNoText;
+    uint32_t animationStartMs = 0;
+    uint32_t animationDurationMs = 0;
+    uint32_t fadeStartMs = 0;
+    uint32_t fadeDurationMs = 0;
+    bool fadingIn = true;               // Last fade was a fade_in (or none yet)
+};
+
 class LystrInterpreter {
 public:
+    // Display state before instruction `index`. Lyrics still showing there
+    // were displayed from `liveFrom` on, so a seek replays the animations
+    // from that far back.
+    struct Keyframe {
+        uint32_t index;
+        uint32_t liveFrom;
+        LystrDisplayState state;
+    };
+    
     LystrInterpreter();
     ~LystrInterpreter();
     
-    void LoadScript(const std::vector<LystrCommand>& commands);
+    void LoadScript(const LystrTimeline& timeline);
+    void LoadScript(LystrTimeline&& timeline);
+    // With keyframes built earlier from the same timeline (a compiled
+    // script); none and they're built here
+    void LoadScript(LystrTimeline&& timeline, std::vector<Keyframe>&& keyframes);
+    // Swaps in an edited script and carries on from `timeMs`, as Seek
+    void ReloadScript(const LystrTimeline& timeline, uint32_t timeMs);
     void Update(uint32_t currentTimeMs);
-    void Seek(uint32_t timeMs);
     void Reset();
     
-    void SetLyricCallback(std::function<void(const std::string&)> callback);
+    // O(log n): binary search for the position, then the display state is
+    // restored from the nearest keyframe and replayed forward from there.
+    // The lyric showing at `timeMs` (or an empty one) is sent again.
+    void Seek(uint32_t timeMs);
+    
+    // Inputs to runtime branches (if (score > 80) { ... }). Each branch
+    // reads them as it comes up, so set them before Update.
+    void SetRuntimeValue(LystrRuntimeValue value, float current);
+    
+    // Every lyric on screen at `timeMs` with its fades, animations, color
+    // and position worked out, ready to draw. Call after Update or Seek.
+    const std::vector<LystrElementState>& Animate(uint32_t timeMs) { return animator_.Evaluate(timeMs, timeline_); }
+    
+    const LystrDisplayState& GetDisplayState() const { return state_; }
+    std::string_view GetText(uint32_t id) const {
+        return id == LystrDisplayState::kNoText ? std::string_view() : timeline_.GetString(id);
+    }
+    
+    // The text points into the loaded timeline's string pool
+    void SetLyricCallback(std::function<void(std::string_view)> callback);
+    
+    // Seek points every few seconds of `timeline`. Guarded instructions
+    // depend on the singing, so they're left out.
+    static std::vector<Keyframe> BuildKeyframes(const LystrTimeline& timeline);
+    const std::vector<Keyframe>& GetKeyframes() const { return keyframes_; }
     
 private:
-    std::vector<LystrCommand> commands_;
+
+    // Outcome of each BRANCH. A seek can't know what was sung before the
+    // new position, so it sets them back to unknown, and instructions
+    // guarded by an unknown branch are skipped either way.
+    enum BranchState : uint8_t {
+        BRANCH_UNKNOWN,
+        BRANCH_TAKEN,
+        BRANCH_NOT_TAKEN
+    };
+    
+    LystrTimeline timeline_;
     size_t currentCommandIndex_;
-    std::function<void(const std::string&)> lyricCallback_;
+    LystrDisplayState state_;
+    LystrAnimator animator_;
+    std::vector<Keyframe> keyframes_;
+    std::vector<uint8_t> branches_;
+    float runtimeValues_[kLystrRuntimeValueCount];
+    std::function<void(std::string_view)> lyricCallback_;
+    
+    bool IsGuardedOut(const LystrInstruction& instruction) const;
+    void Execute(size_t index);
+    void SizeBranches();
+    static void ApplyState(LystrDisplayState& state, const LystrInstruction& instruction);
 };
 
 } // namespace Lyricstator
@@ -1,31 +1,280 @@
 #include "scripting/LystrParser.h"
+#include "scripting/LystrAnimator.h"
 #include <iostream>
 #include <fstream>
+#include <algorithm>
 #include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <thread>
 
 namespace Lyricstator {
 
+namespace {
+
+// Keyword lookup: a perfect hash over the fixed keyword set, built and
+// checked for collisions at compile time. One table probe and one compare
+// per identifier.
+struct Keyword {
+    std::string_view text;
+    TokenType type = TokenType::IDENTIFIER;
+};
+
+constexpr Keyword kKeywords[] = {
+    {"display", TokenType::DISPLAY},
+    {"timing", TokenType::TIMING},
+    {"animate", TokenType::ANIMATE},
+    {"color", TokenType::COLOR},
+    {"position", TokenType::POSITION},
+    {"fade_in", TokenType::FADE_IN},
+    {"fade_out", TokenType::FADE_OUT},
+    {"highlight", TokenType::HIGHLIGHT},
+    {"wait", TokenType::WAIT},
+    {"repeat", TokenType::REPEAT},
+    {"if", TokenType::IF},
+    {"else", TokenType::ELSE},
+    {"while", TokenType::WHILE},
+    {"true", TokenType::BOOLEAN},
+    {"false", TokenType::BOOLEAN},
+};
+
+constexpr size_t kKeywordSlots = 32;
+
+constexpr size_t KeywordHash(std::string_view word) {
+    return (static_cast<unsigned char>(word.front()) + 2u * static_cast<unsigned char>(word.back()) + word.size())
+           & (kKeywordSlots - 1);
+}
+
+struct KeywordTable {
+    Keyword slots[kKeywordSlots] = {};
+    size_t maxLength = 0;
+    bool collision = false;
+};
+
+constexpr KeywordTable BuildKeywordTable() {
+    KeywordTable table;
+    for (const Keyword& keyword : kKeywords) {
+        Keyword& slot = table.slots[KeywordHash(keyword.text)];
+        table.collision = table.collision || !slot.text.empty();
+        slot = keyword;
+        table.maxLength = std::max(table.maxLength, keyword.text.size());
+    }
+    return table;
+}
+
+constexpr KeywordTable kKeywordTable = BuildKeywordTable();
+static_assert(!kKeywordTable.collision, "Keyword hash has a collision; change KeywordHash");
+
+constexpr TokenType LookupKeyword(std::string_view word) {
+    if (word.empty() || word.size() > kKeywordTable.maxLength) {
+        return TokenType::IDENTIFIER;
+    }
+    const Keyword& slot = kKeywordTable.slots[KeywordHash(word)];
+    return slot.text == word ? slot.type : TokenType::IDENTIFIER;
+}
+
+static_assert(LookupKeyword("fade_out") == TokenType::FADE_OUT, "Keyword table is broken");
+static_assert(LookupKeyword("lyric") == TokenType::IDENTIFIER, "Keyword table is broken");
+
+// String token contents -> text, resolving \" \\ \n and \t
+std::string Unescape(std::string_view raw) {
+    std::string text;
+    text.reserve(raw.size());
+    for (size_t i = 0; i < raw.size(); ++i) {
+        if (raw[i] != '\\' || i + 1 == raw.size()) {
+            text += raw[i];
+            continue;
+        }
+        char escaped = raw[++i];
+        switch (escaped) {
+            case 'n': text += '\n'; break;
+            case 't': text += '\t'; break;
+            default: text += escaped; break;
+        }
+    }
+    return text;
+}
+
+std::string DescribeInvalidToken(const Token& token) {
+    if (!token.value.empty() && token.value.front() == '"') {
+        return "Unterminated string";
+    }
+    return "Unexpected character '" + std::string(token.value) + "'";
+}
+
+// An edit re-parses in place and leaves the old nodes behind; once they
+// outnumber the live ones (beyond this slack) the whole script is parsed
+// again to reclaim them
+const size_t kNodeSlack = 4096;
+
+// Below this many statements per thread, splitting validation up costs
+// more than it saves
+const size_t kMinSectionStatements = 2048;
+
+// Loop bodies one statement may unroll; past this it's most likely a
+// while() that never ends
+const size_t kMaxLoopIterations = 100000;
+
+// Names read from the singer during playback rather than set in the script
+struct RuntimeName {
+    std::string_view name;
+    LystrRuntimeValue value;
+};
+
+const RuntimeName kRuntimeNames[] = {
+    {"score", LystrRuntimeValue::PITCH_SCORE},
+    {"note", LystrRuntimeValue::SUNG_NOTE},
+    {"cents", LystrRuntimeValue::PITCH_CENTS},
+};
+
+bool FindRuntimeValue(std::string_view name, LystrRuntimeValue& value) {
+    for (const RuntimeName& runtime : kRuntimeNames) {
+        if (runtime.name == name) {
+            value = runtime.value;
+            return true;
+        }
+    }
+    return false;
+}
+
+std::string GetRuntimeName(LystrRuntimeValue value) {
+    for (const RuntimeName& runtime : kRuntimeNames) {
+        if (runtime.value == value) {
+            return std::string(runtime.name);
+        }
+    }
+    return "?";
+}
+
+bool IsNumber(const std::string& text) {
+    char* end = nullptr;
+    std::strtod(text.c_str(), &end);
+    return !text.empty() && *end == '\0';
+}
+
+bool ToNumber(const std::string& text, double& number) {
+    char* end = nullptr;
+    number = std::strtod(text.c_str(), &end);
+    return !text.empty() && *end == '\0' && std::isfinite(number);
+}
+
+// Whole numbers print without a fraction, so folded values read like the
+// literals they replace
+std::string FormatNumber(double number) {
+    if (number == std::floor(number) && std::fabs(number) < 1e15) {
+        return std::to_string(static_cast<long long>(number));
+    }
+    char text[32];
+    std::snprintf(text, sizeof(text), "%.15g", number);
+    return text;
+}
+
+// true/false, or a number (anything but 0 is true)
+bool ToCondition(const std::string& text, bool& result) {
+    double number = 0.0;
+    if (text == "true" || text == "false") {
+        result = text == "true";
+    } else if (ToNumber(text, number)) {
+        result = number != 0.0;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+bool ParseMilliseconds(const std::string& text, uint32_t& ms) {
+    char* end = nullptr;
+    double value = std::strtod(text.c_str(), &end);
+    if (text.empty() || *end != '\0' || !(value >= 0.0) || value > 4294967295.0) {
+        return false;
+    }
+    ms = static_cast<uint32_t>(std::lround(value));
+    return true;
+}
+
+} // namespace
+
 // Lexer Implementation
-Lexer::Lexer(const std::string& source) : source_(source), position_(0), line_(1), column_(1) {
+Lexer::Lexer(std::string_view source, int firstLine)
+    : source_(source), position_(0), lineStart_(0), line_(firstLine) {
 }
 
 std::vector<Token> Lexer::Tokenize() {
     std::vector<Token> tokens;
-    while (HasMoreTokens()) {
+    tokens.reserve(source_.size() / 4 + 1);
+    for (;;) {
         tokens.push_back(GetNextToken());
+        if (tokens.back().type == TokenType::END_OF_FILE) {
+            break;
+        }
     }
     return tokens;
 }
 
 Token Lexer::GetNextToken() {
-    // Stub implementation - returns basic tokens
+    for (;;) {
+        SkipWhitespace();
+        char c = CurrentChar();
+        if (c == '#' || (c == '/' && PeekChar() == '/')) {
+            SkipComment();
+            continue;
+        }
+        break;
+    }
+    
     if (!HasMoreTokens()) {
-        return Token(TokenType::END_OF_FILE, "", line_, column_);
+        return MakeToken(TokenType::END_OF_FILE, position_, 0);
+    }
+    
+    char c = CurrentChar();
+    if (c == '"') {
+        return ReadString();
+    }
+    if (IsDigit(c) || (c == '.' && IsDigit(PeekChar()))) {
+        return ReadNumber();
+    }
+    if (IsAlpha(c)) {
+        return ReadIdentifier();
     }
     
-    // Skip to end for now
-    position_ = source_.length();
-    return Token(TokenType::END_OF_FILE, "", line_, column_);
+    TokenType type = TokenType::INVALID;
+    size_t length = 1;
+    switch (c) {
+        case '=':
+            type = PeekChar() == '=' ? TokenType::EQUALS : TokenType::ASSIGN;
+            break;
+        case '!':
+            if (PeekChar() == '=') {
+                type = TokenType::NOT_EQUALS;
+            }
+            break;
+        case '<': type = TokenType::LESS_THAN; break;
+        case '>': type = TokenType::GREATER_THAN; break;
+        case '+': type = TokenType::PLUS; break;
+        case '-': type = TokenType::MINUS; break;
+        case '*': type = TokenType::MULTIPLY; break;
+        case '/': type = TokenType::DIVIDE; break;
+        case ';': type = TokenType::SEMICOLON; break;
+        case ',': type = TokenType::COMMA; break;
+        case '(': type = TokenType::LEFT_PAREN; break;
+        case ')': type = TokenType::RIGHT_PAREN; break;
+        case '{': type = TokenType::LEFT_BRACE; break;
+        case '}': type = TokenType::RIGHT_BRACE; break;
+        case '[': type = TokenType::LEFT_BRACKET; break;
+        case ']': type = TokenType::RIGHT_BRACKET; break;
+        default: break;
+    }
+    if (type == TokenType::EQUALS || type == TokenType::NOT_EQUALS) {
+        length = 2;
+    }
+    
+    Token token = MakeToken(type, position_, length);
+    position_ += length;
+    return token;
 }
 
 bool Lexer::HasMoreTokens() const {
@@ -45,60 +294,95 @@ void Lexer::Advance() {
     if (position_ < source_.length()) {
         if (source_[position_] == '\n') {
             line_++;
-            column_ = 1;
-        } else {
-            column_++;
+            lineStart_ = position_ + 1;
         }
         position_++;
     }
 }
 
 void Lexer::SkipWhitespace() {
-    while (CurrentChar() == ' ' || CurrentChar() == '\t' || CurrentChar() == '\r') {
+    for (;;) {
+        char c = CurrentChar();
+        if (c != ' ' && c != '\t' && c != '\r' && c != '\n') {
+            break;
+        }
         Advance();
     }
 }
 
 void Lexer::SkipComment() {
-    // Skip // comments
-    if (CurrentChar() == '/' && PeekChar() == '/') {
-        while (CurrentChar() != '\n' && CurrentChar() != '\0') {
-            Advance();
-        }
-    }
+    // To the end of the line; the newline itself is whitespace
+    size_t end = source_.find('\n', position_);
+    position_ = (end == std::string_view::npos) ? source_.length() : end;
 }
 
 Token Lexer::ReadString() {
-    return Token(TokenType::STRING, "", line_, column_);
+    size_t start = position_;
+    size_t pos = position_ + 1;
+    while (pos < source_.length()) {
+        char c = source_[pos];
+        if (c == '"') {
+            position_ = pos + 1;
+            return Token(TokenType::STRING, source_.substr(start + 1, pos - start - 1),
+                         line_, static_cast<int>(start - lineStart_ + 1));
+        }
+        if (c == '\n') {
+            break;
+        }
+        pos += (c == '\\') ? 2 : 1;
+    }
+    
+    // Unterminated: the INVALID token starts at the quote so the parser
+    // can say so
+    pos = std::min(pos, source_.length());
+    Token token = MakeToken(TokenType::INVALID, start, pos - start);
+    position_ = pos;
+    return token;
 }
 
 Token Lexer::ReadNumber() {
-    return Token(TokenType::NUMBER, "", line_, column_);
+    size_t start = position_;
+    while (IsDigit(CurrentChar())) {
+        position_++;
+    }
+    if (CurrentChar() == '.' && IsDigit(PeekChar())) {
+        position_++;
+        while (IsDigit(CurrentChar())) {
+            position_++;
+        }
+    }
+    return MakeToken(TokenType::NUMBER, start, position_ - start);
 }
 
 Token Lexer::ReadIdentifier() {
-    return Token(TokenType::IDENTIFIER, "", line_, column_);
+    size_t start = position_;
+    while (IsAlphaNumeric(CurrentChar())) {
+        position_++;
+    }
+    Token token = MakeToken(TokenType::IDENTIFIER, start, position_ - start);
+    token.type = LookupKeyword(token.value);
+    return token;
 }
 
-bool Lexer::IsAlpha(char c) const {
+Token Lexer::MakeToken(TokenType type, size_t start, size_t length) const {
+    return Token(type, source_.substr(start, length), line_, static_cast<int>(start - lineStart_ + 1));
+}
+
+bool Lexer::IsAlpha(char c) {
     return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
 }
 
-bool Lexer::IsDigit(char c) const {
+bool Lexer::IsDigit(char c) {
     return c >= '0' && c <= '9';
 }
 
-bool Lexer::IsAlphaNumeric(char c) const {
+bool Lexer::IsAlphaNumeric(char c) {
     return IsAlpha(c) || IsDigit(c);
 }
 
-TokenType Lexer::GetKeywordType(const std::string& identifier) const {
-    // Stub implementation
-    return TokenType::IDENTIFIER;
-}
-
 // LystrParser Implementation
-LystrParser::LystrParser() : currentToken_(0) {
+LystrParser::LystrParser()
+    : currentToken_(0), liveNodes_(0), assignments_(0), commandsStale_(false), screenWidth_(1280), screenHeight_(720) {
     InitializeBuiltins();
 }
 
@@ -106,7 +390,7 @@ LystrParser::~LystrParser() {
 }
 
 bool LystrParser::ParseFile(const std::string& filepath) {
-    std::ifstream file(filepath);
+    std::ifstream file(filepath, std::ios::binary);
     if (!file.is_open()) {
         AddError("Could not open file: " + filepath);
         return false;
@@ -120,70 +404,724 @@ bool LystrParser::ParseFile(const std::string& filepath) {
 }
 
 bool LystrParser::ParseString(const std::string& source) {
-    Clear();
-    
-    // Stub implementation - creates a simple display command
-    LystrCommand command;
-    command.type = LystrCommandType::DISPLAY_LYRIC;
-    command.parameters["text"] = "Hello, World!";
-    command.timestamp = 0;
-    commands_.push_back(command);
+    if (!Load(source)) {
+        for (const std::string& error : errors_) {
+            std::cerr << "Lystr error: " << error << std::endl;
+        }
+        // A script that loads with errors doesn't play at all; editing can
+        // carry on from the statements that did parse
+        timeline_.SetInstructions({});
+        commands_.clear();
+        commandsStale_ = false;
+        return false;
+    }
     
-    std::cout << "Parsed lystr script with " << commands_.size() << " commands" << std::endl;
+    std::cout << "Parsed lystr script with " << timeline_.GetSize() << " commands" << std::endl;
     return true;
 }
 
+bool LystrParser::ApplyEdit(size_t position, size_t removed, std::string_view text) {
+    if (position > source_.size() || removed > source_.size() - position) {
+        std::cerr << "Lystr edit at " << position << " is outside the script" << std::endl;
+        return false;
+    }
+    
+    // Lines the edit spans, numbered as before it
+    const int firstLine = GetLineOf(position);
+    const int lastLine = GetLineOf(position + removed);
+    const int delta = static_cast<int>(std::count(text.begin(), text.end(), '\n')) - (lastLine - firstLine);
+    
+    // Line starts inside the removed text go, the ones after it move and
+    // the inserted text brings its own
+    const ptrdiff_t shift = static_cast<ptrdiff_t>(text.size()) - static_cast<ptrdiff_t>(removed);
+    lineStarts_.erase(lineStarts_.begin() + firstLine, lineStarts_.begin() + lastLine);
+    for (size_t i = firstLine; i < lineStarts_.size(); ++i) {
+        lineStarts_[i] += shift;
+    }
+    std::vector<size_t> inserted;
+    for (size_t i = 0; i < text.size(); ++i) {
+        if (text[i] == '\n') {
+            inserted.push_back(position + i + 1);
+        }
+    }
+    lineStarts_.insert(lineStarts_.begin() + firstLine, inserted.begin(), inserted.end());
+    source_.replace(position, removed, text.data(), text.size());
+    
+    if (ast_.GetNodeCount() > 2 * liveNodes_ + kNodeSlack) {
+        return Reparse();
+    }
+    
+    // The statements on those lines, widened until no statement left out
+    // shares a line with the region: lexing restarts at a line start
+    auto firstAffected = std::lower_bound(statements_.begin(), statements_.end(), firstLine,
+                                          [](const Statement& statement, int line) { return statement.lastLine < line; });
+    size_t begin = static_cast<size_t>(firstAffected - statements_.begin());
+    size_t end = begin;
+    int regionFirst = firstLine;
+    int regionLast = lastLine;
+    auto widen = [&]() {
+        while (end < statements_.size() && statements_[end].firstLine <= regionLast) {
+            regionFirst = std::min(regionFirst, statements_[end].firstLine);
+            regionLast = std::max(regionLast, statements_[end].lastLine);
+            ++end;
+        }
+    };
+    widen();
+    if (begin > 0 && statements_[begin - 1].nextLine >= firstLine) {
+        --begin;
+        regionFirst = std::min(regionFirst, statements_[begin].firstLine);
+    }
+    while (begin > 0 && statements_[begin - 1].lastLine >= regionFirst) {
+        --begin;
+        regionFirst = std::min(regionFirst, statements_[begin].firstLine);
+    }
+    
+    const int lineCount = static_cast<int>(lineStarts_.size());
+    const Variables& variablesBefore = GetVariablesBefore(begin);
+    std::vector<Statement> parsed;
+    for (;;) {
+        bool reachedEnd = false;
+        parsed = ParseLines(regionFirst, regionLast + delta, reachedEnd, variablesBefore);
+        if (!reachedEnd || regionLast + delta >= lineCount) {
+            break;
+        }
+        
+        // The last statement runs on past the region (an edit opened a
+        // parenthesis, say), so take in the next one too and try again
+        if (end < statements_.size()) {
+            regionLast = std::max(regionLast, statements_[end].lastLine);
+            ++end;
+            widen();
+        } else {
+            regionLast = lineCount - delta;
+        }
+    }
+    
+    // Statements after the region keep their nodes and instructions; only
+    // their line numbers move (their AST nodes keep the line they were
+    // parsed at)
+    if (delta != 0) {
+        for (size_t i = end; i < statements_.size(); ++i) {
+            Statement& statement = statements_[i];
+            statement.firstLine += delta;
+            statement.lastLine += delta;
+            if (statement.nextLine != 0) {
+                statement.nextLine += delta;
+            }
+            for (auto& error : statement.errors) {
+                error.first += delta;
+            }
+        }
+    }
+    
+    // Kept current here, not just in Resolve: GetVariablesBefore relies on it
+    auto assigns = [](const Statement& statement) { return statement.assigns; };
+    const size_t assignedBefore = std::count_if(statements_.begin() + begin, statements_.begin() + end, assigns);
+    const size_t assignedAfter = std::count_if(parsed.begin(), parsed.end(), assigns);
+    const bool assignmentsChanged = assignedBefore > 0 || assignedAfter > 0;
+    assignments_ += assignedAfter - assignedBefore;
+    
+    // Splice, moving as little of the vector as possible
+    size_t reused = std::min(parsed.size(), end - begin);
+    std::move(parsed.begin(), parsed.begin() + reused, statements_.begin() + begin);
+    if (parsed.size() > reused) {
+        statements_.insert(statements_.begin() + begin + reused,
+                           std::make_move_iterator(parsed.begin() + reused), std::make_move_iterator(parsed.end()));
+    } else {
+        statements_.erase(statements_.begin() + begin + reused, statements_.begin() + end);
+    }
+    LinkStatements(begin, begin + parsed.size());
+    
+    // Later statements may have used what the region assigned
+    if (assignmentsChanged) {
+        const size_t after = begin + parsed.size();
+        RecompileFrom(after, GetVariablesBefore(after));
+    }
+    
+    Resolve();
+    return !HasErrors();
+}
+
+const std::vector<LystrCommand>& LystrParser::GetCommands() const {
+    if (commandsStale_) {
+        commands_.clear();
+        commands_.reserve(statements_.size());
+        for (const Statement& statement : statements_) {
+            if (!statement.compiled) {
+                continue;
+            }
+            for (uint32_t i = 0; i < statement.instructionCount; ++i) {
+                const LystrInstruction& instruction = compiled_[statement.firstInstruction + i];
+                if (instruction.op != LystrOpcode::BRANCH) {
+                    commands_.push_back(compiledCommands_[statement.firstInstruction + i].command);
+                    commands_.back().timestamp = instruction.time;
+                    if (instruction.guard != 0) {
+                        commands_.back().parameters["branch"] = std::to_string(instruction.guard - 1);
+                        if (instruction.flags & LystrInstruction::kElseBranch) {
+                            commands_.back().parameters["else"] = "true";
+                        }
+                    }
+                }
+            }
+        }
+        std::stable_sort(commands_.begin(), commands_.end(), [](const LystrCommand& a, const LystrCommand& b) {
+            return a.timestamp < b.timestamp;
+        });
+        commandsStale_ = false;
+    }
+    return commands_;
+}
+
 void LystrParser::Clear() {
     commands_.clear();
+    commandsStale_ = false;
+    statements_.clear();
+    liveNodes_ = 0;
+    assignments_ = 0;
+    timeline_.Clear();
+    pooledStrings_.clear();
+    compiled_.clear();
+    compiledCommands_.clear();
     errors_.clear();
     tokens_.clear();
     currentToken_ = 0;
-    ast_.reset();
+    ast_.Clear();
+    lexer_.reset();
+    source_.clear();
+    lineStarts_.clear();
 }
 
 bool LystrParser::ValidateScript() const {
+    return GetValidationErrors().empty();
+}
+
+std::vector<std::string> LystrParser::GetValidationErrors(int threadCount) const {
+    if (threadCount <= 0) {
+        threadCount = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+    }
+    size_t sections = std::min(static_cast<size_t>(threadCount), statements_.size() / kMinSectionStatements);
+    sections = std::max<size_t>(sections, 1);
+    
+    // The per-statement checks only look at their own statement, so the
+    // sections run independently; the timing pass needs the whole script in
+    // order but is a cheap sweep, and runs here alongside them
+    const size_t perSection = (statements_.size() + sections - 1) / sections;
+    std::vector<std::vector<Issue>> found(sections + 1);
+    std::vector<std::future<void>> running;
+    for (size_t section = 1; section < sections; ++section) {
+        running.push_back(std::async(std::launch::async, [this, &found, section, perSection]() {
+            size_t begin = std::min(section * perSection, statements_.size());
+            ValidateSection(begin, std::min(begin + perSection, statements_.size()), found[section]);
+        }));
+    }
+    ValidateSection(0, std::min(perSection, statements_.size()), found[0]);
+    ValidateTiming(found[sections]);
+    for (std::future<void>& section : running) {
+        section.get();
+    }
+    
+    std::vector<Issue> issues;
+    for (std::vector<Issue>& section : found) {
+        issues.insert(issues.end(), std::make_move_iterator(section.begin()), std::make_move_iterator(section.end()));
+    }
+    std::stable_sort(issues.begin(), issues.end(), [](const Issue& a, const Issue& b) {
+        return a.first < b.first;
+    });
+    
+    // An unrolled loop finds its body's issues once per pass
+    issues.erase(std::unique(issues.begin(), issues.end()), issues.end());
+    
+    std::vector<std::string> result = errors_;
+    for (const Issue& issue : issues) {
+        result.push_back("Line " + std::to_string(issue.first) + ": " + issue.second);
+    }
+    return result;
+}
+
+void LystrParser::SetScreenSize(int width, int height) {
+    screenWidth_ = width;
+    screenHeight_ = height;
+}
+
+LystrLibraryReport LystrParser::ValidateLibrary(const std::vector<std::string>& filepaths, int threadCount) {
+    LystrLibraryReport report;
+    report.scripts.resize(filepaths.size());
+    if (filepaths.empty()) {
+        return report;
+    }
+    
+    if (threadCount <= 0) {
+        threadCount = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+    }
+    threadCount = std::min(threadCount, static_cast<int>(filepaths.size()));
+    
+    // Scripts are handed out one at a time, so a few long ones don't leave
+    // the other threads idle; each thread reuses one parser
+    std::atomic<size_t> next(0);
+    std::atomic<size_t> bytes(0);
+    std::atomic<size_t> commands(0);
+    auto worker = [&]() {
+        LystrParser parser;
+        for (size_t i = next++; i < filepaths.size(); i = next++) {
+            LystrLibraryReport::Script& script = report.scripts[i];
+            script.filepath = filepaths[i];
+            
+            std::ifstream file(filepaths[i], std::ios::binary);
+            if (!file.is_open()) {
+                script.issues.push_back("Could not open file: " + filepaths[i]);
+                continue;
+            }
+            std::string content((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+            
+            script.parsed = parser.Load(content);
+            script.issues = parser.GetValidationErrors(1);
+            bytes += content.size();
+            commands += parser.GetTimeline().GetSize();
+        }
+    };
+    
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (int i = 1; i < threadCount; ++i) {
+        threads.emplace_back(worker);
+    }
+    worker();
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    
+    report.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    report.bytes = bytes;
+    report.commands = commands;
+    size_t issueCount = 0;
+    for (const LystrLibraryReport::Script& script : report.scripts) {
+        issueCount += script.issues.size();
+    }
+    std::cout << "Validated " << filepaths.size() << " lystr scripts (" << report.commands << " commands) on "
+              << threadCount << " threads in " << report.seconds * 1000.0 << " ms, "
+              << report.GetMegabytesPerSecond() << " MB/s: " << issueCount << " issues" << std::endl;
+    return report;
+}
+
+bool LystrParser::Load(const std::string& source) {
+    Clear();
+    source_ = source;
+    return Reparse();
+}
+
+bool LystrParser::Reparse() {
+    ast_.Clear();
+    timeline_.Clear();
+    pooledStrings_.clear();
+    compiled_.clear();
+    compiledCommands_.clear();
+    IndexLines();
+    
+    ast_.SetRoot(ast_.AddNode(ASTNodeType::PROGRAM));
+    bool reachedEnd = false;
+    statements_ = ParseLines(1, static_cast<int>(lineStarts_.size()), reachedEnd, variables_);
+    LinkStatements(0, statements_.size());
+    Resolve();
     return !HasErrors();
 }
 
-std::vector<std::string> LystrParser::GetValidationErrors() const {
-    return errors_;
+std::vector<LystrParser::Statement> LystrParser::ParseLines(int firstLine, int lastLine, bool& reachedEnd,
+                                                            Variables variables) {
+    size_t begin = lineStarts_[firstLine - 1];
+    size_t end = static_cast<size_t>(lastLine) < lineStarts_.size() ? lineStarts_[lastLine] : source_.size();
+    lexer_ = std::make_unique<Lexer>(std::string_view(source_).substr(begin, end - begin), firstLine);
+    tokens_ = lexer_->Tokenize();
+    currentToken_ = 0;
+    reachedEnd = false;
+    
+    // Never more nodes than tokens
+    ast_.Reserve(ast_.GetNodeCount() + tokens_.size());
+    
+    std::vector<Statement> statements;
+    for (;;) {
+        // Stray semicolons are empty statements and belong to none
+        while (Match(TokenType::SEMICOLON)) {
+            ConsumeToken();
+        }
+        if (Match(TokenType::END_OF_FILE)) {
+            break;
+        }
+        
+        Statement statement;
+        statement.firstLine = CurrentToken().line;
+        statement.firstNode = static_cast<NodeId>(ast_.GetNodeCount());
+        statementErrors_.clear();
+        
+        statement.node = ParseStatement();
+        int lookedAt = statement.firstLine;
+        const Token* next = nullptr;
+        if (statement.node == kNoNode) {
+            // Out of tokens mid-statement: it may go on past these lines.
+            // Otherwise the token it failed on counts as its own, since
+            // editing that changes the error.
+            if (Match(TokenType::END_OF_FILE)) {
+                reachedEnd = true;
+            } else {
+                lookedAt = CurrentToken().line;
+                if (Match(TokenType::IDENTIFIER)) {
+                    next = &PeekToken();        // For an '=' after it
+                }
+            }
+            SkipStatement(statement.firstLine);
+        } else if (IsOpenEnded(statement.node) && tokens_[currentToken_ - 1].type != TokenType::SEMICOLON) {
+            next = &CurrentToken();
+        }
+        statement.lastLine = std::max(tokens_[currentToken_ - 1].line, lookedAt);
+        statement.endNode = static_cast<NodeId>(ast_.GetNodeCount());
+        
+        // Parsing looked at the token after the statement to see whether it
+        // went on. That line isn't the statement's, but editing it can
+        // change the statement.
+        statement.nextLine = 0;
+        if (next && next->type == TokenType::END_OF_FILE) {
+            reachedEnd = true;
+        } else if (next && next->line > statement.lastLine) {
+            statement.nextLine = next->line;
+        }
+        
+        statement.assigns = false;
+        statement.readsNames = false;
+        if (statement.node != kNoNode) {
+            for (NodeId node = statement.firstNode; node < statement.endNode; ++node) {
+                ASTNodeType type = ast_.GetNode(node).type;
+                statement.assigns = statement.assigns || type == ASTNodeType::ASSIGNMENT;
+                statement.readsNames = statement.readsNames || type == ASTNodeType::IDENTIFIER;
+            }
+        }
+        
+        CompileStatement(statement, variables, 0);
+        statement.errors.swap(statementErrors_);
+        statements.push_back(std::move(statement));
+    }
+    return statements;
 }
 
-// Parser methods (stubs)
-std::unique_ptr<ASTNode> LystrParser::ParseProgram() {
-    return std::make_unique<ASTNode>(ASTNodeType::PROGRAM);
+// Parser methods. Each returns the node it built, or kNoNode after
+// reporting an error.
+NodeId LystrParser::ParseStatement() {
+    switch (CurrentToken().type) {
+        case TokenType::REPEAT:
+        case TokenType::WHILE:
+            return ParseLoop();
+        case TokenType::IF:
+            return ParseCondition();
+        case TokenType::IDENTIFIER:
+            if (PeekToken().type == TokenType::ASSIGN) {
+                return ParseAssignment();
+            }
+            break;
+        default:
+            break;
+    }
+    return ParseCommand();
+}
+
+NodeId LystrParser::ParseCommand() {
+    const Token& name = CurrentToken();
+    if (name.type == TokenType::INVALID) {
+        AddError(DescribeInvalidToken(name), name);
+        return kNoNode;
+    }
+    
+    std::string commandName(name.value);
+    if (!IsBuiltinFunction(commandName)) {
+        AddError("Expected a command, found '" + commandName + "'", name);
+        return kNoNode;
+    }
+    
+    NodeId command = ast_.AddNode(ASTNodeType::COMMAND, name.value, name.line);
+    ConsumeToken();
+    
+    if (!Expect(TokenType::LEFT_PAREN)) {
+        AddError("Expected '(' after '" + commandName + "'", CurrentToken());
+        return kNoNode;
+    }
+    
+    NodeId parameters = ParseParameterList();
+    if (parameters == kNoNode) {
+        return kNoNode;
+    }
+    ast_.AddChild(command, parameters);
+    
+    if (!Expect(TokenType::RIGHT_PAREN)) {
+        AddError("Expected ')' to close '" + commandName + "'", CurrentToken());
+        return kNoNode;
+    }
+    Expect(TokenType::SEMICOLON);
+    return command;
 }
 
-std::unique_ptr<ASTNode> LystrParser::ParseStatement() {
-    return std::make_unique<ASTNode>(ASTNodeType::COMMAND);
+NodeId LystrParser::ParseAssignment() {
+    // name = value
+    const Token& name = CurrentToken();
+    LystrRuntimeValue runtime;
+    if (FindRuntimeValue(name.value, runtime)) {
+        AddError("'" + std::string(name.value) + "' is read from the singer and can't be assigned", name);
+        return kNoNode;
+    }
+    
+    NodeId assignment = ast_.AddNode(ASTNodeType::ASSIGNMENT, name.value, name.line);
+    ConsumeToken();
+    ConsumeToken();
+    
+    NodeId value = ParseExpression();
+    if (value == kNoNode) {
+        return kNoNode;
+    }
+    ast_.AddChild(assignment, value);
+    Expect(TokenType::SEMICOLON);
+    return assignment;
 }
 
-std::unique_ptr<ASTNode> LystrParser::ParseCommand() {
-    return std::make_unique<ASTNode>(ASTNodeType::COMMAND);
+// Expressions, loosest binding first: comparisons, then + -, then * /.
+// Operators are EXPRESSION nodes named after them, with their operands as
+// children (one for a negation).
+NodeId LystrParser::ParseExpression() {
+    NodeId left = ParseSum();
+    while (left != kNoNode && (Match(TokenType::EQUALS) || Match(TokenType::NOT_EQUALS)
+                               || Match(TokenType::LESS_THAN) || Match(TokenType::GREATER_THAN))) {
+        left = ParseOperator(left, &LystrParser::ParseSum);
+    }
+    return left;
+}
+
+NodeId LystrParser::ParseSum() {
+    NodeId left = ParseProduct();
+    while (left != kNoNode && (Match(TokenType::PLUS) || Match(TokenType::MINUS))) {
+        left = ParseOperator(left, &LystrParser::ParseProduct);
+    }
+    return left;
+}
+
+NodeId LystrParser::ParseProduct() {
+    NodeId left = ParseOperand();
+    while (left != kNoNode && (Match(TokenType::MULTIPLY) || Match(TokenType::DIVIDE))) {
+        left = ParseOperator(left, &LystrParser::ParseOperand);
+    }
+    return left;
+}
+
+NodeId LystrParser::ParseOperator(NodeId left, NodeId (LystrParser::*parseRight)()) {
+    const Token& symbol = CurrentToken();
+    NodeId node = ast_.AddNode(ASTNodeType::EXPRESSION, symbol.value, symbol.line);
+    ConsumeToken();
+    
+    NodeId right = (this->*parseRight)();
+    if (right == kNoNode) {
+        return kNoNode;
+    }
+    ast_.AddChild(node, left);
+    ast_.AddChild(node, right);
+    return node;
+}
+
+NodeId LystrParser::ParseOperand() {
+    const Token& token = CurrentToken();
+    NodeId node = kNoNode;
+    
+    switch (token.type) {
+        case TokenType::STRING:
+            if (token.value.find('\\') == std::string_view::npos) {
+                node = ast_.AddNode(ASTNodeType::LITERAL, token.value, token.line);
+            } else {
+                node = ast_.AddNode(ASTNodeType::LITERAL, Unescape(token.value), token.line);
+            }
+            break;
+        case TokenType::NUMBER:
+        case TokenType::BOOLEAN:
+            node = ast_.AddNode(ASTNodeType::LITERAL, token.value, token.line);
+            break;
+        case TokenType::MINUS: {
+            if (PeekToken().type == TokenType::NUMBER) {
+                ConsumeToken();
+                node = ast_.AddNode(ASTNodeType::LITERAL, "-" + std::string(CurrentToken().value), token.line);
+                break;
+            }
+            NodeId negation = ast_.AddNode(ASTNodeType::EXPRESSION, token.value, token.line);
+            ConsumeToken();
+            NodeId operand = ParseOperand();
+            if (operand == kNoNode) {
+                return kNoNode;
+            }
+            ast_.AddChild(negation, operand);
+            return negation;
+        }
+        case TokenType::LEFT_PAREN: {
+            ConsumeToken();
+            NodeId inner = ParseExpression();
+            if (inner == kNoNode) {
+                return kNoNode;
+            }
+            if (!Expect(TokenType::RIGHT_PAREN)) {
+                AddError("Expected ')'", CurrentToken());
+                return kNoNode;
+            }
+            return inner;
+        }
+        case TokenType::IDENTIFIER:
+            // A variable if one is defined, a runtime value (score), or
+            // else a bare word (animate(pulse, 500))
+            node = ast_.AddNode(ASTNodeType::IDENTIFIER, token.value, token.line);
+            break;
+        default:
+            break;
+    }
+    
+    if (node == kNoNode) {
+        AddError(token.type == TokenType::INVALID ? DescribeInvalidToken(token) : "Expected a value", token);
+        return kNoNode;
+    }
+    ConsumeToken();
+    return node;
+}
+
+NodeId LystrParser::ParseParameterList() {
+    NodeId list = ast_.AddNode(ASTNodeType::PARAMETER_LIST, kEmptyString, CurrentToken().line);
+    if (Match(TokenType::RIGHT_PAREN)) {
+        return list;
+    }
+    
+    for (;;) {
+        NodeId parameter = ParseParameter();
+        if (parameter == kNoNode) {
+            return kNoNode;
+        }
+        ast_.AddChild(list, parameter);
+        if (!Expect(TokenType::COMMA)) {
+            return list;
+        }
+    }
 }
 
-std::unique_ptr<ASTNode> LystrParser::ParseExpression() {
-    return std::make_unique<ASTNode>(ASTNodeType::EXPRESSION);
+NodeId LystrParser::ParseParameter() {
+    // Positional, or named: display(text = "...", duration = 500)
+    NodeId parameter = ast_.AddNode(ASTNodeType::PARAMETER, kEmptyString, CurrentToken().line);
+    if (Match(TokenType::IDENTIFIER) && PeekToken().type == TokenType::ASSIGN) {
+        ast_.GetNode(parameter).value = ast_.GetStrings().Intern(CurrentToken().value);
+        ConsumeToken();
+        ConsumeToken();
+    }
+    
+    NodeId value = ParseExpression();
+    if (value == kNoNode) {
+        return kNoNode;
+    }
+    ast_.AddChild(parameter, value);
+    return parameter;
 }
 
-std::unique_ptr<ASTNode> LystrParser::ParseParameterList() {
-    return std::make_unique<ASTNode>(ASTNodeType::PARAMETER_LIST);
+NodeId LystrParser::ParseCondition() {
+    // if (test) { ... }, optionally followed by else { ... } or else if
+    const Token& keyword = CurrentToken();
+    NodeId condition = ast_.AddNode(ASTNodeType::CONDITION, keyword.value, keyword.line);
+    ConsumeToken();
+    
+    NodeId test = ParseControl("if");
+    if (test == kNoNode) {
+        return kNoNode;
+    }
+    NodeId body = ParseBlock();
+    if (body == kNoNode) {
+        return kNoNode;
+    }
+    ast_.AddChild(condition, test);
+    ast_.AddChild(condition, body);
+    
+    if (Expect(TokenType::ELSE)) {
+        NodeId otherwise = Match(TokenType::IF) ? ParseCondition() : ParseBlock();
+        if (otherwise == kNoNode) {
+            return kNoNode;
+        }
+        ast_.AddChild(condition, otherwise);
+    }
+    Expect(TokenType::SEMICOLON);
+    return condition;
 }
 
-std::unique_ptr<ASTNode> LystrParser::ParseParameter() {
-    return std::make_unique<ASTNode>(ASTNodeType::PARAMETER);
+NodeId LystrParser::ParseLoop() {
+    // repeat (count) { ... } or while (test) { ... }
+    const Token& keyword = CurrentToken();
+    NodeId loop = ast_.AddNode(ASTNodeType::LOOP, keyword.value, keyword.line);
+    ConsumeToken();
+    
+    NodeId control = ParseControl(std::string(keyword.value));
+    if (control == kNoNode) {
+        return kNoNode;
+    }
+    NodeId body = ParseBlock();
+    if (body == kNoNode) {
+        return kNoNode;
+    }
+    ast_.AddChild(loop, control);
+    ast_.AddChild(loop, body);
+    Expect(TokenType::SEMICOLON);
+    return loop;
 }
 
-std::unique_ptr<ASTNode> LystrParser::ParseCondition() {
-    return std::make_unique<ASTNode>(ASTNodeType::CONDITION);
+NodeId LystrParser::ParseControl(const std::string& keyword) {
+    // The parenthesised expression after if, repeat or while
+    if (!Expect(TokenType::LEFT_PAREN)) {
+        AddError("Expected '(' after '" + keyword + "'", CurrentToken());
+        return kNoNode;
+    }
+    NodeId control = ParseExpression();
+    if (control == kNoNode) {
+        return kNoNode;
+    }
+    if (!Expect(TokenType::RIGHT_PAREN)) {
+        AddError("Expected ')' to close '" + keyword + "'", CurrentToken());
+        return kNoNode;
+    }
+    return control;
 }
 
-std::unique_ptr<ASTNode> LystrParser::ParseLoop() {
-    return std::make_unique<ASTNode>(ASTNodeType::LOOP);
+NodeId LystrParser::ParseBlock() {
+    const Token& open = CurrentToken();
+    if (!Expect(TokenType::LEFT_BRACE)) {
+        AddError("Expected '{'", open);
+        return kNoNode;
+    }
+    
+    NodeId block = ast_.AddNode(ASTNodeType::BLOCK, kEmptyString, open.line);
+    for (;;) {
+        while (Match(TokenType::SEMICOLON)) {
+            ConsumeToken();
+        }
+        if (Expect(TokenType::RIGHT_BRACE)) {
+            return block;
+        }
+        if (Match(TokenType::END_OF_FILE)) {
+            AddError("'{' is never closed", open);
+            return kNoNode;
+        }
+        
+        NodeId statement = ParseStatement();
+        if (statement == kNoNode) {
+            return kNoNode;
+        }
+        ast_.AddChild(block, statement);
+    }
 }
 
-std::unique_ptr<ASTNode> LystrParser::ParseBlock() {
-    return std::make_unique<ASTNode>(ASTNodeType::BLOCK);
+bool LystrParser::IsOpenEnded(NodeId node) const {
+    // An assignment's value would take in a following operator, and an
+    // if() whose last else-if has no else would take a following else
+    if (ast_.GetNode(node).type == ASTNodeType::ASSIGNMENT) {
+        return true;
+    }
+    while (node != kNoNode && ast_.GetNode(node).type == ASTNodeType::CONDITION) {
+        NodeId otherwise = ast_.NextSibling(ast_.NextSibling(ast_.FirstChild(node)));
+        if (otherwise == kNoNode) {
+            return true;
+        }
+        node = otherwise;
+    }
+    return false;
 }
 
 // Token utilities
@@ -221,18 +1159,531 @@ void LystrParser::AddError(const std::string& message) {
 }
 
 void LystrParser::AddError(const std::string& message, const Token& token) {
-    errors_.push_back("Line " + std::to_string(token.line) + ": " + message);
+    AddError(message, token.line);
+}
+
+void LystrParser::AddError(const std::string& message, int line) {
+    // Kept with the statement, so the line can follow edits above it
+    statementErrors_.emplace_back(line, message);
+}
+
+void LystrParser::SkipStatement(int line) {
+    // Resume after the statement's ';', or at the next line it doesn't have
+    while (!Match(TokenType::END_OF_FILE)) {
+        if (Expect(TokenType::SEMICOLON)) {
+            return;
+        }
+        if (CurrentToken().line > line) {
+            return;
+        }
+        ConsumeToken();
+    }
+}
+
+void LystrParser::IndexLines() {
+    lineStarts_.assign(1, 0);
+    for (size_t i = 0; i < source_.size(); ++i) {
+        if (source_[i] == '\n') {
+            lineStarts_.push_back(i + 1);
+        }
+    }
 }
 
-void LystrParser::ConvertASTToCommands(const ASTNode* node) {
-    // Stub implementation
+int LystrParser::GetLineOf(size_t offset) const {
+    return static_cast<int>(std::upper_bound(lineStarts_.begin(), lineStarts_.end(), offset) - lineStarts_.begin());
+}
+
+void LystrParser::CompileStatement(Statement& statement, Variables& variables, int lineShift) {
+    statement.compiled = false;
+    statement.branchCount = 0;
+    statement.firstInstruction = static_cast<uint32_t>(compiled_.size());
+    statement.instructionCount = 0;
+    statement.variablesAfter.reset();
+    if (statement.node == kNoNode) {
+        return;
+    }
+    
+    // Assignments go to a copy, kept only if the whole statement compiles
+    Variables assigned;
+    if (statement.assigns) {
+        assigned = variables;
+    }
+    CompileState state{&statement, statement.assigns ? &assigned : &variables, lineShift, 0, false, 0};
+    statement.compiled = CompileNode(statement.node, state);
+    if (statement.compiled) {
+        statement.instructionCount = static_cast<uint32_t>(compiled_.size() - statement.firstInstruction);
+    } else {
+        statement.branchCount = 0;
+        compiled_.resize(statement.firstInstruction);
+        compiledCommands_.resize(statement.firstInstruction);
+    }
+    
+    if (statement.assigns) {
+        if (statement.compiled) {
+            variables.swap(assigned);
+        }
+        statement.variablesAfter = std::make_unique<const Variables>(variables);
+    }
 }
 
-LystrCommand LystrParser::CreateCommand(const ASTNode* commandNode) {
+void LystrParser::RecompileFrom(size_t begin, Variables variables) {
+    // Only statements that read or set variables can come out differently.
+    // Their nodes keep the lines they were parsed at, so errors are moved
+    // to where the statement is now.
+    for (size_t i = begin; i < statements_.size(); ++i) {
+        Statement& statement = statements_[i];
+        if (statement.node == kNoNode || !(statement.assigns || statement.readsNames)) {
+            continue;
+        }
+        statementErrors_.clear();
+        CompileStatement(statement, variables, statement.firstLine - ast_.GetNode(statement.node).line);
+        statement.errors.swap(statementErrors_);
+    }
+}
+
+const LystrParser::Variables& LystrParser::GetVariablesBefore(size_t index) const {
+    for (size_t i = assignments_ > 0 ? index : 0; i > 0; --i) {
+        if (statements_[i - 1].variablesAfter) {
+            return *statements_[i - 1].variablesAfter;
+        }
+    }
+    return variables_;
+}
+
+bool LystrParser::CompileNode(NodeId node, CompileState& state) {
+    const int line = ast_.GetNode(node).line + state.lineShift;
+    auto nextIteration = [&]() {
+        if (++state.iterations > kMaxLoopIterations) {
+            AddError("Loops here run more than " + std::to_string(kMaxLoopIterations)
+                     + " times; does the while() ever end?", line);
+            return false;
+        }
+        return true;
+    };
+    
+    switch (ast_.GetNode(node).type) {
+        case ASTNodeType::COMMAND:
+            return CompileCommand(node, state);
+        
+        case ASTNodeType::ASSIGNMENT: {
+            if (state.guard != 0) {
+                AddError("Variables are set before playback, so can't be assigned inside an if() on a runtime value",
+                         line);
+                return false;
+            }
+            std::string text;
+            if (!EvaluateConstant(ast_.FirstChild(node), state, text)) {
+                return false;
+            }
+            (*state.variables)[std::string(ast_.GetValue(node))] = std::move(text);
+            return true;
+        }
+        
+        case ASTNodeType::BLOCK:
+            for (NodeId child = ast_.FirstChild(node); child != kNoNode; child = ast_.NextSibling(child)) {
+                if (!CompileNode(child, state)) {
+                    return false;
+                }
+            }
+            return true;
+        
+        case ASTNodeType::LOOP: {
+            NodeId control = ast_.FirstChild(node);
+            NodeId body = ast_.NextSibling(control);
+            if (ast_.GetValue(node) == "repeat") {
+                std::string text;
+                double count = 0.0;
+                if (!EvaluateConstant(control, state, text)) {
+                    return false;
+                }
+                if (!ToNumber(text, count) || count < 0.0 || count > kMaxLoopIterations || count != std::floor(count)) {
+                    AddError("repeat() needs a whole number from 0 to " + std::to_string(kMaxLoopIterations)
+                             + ", got '" + text + "'", line);
+                    return false;
+                }
+                for (double i = 0.0; i < count; ++i) {
+                    if (!nextIteration() || !CompileNode(body, state)) {
+                        return false;
+                    }
+                }
+                return true;
+            }
+            
+            // while: unrolled, so its test has to settle before playback
+            for (;;) {
+                Value test;
+                bool running = false;
+                if (!Evaluate(control, state, test)) {
+                    return false;
+                }
+                if (test.kind != Value::CONSTANT) {
+                    AddError("while() can't test " + GetRuntimeName(test.test.value)
+                             + ", which is only known during playback; use if()", line);
+                    return false;
+                }
+                if (!ToCondition(test.text, running)) {
+                    AddError("while() needs true, false or a number, got '" + test.text + "'", line);
+                    return false;
+                }
+                if (!running) {
+                    return true;
+                }
+                if (!nextIteration() || !CompileNode(body, state)) {
+                    return false;
+                }
+            }
+        }
+        
+        case ASTNodeType::CONDITION: {
+            NodeId control = ast_.FirstChild(node);
+            NodeId body = ast_.NextSibling(control);
+            NodeId otherwise = ast_.NextSibling(body);
+            Value test;
+            bool taken = false;
+            if (!Evaluate(control, state, test)) {
+                return false;
+            }
+            if (test.kind != Value::CONSTANT) {
+                return CompileBranch(node, test.test, state);
+            }
+            if (!ToCondition(test.text, taken)) {
+                AddError("if() needs true, false or a number, got '" + test.text + "'", line);
+                return false;
+            }
+            if (taken) {
+                return CompileNode(body, state);
+            }
+            return otherwise == kNoNode || CompileNode(otherwise, state);
+        }
+        
+        default:
+            return true;
+    }
+}
+
+bool LystrParser::CompileCommand(NodeId commandNode, CompileState& state) {
+    const std::string commandName(ast_.GetValue(commandNode));
+    const int line = ast_.GetNode(commandNode).line + state.lineShift;
     LystrCommand command;
-    command.type = LystrCommandType::DISPLAY_LYRIC;
+    command.type = GetCommandType(commandName);
     command.timestamp = 0;
-    return command;
+    
+    const std::vector<LystrParameter>& signature = functions_.at(commandName);
+    NodeId parameters = ast_.FirstChild(commandNode);
+    
+    size_t position = 0;
+    for (NodeId parameter = ast_.FirstChild(parameters); parameter != kNoNode; parameter = ast_.NextSibling(parameter)) {
+        std::string name(ast_.GetValue(parameter));
+        if (name.empty()) {
+            if (position >= signature.size()) {
+                AddError("Too many arguments to " + commandName + "()", line);
+                return false;
+            }
+            name = signature[position++].name;
+        }
+        if (!EvaluateConstant(ast_.FirstChild(parameter), state, command.parameters[name])) {
+            return false;
+        }
+    }
+    
+    uint32_t ms = 0;
+    if (command.type == LystrCommandType::SET_TIMING && !ParseMilliseconds(command.parameters["time"], ms)) {
+        AddError("timing() needs a time in milliseconds", line);
+        return false;
+    }
+    if (command.type == LystrCommandType::WAIT && !ParseMilliseconds(command.parameters["duration"], ms)) {
+        AddError("wait() needs a duration in milliseconds", line);
+        return false;
+    }
+    
+    // Every playthrough has to agree on the clock
+    if (state.guard != 0 && (command.type == LystrCommandType::SET_TIMING || command.type == LystrCommandType::WAIT)) {
+        AddError(commandName + "() can't be inside an if() on a runtime value", line);
+        return false;
+    }
+    
+    LystrInstruction instruction;
+    std::vector<std::string> errors;
+    if (!timeline_.CompileCommand(command, instruction, pooledStrings_, errors)) {
+        for (const std::string& error : errors) {
+            AddError(error, line);
+        }
+        return false;
+    }
+    instruction.guard = state.guard;
+    instruction.flags = state.elseBranch ? LystrInstruction::kElseBranch : 0;
+    
+    Statement& statement = *state.statement;
+    compiled_.push_back(instruction);
+    compiledCommands_.push_back(CompiledCommand{std::move(command), line - statement.firstLine});
+    return true;
+}
+
+bool LystrParser::CompileBranch(NodeId conditionNode, const LystrCondition& test, CompileState& state) {
+    // Decided during playback: a BRANCH records the outcome in a slot, and
+    // both bodies are compiled, guarded by that slot
+    Statement& statement = *state.statement;
+    const int line = ast_.GetNode(conditionNode).line + state.lineShift;
+    if (statement.branchCount == UINT16_MAX) {
+        AddError("Too many if()s on runtime values", line);
+        return false;
+    }
+    const uint16_t slot = statement.branchCount++;
+    
+    LystrInstruction branch = {};
+    branch.op = LystrOpcode::BRANCH;
+    branch.a = timeline_.AddCondition(test);
+    branch.b = slot;
+    branch.guard = state.guard;
+    branch.flags = state.elseBranch ? LystrInstruction::kElseBranch : 0;
+    compiled_.push_back(branch);
+    compiledCommands_.push_back(CompiledCommand{LystrCommand{}, line - statement.firstLine});
+    
+    const uint16_t outerGuard = state.guard;
+    const bool outerElse = state.elseBranch;
+    NodeId body = ast_.NextSibling(ast_.FirstChild(conditionNode));
+    NodeId otherwise = ast_.NextSibling(body);
+    
+    state.guard = static_cast<uint16_t>(slot + 1);
+    state.elseBranch = false;
+    bool compiled = CompileNode(body, state);
+    if (compiled && otherwise != kNoNode) {
+        state.elseBranch = true;
+        compiled = CompileNode(otherwise, state);
+    }
+    state.guard = outerGuard;
+    state.elseBranch = outerElse;
+    return compiled;
+}
+
+bool LystrParser::Evaluate(NodeId node, CompileState& state, Value& value) {
+    const ASTNode& info = ast_.GetNode(node);
+    const int line = info.line + state.lineShift;
+    const std::string_view text = ast_.GetValue(node);
+    value.kind = Value::CONSTANT;
+    
+    if (info.type == ASTNodeType::LITERAL) {
+        value.text.assign(text);
+        return true;
+    }
+    if (info.type == ASTNodeType::IDENTIFIER) {
+        auto variable = state.variables->find(std::string(text));
+        LystrRuntimeValue runtime;
+        if (variable != state.variables->end()) {
+            value.text = variable->second;
+        } else if (FindRuntimeValue(text, runtime)) {
+            value.kind = Value::RUNTIME;
+            value.test = LystrCondition{runtime, LystrCompare::NOT_EQUAL, 0.0f};
+        } else {
+            value.text.assign(text);
+        }
+        return true;
+    }
+    
+    // An operator
+    NodeId leftNode = ast_.FirstChild(node);
+    NodeId rightNode = ast_.NextSibling(leftNode);
+    Value left;
+    Value right;
+    if (!Evaluate(leftNode, state, left)) {
+        return false;
+    }
+    if (rightNode != kNoNode && !Evaluate(rightNode, state, right)) {
+        return false;
+    }
+    
+    const bool comparison = text == "==" || text == "!=" || text == "<" || text == ">";
+    if (left.kind != Value::CONSTANT || right.kind != Value::CONSTANT) {
+        // All that's left for playback is comparing a runtime value with a
+        // number
+        const bool runtimeOnLeft = left.kind != Value::CONSTANT;
+        const Value& runtime = runtimeOnLeft ? left : right;
+        const Value& other = runtimeOnLeft ? right : left;
+        double constant = 0.0;
+        if (!comparison || runtime.kind != Value::RUNTIME || other.kind != Value::CONSTANT
+            || !ToNumber(other.text, constant)) {
+            AddError(GetRuntimeName(runtime.test.value) + " is only known during playback, so it can only be "
+                     "compared with a number", line);
+            return false;
+        }
+        
+        value.kind = Value::CONDITION;
+        value.test.value = runtime.test.value;
+        value.test.constant = static_cast<float>(constant);
+        if (text == "==") {
+            value.test.compare = LystrCompare::EQUAL;
+        } else if (text == "!=") {
+            value.test.compare = LystrCompare::NOT_EQUAL;
+        } else {
+            // 80 < score is score > 80
+            value.test.compare = (text == "<") == runtimeOnLeft ? LystrCompare::LESS : LystrCompare::GREATER;
+        }
+        return true;
+    }
+    
+    double a = 0.0;
+    double b = 0.0;
+    if (rightNode == kNoNode) {
+        if (!ToNumber(left.text, a)) {
+            AddError("Can't negate '" + left.text + "'", line);
+            return false;
+        }
+        value.text = FormatNumber(-a);
+        return true;
+    }
+    
+    const bool numeric = ToNumber(left.text, a) && ToNumber(right.text, b);
+    if (comparison) {
+        bool result = false;
+        if (numeric) {
+            result = text == "==" ? a == b : text == "!=" ? a != b : text == "<" ? a < b : a > b;
+        } else if (text == "==" || text == "!=") {
+            result = (left.text == right.text) == (text == "==");
+        } else {
+            AddError("Can't compare '" + left.text + "' and '" + right.text + "' with " + std::string(text), line);
+            return false;
+        }
+        value.text = result ? "true" : "false";
+        return true;
+    }
+    
+    // + joins text ("Verse " + n); everything else needs numbers
+    if (!numeric) {
+        if (text == "+") {
+            value.text = left.text + right.text;
+            return true;
+        }
+        AddError("'" + left.text + "' " + std::string(text) + " '" + right.text + "' needs two numbers", line);
+        return false;
+    }
+    if (text == "/" && b == 0.0) {
+        AddError("Division by zero", line);
+        return false;
+    }
+    value.text = FormatNumber(text == "+" ? a + b : text == "-" ? a - b : text == "*" ? a * b : a / b);
+    return true;
+}
+
+bool LystrParser::EvaluateConstant(NodeId node, CompileState& state, std::string& text) {
+    Value value;
+    if (!Evaluate(node, state, value)) {
+        return false;
+    }
+    if (value.kind != Value::CONSTANT) {
+        AddError(GetRuntimeName(value.test.value) + " is only known during playback; only if() can test it",
+                 ast_.GetNode(node).line + state.lineShift);
+        return false;
+    }
+    text = std::move(value.text);
+    return true;
+}
+
+void LystrParser::LinkStatements(size_t begin, size_t end) {
+    // The program's children are the statements' command nodes, in order;
+    // splice [begin, end) between the nearest ones either side
+    auto nodeOf = [this](size_t i) { return statements_[i].node; };
+    NodeId program = ast_.GetRoot();
+    NodeId previous = kNoNode;
+    for (size_t i = begin; i > 0 && previous == kNoNode; --i) {
+        previous = nodeOf(i - 1);
+    }
+    NodeId next = kNoNode;
+    for (size_t i = end; i < statements_.size() && next == kNoNode; ++i) {
+        next = nodeOf(i);
+    }
+    
+    NodeId* link = previous == kNoNode ? &ast_.GetNode(program).firstChild : &ast_.GetNode(previous).nextSibling;
+    for (size_t i = begin; i < end; ++i) {
+        if (nodeOf(i) != kNoNode) {
+            *link = nodeOf(i);
+            previous = nodeOf(i);
+            link = &ast_.GetNode(previous).nextSibling;
+        }
+    }
+    *link = next;
+    if (next == kNoNode) {
+        ast_.GetNode(program).lastChild = previous;
+    }
+}
+
+void LystrParser::Resolve() {
+    // timing() moves the clock to an absolute time and wait() advances it;
+    // every other command happens at the current time. Branch slots are
+    // numbered per statement and made unique here. No parsing, just a walk
+    // over compiled statements, so it's cheap enough to redo in full after
+    // every edit.
+    std::vector<LystrInstruction> instructions;
+    instructions.reserve(compiled_.size());
+    errors_.clear();
+    liveNodes_ = 1;
+    assignments_ = 0;
+    
+    uint32_t time = 0;
+    size_t branchBase = 0;
+    for (Statement& statement : statements_) {
+        for (const auto& error : statement.errors) {
+            errors_.push_back("Line " + std::to_string(error.first) + ": " + error.second);
+        }
+        liveNodes_ += statement.endNode - statement.firstNode;
+        assignments_ += statement.assigns ? 1 : 0;
+        if (!statement.compiled) {
+            continue;
+        }
+        if (branchBase + statement.branchCount > UINT16_MAX) {
+            errors_.push_back("Line " + std::to_string(statement.firstLine) + ": more than "
+                              + std::to_string(UINT16_MAX) + " if()s on runtime values in the script");
+            continue;
+        }
+        
+        for (uint32_t i = 0; i < statement.instructionCount; ++i) {
+            LystrInstruction& instruction = compiled_[statement.firstInstruction + i];
+            if (instruction.op == LystrOpcode::SET_TIMING) {
+                time = instruction.a;
+            }
+            instruction.time = time;
+            if (instruction.op == LystrOpcode::WAIT) {
+                time += instruction.a;
+            }
+            
+            instructions.push_back(instruction);
+            LystrInstruction& placed = instructions.back();
+            if (placed.guard != 0) {
+                placed.guard = static_cast<uint16_t>(placed.guard + branchBase);
+            }
+            if (placed.op == LystrOpcode::BRANCH) {
+                placed.b += static_cast<uint32_t>(branchBase);
+            }
+        }
+        branchBase += statement.branchCount;
+    }
+    CompactCode(instructions.size());
+    
+    // A timing() that goes back only reorders, it doesn't drop anything
+    timeline_.SetInstructions(std::move(instructions));
+    commandsStale_ = true;
+}
+
+void LystrParser::CompactCode(size_t live) {
+    // Edits leave the instructions of the statements they replaced behind;
+    // once those outnumber the live ones, copy the live ones down
+    if (compiled_.size() <= 2 * live + kNodeSlack) {
+        return;
+    }
+    
+    std::vector<LystrInstruction> compacted;
+    std::vector<CompiledCommand> compactedCommands;
+    compacted.reserve(live);
+    compactedCommands.reserve(live);
+    for (Statement& statement : statements_) {
+        const auto first = compiled_.begin() + statement.firstInstruction;
+        const auto firstCommand = compiledCommands_.begin() + statement.firstInstruction;
+        statement.firstInstruction = static_cast<uint32_t>(compacted.size());
+        compacted.insert(compacted.end(), first, first + statement.instructionCount);
+        compactedCommands.insert(compactedCommands.end(), std::make_move_iterator(firstCommand),
+                                 std::make_move_iterator(firstCommand + statement.instructionCount));
+    }
+    compiled_.swap(compacted);
+    compiledCommands_.swap(compactedCommands);
 }
 
 LystrCommandType LystrParser::GetCommandType(const std::string& commandName) {
@@ -248,23 +1699,189 @@ LystrCommandType LystrParser::GetCommandType(const std::string& commandName) {
     return LystrCommandType::DISPLAY_LYRIC;
 }
 
-bool LystrParser::ValidateCommand(const LystrCommand& command) const {
-    return true; // Stub
+void LystrParser::ValidateSection(size_t begin, size_t end, std::vector<Issue>& issues) const {
+    for (size_t i = begin; i < end; ++i) {
+        // Statements that didn't compile have their errors already
+        const Statement& statement = statements_[i];
+        if (!statement.compiled) {
+            continue;
+        }
+        for (uint32_t k = 0; k < statement.instructionCount; ++k) {
+            const LystrInstruction& instruction = compiled_[statement.firstInstruction + k];
+            const CompiledCommand& compiled = compiledCommands_[statement.firstInstruction + k];
+            if (instruction.op != LystrOpcode::BRANCH) {
+                const int line = statement.firstLine + compiled.lineOffset;
+                ValidateParameters(compiled.command, line, issues);
+                ValidateCommand(instruction, line, issues);
+            }
+        }
+    }
 }
 
-bool LystrParser::ValidateParameters(const LystrCommand& command) const {
-    return true; // Stub
+bool LystrParser::ValidateCommand(const LystrInstruction& instruction, int line, std::vector<Issue>& issues) const {
+    const size_t issueCount = issues.size();
+    
+    switch (instruction.op) {
+        case LystrOpcode::SET_POSITION: {
+            int x = instruction.GetSignedA();
+            int y = instruction.GetSignedB();
+            if (x < 0 || y < 0 || x >= screenWidth_ || y >= screenHeight_) {
+                issues.emplace_back(line, "position(" + std::to_string(x) + ", " + std::to_string(y)
+                                    + ") is off the " + std::to_string(screenWidth_) + "x"
+                                    + std::to_string(screenHeight_) + " screen");
+            }
+            break;
+        }
+        case LystrOpcode::FADE_IN:
+        case LystrOpcode::FADE_OUT:
+            if (instruction.a == 0) {
+                issues.emplace_back(line, std::string(instruction.op == LystrOpcode::FADE_IN ? "fade_in" : "fade_out")
+                                    + "(0) has no effect");
+            }
+            break;
+        case LystrOpcode::ANIMATE_TEXT:
+            if (!LystrAnimator::IsKnownAnimation(timeline_.GetString(instruction.a))) {
+                issues.emplace_back(line, "animate(\"" + std::string(timeline_.GetString(instruction.a))
+                                    + "\") isn't an animation; try glow, pulse, slide_left, slide_right,"
+                                    " slide_up, slide_down or zoom_in");
+            }
+            break;
+        default:
+            break;
+    }
+    return issues.size() == issueCount;
 }
 
-bool LystrParser::ValidateTiming(const std::vector<LystrCommand>& commands) const {
-    return true; // Stub
+bool LystrParser::ValidateParameters(const LystrCommand& command, int line, std::vector<Issue>& issues) const {
+    const std::string commandName(LystrTimeline::GetCommandName(command.type));
+    const std::vector<LystrParameter>& signature = functions_.at(commandName);
+    const size_t issueCount = issues.size();
+    
+    for (const auto& parameter : command.parameters) {
+        auto expected = std::find_if(signature.begin(), signature.end(), [&](const LystrParameter& candidate) {
+            return candidate.name == parameter.first;
+        });
+        if (expected == signature.end()) {
+            issues.emplace_back(line, commandName + "() has no parameter '" + parameter.first + "'");
+        } else if (expected->numeric && !IsNumber(parameter.second)) {
+            issues.emplace_back(line, commandName + "(): " + parameter.first
+                                + " should be a number, got '" + parameter.second + "'");
+        }
+    }
+    for (const LystrParameter& parameter : signature) {
+        if (parameter.required && command.parameters.find(parameter.name) == command.parameters.end()) {
+            issues.emplace_back(line, commandName + "() needs " + parameter.name);
+        }
+    }
+    return issues.size() == issueCount;
+}
+
+bool LystrParser::ValidateTiming(std::vector<Issue>& issues) const {
+    const size_t issueCount = issues.size();
+    
+    // timing() blocks in source order: each should start no earlier than
+    // the previous one, and not before the previous one's wait()s run out
+    uint32_t blockStart = 0;
+    int blockLine = 0;
+    uint32_t clock = 0;
+    
+    // Commands at the same time run in the same frame, so a highlight()
+    // followed by another never shows, and neither does a fade or an
+    // animation whose curves the next one of its kind on the same lyric
+    // takes over. display(), color() and position() each make or set up a
+    // lyric of their own, so nothing replaces them. Those in a runtime
+    // if() may not run at all, so they're left out.
+    struct Shown {
+        int line;
+        LystrCommandType type;
+        LystrOpcode op;
+        uint32_t properties;    // Curves it drives on the lyric (LystrAnimator)
+    };
+    uint32_t groupTime = 0;
+    std::vector<Shown> shown;   // At groupTime, since the last display()
+    
+    for (const Statement& statement : statements_) {
+        if (!statement.compiled) {
+            continue;
+        }
+        for (uint32_t k = 0; k < statement.instructionCount; ++k) {
+            const LystrInstruction& instruction = compiled_[statement.firstInstruction + k];
+            const CompiledCommand& compiled = compiledCommands_[statement.firstInstruction + k];
+            const int line = statement.firstLine + compiled.lineOffset;
+            
+            if (instruction.op == LystrOpcode::SET_TIMING) {
+                if (blockLine > 0 && instruction.a < blockStart) {
+                    issues.emplace_back(line, "timing(" + std::to_string(instruction.a)
+                                        + ") goes back before timing(" + std::to_string(blockStart)
+                                        + ") on line " + std::to_string(blockLine));
+                } else if (instruction.a < clock) {
+                    issues.emplace_back(line, "timing(" + std::to_string(instruction.a)
+                                        + ") starts before the commands above it finish at "
+                                        + std::to_string(clock) + " ms");
+                }
+                blockStart = instruction.a;
+                blockLine = line;
+            }
+            clock = instruction.time + (instruction.op == LystrOpcode::WAIT ? instruction.a : 0);
+            
+            if (instruction.time != groupTime) {
+                groupTime = instruction.time;
+                shown.clear();
+            }
+            if (instruction.op == LystrOpcode::DISPLAY_LYRIC) {
+                // What follows acts on the new lyric (even one in an if())
+                shown.clear();
+                continue;
+            }
+            if (instruction.guard != 0) {
+                continue;
+            }
+            
+            uint32_t properties = 0;
+            if (instruction.op == LystrOpcode::FADE_IN || instruction.op == LystrOpcode::FADE_OUT) {
+                properties = 1u << static_cast<uint32_t>(LystrProperty::ALPHA);
+            } else if (instruction.op == LystrOpcode::ANIMATE_TEXT) {
+                // Unknown animations are reported by ValidateCommand
+                properties = LystrAnimator::GetAnimatedProperties(timeline_.GetString(instruction.a));
+                if (properties == 0) {
+                    continue;
+                }
+            } else if (instruction.op != LystrOpcode::HIGHLIGHT) {
+                continue;
+            }
+            
+            for (auto previous = shown.begin(); previous != shown.end();) {
+                // A fade_in() restarts the lyric's alpha from now, so it takes
+                // over a fade_out() as well
+                const bool sameKind = previous->op == instruction.op
+                    || (instruction.op == LystrOpcode::FADE_IN && previous->op == LystrOpcode::FADE_OUT);
+                if (sameKind && (previous->properties & ~properties) == 0) {
+                    issues.emplace_back(previous->line, std::string(LystrTimeline::GetCommandName(previous->type))
+                                        + "() never shows: line " + std::to_string(line)
+                                        + " replaces it at the same time (" + std::to_string(groupTime) + " ms)");
+                    previous = shown.erase(previous);
+                } else {
+                    ++previous;
+                }
+            }
+            shown.push_back(Shown{line, compiled.command.type, instruction.op, properties});
+        }
+    }
+    return issues.size() == issueCount;
 }
 
 void LystrParser::InitializeBuiltins() {
-    // Initialize built-in functions and variables
-    functions_["display"] = {"text", "duration"};
-    functions_["timing"] = {"time"};
-    functions_["color"] = {"r", "g", "b", "a"};
+    // Commands and their parameters, in positional order:
+    // name, numeric, required
+    functions_["display"] = {{"text", false, true}, {"duration", true, false}};
+    functions_["timing"] = {{"time", true, true}};
+    functions_["animate"] = {{"animation", false, true}, {"duration", true, false}};
+    functions_["color"] = {{"r", true, true}, {"g", true, true}, {"b", true, true}, {"a", true, false}};
+    functions_["position"] = {{"x", true, true}, {"y", true, true}};
+    functions_["fade_in"] = {{"duration", true, true}};
+    functions_["fade_out"] = {{"duration", true, true}};
+    functions_["highlight"] = {{"text", false, true}};
+    functions_["wait"] = {{"duration", true, true}};
 }
 
 bool LystrParser::IsBuiltinFunction(const std::string& name) const {
@@ -319,7 +1936,21 @@ bool LystrAnalyzer::HasAnimations(const std::vector<LystrCommand>& commands) {
 }
 
 bool LystrAnalyzer::HasConditionals(const std::vector<LystrCommand>& commands) {
-    // Stub - would check for conditional commands
+    // Only runtime if()s are left; constant conditions were folded away
+    for (const auto& cmd : commands) {
+        if (cmd.parameters.find("branch") != cmd.parameters.end()) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool LystrAnalyzer::HasConditionals(const LystrTimeline& timeline) {
+    for (const LystrInstruction& instruction : timeline.GetInstructions()) {
+        if (instruction.op == LystrOpcode::BRANCH) {
+            return true;
+        }
+    }
     return false;
 }
 
@@ -1,9 +1,13 @@
 #pragma once
 #include "common/Types.h"
+#include "scripting/LystrAst.h"
+#include "scripting/LystrTimeline.h"
 #include <vector>
 #include <string>
+#include <string_view>
 #include <unordered_map>
 #include <memory>
+#include <utility>
 
 namespace Lyricstator {
 
@@ -59,70 +63,36 @@ enum class TokenType {
     INVALID
 };
 
-// Token structure
+// Token structure. `value` is a slice of the lexed source, which must
+// outlive the token; string tokens exclude the quotes and keep any escapes.
 struct Token {
     TokenType type;
-    std::string value;
+    std::string_view value;
     int line;
     int column;
     
-    Token(TokenType t = TokenType::INVALID, const std::string& v = "", int l = 0, int c = 0)
+    Token(TokenType t = TokenType::INVALID, std::string_view v = {}, int l = 0, int c = 0)
         : type(t), value(v), line(l), column(c) {}
 };
 
-// AST Node types
-enum class ASTNodeType {
-    PROGRAM,
-    COMMAND,
-    EXPRESSION,
-    LITERAL,
-    IDENTIFIER,
-    PARAMETER_LIST,
-    PARAMETER,
-    CONDITION,
-    LOOP,
-    BLOCK
-};
-
-// Abstract Syntax Tree Node
-class ASTNode {
-public:
-    ASTNodeType type;
-    std::string value;
-    std::vector<std::unique_ptr<ASTNode>> children;
-    std::unordered_map<std::string, std::string> attributes;
-    
-    ASTNode(ASTNodeType t, const std::string& v = "") : type(t), value(v) {}
-    virtual ~ASTNode() = default;
-    
-    void AddChild(std::unique_ptr<ASTNode> child) {
-        children.push_back(std::move(child));
-    }
-    
-    void SetAttribute(const std::string& key, const std::string& value) {
-        attributes[key] = value;
-    }
-    
-    std::string GetAttribute(const std::string& key) const {
-        auto it = attributes.find(key);
-        return (it != attributes.end()) ? it->second : "";
-    }
-};
-
-// Lexical analyzer
+// Lexical analyzer. One pass over the source, no copies: tokens point
+// back into it. Newlines are whitespace (statements end at ';' or ')'),
+// and '#' or '//' starts a comment. Unterminated strings and stray
+// characters come back as INVALID tokens for the parser to report.
 class Lexer {
 public:
-    Lexer(const std::string& source);
+    // `firstLine` numbers the lines of a slice lexed on its own
+    Lexer(std::string_view source, int firstLine = 1);
     
-    std::vector<Token> Tokenize();
+    std::vector<Token> Tokenize();      // Ends with END_OF_FILE
     Token GetNextToken();
     bool HasMoreTokens() const;
     
 private:
-    std::string source_;
+    std::string_view source_;
     size_t position_;
+    size_t lineStart_;
     int line_;
-    int column_;
     
     char CurrentChar() const;
     char PeekChar(int offset = 1) const;
@@ -133,15 +103,44 @@ private:
     Token ReadString();
     Token ReadNumber();
     Token ReadIdentifier();
+    Token MakeToken(TokenType type, size_t start, size_t length) const;
     
-    bool IsAlpha(char c) const;
-    bool IsDigit(char c) const;
-    bool IsAlphaNumeric(char c) const;
+    static bool IsAlpha(char c);
+    static bool IsDigit(char c);
+    static bool IsAlphaNumeric(char c);
+};
+
+// A command parameter: its name, for positional arguments, and what the
+// validator expects of it
+struct LystrParameter {
+    std::string name;
+    bool numeric;
+    bool required;
+};
+
+// Outcome of validating a batch of scripts (importing a song library)
+struct LystrLibraryReport {
+    struct Script {
+        std::string filepath;
+        bool parsed = false;
+        std::vector<std::string> issues;    // Parse errors, then validation
+    };
+    
+    std::vector<Script> scripts;
+    size_t bytes = 0;
+    size_t commands = 0;
+    double seconds = 0.0;
     
-    TokenType GetKeywordType(const std::string& identifier) const;
+    double GetMegabytesPerSecond() const {
+        return seconds > 0.0 ? bytes / (1024.0 * 1024.0) / seconds : 0.0;
+    }
 };
 
-// Syntax analyzer and parser
+// Syntax analyzer and parser. Besides commands, a script can set variables
+// (beat = 60000 / 120), and use repeat (n) { }, while (test) { } and
+// if (test) { } else { }. All of that is worked out when the script is
+// compiled; only if()s on `score`, `note` or `cents`, read from the singer,
+// are left to decide during playback.
 class LystrParser {
 public:
     LystrParser();
@@ -152,39 +151,128 @@ public:
     bool ParseString(const std::string& source);
     void Clear();
     
-    // Result access
-    const std::vector<LystrCommand>& GetCommands() const { return commands_; }
+    // Live editing: replaces `removed` bytes at `position` in the script
+    // with `text` (as QTextDocument::contentsChange reports it) and parses
+    // again only the statements on the lines the edit touched. The
+    // timeline is rebuilt from every statement that parses, so a half
+    // typed line doesn't blank the preview; returns false while the script
+    // has errors.
+    bool ApplyEdit(size_t position, size_t removed, std::string_view text);
+    const std::string& GetSource() const { return source_; }
+    
+    // Result access. Commands inside a runtime if() carry a `branch`
+    // parameter naming its slot, plus `else` in the else block.
+    const std::vector<LystrCommand>& GetCommands() const;
+    const LystrTimeline& GetTimeline() const { return timeline_; }   // Compiled for playback
     const std::vector<std::string>& GetErrors() const { return errors_; }
     bool HasErrors() const { return !errors_.empty(); }
     
     // AST access (for debugging/advanced usage)
-    const ASTNode* GetAST() const { return ast_.get(); }
+    const LystrAst& GetAST() const { return ast_; }
     
-    // Validation
+    // Validation. Beyond parse errors, this flags what's legal but almost
+    // certainly a mistake: parameters that don't fit the command, timing()
+    // blocks that overlap or go back in time, highlights, fades and
+    // animations replaced before they ever show, positions off the screen
+    // and unknown animations. Large scripts are checked in sections on
+    // several threads (0 = one per core).
     bool ValidateScript() const;
-    std::vector<std::string> GetValidationErrors() const;
+    std::vector<std::string> GetValidationErrors(int threadCount = 0) const;
+    void SetScreenSize(int width, int height);
+    
+    // Parses and validates many scripts, spread over threads (0 = one per
+    // core), and prints the throughput
+    static LystrLibraryReport ValidateLibrary(const std::vector<std::string>& filepaths, int threadCount = 0);
     
 private:
-    // Lexical analysis
+    using Issue = std::pair<int, std::string>;      // Line, message
+    using Variables = std::unordered_map<std::string, std::string>;
+    
+    // The command behind an instruction (empty for a BRANCH)
+    struct CompiledCommand {
+        LystrCommand command;
+        int lineOffset;                     // From the statement's first line
+    };
+    
+    // A top-level statement and everything built from it, kept so an edit
+    // only redoes the statements on the lines it touches. Loops and
+    // compile-time if()s are already unrolled into its instructions.
+    struct Statement {
+        int firstLine;
+        int lastLine;
+        int nextLine;                       // Line of the token after it, if parsing looked there
+        NodeId firstNode;                   // Its AST nodes are [firstNode, endNode)
+        NodeId endNode;
+        NodeId node;                        // Its root, or kNoNode if it didn't parse
+        bool compiled;                      // instructions and commands are usable
+        bool assigns;                       // Sets a variable...
+        bool readsNames;                    // ...or uses one (or a bare word)
+        uint16_t branchCount;               // Its BRANCH slots are numbered from 0
+        uint32_t firstInstruction;          // Its instructions are a range of compiled_
+        uint32_t instructionCount;
+        std::unique_ptr<const Variables> variablesAfter;    // If it assigns
+        std::vector<Issue> errors;
+    };
+    
+    // A folded expression: text, or something only known during playback
+    struct Value {
+        enum Kind { CONSTANT, RUNTIME, CONDITION };
+        Kind kind = CONSTANT;
+        std::string text;
+        LystrCondition test = {};           // RUNTIME: value != 0; CONDITION: the comparison
+    };
+    
+    // Where one statement's compile is up to
+    struct CompileState {
+        Statement* statement;
+        Variables* variables;
+        int lineShift;                      // Current line minus the line its nodes were parsed at
+        uint16_t guard;                     // What's emitted sits in this runtime branch (0 = none)
+        bool elseBranch;
+        size_t iterations;                  // Loop bodies run so far
+    };
+    
+    // Lexical analysis. Tokens point into source_ and only cover the lines
+    // last parsed.
+    std::string source_;
+    std::vector<size_t> lineStarts_;    // Offset of each line in source_
     std::unique_ptr<Lexer> lexer_;
     std::vector<Token> tokens_;
     size_t currentToken_;
     
     // Parsing state
-    std::unique_ptr<ASTNode> ast_;
-    std::vector<LystrCommand> commands_;
+    LystrAst ast_;
+    std::vector<Statement> statements_;
+    size_t liveNodes_;                  // Nodes still owned by a statement
+    size_t assignments_;                // Statements that set variables
+    std::vector<LystrInstruction> compiled_;    // Statements' instructions; like the AST, edits append
+    std::vector<CompiledCommand> compiledCommands_;     // One per instruction in compiled_
+    std::vector<Issue> statementErrors_;
+    mutable std::vector<LystrCommand> commands_;    // Built on request from statements_
+    mutable bool commandsStale_;
+    LystrTimeline timeline_;
+    LystrTimeline::StringIndex pooledStrings_;
     std::vector<std::string> errors_;
     
     // Parser methods
-    std::unique_ptr<ASTNode> ParseProgram();
-    std::unique_ptr<ASTNode> ParseStatement();
-    std::unique_ptr<ASTNode> ParseCommand();
-    std::unique_ptr<ASTNode> ParseExpression();
-    std::unique_ptr<ASTNode> ParseParameterList();
-    std::unique_ptr<ASTNode> ParseParameter();
-    std::unique_ptr<ASTNode> ParseCondition();
-    std::unique_ptr<ASTNode> ParseLoop();
-    std::unique_ptr<ASTNode> ParseBlock();
+    bool Load(const std::string& source);
+    bool Reparse();
+    std::vector<Statement> ParseLines(int firstLine, int lastLine, bool& reachedEnd, Variables variables);
+    NodeId ParseStatement();
+    NodeId ParseCommand();
+    NodeId ParseAssignment();
+    NodeId ParseExpression();
+    NodeId ParseSum();
+    NodeId ParseProduct();
+    NodeId ParseOperand();
+    NodeId ParseOperator(NodeId left, NodeId (LystrParser::*parseRight)());
+    NodeId ParseParameterList();
+    NodeId ParseParameter();
+    NodeId ParseCondition();
+    NodeId ParseLoop();
+    NodeId ParseControl(const std::string& keyword);
+    NodeId ParseBlock();
+    bool IsOpenEnded(NodeId node) const;
     
     // Token utilities
     const Token& CurrentToken() const;
@@ -196,20 +284,42 @@ private:
     // Error handling
     void AddError(const std::string& message);
     void AddError(const std::string& message, const Token& token);
+    void AddError(const std::string& message, int line);
+    void SkipStatement(int line);
+    
+    // Line bookkeeping
+    void IndexLines();
+    int GetLineOf(size_t offset) const;
     
-    // AST to command conversion
-    void ConvertASTToCommands(const ASTNode* node);
-    LystrCommand CreateCommand(const ASTNode* commandNode);
+    // AST to instructions. Everything that doesn't depend on the singing is
+    // evaluated here: variables and arithmetic fold to constants, loops
+    // unroll and if()s pick their branch, so playback only ever sees plain
+    // instructions plus a BRANCH for each if() on a runtime value.
+    void CompileStatement(Statement& statement, Variables& variables, int lineShift);
+    void RecompileFrom(size_t begin, Variables variables);
+    const Variables& GetVariablesBefore(size_t index) const;
+    bool CompileNode(NodeId node, CompileState& state);
+    bool CompileCommand(NodeId commandNode, CompileState& state);
+    bool CompileBranch(NodeId conditionNode, const LystrCondition& test, CompileState& state);
+    bool Evaluate(NodeId node, CompileState& state, Value& value);
+    bool EvaluateConstant(NodeId node, CompileState& state, std::string& text);
+    void LinkStatements(size_t begin, size_t end);
+    void Resolve();
+    void CompactCode(size_t live);
     LystrCommandType GetCommandType(const std::string& commandName);
     
-    // Validation helpers
-    bool ValidateCommand(const LystrCommand& command) const;
-    bool ValidateParameters(const LystrCommand& command) const;
-    bool ValidateTiming(const std::vector<LystrCommand>& commands) const;
+    // Validation helpers. Issues are appended; each returns false if it
+    // found any.
+    void ValidateSection(size_t begin, size_t end, std::vector<Issue>& issues) const;
+    bool ValidateCommand(const LystrInstruction& instruction, int line, std::vector<Issue>& issues) const;
+    bool ValidateParameters(const LystrCommand& command, int line, std::vector<Issue>& issues) const;
+    bool ValidateTiming(std::vector<Issue>& issues) const;
+    int screenWidth_;
+    int screenHeight_;
     
     // Built-in functions and variables
-    std::unordered_map<std::string, std::string> variables_;
-    std::unordered_map<std::string, std::vector<std::string>> functions_;
+    Variables variables_;
+    std::unordered_map<std::string, std::vector<LystrParameter>> functions_;
     
     void InitializeBuiltins();
     bool IsBuiltinFunction(const std::string& name) const;
@@ -224,6 +334,7 @@ public:
     static uint32_t GetScriptDuration(const std::vector<LystrCommand>& commands);
     static bool HasAnimations(const std::vector<LystrCommand>& commands);
     static bool HasConditionals(const std::vector<LystrCommand>& commands);
+    static bool HasConditionals(const LystrTimeline& timeline);
     static std::unordered_map<std::string, int> GetCommandStats(const std::vector<LystrCommand>& commands);
 };
 
@@ -0,0 +1,190 @@
+#include "scripting/LystrTimeline.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+namespace Lyricstator {
+
+namespace {
+
+// Reads one numeric parameter; a missing one takes `fallback`
+class OperandReader {
+public:
+    OperandReader(const LystrCommand& command, std::vector<std::string>& errors)
+        : command_(command), errors_(errors), ok_(true) {}
+    
+    int64_t Read(const char* name, int64_t fallback, int64_t minimum, int64_t maximum) {
+        auto it = command_.parameters.find(name);
+        if (it == command_.parameters.end()) {
+            return fallback;
+        }
+        
+        char* end = nullptr;
+        double value = std::strtod(it->second.c_str(), &end);
+        if (it->second.empty() || *end != '\0' || !(value >= minimum && value <= maximum)) {
+            errors_.push_back(std::string(LystrTimeline::GetCommandName(command_.type)) + "(): " + name + " must be a number from " + std::to_string(minimum)
+                              + " to " + std::to_string(maximum) + ", got '" + it->second + "'");
+            ok_ = false;
+            return fallback;
+        }
+        return std::llround(value);
+    }
+    
+    const std::string& Text(const char* name) const {
+        static const std::string empty;
+        auto it = command_.parameters.find(name);
+        return it != command_.parameters.end() ? it->second : empty;
+    }
+    
+    bool IsOk() const { return ok_; }
+
+private:
+    const LystrCommand& command_;
+    std::vector<std::string>& errors_;
+    bool ok_;
+};
+
+const int64_t kMaxMs = UINT32_MAX;
+const int64_t kMaxCoordinate = 1 << 20;
+
+} // namespace
+
+bool LystrTimeline::CompileCommand(const LystrCommand& command, LystrInstruction& instruction,
+                                   StringIndex& pooled, std::vector<std::string>& errors) {
+    auto pool = [&](const std::string& text) {
+        auto it = pooled.find(text);
+        if (it != pooled.end()) {
+            return it->second;
+        }
+        uint32_t id = AddString(text);
+        pooled.emplace(text, id);
+        return id;
+    };
+    
+    instruction = LystrInstruction{};
+    OperandReader operands(command, errors);
+    
+    switch (command.type) {
+        case LystrCommandType::DISPLAY_LYRIC:
+            instruction.op = LystrOpcode::DISPLAY_LYRIC;
+            instruction.a = pool(operands.Text("text"));
+            instruction.b = static_cast<uint32_t>(operands.Read("duration", 0, 0, kMaxMs));
+            break;
+        case LystrCommandType::SET_TIMING:
+            instruction.op = LystrOpcode::SET_TIMING;
+            instruction.a = static_cast<uint32_t>(operands.Read("time", 0, 0, kMaxMs));
+            break;
+        case LystrCommandType::ANIMATE_TEXT:
+            instruction.op = LystrOpcode::ANIMATE_TEXT;
+            instruction.a = pool(operands.Text("animation"));
+            instruction.b = static_cast<uint32_t>(operands.Read("duration", 0, 0, kMaxMs));
+            break;
+        case LystrCommandType::SET_COLOR: {
+            instruction.op = LystrOpcode::SET_COLOR;
+            Color color(static_cast<uint8_t>(operands.Read("r", 255, 0, 255)),
+                        static_cast<uint8_t>(operands.Read("g", 255, 0, 255)),
+                        static_cast<uint8_t>(operands.Read("b", 255, 0, 255)),
+                        static_cast<uint8_t>(operands.Read("a", 255, 0, 255)));
+            instruction.a = PackColor(color);
+            break;
+        }
+        case LystrCommandType::SET_POSITION:
+            instruction.op = LystrOpcode::SET_POSITION;
+            instruction.a = static_cast<uint32_t>(static_cast<int32_t>(operands.Read("x", 0, -kMaxCoordinate, kMaxCoordinate)));
+            instruction.b = static_cast<uint32_t>(static_cast<int32_t>(operands.Read("y", 0, -kMaxCoordinate, kMaxCoordinate)));
+            break;
+        case LystrCommandType::FADE_IN:
+            instruction.op = LystrOpcode::FADE_IN;
+            instruction.a = static_cast<uint32_t>(operands.Read("duration", 0, 0, kMaxMs));
+            break;
+        case LystrCommandType::FADE_OUT:
+            instruction.op = LystrOpcode::FADE_OUT;
+            instruction.a = static_cast<uint32_t>(operands.Read("duration", 0, 0, kMaxMs));
+            break;
+        case LystrCommandType::HIGHLIGHT:
+            instruction.op = LystrOpcode::HIGHLIGHT;
+            instruction.a = pool(operands.Text("text"));
+            break;
+        case LystrCommandType::WAIT:
+            instruction.op = LystrOpcode::WAIT;
+            instruction.a = static_cast<uint32_t>(operands.Read("duration", 0, 0, kMaxMs));
+            break;
+    }
+    return operands.IsOk();
+}
+
+void LystrTimeline::SetInstructions(std::vector<LystrInstruction>&& instructions) {
+    auto byTime = [](const LystrInstruction& a, const LystrInstruction& b) {
+        return a.time < b.time;
+    };
+    instructions_ = std::move(instructions);
+    if (!std::is_sorted(instructions_.begin(), instructions_.end(), byTime)) {
+        std::stable_sort(instructions_.begin(), instructions_.end(), byTime);
+    }
+}
+
+void LystrTimeline::Restore(std::vector<LystrInstruction>&& instructions, std::vector<char>&& text,
+                            std::vector<uint32_t>&& offsets, std::vector<LystrCondition>&& conditions) {
+    instructions_ = std::move(instructions);
+    text_ = std::move(text);
+    offsets_ = std::move(offsets);
+    conditions_ = std::move(conditions);
+}
+
+void LystrTimeline::Clear() {
+    instructions_.clear();
+    text_.clear();
+    offsets_.assign(1, 0);
+    conditions_.clear();
+}
+
+uint32_t LystrTimeline::AddCondition(const LystrCondition& condition) {
+    conditions_.push_back(condition);
+    return static_cast<uint32_t>(conditions_.size() - 1);
+}
+
+uint32_t LystrTimeline::AddString(std::string_view text) {
+    if (offsets_.empty()) {
+        offsets_.push_back(0);
+    }
+    text_.insert(text_.end(), text.begin(), text.end());
+    offsets_.push_back(static_cast<uint32_t>(text_.size()));
+    return static_cast<uint32_t>(offsets_.size() - 2);
+}
+
+const char* LystrTimeline::GetCommandName(LystrCommandType type) {
+    switch (type) {
+        case LystrCommandType::DISPLAY_LYRIC: return "display";
+        case LystrCommandType::SET_TIMING: return "timing";
+        case LystrCommandType::ANIMATE_TEXT: return "animate";
+        case LystrCommandType::SET_COLOR: return "color";
+        case LystrCommandType::SET_POSITION: return "position";
+        case LystrCommandType::FADE_IN: return "fade_in";
+        case LystrCommandType::FADE_OUT: return "fade_out";
+        case LystrCommandType::HIGHLIGHT: return "highlight";
+        case LystrCommandType::WAIT: return "wait";
+    }
+    return "?";
+}
+
+uint32_t LystrTimeline::PackColor(const Color& color) {
+    return (static_cast<uint32_t>(color.r) << 24) | (static_cast<uint32_t>(color.g) << 16)
+         | (static_cast<uint32_t>(color.b) << 8) | color.a;
+}
+
+Color LystrTimeline::UnpackColor(uint32_t rgba) {
+    return Color(static_cast<uint8_t>(rgba >> 24), static_cast<uint8_t>(rgba >> 16),
+                 static_cast<uint8_t>(rgba >> 8), static_cast<uint8_t>(rgba));
+}
+
+bool LystrCondition::Test(float actual) const {
+    switch (compare) {
+        case LystrCompare::EQUAL: return actual == constant;
+        case LystrCompare::NOT_EQUAL: return actual != constant;
+        case LystrCompare::LESS: return actual < constant;
+        case LystrCompare::GREATER: return actual > constant;
+    }
+    return false;
+}
+
+} // namespace Lyricstator
@@ -0,0 +1,124 @@
+#pragma once
+#include "common/Types.h"
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace Lyricstator {
+
+enum class LystrOpcode : uint8_t {
+    DISPLAY_LYRIC,      // a = text, b = duration ms
+    SET_TIMING,         // a = time ms
+    ANIMATE_TEXT,       // a = animation name, b = duration ms
+    SET_COLOR,          // a = RGBA, 8 bits each, red highest
+    SET_POSITION,       // a = x, b = y (signed)
+    FADE_IN,            // a = duration ms
+    FADE_OUT,           // a = duration ms
+    HIGHLIGHT,          // a = text
+    WAIT,               // a = duration ms
+    BRANCH              // a = condition, b = branch slot to set from it
+};
+
+// Values only known while the song plays, which runtime branches test
+enum class LystrRuntimeValue : uint8_t {
+    PITCH_SCORE,        // `score`: how steadily the current note is held, 0-100
+    SUNG_NOTE,          // `note`: MIDI note being sung, 0 if none
+    PITCH_CENTS         // `cents`: how far off that note, -50 to 50
+};
+const size_t kLystrRuntimeValueCount = 3;
+
+enum class LystrCompare : uint8_t {
+    EQUAL,
+    NOT_EQUAL,
+    LESS,
+    GREATER
+};
+
+// A runtime branch's test: value <compare> constant
+struct LystrCondition {
+    LystrRuntimeValue value;
+    LystrCompare compare;
+    float constant;
+    
+    bool Test(float actual) const;
+};
+
+// One step of a compiled script. Fixed width, operands already decoded:
+// numbers as integers, text as an index into the timeline's string pool.
+// Inside a runtime if(), `guard` names the BRANCH that decides whether the
+// instruction runs.
+struct LystrInstruction {
+    static constexpr uint8_t kElseBranch = 1;   // Runs if the branch isn't taken
+    
+    uint32_t time;          // When it fires, ms
+    LystrOpcode op;
+    uint8_t flags;
+    uint16_t guard;         // 0, or 1 + the branch slot
+    uint32_t a;
+    uint32_t b;
+    
+    int32_t GetSignedA() const { return static_cast<int32_t>(a); }
+    int32_t GetSignedB() const { return static_cast<int32_t>(b); }
+};
+static_assert(sizeof(LystrInstruction) == 16, "LystrInstruction should stay 16 bytes");
+
+// A script lowered for playback: instructions sorted by time, plus a pool
+// holding each distinct string once and the tests of any runtime branches.
+// Nothing is hashed or parsed once compiled; the interpreter walks the
+// array and switches on the opcode.
+class LystrTimeline {
+public:
+    // Strings already in the pool, so each is stored once. Whoever compiles
+    // into a timeline in several goes keeps one of these alongside it.
+    using StringIndex = std::unordered_map<std::string, uint32_t>;
+    
+    // Lowers one command, adding its text to the pool. `time` is left to
+    // the caller, which knows where the script's clock is. Errors are
+    // appended to `errors`.
+    bool CompileCommand(const LystrCommand& command, LystrInstruction& instruction,
+                        StringIndex& pooled, std::vector<std::string>& errors);
+    
+    // Replaces the instructions. The interpreter relies on time order, so
+    // they're sorted (stably) unless they already are.
+    void SetInstructions(std::vector<LystrInstruction>&& instructions);
+    void Clear();
+    
+    const std::vector<LystrInstruction>& GetInstructions() const { return instructions_; }
+    size_t GetSize() const { return instructions_.size(); }
+    bool IsEmpty() const { return instructions_.empty(); }
+    
+    std::string_view GetString(uint32_t id) const {
+        return std::string_view(text_.data() + offsets_[id], offsets_[id + 1] - offsets_[id]);
+    }
+    size_t GetStringCount() const { return offsets_.empty() ? 0 : offsets_.size() - 1; }
+    
+    uint32_t AddCondition(const LystrCondition& condition);
+    const LystrCondition& GetCondition(uint32_t id) const { return conditions_[id]; }
+    size_t GetConditionCount() const { return conditions_.size(); }
+    
+    // The pool and conditions as stored, for saving a compiled script
+    const std::vector<char>& GetPoolText() const { return text_; }
+    const std::vector<uint32_t>& GetPoolOffsets() const { return offsets_; }
+    const std::vector<LystrCondition>& GetConditions() const { return conditions_; }
+    
+    // Takes back arrays saved from a timeline. The caller has checked them:
+    // instructions in time order, operands in range.
+    void Restore(std::vector<LystrInstruction>&& instructions, std::vector<char>&& text,
+                 std::vector<uint32_t>&& offsets, std::vector<LystrCondition>&& conditions);
+    
+    static const char* GetCommandName(LystrCommandType type);
+    static uint32_t PackColor(const Color& color);
+    static Color UnpackColor(uint32_t rgba);
+
+private:
+    std::vector<LystrInstruction> instructions_;
+    std::vector<char> text_;            // All strings, back to back
+    std::vector<uint32_t> offsets_;     // String i is [offsets_[i], offsets_[i + 1])
+    std::vector<LystrCondition> conditions_;
+    
+    uint32_t AddString(std::string_view text);
+};
+
+} // namespace Lyricstator